@@ -5,6 +5,7 @@ if not exist build mkdir build
 pushd build
 
 cl /EHsc^
+  /std:c++17^
   /Zi^
   /DDEBUG_DIRECTX^
   /Fe"demo-hexagonal-plane.exe"^
@@ -0,0 +1,13 @@
+#!/bin/sh
+# Headless build of the platform-neutral core - no DirectX, runs on Linux
+# Pass extra compiler flags as arguments, ex. ./build_headless.sh -DHEX_FORCE_SCALAR
+
+set -e
+
+mkdir -p build
+cd build
+
+# No FMA contraction - MSVC does not do it either, and SIMD paths are checked bit for bit against scalar ones
+${CXX:-g++} -std=c++17 -O2 -march=native -ffp-contract=off -pthread -Wall \
+  -o demo-hexagonal-plane-headless \
+  ../src/headless_main.cpp "$@"
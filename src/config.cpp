@@ -0,0 +1,26 @@
+#ifndef _H_CONFIG
+#define _H_CONFIG
+
+// Configuration variables - shared by the win32 build and the headless one
+constexpr int DISPLAY_FACTOR = 100;
+constexpr int DISPLAY_WIDTH = 16 * DISPLAY_FACTOR;
+constexpr int DISPLAY_HEIGHT = 9 * DISPLAY_FACTOR;
+
+// CPU occlusion buffer, same aspect as the display - coarse enough to rasterize in a fraction of a millisecond.
+// Twice this culls about as many chunks and costs twice as much, most of it filling pixels.
+constexpr int OCCLUSION_WIDTH = 128;
+constexpr int OCCLUSION_HEIGHT = OCCLUSION_WIDTH * DISPLAY_HEIGHT / DISPLAY_WIDTH;
+
+// Compiled shaders and pipeline state blobs, relative to the working directory
+constexpr const char* SHADER_CACHE_PATH = "shader_cache.bin";
+
+// Chrome trace written by the profiler (F9 in the window, `profile` headless)
+constexpr const char* PROFILE_TRACE_PATH = "profile_trace.json";
+
+// Baked hex map - generated from a random seed when missing, delete it for a new map
+constexpr const char* HEX_MAP_PATH = "hexmap.bin";
+
+// Render command capture (F7 in the window starts and stops it, `replay` headless plays it back)
+constexpr const char* COMMAND_CAPTURE_PATH = "command_capture.bin";
+
+#endif /* _H_CONFIG */
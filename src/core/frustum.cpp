@@ -0,0 +1,198 @@
+#ifndef _H_CORE_FRUSTUM
+#define _H_CORE_FRUSTUM
+
+#include "simd.cpp"
+#include "memory.cpp"
+#include "timer.cpp"
+
+#include <cstdint>
+#include <cmath>
+
+// Six planes stored SoA, a point p is inside when x*p.x + y*p.y + z*p.z + w >= 0 for every plane
+typedef struct Frustum {
+  float plane_x[6];
+  float plane_y[6];
+  float plane_z[6];
+  float plane_w[6];
+} Frustum;
+
+// Boxes stored SoA so one plane can be tested against SIMD_WIDTH boxes at once.
+// Arrays are allocated with room for a whole register past count.
+typedef struct AabbSoA {
+  float* min_x = nullptr;
+  float* min_y = nullptr;
+  float* min_z = nullptr;
+  float* max_x = nullptr;
+  float* max_y = nullptr;
+  float* max_z = nullptr;
+  size_t count = 0;
+} AabbSoA;
+
+typedef struct CullStats {
+  size_t tested = 0;
+  size_t visible = 0;
+  double time_ms = 0.0;
+} CullStats;
+
+bool allocateAabbSoA(AabbSoA& boxes, size_t count) {
+  const size_t bytes = (count + 8) * sizeof(float);
+  boxes = {};
+  boxes.min_x = (float*)alignedAlloc(bytes);
+  boxes.min_y = (float*)alignedAlloc(bytes);
+  boxes.min_z = (float*)alignedAlloc(bytes);
+  boxes.max_x = (float*)alignedAlloc(bytes);
+  boxes.max_y = (float*)alignedAlloc(bytes);
+  boxes.max_z = (float*)alignedAlloc(bytes);
+  if (!boxes.min_x || !boxes.min_y || !boxes.min_z || !boxes.max_x || !boxes.max_y || !boxes.max_z) {
+    return false;
+  }
+  // Padding lanes get zero sized boxes, results past count are thrown away anyway
+  for (size_t i = 0; i < count + 8; i++) {
+    boxes.min_x[i] = boxes.min_y[i] = boxes.min_z[i] = 0.0f;
+    boxes.max_x[i] = boxes.max_y[i] = boxes.max_z[i] = 0.0f;
+  }
+  boxes.count = count;
+  return true;
+}
+
+void destroyAabbSoA(AabbSoA& boxes) {
+  alignedFree(boxes.min_x);
+  alignedFree(boxes.min_y);
+  alignedFree(boxes.min_z);
+  alignedFree(boxes.max_x);
+  alignedFree(boxes.max_y);
+  alignedFree(boxes.max_z);
+  boxes = {};
+}
+
+// Gribb/Hartmann plane extraction. Matrix is row-major for row vectors (v * M), the way
+// DirectXMath stores world * view * projection. Clip space z goes from 0 to 1 like in D3D.
+void frustumFromMatrix(Frustum& frustum, const float m[16]) {
+  // Column j of M is (m[j], m[4 + j], m[8 + j], m[12 + j])
+  float c[4][4];
+  for (int j = 0; j < 4; j++) {
+    c[j][0] = m[j];
+    c[j][1] = m[4 + j];
+    c[j][2] = m[8 + j];
+    c[j][3] = m[12 + j];
+  }
+
+  float planes[6][4];
+  for (int k = 0; k < 4; k++) {
+    planes[0][k] = c[3][k] + c[0][k]; // Left
+    planes[1][k] = c[3][k] - c[0][k]; // Right
+    planes[2][k] = c[3][k] + c[1][k]; // Bottom
+    planes[3][k] = c[3][k] - c[1][k]; // Top
+    planes[4][k] = c[2][k];           // Near
+    planes[5][k] = c[3][k] - c[2][k]; // Far
+  }
+
+  for (int p = 0; p < 6; p++) {
+    float length = sqrtf(planes[p][0] * planes[p][0] + planes[p][1] * planes[p][1] + planes[p][2] * planes[p][2]);
+    float inv = length > 0.0f ? 1.0f / length : 0.0f;
+    frustum.plane_x[p] = planes[p][0] * inv;
+    frustum.plane_y[p] = planes[p][1] * inv;
+    frustum.plane_z[p] = planes[p][2] * inv;
+    frustum.plane_w[p] = planes[p][3] * inv;
+  }
+}
+
+// Reference version, one box at a time. Kept around to check the SIMD path against.
+size_t cullAabbsScalar(const Frustum& frustum, const AabbSoA& boxes, uint32_t* visible) {
+  size_t count = 0;
+  for (size_t i = 0; i < boxes.count; i++) {
+    bool inside = true;
+    for (int p = 0; p < 6 && inside; p++) {
+      // Corner of the box furthest along the plane normal
+      float x = frustum.plane_x[p] >= 0.0f ? boxes.max_x[i] : boxes.min_x[i];
+      float y = frustum.plane_y[p] >= 0.0f ? boxes.max_y[i] : boxes.min_y[i];
+      float z = frustum.plane_z[p] >= 0.0f ? boxes.max_z[i] : boxes.min_z[i];
+      inside = frustum.plane_x[p] * x + frustum.plane_y[p] * y + frustum.plane_z[p] * z + frustum.plane_w[p] >= 0.0f;
+    }
+    if (inside) visible[count++] = (uint32_t)i;
+  }
+  return count;
+}
+
+// Writes indices of boxes that intersect the frustum into visible (room for boxes.count entries
+// is enough) and returns how many there are. Conservative - boxes near frustum corners may pass.
+size_t cullAabbs(const Frustum& frustum, const AabbSoA& boxes, uint32_t* visible, CullStats* stats = nullptr) {
+  uint64_t start = timerNanoseconds();
+  size_t count = 0;
+
+#if defined(HEX_SIMD_AVX2) || defined(HEX_SIMD_SSE)
+  #if defined(HEX_SIMD_AVX2)
+    #define CULL_WIDTH 8
+    #define CULL_VEC __m256
+    #define CULL_SET1 _mm256_set1_ps
+    #define CULL_LOAD _mm256_load_ps
+    #define CULL_ADD _mm256_add_ps
+    #define CULL_MUL _mm256_mul_ps
+    #define CULL_OR _mm256_or_ps
+    #define CULL_LESS(a, b) _mm256_cmp_ps(a, b, _CMP_LT_OQ)
+    #define CULL_MASK _mm256_movemask_ps
+    #define CULL_ZERO _mm256_setzero_ps
+  #else
+    #define CULL_WIDTH 4
+    #define CULL_VEC __m128
+    #define CULL_SET1 _mm_set1_ps
+    #define CULL_LOAD _mm_load_ps
+    #define CULL_ADD _mm_add_ps
+    #define CULL_MUL _mm_mul_ps
+    #define CULL_OR _mm_or_ps
+    #define CULL_LESS(a, b) _mm_cmplt_ps(a, b)
+    #define CULL_MASK _mm_movemask_ps
+    #define CULL_ZERO _mm_setzero_ps
+  #endif
+  // The plane is the same for every lane, so picking the far corner is a per-plane pointer choice, no blends
+  const float* px[6]; const float* py[6]; const float* pz[6];
+  for (int p = 0; p < 6; p++) {
+    px[p] = frustum.plane_x[p] >= 0.0f ? boxes.max_x : boxes.min_x;
+    py[p] = frustum.plane_y[p] >= 0.0f ? boxes.max_y : boxes.min_y;
+    pz[p] = frustum.plane_z[p] >= 0.0f ? boxes.max_z : boxes.min_z;
+  }
+
+  for (size_t i = 0; i < boxes.count; i += CULL_WIDTH) {
+    CULL_VEC outside = CULL_ZERO();
+    for (int p = 0; p < 6; p++) {
+      CULL_VEC d = CULL_SET1(frustum.plane_w[p]);
+      d = CULL_ADD(d, CULL_MUL(CULL_SET1(frustum.plane_x[p]), CULL_LOAD(px[p] + i)));
+      d = CULL_ADD(d, CULL_MUL(CULL_SET1(frustum.plane_y[p]), CULL_LOAD(py[p] + i)));
+      d = CULL_ADD(d, CULL_MUL(CULL_SET1(frustum.plane_z[p]), CULL_LOAD(pz[p] + i)));
+      outside = CULL_OR(outside, CULL_LESS(d, CULL_ZERO()));
+    }
+
+    // Compact the visible lanes straight into the output list
+    unsigned int mask = ~(unsigned int)CULL_MASK(outside) & ((1u << CULL_WIDTH) - 1);
+    while (mask) {
+      unsigned int lane = 0;
+      while (!(mask & (1u << lane))) lane++;
+      mask &= mask - 1;
+      size_t index = i + lane;
+      if (index < boxes.count) visible[count++] = (uint32_t)index;
+    }
+  }
+
+  #undef CULL_WIDTH
+  #undef CULL_VEC
+  #undef CULL_SET1
+  #undef CULL_LOAD
+  #undef CULL_ADD
+  #undef CULL_MUL
+  #undef CULL_OR
+  #undef CULL_LESS
+  #undef CULL_MASK
+  #undef CULL_ZERO
+#else
+  count = cullAabbsScalar(frustum, boxes, visible);
+#endif
+
+  if (stats) {
+    stats->tested += boxes.count;
+    stats->visible += count;
+    stats->time_ms += (double)(timerNanoseconds() - start) / 1000000.0;
+  }
+  return count;
+}
+
+#endif /* _H_CORE_FRUSTUM */
@@ -0,0 +1,315 @@
+#ifndef _H_CORE_JOBS
+#define _H_CORE_JOBS
+
+// Work-stealing job system - one Chase-Lev deque per worker, no lock on the push/pop/steal path.
+// Owners push and pop at the bottom of their own deque (LIFO, cache friendly), idle workers steal
+// from the top of somebody else's. Jobs form trees: a child keeps its parent unfinished until it is
+// done, and waiting on a job means running other jobs until its counter hits zero.
+// The calling thread is worker 0, so createJobSystem(jobs, 1) runs everything inline.
+#include "parallel.cpp"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <new>
+#include <thread>
+
+constexpr int JOB_MAX_WORKERS = 64;
+constexpr uint32_t JOB_POOL_SIZE = 4096;    // Jobs alive at once per worker - slots are recycled in a ring
+constexpr uint32_t JOB_DEQUE_SIZE = 4096;   // Power of two, a full deque runs the job inline instead
+constexpr size_t JOB_MAX_SPLITS = 1024;     // jobParallelFor never makes more leaves than this
+
+struct JobSystem;
+struct Job;
+typedef void (*JobFunction)(JobSystem& jobs, Job* job);
+
+typedef struct Job {
+  JobFunction function = nullptr;
+  Job* parent = nullptr;
+  std::atomic<int32_t> unfinished{0};   // 1 for itself plus one per unfinished child
+  void* data = nullptr;                 // Owned by whoever created the job, has to outlive it
+  size_t begin = 0;                     // Range for jobParallelFor, free to use otherwise
+  size_t end = 0;
+} Job;
+
+// Chase-Lev with a fixed ring, see "Correct and Efficient Work-Stealing for Weak Memory Models" (Le et al.)
+typedef struct JobDeque {
+  alignas(64) std::atomic<int64_t> top{0};
+  alignas(64) std::atomic<int64_t> bottom{0};
+  std::atomic<Job*> slots[JOB_DEQUE_SIZE];
+} JobDeque;
+
+typedef struct JobWorkerStats {
+  uint64_t executed = 0;
+  uint64_t stolen = 0;        // Jobs this worker took from other deques
+  uint64_t steal_misses = 0;  // Steal attempts that came back empty
+} JobWorkerStats;
+
+// Only the owner bumps these, atomics so other threads can read (or reset) them while it runs
+typedef struct JobWorkerCounters {
+  std::atomic<uint64_t> executed{0};
+  std::atomic<uint64_t> stolen{0};
+  std::atomic<uint64_t> steal_misses{0};
+} JobWorkerCounters;
+
+static inline void jobCount(std::atomic<uint64_t>& counter) {
+  counter.store(counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+}
+
+typedef struct alignas(64) JobWorker {
+  JobDeque deque;
+  Job pool[JOB_POOL_SIZE];
+  uint32_t pool_next = 0;
+  uint32_t victim_seed = 0;
+  JobWorkerCounters stats;
+  std::thread thread;
+} JobWorker;
+
+typedef struct JobSystem {
+  int worker_count = 0;
+  JobWorker* workers = nullptr;
+  std::atomic<bool> running{false};
+  // Parking for idle workers only - never touched while there is work around
+  std::atomic<int> sleepers{0};
+  std::mutex sleep_mutex;
+  std::condition_variable sleep_cv;
+} JobSystem;
+
+// Worker index of the current thread, -1 for threads that are not part of a job system
+static thread_local int jobWorkerIndex = -1;
+
+static bool jobDequePush(JobDeque& deque, Job* job) {
+  int64_t b = deque.bottom.load(std::memory_order_relaxed);
+  int64_t t = deque.top.load(std::memory_order_acquire);
+  if (b - t >= (int64_t)JOB_DEQUE_SIZE) return false;
+  // Release on the slot as well as the fence, so the job's fields are visible to whoever loads it
+  deque.slots[b & (JOB_DEQUE_SIZE - 1)].store(job, std::memory_order_release);
+  std::atomic_thread_fence(std::memory_order_release);
+  deque.bottom.store(b + 1, std::memory_order_relaxed);
+  return true;
+}
+
+static Job* jobDequePop(JobDeque& deque) {
+  int64_t b = deque.bottom.load(std::memory_order_relaxed) - 1;
+  deque.bottom.store(b, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  int64_t t = deque.top.load(std::memory_order_relaxed);
+  if (t > b) {
+    deque.bottom.store(b + 1, std::memory_order_relaxed);
+    return nullptr;
+  }
+  Job* job = deque.slots[b & (JOB_DEQUE_SIZE - 1)].load(std::memory_order_relaxed);
+  if (t == b) {
+    // Last one - race the thieves for it
+    if (!deque.top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) job = nullptr;
+    deque.bottom.store(b + 1, std::memory_order_relaxed);
+  }
+  return job;
+}
+
+static Job* jobDequeSteal(JobDeque& deque) {
+  int64_t t = deque.top.load(std::memory_order_acquire);
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  int64_t b = deque.bottom.load(std::memory_order_acquire);
+  if (t >= b) return nullptr;
+  Job* job = deque.slots[t & (JOB_DEQUE_SIZE - 1)].load(std::memory_order_acquire);
+  if (!deque.top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) return nullptr;
+  return job;
+}
+
+static bool jobWorkAvailable(JobSystem& jobs) {
+  for (int i = 0; i < jobs.worker_count; i++) {
+    JobDeque& deque = jobs.workers[i].deque;
+    if (deque.bottom.load(std::memory_order_acquire) > deque.top.load(std::memory_order_acquire)) return true;
+  }
+  return false;
+}
+
+static inline int jobCurrentWorker(JobSystem& jobs) {
+  // Threads outside the system act as worker 0 - only the owner thread should do that
+  return jobWorkerIndex >= 0 && jobWorkerIndex < jobs.worker_count ? jobWorkerIndex : 0;
+}
+
+// Own deque first, then one random victim
+static Job* jobNext(JobSystem& jobs, int worker) {
+  JobWorker& self = jobs.workers[worker];
+  Job* job = jobDequePop(self.deque);
+  if (job != nullptr || jobs.worker_count == 1) return job;
+
+  self.victim_seed = self.victim_seed * 1664525u + 1013904223u;
+  int victim = (int)((self.victim_seed >> 8) % (uint32_t)(jobs.worker_count - 1));
+  if (victim >= worker) victim++;
+  job = jobDequeSteal(jobs.workers[victim].deque);
+  if (job != nullptr) {
+    jobCount(self.stats.stolen);
+  } else {
+    jobCount(self.stats.steal_misses);
+  }
+  return job;
+}
+
+static void jobFinish(Job* job) {
+  while (job != nullptr) {
+    // Parent is read first - once the counter hits zero the owner is free to recycle the slot
+    Job* parent = job->parent;
+    if (job->unfinished.fetch_sub(1, std::memory_order_acq_rel) != 1) break;
+    job = parent;
+  }
+}
+
+static void jobExecute(JobSystem& jobs, int worker, Job* job) {
+  job->function(jobs, job);
+  jobCount(jobs.workers[worker].stats.executed);
+  jobFinish(job);
+}
+
+// Runs one job if there is one, false when every deque looked empty
+static bool jobHelp(JobSystem& jobs, int worker) {
+  Job* job = jobNext(jobs, worker);
+  if (job == nullptr) return false;
+  jobExecute(jobs, worker, job);
+  return true;
+}
+
+static void jobWorkerMain(JobSystem* jobs, int worker) {
+  jobWorkerIndex = worker;
+  int idle = 0;
+  while (jobs->running.load(std::memory_order_acquire)) {
+    if (jobHelp(*jobs, worker)) {
+      idle = 0;
+      continue;
+    }
+    if (++idle < 64) {
+      std::this_thread::yield();
+      continue;
+    }
+    // Park - sleepers is bumped before looking at the deques again, jobRun looks at sleepers after
+    // publishing, so one of the two always sees the other
+    std::unique_lock<std::mutex> lock(jobs->sleep_mutex);
+    jobs->sleepers.fetch_add(1, std::memory_order_seq_cst);
+    if (jobs->running.load(std::memory_order_acquire) && !jobWorkAvailable(*jobs)) {
+      jobs->sleep_cv.wait_for(lock, std::chrono::milliseconds(10));
+    }
+    jobs->sleepers.fetch_sub(1, std::memory_order_relaxed);
+    idle = 0;
+  }
+}
+
+bool createJobSystem(JobSystem& jobs, int threads) {
+  threads = threads < 1 ? 1 : (threads > JOB_MAX_WORKERS ? JOB_MAX_WORKERS : threads);
+  jobs.workers = new (std::nothrow) JobWorker[threads];
+  if (jobs.workers == nullptr) return false;
+  jobs.worker_count = threads;
+  for (int i = 0; i < threads; i++) jobs.workers[i].victim_seed = 0x9e3779b9u * (uint32_t)(i + 1);
+  jobs.running.store(true, std::memory_order_release);
+  jobWorkerIndex = 0;
+  for (int i = 1; i < threads; i++) jobs.workers[i].thread = std::thread(jobWorkerMain, &jobs, i);
+  return true;
+}
+
+void destroyJobSystem(JobSystem& jobs) {
+  jobs.running.store(false, std::memory_order_release);
+  {
+    std::lock_guard<std::mutex> lock(jobs.sleep_mutex);
+    jobs.sleep_cv.notify_all();
+  }
+  for (int i = 1; i < jobs.worker_count; i++) jobs.workers[i].thread.join();
+  delete[] jobs.workers;
+  jobs.workers = nullptr;
+  jobs.worker_count = 0;
+}
+
+// Job from this thread's pool. With a parent, the parent stays unfinished until this one is done.
+// The slot gets recycled after JOB_POOL_SIZE more jobs from the same worker.
+Job* jobCreate(JobSystem& jobs, JobFunction function, void* data, Job* parent = nullptr) {
+  JobWorker& self = jobs.workers[jobCurrentWorker(jobs)];
+  Job* job = &self.pool[self.pool_next++ & (JOB_POOL_SIZE - 1)];
+  job->function = function;
+  job->parent = parent;
+  job->data = data;
+  job->begin = 0;
+  job->end = 0;
+  job->unfinished.store(1, std::memory_order_relaxed);
+  if (parent != nullptr) parent->unfinished.fetch_add(1, std::memory_order_relaxed);
+  return job;
+}
+
+void jobRun(JobSystem& jobs, Job* job) {
+  int worker = jobCurrentWorker(jobs);
+  if (!jobDequePush(jobs.workers[worker].deque, job)) {
+    jobExecute(jobs, worker, job);
+    return;
+  }
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (jobs.sleepers.load(std::memory_order_relaxed) > 0) {
+    std::lock_guard<std::mutex> lock(jobs.sleep_mutex);
+    jobs.sleep_cv.notify_one();
+  }
+}
+
+// Keeps running jobs (this one's children or anybody's) until job and its children are done
+void jobWait(JobSystem& jobs, Job* job) {
+  int worker = jobCurrentWorker(jobs);
+  while (job->unfinished.load(std::memory_order_acquire) > 0) {
+    if (!jobHelp(jobs, worker)) std::this_thread::yield();
+  }
+}
+
+inline bool jobIsDone(const Job* job) {
+  return job->unfinished.load(std::memory_order_acquire) == 0;
+}
+
+template <typename Fn>
+static void jobParallelForSplit(JobSystem& jobs, Job* job) {
+  const size_t grain = reinterpret_cast<size_t*>(job->data)[1];
+  while (job->end - job->begin > grain) {
+    // Hand the upper half to a child, keep splitting the lower one - thieves take the big halves
+    size_t middle = job->begin + (job->end - job->begin) / 2;
+    Job* child = jobCreate(jobs, jobParallelForSplit<Fn>, job->data, job);
+    child->begin = middle;
+    child->end = job->end;
+    jobRun(jobs, child);
+    job->end = middle;
+  }
+  Fn& fn = *reinterpret_cast<Fn*>(reinterpret_cast<void**>(job->data)[0]);
+  fn(job->begin, job->end);
+}
+
+// fn(begin, end) over [0, count) in ranges of at least grain, blocks until done.
+// The calling thread takes part, nested calls from inside jobs are fine.
+template <typename Fn>
+void jobParallelFor(JobSystem& jobs, size_t count, size_t grain, Fn fn) {
+  if (count == 0) return;
+  grain = grain < 1 ? 1 : grain;
+  if (count / grain > JOB_MAX_SPLITS) grain = (count + JOB_MAX_SPLITS - 1) / JOB_MAX_SPLITS;
+
+  // data[0] - the functor, data[1] - grain
+  size_t data[2] = { (size_t)reinterpret_cast<uintptr_t>(&fn), grain };
+  Job* root = jobCreate(jobs, jobParallelForSplit<Fn>, data);
+  root->begin = 0;
+  root->end = count;
+  jobExecute(jobs, jobCurrentWorker(jobs), root);
+  jobWait(jobs, root);
+}
+
+JobWorkerStats jobSystemStats(const JobSystem& jobs) {
+  JobWorkerStats total = {};
+  for (int i = 0; i < jobs.worker_count; i++) {
+    total.executed += jobs.workers[i].stats.executed.load(std::memory_order_relaxed);
+    total.stolen += jobs.workers[i].stats.stolen.load(std::memory_order_relaxed);
+    total.steal_misses += jobs.workers[i].stats.steal_misses.load(std::memory_order_relaxed);
+  }
+  return total;
+}
+
+void resetJobSystemStats(JobSystem& jobs) {
+  for (int i = 0; i < jobs.worker_count; i++) {
+    jobs.workers[i].stats.executed.store(0, std::memory_order_relaxed);
+    jobs.workers[i].stats.stolen.store(0, std::memory_order_relaxed);
+    jobs.workers[i].stats.steal_misses.store(0, std::memory_order_relaxed);
+  }
+}
+
+#endif /* _H_CORE_JOBS */
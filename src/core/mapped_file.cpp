@@ -0,0 +1,133 @@
+#ifndef _H_CORE_MAPPED_FILE
+#define _H_CORE_MAPPED_FILE
+
+// Read-only file mappings - mmap on POSIX, MapViewOfFile on Windows. The whole file is one view, the OS
+// pages it in on first touch and can drop clean pages whenever it wants, so files bigger than RAM are fine
+// as long as only part of them is in use at a time.
+#include <cstdint>
+#include <cstddef>
+#include <cstdio>
+
+#if defined(_WIN32)
+  #include <windows.h>
+  #include <psapi.h>
+#else
+  #include <fcntl.h>
+  #include <sys/mman.h>
+  #include <sys/stat.h>
+  #include <unistd.h>
+#endif
+
+constexpr uint64_t MAPPED_PAGE_SIZE = 4096;  // Smallest page on every platform we run on
+
+typedef struct MappedFile {
+  const uint8_t* data = nullptr;
+  uint64_t size = 0;
+#if defined(_WIN32)
+  HANDLE file = INVALID_HANDLE_VALUE;
+  HANDLE mapping = nullptr;
+#else
+  int fd = -1;
+#endif
+} MappedFile;
+
+void closeMappedFile(MappedFile& file) {
+#if defined(_WIN32)
+  if (file.data) UnmapViewOfFile(file.data);
+  if (file.mapping) CloseHandle(file.mapping);
+  if (file.file != INVALID_HANDLE_VALUE) CloseHandle(file.file);
+#else
+  if (file.data) munmap(const_cast<uint8_t*>(file.data), (size_t)file.size);
+  if (file.fd >= 0) close(file.fd);
+#endif
+  file = {};
+}
+
+// Maps the whole file, nothing is read yet. Empty files do not map.
+bool openMappedFile(MappedFile& file, const char* path) {
+  file = {};
+#if defined(_WIN32)
+  file.file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+  if (file.file == INVALID_HANDLE_VALUE) return false;
+  LARGE_INTEGER size;
+  if (!GetFileSizeEx(file.file, &size) || size.QuadPart <= 0) {
+    closeMappedFile(file);
+    return false;
+  }
+  file.size = (uint64_t)size.QuadPart;
+  file.mapping = CreateFileMappingA(file.file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+  if (file.mapping == nullptr) {
+    closeMappedFile(file);
+    return false;
+  }
+  file.data = reinterpret_cast<const uint8_t*>(MapViewOfFile(file.mapping, FILE_MAP_READ, 0, 0, 0));
+#else
+  file.fd = open(path, O_RDONLY);
+  if (file.fd < 0) return false;
+  struct stat info;
+  if (fstat(file.fd, &info) != 0 || info.st_size <= 0) {
+    closeMappedFile(file);
+    return false;
+  }
+  file.size = (uint64_t)info.st_size;
+  void* data = mmap(nullptr, (size_t)file.size, PROT_READ, MAP_SHARED, file.fd, 0);
+  file.data = data == MAP_FAILED ? nullptr : reinterpret_cast<const uint8_t*>(data);
+#endif
+  if (file.data == nullptr) {
+    closeMappedFile(file);
+    return false;
+  }
+  return true;
+}
+
+static inline void mappedFilePageRange(const MappedFile& file, uint64_t offset, uint64_t size, uint64_t& first, uint64_t& end) {
+  first = offset & ~(MAPPED_PAGE_SIZE - 1);
+  end = offset + size < file.size ? offset + size : file.size;
+}
+
+// Brings a range in - asks for read-ahead, then touches every page so the caller returns with it resident.
+// Meant for a background thread, whoever reads the range afterwards does not fault.
+void mappedFilePrefetch(const MappedFile& file, uint64_t offset, uint64_t size) {
+  uint64_t first, end;
+  mappedFilePageRange(file, offset, size, first, end);
+  if (first >= end) return;
+#if !defined(_WIN32)
+  madvise(const_cast<uint8_t*>(file.data) + first, (size_t)(end - first), MADV_WILLNEED);
+#endif
+  const volatile uint8_t* bytes = file.data;
+  uint8_t sink = 0;
+  for (uint64_t page = first; page < end; page += MAPPED_PAGE_SIZE) sink ^= bytes[page];
+  (void)sink;
+}
+
+// Drops a range from this process - the data stays valid, touching it again pages it back in from the file
+void mappedFileEvict(const MappedFile& file, uint64_t offset, uint64_t size) {
+  uint64_t first, end;
+  mappedFilePageRange(file, offset, size, first, end);
+  if (first >= end) return;
+#if defined(_WIN32)
+  // Unlocking pages that were never locked fails, but takes them out of the working set anyway
+  VirtualUnlock(const_cast<uint8_t*>(file.data) + first, (SIZE_T)(end - first));
+#else
+  madvise(const_cast<uint8_t*>(file.data) + first, (size_t)(end - first), MADV_DONTNEED);
+#endif
+}
+
+// Resident set size of the whole process in bytes, mapped file pages included. 0 when it can not be read.
+uint64_t processResidentBytes() {
+#if defined(_WIN32)
+  PROCESS_MEMORY_COUNTERS counters = {};
+  counters.cb = sizeof(counters);
+  if (!K32GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) return 0;
+  return (uint64_t)counters.WorkingSetSize;
+#else
+  FILE* statm = fopen("/proc/self/statm", "r");
+  if (statm == nullptr) return 0;
+  unsigned long long pages = 0, resident = 0;
+  int read = fscanf(statm, "%llu %llu", &pages, &resident);
+  fclose(statm);
+  return read == 2 ? (uint64_t)resident * (uint64_t)sysconf(_SC_PAGESIZE) : 0;
+#endif
+}
+
+#endif /* _H_CORE_MAPPED_FILE */
@@ -0,0 +1,34 @@
+#ifndef _H_CORE_MEMORY
+#define _H_CORE_MEMORY
+
+#include <cstdlib>
+#include <cstddef>
+
+// SIMD kernels want at least 32 byte alignment, a cache line is fine for everything we do
+constexpr size_t DEFAULT_ALIGNMENT = 64;
+
+// Platform-neutral aligned malloc/free - the CRT on Windows does not have aligned_alloc
+inline void* alignedAlloc(size_t size, size_t alignment = DEFAULT_ALIGNMENT) {
+  if (size == 0) size = alignment;
+#if defined(_MSC_VER)
+  return _aligned_malloc(size, alignment);
+#else
+  // aligned_alloc wants size to be a multiple of alignment
+  size = (size + alignment - 1) & ~(alignment - 1);
+  return aligned_alloc(alignment, size);
+#endif
+}
+
+inline void alignedFree(void* ptr) {
+#if defined(_MSC_VER)
+  _aligned_free(ptr);
+#else
+  free(ptr);
+#endif
+}
+
+inline size_t alignUp(size_t value, size_t alignment) {
+  return (value + alignment - 1) & ~(alignment - 1);
+}
+
+#endif /* _H_CORE_MEMORY */
@@ -0,0 +1,35 @@
+#ifndef _H_CORE_PARALLEL
+#define _H_CORE_PARALLEL
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+inline int hardwareThreads() {
+  unsigned int n = std::thread::hardware_concurrency();
+  return n == 0 ? 1 : (int)n;
+}
+
+// Runs fn(index) for every index in [0, count) on up to `threads` threads, the calling thread included.
+// Indices are handed out one at a time, so uneven work balances itself. Blocks until everything is done.
+template <typename Fn>
+void parallelFor(size_t count, int threads, Fn fn) {
+  if (threads <= 1 || count <= 1) {
+    for (size_t i = 0; i < count; i++) fn(i);
+    return;
+  }
+
+  std::atomic<size_t> next(0);
+  auto worker = [&]() {
+    for (size_t i = next.fetch_add(1); i < count; i = next.fetch_add(1)) fn(i);
+  };
+
+  size_t spawn = (size_t)threads - 1 < count - 1 ? (size_t)threads - 1 : count - 1;
+  std::vector<std::thread> pool;
+  pool.reserve(spawn);
+  for (size_t i = 0; i < spawn; i++) pool.emplace_back(worker);
+  worker();
+  for (std::thread& t : pool) t.join();
+}
+
+#endif /* _H_CORE_PARALLEL */
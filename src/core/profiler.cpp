@@ -0,0 +1,235 @@
+#ifndef _H_CORE_PROFILER
+#define _H_CORE_PROFILER
+
+// Hierarchical frame profiler. PROFILE_SCOPE("name") records one complete event per scope into a ring
+// owned by the calling thread - one writer per ring, so a scope costs two clock reads and a few stores.
+// Readers (trace export) copy rings out and throw away whatever the writer may have overwritten meanwhile.
+// Extra tracks, ex. GPU timestamps, are rings too, written by whoever owns them.
+// Build with HEX_NO_PROFILER to compile the scopes out.
+#include "timer.cpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+constexpr uint32_t PROFILE_RING_SIZE = 16384;    // Events kept per track, power of two
+constexpr int PROFILE_MAX_TRACKS = 80;           // Every thread that records takes one, so do extra tracks
+constexpr uint32_t PROFILE_FRAME_HISTORY = 512;  // Frames the rolling percentiles look at
+
+typedef struct ProfileEvent {
+  const char* name;     // Has to outlive the profiler - string literals
+  uint64_t start_ns;
+  uint64_t end_ns;
+  uint32_t depth;
+  uint32_t frame;
+} ProfileEvent;
+
+typedef struct ProfileTrack {
+  char name[32] = {};
+  int index = 0;
+  uint32_t depth = 0;              // Open scopes, only touched by the writer
+  std::atomic<uint64_t> head{0};   // Events ever written, newest one sits at (head - 1) % PROFILE_RING_SIZE
+  ProfileEvent events[PROFILE_RING_SIZE];
+} ProfileTrack;
+
+// Last PROFILE_FRAME_HISTORY samples of something measured once per frame
+typedef struct RollingStats {
+  float samples[PROFILE_FRAME_HISTORY];
+  uint32_t count = 0;
+  uint32_t next = 0;
+} RollingStats;
+
+typedef struct ProfileFrameStats {
+  float p50_ms = 0.0f;
+  float p99_ms = 0.0f;
+  float max_ms = 0.0f;
+  uint32_t frames = 0;
+} ProfileFrameStats;
+
+typedef struct Profiler {
+  std::atomic<bool> enabled{true};
+  std::atomic<int> track_count{0};
+  std::atomic<ProfileTrack*> tracks[PROFILE_MAX_TRACKS] = {};
+  std::atomic<uint32_t> frame{0};
+  uint64_t frame_start_ns = 0;
+  RollingStats cpu_frames;     // Time between profilerEndFrame calls
+  RollingStats gpu_frames;     // Filled by whoever reads GPU timestamps back
+} Profiler;
+
+// One per process - tracks are never freed, a thread keeps its ring for good
+static Profiler profiler;
+static thread_local ProfileTrack* profileThreadTrack = nullptr;
+static thread_local bool profileThreadTrackTried = false;
+
+void rollingStatsAdd(RollingStats& stats, float value) {
+  stats.samples[stats.next] = value;
+  stats.next = (stats.next + 1) % PROFILE_FRAME_HISTORY;
+  if (stats.count < PROFILE_FRAME_HISTORY) stats.count++;
+}
+
+ProfileFrameStats rollingStatsSummary(const RollingStats& stats) {
+  ProfileFrameStats summary = {};
+  summary.frames = stats.count;
+  if (stats.count == 0) return summary;
+  float sorted[PROFILE_FRAME_HISTORY];
+  memcpy(sorted, stats.samples, stats.count * sizeof(float));
+  std::sort(sorted, sorted + stats.count);
+  // Nearest rank
+  summary.p50_ms = sorted[(stats.count * 50 + 99) / 100 - 1];
+  summary.p99_ms = sorted[(stats.count * 99 + 99) / 100 - 1];
+  summary.max_ms = sorted[stats.count - 1];
+  return summary;
+}
+
+// New track, nullptr once PROFILE_MAX_TRACKS are taken - events meant for it are dropped then.
+// Threads that come and go (ex. parallelFor helpers) should not record, each one would take a track.
+ProfileTrack* profilerCreateTrack(const char* name) {
+  int index = profiler.track_count.fetch_add(1, std::memory_order_relaxed);
+  if (index >= PROFILE_MAX_TRACKS) return nullptr;
+  ProfileTrack* track = new ProfileTrack();
+  snprintf(track->name, sizeof(track->name), "%s", name);
+  track->index = index;
+  profiler.tracks[index].store(track, std::memory_order_release);
+  return track;
+}
+
+// Calling thread's track, created on first use
+ProfileTrack* profilerThreadTrack() {
+  if (!profileThreadTrackTried) {
+    profileThreadTrackTried = true;
+    char name[32];
+    snprintf(name, sizeof(name), "thread %d", profiler.track_count.load(std::memory_order_relaxed));
+    profileThreadTrack = profilerCreateTrack(name);
+  }
+  return profileThreadTrack;
+}
+
+void profilerSetThreadName(const char* name) {
+  ProfileTrack* track = profilerThreadTrack();
+  if (track != nullptr) snprintf(track->name, sizeof(track->name), "%s", name);
+}
+
+// Single writer per track
+inline void profilerRecord(ProfileTrack* track, const char* name, uint64_t startNs, uint64_t endNs, uint32_t depth) {
+  uint64_t head = track->head.load(std::memory_order_relaxed);
+  ProfileEvent& event = track->events[head & (PROFILE_RING_SIZE - 1)];
+  event.name = name;
+  event.start_ns = startNs;
+  event.end_ns = endNs;
+  event.depth = depth;
+  event.frame = profiler.frame.load(std::memory_order_relaxed);
+  track->head.store(head + 1, std::memory_order_release);
+}
+
+class ProfileScope {
+public:
+  explicit ProfileScope(const char* name) : name_(name) {
+    if (!profiler.enabled.load(std::memory_order_relaxed)) return;
+    track_ = profilerThreadTrack();
+    if (track_ == nullptr) return;
+    track_->depth++;
+    start_ = timerNanoseconds();
+  }
+
+  ~ProfileScope() {
+    if (track_ == nullptr) return;
+    uint64_t end = timerNanoseconds();
+    track_->depth--;
+    profilerRecord(track_, name_, start_, end, track_->depth);
+  }
+
+  ProfileScope(const ProfileScope&) = delete;
+  ProfileScope& operator=(const ProfileScope&) = delete;
+
+private:
+  const char* name_;
+  ProfileTrack* track_ = nullptr;
+  uint64_t start_ = 0;
+};
+
+#if defined(HEX_NO_PROFILER)
+  #define PROFILE_SCOPE(name)
+#else
+  #define PROFILE_CONCAT_INNER(a, b) a##b
+  #define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+  #define PROFILE_SCOPE(name) ProfileScope PROFILE_CONCAT(profileScope, __LINE__)(name)
+#endif
+
+// Call once per frame from the thread that owns the frame loop
+void profilerEndFrame() {
+  uint64_t now = timerNanoseconds();
+  if (profiler.frame_start_ns != 0) rollingStatsAdd(profiler.cpu_frames, (float)((double)(now - profiler.frame_start_ns) / 1000000.0));
+  profiler.frame_start_ns = now;
+  profiler.frame.fetch_add(1, std::memory_order_relaxed);
+}
+
+// Copies out what the track still holds. The writer keeps going meanwhile, so anything it could have
+// started overwriting during the copy is dropped.
+size_t profilerSnapshotTrack(const ProfileTrack& track, std::vector<ProfileEvent>& out) {
+  out.clear();
+  uint64_t head = track.head.load(std::memory_order_acquire);
+  uint64_t first = head > PROFILE_RING_SIZE ? head - PROFILE_RING_SIZE : 0;
+  out.reserve((size_t)(head - first));
+  for (uint64_t i = first; i < head; i++) out.push_back(track.events[i & (PROFILE_RING_SIZE - 1)]);
+
+  uint64_t after = track.head.load(std::memory_order_acquire);
+  uint64_t safe = after >= PROFILE_RING_SIZE ? after - PROFILE_RING_SIZE + 1 : 0;
+  if (safe > first) {
+    size_t drop = (size_t)(safe - first) < out.size() ? (size_t)(safe - first) : out.size();
+    out.erase(out.begin(), out.begin() + drop);
+  }
+  return out.size();
+}
+
+static void profilerWriteJsonString(FILE* file, const char* text) {
+  fputc('"', file);
+  for (const char* c = text; *c; c++) {
+    if (*c == '"' || *c == '\\') fputc('\\', file);
+    if ((unsigned char)*c >= 0x20) fputc(*c, file);
+  }
+  fputc('"', file);
+}
+
+// Chrome trace event format - open with chrome://tracing or ui.perfetto.dev.
+// Timestamps are microseconds from the oldest event still around. Returns events written, -1 on failure.
+long profilerWriteChromeTrace(const char* path) {
+  const int trackCount = (std::min)(profiler.track_count.load(std::memory_order_acquire), PROFILE_MAX_TRACKS);
+  std::vector<std::vector<ProfileEvent>> snapshots((size_t)trackCount);
+  std::vector<const ProfileTrack*> tracks((size_t)trackCount, nullptr);
+  uint64_t origin = UINT64_MAX;
+  for (int i = 0; i < trackCount; i++) {
+    tracks[i] = profiler.tracks[i].load(std::memory_order_acquire);
+    if (tracks[i] == nullptr) continue;
+    profilerSnapshotTrack(*tracks[i], snapshots[i]);
+    for (const ProfileEvent& event : snapshots[i]) origin = (std::min)(origin, event.start_ns);
+  }
+
+  FILE* file = fopen(path, "wb");
+  if (file == nullptr) return -1;
+  fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+  long written = 0;
+  bool first = true;
+  for (int i = 0; i < trackCount; i++) {
+    if (tracks[i] == nullptr) continue;
+    fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":", first ? "" : ",\n", i);
+    profilerWriteJsonString(file, tracks[i]->name);
+    fprintf(file, "}}");
+    first = false;
+    for (const ProfileEvent& event : snapshots[i]) {
+      fprintf(file, ",\n{\"name\":");
+      profilerWriteJsonString(file, event.name);
+      fprintf(file, ",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"frame\":%u,\"depth\":%u}}",
+          i, (double)(event.start_ns - origin) / 1000.0, (double)(event.end_ns - event.start_ns) / 1000.0, event.frame, event.depth);
+      written++;
+    }
+  }
+  fprintf(file, "\n]}\n");
+  bool ok = ferror(file) == 0;
+  ok = fclose(file) == 0 && ok;
+  return ok ? written : -1;
+}
+
+#endif /* _H_CORE_PROFILER */
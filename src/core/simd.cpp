@@ -0,0 +1,61 @@
+#ifndef _H_CORE_SIMD
+#define _H_CORE_SIMD
+
+// Picks the widest instruction set the compiler is allowed to emit.
+// MSVC only defines __AVX2__ with /arch:AVX2, x64 always has SSE2.
+// HEX_FORCE_SCALAR is there so we can check SIMD paths against plain C++ code.
+#if !defined(HEX_FORCE_SCALAR) && defined(__AVX2__)
+  #define HEX_SIMD_AVX2 1
+  #define HEX_SIMD_SSE 1
+  #include <immintrin.h>
+#elif !defined(HEX_FORCE_SCALAR) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+  #define HEX_SIMD_SSE 1
+  #include <emmintrin.h>
+#elif !defined(HEX_FORCE_SCALAR) && (defined(__ARM_NEON) || defined(_M_ARM64))
+  #define HEX_SIMD_NEON 1
+  #include <arm_neon.h>
+#endif
+
+// Half float conversions - every AVX2 CPU has F16C, GCC/Clang still want it enabled on its own (-mf16c or -march)
+#if defined(HEX_SIMD_AVX2) && (defined(__F16C__) || defined(_MSC_VER))
+  #define HEX_SIMD_F16C 1
+#endif
+
+#include <cstdint>
+#if defined(_MSC_VER)
+  #include <intrin.h>
+#endif
+
+// Number of float lanes the widest path works on - buffers written by SIMD kernels get padded by this
+#if defined(HEX_SIMD_AVX2)
+constexpr int SIMD_WIDTH = 8;
+#elif defined(HEX_SIMD_SSE) || defined(HEX_SIMD_NEON)
+constexpr int SIMD_WIDTH = 4;
+#else
+constexpr int SIMD_WIDTH = 1;
+#endif
+
+// Index of the lowest set bit, value must not be 0 - for walking bit masks
+inline int lowestBit64(uint64_t value) {
+#if defined(_MSC_VER)
+  unsigned long index;
+  _BitScanForward64(&index, value);
+  return (int)index;
+#else
+  return __builtin_ctzll(value);
+#endif
+}
+
+inline const char* simdName() {
+#if defined(HEX_SIMD_AVX2)
+  return "AVX2";
+#elif defined(HEX_SIMD_SSE)
+  return "SSE2";
+#elif defined(HEX_SIMD_NEON)
+  return "NEON";
+#else
+  return "scalar";
+#endif
+}
+
+#endif /* _H_CORE_SIMD */
@@ -0,0 +1,295 @@
+#ifndef _H_CORE_SIMD_MATH
+#define _H_CORE_SIMD_MATH
+
+// Portable stand-in for the parts of DirectXMath we use - row-major matrices for row vectors, v * world * view * projection.
+// Every function does the same float operations in the same order as DirectXMath's SSE2 path (no FMA, it is
+// off there by default and -ffp-contract=off keeps GCC from adding it), so results match it bit for bit - and
+// AVX2, SSE2, NEON and scalar builds match each other. Not matched: XMMatrixInverse, mat4Inverse goes through
+// cofactors instead; normalizing a zero vector gives NaN here.
+#include "simd.cpp"
+#include "matrix.cpp"
+
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+
+constexpr float MATH_PI = 3.141592654f;
+constexpr float MATH_2PI = 6.283185307f;
+constexpr float MATH_1DIV2PI = 0.159154943f;
+constexpr float MATH_PIDIV2 = 1.570796327f;
+constexpr float MATH_PIDIV4 = 0.785398163f;
+
+typedef struct Float3 {
+  float x, y, z;
+} Float3;
+
+typedef struct Float4 {
+  float x, y, z, w;
+} Float4;
+
+// Same 64 bytes as XMMATRIX and XMFLOAT4X4, can go into a constant buffer as is
+typedef struct alignas(16) Mat4 {
+  float m[16];
+} Mat4;
+
+// Sine and cosine at once, 11/10-degree minimax polynomials - XMScalarSinCos, so matrices built from angles
+// come out the same as with DirectXMath
+inline void scalarSinCos(float value, float& outSin, float& outCos) {
+  // Value to y in [-pi, pi]
+  float quotient = MATH_1DIV2PI * value;
+  quotient = value >= 0.0f ? (float)(int)(quotient + 0.5f) : (float)(int)(quotient - 0.5f);
+  float y = value - MATH_2PI * quotient;
+
+  // y to [-pi/2, pi/2] with sin(y) = sin(value)
+  float sign = 1.0f;
+  if (y > MATH_PIDIV2) {
+    y = MATH_PI - y;
+    sign = -1.0f;
+  } else if (y < -MATH_PIDIV2) {
+    y = -MATH_PI - y;
+    sign = -1.0f;
+  }
+  const float y2 = y * y;
+  outSin = (((((-2.3889859e-08f * y2 + 2.7525562e-06f) * y2 - 0.00019840874f) * y2 + 0.0083333310f) * y2 - 0.16666667f) * y2 + 1.0f) * y;
+  const float p = ((((-2.6051615e-07f * y2 + 2.4760495e-05f) * y2 - 0.0013888378f) * y2 + 0.041666638f) * y2 - 0.5f) * y2 + 1.0f;
+  outCos = sign * p;
+}
+
+inline Float3 float3Sub(Float3 a, Float3 b) {
+  return { a.x - b.x, a.y - b.y, a.z - b.z };
+}
+
+// (x * x + y * y) + z * z, the order XMVector3Dot sums in
+inline float float3Dot(Float3 a, Float3 b) {
+  return (a.x * b.x + a.y * b.y) + a.z * b.z;
+}
+
+inline Float3 float3Cross(Float3 a, Float3 b) {
+  return { a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x };
+}
+
+// Divides by the length like XMVector3Normalize, no multiply by a reciprocal
+inline Float3 float3Normalize(Float3 v) {
+  const float length = sqrtf(float3Dot(v, v));
+  return { v.x / length, v.y / length, v.z / length };
+}
+
+inline Mat4 mat4Identity() {
+  Mat4 out = {};
+  out.m[0] = out.m[5] = out.m[10] = out.m[15] = 1.0f;
+  return out;
+}
+
+inline Mat4 mat4Transpose(const Mat4& a) {
+  Mat4 out;
+  for (int r = 0; r < 4; r++) {
+    for (int c = 0; c < 4; c++) out.m[c * 4 + r] = a.m[r * 4 + c];
+  }
+  return out;
+}
+
+// Left handed view matrix looking from eye at at - XMMatrixLookAtLH
+Mat4 mat4LookAtLH(Float3 eye, Float3 at, Float3 up) {
+  const Float3 z = float3Normalize(float3Sub(at, eye));
+  const Float3 x = float3Normalize(float3Cross(up, z));
+  const Float3 y = float3Cross(z, x);
+  const Float3 negEye = { -eye.x, -eye.y, -eye.z };
+  Mat4 out = {};
+  out.m[0] = x.x; out.m[1] = y.x; out.m[2] = z.x;
+  out.m[4] = x.y; out.m[5] = y.y; out.m[6] = z.y;
+  out.m[8] = x.z; out.m[9] = y.z; out.m[10] = z.z;
+  out.m[12] = float3Dot(x, negEye);
+  out.m[13] = float3Dot(y, negEye);
+  out.m[14] = float3Dot(z, negEye);
+  out.m[15] = 1.0f;
+  return out;
+}
+
+// Left handed projection, depth 0 at nearZ to 1 at farZ - XMMatrixPerspectiveFovLH
+Mat4 mat4PerspectiveFovLH(float fovY, float aspect, float nearZ, float farZ) {
+  float sinFov, cosFov;
+  scalarSinCos(0.5f * fovY, sinFov, cosFov);
+  const float height = cosFov / sinFov;
+  const float range = farZ / (farZ - nearZ);
+  Mat4 out = {};
+  out.m[0] = height / aspect;
+  out.m[5] = height;
+  out.m[10] = range;
+  out.m[11] = 1.0f;
+  out.m[14] = -range * nearZ;
+  return out;
+}
+
+Mat4 mat4RotationX(float angle) {
+  float s, c;
+  scalarSinCos(angle, s, c);
+  Mat4 out = mat4Identity();
+  out.m[5] = c;  out.m[6] = s;
+  out.m[9] = -s; out.m[10] = c;
+  return out;
+}
+
+Mat4 mat4RotationY(float angle) {
+  float s, c;
+  scalarSinCos(angle, s, c);
+  Mat4 out = mat4Identity();
+  out.m[0] = c; out.m[2] = -s;
+  out.m[8] = s; out.m[10] = c;
+  return out;
+}
+
+Mat4 mat4RotationZ(float angle) {
+  float s, c;
+  scalarSinCos(angle, s, c);
+  Mat4 out = mat4Identity();
+  out.m[0] = c;  out.m[1] = s;
+  out.m[4] = -s; out.m[5] = c;
+  return out;
+}
+
+// a * b - rows of a as row vectors through b. Per element (x * b0 + z * b2) + (y * b1 + w * b3), the pairing
+// XMMatrixMultiply uses. out may alias a or b.
+inline void mat4MultiplyScalar(const float* a, const float* b, float* out) {
+  float m[16];
+  for (int r = 0; r < 4; r++) {
+    const float x = a[r * 4], y = a[r * 4 + 1], z = a[r * 4 + 2], w = a[r * 4 + 3];
+    for (int c = 0; c < 4; c++) m[r * 4 + c] = (x * b[c] + z * b[8 + c]) + (y * b[4 + c] + w * b[12 + c]);
+  }
+  memcpy(out, m, sizeof(m));
+}
+
+inline void mat4MultiplySimd(const float* a, const float* b, float* out) {
+#if defined(HEX_SIMD_AVX2)
+  // Two rows per register, each 128-bit lane is one row
+  const __m256 b0 = _mm256_broadcast_ps((const __m128*)(b + 0));
+  const __m256 b1 = _mm256_broadcast_ps((const __m128*)(b + 4));
+  const __m256 b2 = _mm256_broadcast_ps((const __m128*)(b + 8));
+  const __m256 b3 = _mm256_broadcast_ps((const __m128*)(b + 12));
+  const __m256 rows01 = _mm256_loadu_ps(a);
+  const __m256 rows23 = _mm256_loadu_ps(a + 8);
+  __m256 results[2];
+  const __m256 rows[2] = { rows01, rows23 };
+  for (int i = 0; i < 2; i++) {
+    __m256 x = _mm256_mul_ps(_mm256_permute_ps(rows[i], 0x00), b0);
+    __m256 y = _mm256_mul_ps(_mm256_permute_ps(rows[i], 0x55), b1);
+    __m256 z = _mm256_mul_ps(_mm256_permute_ps(rows[i], 0xaa), b2);
+    __m256 w = _mm256_mul_ps(_mm256_permute_ps(rows[i], 0xff), b3);
+    results[i] = _mm256_add_ps(_mm256_add_ps(x, z), _mm256_add_ps(y, w));
+  }
+  _mm256_storeu_ps(out, results[0]);
+  _mm256_storeu_ps(out + 8, results[1]);
+#elif defined(HEX_SIMD_SSE)
+  const __m128 b0 = _mm_loadu_ps(b), b1 = _mm_loadu_ps(b + 4), b2 = _mm_loadu_ps(b + 8), b3 = _mm_loadu_ps(b + 12);
+  __m128 results[4];
+  for (int r = 0; r < 4; r++) {
+    const __m128 row = _mm_loadu_ps(a + r * 4);
+    __m128 x = _mm_mul_ps(_mm_shuffle_ps(row, row, 0x00), b0);
+    __m128 y = _mm_mul_ps(_mm_shuffle_ps(row, row, 0x55), b1);
+    __m128 z = _mm_mul_ps(_mm_shuffle_ps(row, row, 0xaa), b2);
+    __m128 w = _mm_mul_ps(_mm_shuffle_ps(row, row, 0xff), b3);
+    results[r] = _mm_add_ps(_mm_add_ps(x, z), _mm_add_ps(y, w));
+  }
+  for (int r = 0; r < 4; r++) _mm_storeu_ps(out + r * 4, results[r]);
+#elif defined(HEX_SIMD_NEON)
+  const float32x4_t b0 = vld1q_f32(b), b1 = vld1q_f32(b + 4), b2 = vld1q_f32(b + 8), b3 = vld1q_f32(b + 12);
+  float32x4_t results[4];
+  for (int r = 0; r < 4; r++) {
+    const float32x4_t row = vld1q_f32(a + r * 4);
+    // Separate multiplies and adds, not vmlaq/vfmaq - keeps the rounding of the other paths
+    float32x4_t x = vmulq_n_f32(b0, vgetq_lane_f32(row, 0));
+    float32x4_t y = vmulq_n_f32(b1, vgetq_lane_f32(row, 1));
+    float32x4_t z = vmulq_n_f32(b2, vgetq_lane_f32(row, 2));
+    float32x4_t w = vmulq_n_f32(b3, vgetq_lane_f32(row, 3));
+    results[r] = vaddq_f32(vaddq_f32(x, z), vaddq_f32(y, w));
+  }
+  for (int r = 0; r < 4; r++) vst1q_f32(out + r * 4, results[r]);
+#else
+  mat4MultiplyScalar(a, b, out);
+#endif
+}
+
+inline Mat4 mat4Multiply(const Mat4& a, const Mat4& b) {
+  Mat4 out;
+  mat4MultiplySimd(a.m, b.m, out.m);
+  return out;
+}
+
+inline Mat4 operator*(const Mat4& a, const Mat4& b) {
+  return mat4Multiply(a, b);
+}
+
+// Returns false for singular matrices, out untouched
+inline bool mat4Inverse(Mat4& out, const Mat4& a) {
+  return matrixInverse(out.m, a.m);
+}
+
+// out[i] = a[i] * b for count matrices - ex. every object's world matrix times one view projection
+void mat4MultiplyBatch(const Mat4* a, const Mat4& b, Mat4* out, size_t count) {
+  for (size_t i = 0; i < count; i++) mat4MultiplySimd(a[i].m, b.m, out[i].m);
+}
+
+void mat4MultiplyBatchScalar(const Mat4* a, const Mat4& b, Mat4* out, size_t count) {
+  for (size_t i = 0; i < count; i++) mat4MultiplyScalar(a[i].m, b.m, out[i].m);
+}
+
+// (x, y, z, 1) * m for count SoA points, w dropped - XMVector3Transform order, x * r0 + (y * r1 + (z * r2 + r3)).
+// Outputs may alias the inputs.
+void transformPointsScalar(const Mat4& m, const float* x, const float* y, const float* z, float* outX, float* outY, float* outZ, size_t count) {
+  const float* r = m.m;
+  for (size_t i = 0; i < count; i++) {
+    const float px = x[i], py = y[i], pz = z[i];
+    outX[i] = px * r[0] + (py * r[4] + (pz * r[8] + r[12]));
+    outY[i] = px * r[1] + (py * r[5] + (pz * r[9] + r[13]));
+    outZ[i] = px * r[2] + (py * r[6] + (pz * r[10] + r[14]));
+  }
+}
+
+void transformPoints(const Mat4& m, const float* x, const float* y, const float* z, float* outX, float* outY, float* outZ, size_t count) {
+  size_t i = 0;
+#if defined(HEX_SIMD_AVX2) || defined(HEX_SIMD_SSE) || defined(HEX_SIMD_NEON)
+  const float* r = m.m;
+#endif
+#if defined(HEX_SIMD_AVX2)
+  for (; i + 8 <= count; i += 8) {
+    const __m256 px = _mm256_loadu_ps(x + i), py = _mm256_loadu_ps(y + i), pz = _mm256_loadu_ps(z + i);
+    __m256 c[3];
+    for (int k = 0; k < 3; k++) {
+      __m256 v = _mm256_add_ps(_mm256_mul_ps(pz, _mm256_set1_ps(r[8 + k])), _mm256_set1_ps(r[12 + k]));
+      v = _mm256_add_ps(_mm256_mul_ps(py, _mm256_set1_ps(r[4 + k])), v);
+      c[k] = _mm256_add_ps(_mm256_mul_ps(px, _mm256_set1_ps(r[k])), v);
+    }
+    _mm256_storeu_ps(outX + i, c[0]);
+    _mm256_storeu_ps(outY + i, c[1]);
+    _mm256_storeu_ps(outZ + i, c[2]);
+  }
+#elif defined(HEX_SIMD_SSE)
+  for (; i + 4 <= count; i += 4) {
+    const __m128 px = _mm_loadu_ps(x + i), py = _mm_loadu_ps(y + i), pz = _mm_loadu_ps(z + i);
+    __m128 c[3];
+    for (int k = 0; k < 3; k++) {
+      __m128 v = _mm_add_ps(_mm_mul_ps(pz, _mm_set1_ps(r[8 + k])), _mm_set1_ps(r[12 + k]));
+      v = _mm_add_ps(_mm_mul_ps(py, _mm_set1_ps(r[4 + k])), v);
+      c[k] = _mm_add_ps(_mm_mul_ps(px, _mm_set1_ps(r[k])), v);
+    }
+    _mm_storeu_ps(outX + i, c[0]);
+    _mm_storeu_ps(outY + i, c[1]);
+    _mm_storeu_ps(outZ + i, c[2]);
+  }
+#elif defined(HEX_SIMD_NEON)
+  for (; i + 4 <= count; i += 4) {
+    const float32x4_t px = vld1q_f32(x + i), py = vld1q_f32(y + i), pz = vld1q_f32(z + i);
+    float32x4_t c[3];
+    for (int k = 0; k < 3; k++) {
+      float32x4_t v = vaddq_f32(vmulq_n_f32(pz, r[8 + k]), vdupq_n_f32(r[12 + k]));
+      v = vaddq_f32(vmulq_n_f32(py, r[4 + k]), v);
+      c[k] = vaddq_f32(vmulq_n_f32(px, r[k]), v);
+    }
+    vst1q_f32(outX + i, c[0]);
+    vst1q_f32(outY + i, c[1]);
+    vst1q_f32(outZ + i, c[2]);
+  }
+#endif
+  transformPointsScalar(m, x + i, y + i, z + i, outX + i, outY + i, outZ + i, count - i);
+}
+
+#endif /* _H_CORE_SIMD_MATH */
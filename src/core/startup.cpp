@@ -0,0 +1,194 @@
+#ifndef _H_CORE_STARTUP
+#define _H_CORE_STARTUP
+
+// Startup as a dependency graph - every stage is a task that names the stages it needs, stages with
+// nothing in between run at the same time on the job system. Some things have to happen on the thread that
+// owns the window (creating it, the swap chain, the first Present), those tasks are marked main_thread and the
+// calling thread picks them up while it helps with the rest.
+//
+// Every task gets its own timing and error. A failed task does not stop the graph - whatever does not depend
+// on it still runs, dependents are skipped and say which stage they were waiting for.
+#include "jobs.cpp"
+#include "timer.cpp"
+#include "profiler.cpp"
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <exception>
+#include <initializer_list>
+#include <thread>
+
+constexpr int STARTUP_MAX_TASKS = 32;
+constexpr int STARTUP_MAX_DEPENDENCIES = 8;
+
+enum StartupStatus : uint32_t {
+  STARTUP_PENDING = 0,
+  STARTUP_OK,
+  STARTUP_FAILED,
+  STARTUP_SKIPPED   // Something it depends on failed or was skipped
+};
+
+struct StartupTask;
+// Returns false on failure, with a reason in task.error. Exceptions are caught and count as failures.
+typedef bool (*StartupFunction)(void* user, StartupTask& task);
+
+typedef struct StartupTask {
+  const char* name = nullptr;
+  StartupFunction function = nullptr;
+  void* user = nullptr;
+  bool main_thread = false;
+  int dependencies[STARTUP_MAX_DEPENDENCIES];
+  int dependency_count = 0;
+  // Filled in by runStartupGraph
+  std::atomic<uint32_t> status{STARTUP_PENDING};
+  std::atomic<int> waiting{0};  // Dependencies not finished yet
+  double start_ms = 0.0;        // From the start of the graph
+  double end_ms = 0.0;
+  int worker = -1;
+  char error[160] = {};
+} StartupTask;
+
+typedef struct StartupGraph {
+  StartupTask tasks[STARTUP_MAX_TASKS];
+  int count = 0;
+  uint64_t start_ns = 0;
+  double total_ms = 0.0;
+  std::atomic<int> finished{0};
+  std::atomic<bool> main_ready[STARTUP_MAX_TASKS] = {};
+} StartupGraph;
+
+// Returns the task index for later dependencies, -1 when the graph is full
+int addStartupTask(StartupGraph& graph, const char* name, StartupFunction function, void* user,
+                   std::initializer_list<int> dependencies = {}, bool mainThread = false) {
+  if (graph.count == STARTUP_MAX_TASKS || dependencies.size() > (size_t)STARTUP_MAX_DEPENDENCIES) return -1;
+  StartupTask& task = graph.tasks[graph.count];
+  task.name = name;
+  task.function = function;
+  task.user = user;
+  task.main_thread = mainThread;
+  task.dependency_count = 0;
+  for (int dependency : dependencies) {
+    if (dependency < 0 || dependency >= graph.count) return -1;  // Only earlier tasks, so there are no cycles
+    task.dependencies[task.dependency_count++] = dependency;
+  }
+  return graph.count++;
+}
+
+static void startupLaunch(StartupGraph& graph, JobSystem& jobs, int index);
+
+static void startupExecute(StartupGraph& graph, JobSystem& jobs, int index) {
+  StartupTask& task = graph.tasks[index];
+  int failed = -1;
+  for (int i = 0; i < task.dependency_count && failed < 0; i++) {
+    if (graph.tasks[task.dependencies[i]].status.load(std::memory_order_acquire) != STARTUP_OK) failed = task.dependencies[i];
+  }
+
+  task.worker = jobWorkerIndex;
+  task.start_ms = (double)(timerNanoseconds() - graph.start_ns) / 1000000.0;
+  StartupStatus status = STARTUP_SKIPPED;
+  if (failed >= 0) {
+    snprintf(task.error, sizeof(task.error), "needs %s", graph.tasks[failed].name);
+  } else {
+    PROFILE_SCOPE(task.name);
+    bool ok = false;
+    try {
+      ok = task.function(task.user, task);
+    } catch (const std::exception& e) {
+      snprintf(task.error, sizeof(task.error), "%s", e.what());
+    }
+    if (!ok && task.error[0] == 0) snprintf(task.error, sizeof(task.error), "failed");
+    status = ok ? STARTUP_OK : STARTUP_FAILED;
+  }
+  task.end_ms = (double)(timerNanoseconds() - graph.start_ns) / 1000000.0;
+  task.status.store(status, std::memory_order_release);
+
+  // Whoever finishes the last dependency starts the dependent
+  for (int i = index + 1; i < graph.count; i++) {
+    const StartupTask& next = graph.tasks[i];
+    for (int d = 0; d < next.dependency_count; d++) {
+      if (next.dependencies[d] == index && graph.tasks[i].waiting.fetch_sub(1, std::memory_order_acq_rel) == 1) startupLaunch(graph, jobs, i);
+    }
+  }
+  graph.finished.fetch_add(1, std::memory_order_release);
+}
+
+static void startupJob(JobSystem& jobs, Job* job) {
+  startupExecute(*reinterpret_cast<StartupGraph*>(job->data), jobs, (int)job->begin);
+}
+
+static void startupLaunch(StartupGraph& graph, JobSystem& jobs, int index) {
+  if (graph.tasks[index].main_thread) {
+    graph.main_ready[index].store(true, std::memory_order_release);
+    return;
+  }
+  Job* job = jobCreate(jobs, startupJob, &graph);
+  job->begin = (size_t)index;
+  jobRun(jobs, job);
+}
+
+// Runs every task once, call it from the thread that owns the window (worker 0 of jobs).
+// Returns true if every task succeeded.
+bool runStartupGraph(StartupGraph& graph, JobSystem& jobs) {
+  graph.start_ns = timerNanoseconds();
+  graph.finished.store(0, std::memory_order_relaxed);
+  for (int i = 0; i < graph.count; i++) {
+    graph.tasks[i].status.store(STARTUP_PENDING, std::memory_order_relaxed);
+    graph.tasks[i].waiting.store(graph.tasks[i].dependency_count, std::memory_order_relaxed);
+    graph.tasks[i].error[0] = 0;
+    graph.main_ready[i].store(false, std::memory_order_relaxed);
+  }
+  for (int i = 0; i < graph.count; i++) {
+    if (graph.tasks[i].dependency_count == 0) startupLaunch(graph, jobs, i);
+  }
+
+  const int worker = jobCurrentWorker(jobs);
+  while (graph.finished.load(std::memory_order_acquire) < graph.count) {
+    bool ran = false;
+    for (int i = 0; i < graph.count && !ran; i++) {
+      if (graph.main_ready[i].load(std::memory_order_acquire)) {
+        graph.main_ready[i].store(false, std::memory_order_relaxed);
+        startupExecute(graph, jobs, i);
+        ran = true;
+      }
+    }
+    if (!ran && !jobHelp(jobs, worker)) std::this_thread::yield();
+  }
+  graph.total_ms = (double)(timerNanoseconds() - graph.start_ns) / 1000000.0;
+
+  bool ok = true;
+  for (int i = 0; i < graph.count; i++) ok = ok && graph.tasks[i].status.load(std::memory_order_relaxed) == STARTUP_OK;
+  return ok;
+}
+
+static const char* startupStatusName(uint32_t status) {
+  switch (status) {
+    case STARTUP_OK: return "ok";
+    case STARTUP_FAILED: return "FAILED";
+    case STARTUP_SKIPPED: return "skipped";
+    default: return "pending";
+  }
+}
+
+// One line per task - start, duration, worker, status and error. Returns what snprintf would have written.
+int formatStartupReport(const StartupGraph& graph, char* out, size_t size) {
+  int written = snprintf(out, size, "startup: %.2f ms over %d stages\n", graph.total_ms, graph.count);
+  for (int i = 0; i < graph.count; i++) {
+    const StartupTask& task = graph.tasks[i];
+    const size_t used = written > 0 && (size_t)written < size ? (size_t)written : size;
+    written += snprintf(out + used, size - used, "  %-16s at %8.2f ms took %8.2f ms on worker %d%s  %s%s%s\n",
+                        task.name, task.start_ms, task.end_ms - task.start_ms, task.worker, task.main_thread ? " (main)" : "",
+                        startupStatusName(task.status.load(std::memory_order_relaxed)), task.error[0] ? " - " : "", task.error);
+  }
+  return written;
+}
+
+// First failed task in graph order, nullptr when nothing failed
+const StartupTask* firstStartupFailure(const StartupGraph& graph) {
+  for (int i = 0; i < graph.count; i++) {
+    if (graph.tasks[i].status.load(std::memory_order_relaxed) == STARTUP_FAILED) return &graph.tasks[i];
+  }
+  return nullptr;
+}
+
+#endif /* _H_CORE_STARTUP */
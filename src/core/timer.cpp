@@ -0,0 +1,17 @@
+#ifndef _H_CORE_TIMER
+#define _H_CORE_TIMER
+
+#include <chrono>
+#include <cstdint>
+
+// Monotonic clock used for every stat we report - QueryPerformanceCounter under the hood on Windows
+inline uint64_t timerNanoseconds() {
+  return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+inline double timerMilliseconds() {
+  return (double)timerNanoseconds() / 1000000.0;
+}
+
+#endif /* _H_CORE_TIMER */
@@ -0,0 +1,309 @@
+#ifndef _H_CORE_UPLOAD_ALLOCATOR
+#define _H_CORE_UPLOAD_ALLOCATOR
+
+// Sub-allocation of a few big persistently-mapped GPU heaps, platform-neutral - only offsets live here,
+// the D3D12 side owns the resources and turns offsets into CPU pointers and GPU addresses.
+//
+// Two modes:
+//   - LinearAllocator, bump pointer reset once per frame slot - constants and other per-frame data
+//   - BuddyAllocator, power-of-two blocks with O(1) free list operations - long lived buffers
+//     (chunk meshes, instance streams). Blocks are aligned to their own size, so anything up to
+//     the block size comes for free (256 B for CBVs, natural alignment for VB/IB).
+#include "memory.cpp"
+
+#include <cstdint>
+#include <cstdlib>
+
+constexpr size_t CBV_ALIGNMENT = 256;             // D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT
+constexpr size_t UPLOAD_MIN_BLOCK = 256;
+constexpr size_t UPLOAD_INVALID_OFFSET = ~(size_t)0;
+constexpr size_t UPLOAD_FRAME_CONSTANTS = 64 * 1024;  // Bulk per-frame data leaves this much of a slot to constants
+
+typedef struct LinearAllocator {
+  size_t capacity = 0;
+  size_t offset = 0;
+  size_t peak = 0;        // Highest offset ever reached
+  size_t failures = 0;
+} LinearAllocator;
+
+inline void initLinearAllocator(LinearAllocator& linear, size_t capacity) {
+  linear = {};
+  linear.capacity = capacity;
+}
+
+// Returns UPLOAD_INVALID_OFFSET when the frame ran out of space, or would have less than reserve left
+inline size_t linearAllocate(LinearAllocator& linear, size_t size, size_t alignment, size_t reserve = 0) {
+  size_t offset = alignUp(linear.offset, alignment);
+  if (offset + size + reserve > linear.capacity) {
+    linear.failures++;
+    return UPLOAD_INVALID_OFFSET;
+  }
+  linear.offset = offset + size;
+  linear.peak = linear.offset > linear.peak ? linear.offset : linear.peak;
+  return offset;
+}
+
+inline void linearReset(LinearAllocator& linear) {
+  linear.offset = 0;
+}
+
+typedef struct BuddyStats {
+  size_t capacity = 0;
+  size_t used = 0;           // Bytes in allocated blocks
+  size_t requested = 0;      // Bytes callers asked for - used minus this is rounding waste
+  size_t peak_used = 0;
+  size_t allocations = 0;    // Live allocations
+  size_t failures = 0;
+} BuddyStats;
+
+constexpr uint32_t BUDDY_NONE = 0xffffffffu;
+constexpr uint8_t BUDDY_NOT_FREE = 0xff;
+
+// Slots are min_block sized pieces of the heap, every block is identified by its first slot
+typedef struct BuddyAllocator {
+  size_t min_block = UPLOAD_MIN_BLOCK;
+  int max_order = 0;                      // Order k block is min_block << k bytes, max_order covers everything
+  uint32_t slots = 0;
+  uint8_t* free_order = nullptr;          // [slot] order of the free block starting there, or BUDDY_NOT_FREE
+  uint8_t* alloc_order = nullptr;         // [slot] order of the allocated block starting there, or BUDDY_NOT_FREE
+  uint32_t* next = nullptr;               // [slot] intrusive doubly linked free lists
+  uint32_t* prev = nullptr;
+  uint32_t heads[32];
+  BuddyStats stats;
+} BuddyAllocator;
+
+static void buddyPush(BuddyAllocator& buddy, uint32_t slot, int order) {
+  buddy.free_order[slot] = (uint8_t)order;
+  buddy.prev[slot] = BUDDY_NONE;
+  buddy.next[slot] = buddy.heads[order];
+  if (buddy.heads[order] != BUDDY_NONE) buddy.prev[buddy.heads[order]] = slot;
+  buddy.heads[order] = slot;
+}
+
+static void buddyRemove(BuddyAllocator& buddy, uint32_t slot) {
+  int order = buddy.free_order[slot];
+  if (buddy.prev[slot] != BUDDY_NONE) buddy.next[buddy.prev[slot]] = buddy.next[slot];
+  else buddy.heads[order] = buddy.next[slot];
+  if (buddy.next[slot] != BUDDY_NONE) buddy.prev[buddy.next[slot]] = buddy.prev[slot];
+  buddy.free_order[slot] = BUDDY_NOT_FREE;
+}
+
+void destroyBuddyAllocator(BuddyAllocator& buddy) {
+  free(buddy.free_order);
+  free(buddy.alloc_order);
+  free(buddy.next);
+  free(buddy.prev);
+  buddy = {};
+}
+
+// capacity and minBlock have to be powers of two
+bool initBuddyAllocator(BuddyAllocator& buddy, size_t capacity, size_t minBlock = UPLOAD_MIN_BLOCK) {
+  if (capacity < minBlock || (capacity & (capacity - 1)) != 0 || (minBlock & (minBlock - 1)) != 0) return false;
+
+  buddy = {};
+  buddy.min_block = minBlock;
+  buddy.slots = (uint32_t)(capacity / minBlock);
+  while ((minBlock << buddy.max_order) < capacity) buddy.max_order++;
+  buddy.free_order = (uint8_t*)malloc(buddy.slots);
+  buddy.alloc_order = (uint8_t*)malloc(buddy.slots);
+  buddy.next = (uint32_t*)malloc(buddy.slots * sizeof(uint32_t));
+  buddy.prev = (uint32_t*)malloc(buddy.slots * sizeof(uint32_t));
+  if (!buddy.free_order || !buddy.alloc_order || !buddy.next || !buddy.prev) {
+    destroyBuddyAllocator(buddy);
+    return false;
+  }
+  for (uint32_t i = 0; i < buddy.slots; i++) {
+    buddy.free_order[i] = BUDDY_NOT_FREE;
+    buddy.alloc_order[i] = BUDDY_NOT_FREE;
+  }
+  for (int i = 0; i < 32; i++) buddy.heads[i] = BUDDY_NONE;
+  buddyPush(buddy, 0, buddy.max_order);
+  buddy.stats.capacity = capacity;
+  return true;
+}
+
+size_t buddyAllocate(BuddyAllocator& buddy, size_t size, size_t alignment) {
+  size_t need = size > alignment ? size : alignment;
+  int order = 0;
+  while ((buddy.min_block << order) < need && order <= buddy.max_order) order++;
+
+  int found = order;
+  while (found <= buddy.max_order && buddy.heads[found] == BUDDY_NONE) found++;
+  if (found > buddy.max_order) {
+    buddy.stats.failures++;
+    return UPLOAD_INVALID_OFFSET;
+  }
+
+  uint32_t slot = buddy.heads[found];
+  buddyRemove(buddy, slot);
+  // Split down, upper halves go back on the free lists
+  while (found > order) {
+    found--;
+    buddyPush(buddy, slot + (1u << found), found);
+  }
+
+  buddy.alloc_order[slot] = (uint8_t)order;
+  buddy.stats.used += buddy.min_block << order;
+  buddy.stats.requested += size;
+  buddy.stats.allocations++;
+  buddy.stats.peak_used = buddy.stats.used > buddy.stats.peak_used ? buddy.stats.used : buddy.stats.peak_used;
+  return (size_t)slot * buddy.min_block;
+}
+
+// size has to be the same value that was passed to buddyAllocate - only used for stats
+void buddyFree(BuddyAllocator& buddy, size_t offset, size_t size) {
+  uint32_t slot = (uint32_t)(offset / buddy.min_block);
+  int order = buddy.alloc_order[slot];
+  buddy.alloc_order[slot] = BUDDY_NOT_FREE;
+  buddy.stats.used -= buddy.min_block << order;
+  buddy.stats.requested -= size;
+  buddy.stats.allocations--;
+
+  // Merge with the buddy as long as it is free and of the same order
+  while (order < buddy.max_order) {
+    uint32_t other = slot ^ (1u << order);
+    if (buddy.free_order[other] != order) break;
+    buddyRemove(buddy, other);
+    slot = slot < other ? slot : other;
+    order++;
+  }
+  buddyPush(buddy, slot, order);
+}
+
+inline size_t buddyLargestFree(const BuddyAllocator& buddy) {
+  for (int order = buddy.max_order; order >= 0; order--) {
+    if (buddy.heads[order] != BUDDY_NONE) return buddy.min_block << order;
+  }
+  return 0;
+}
+
+// 0 - all free memory is one block, close to 1 - free memory is scattered in small pieces
+inline double buddyFragmentation(const BuddyAllocator& buddy) {
+  size_t freeBytes = buddy.stats.capacity - buddy.stats.used;
+  return freeBytes == 0 ? 0.0 : 1.0 - (double)buddyLargestFree(buddy) / (double)freeBytes;
+}
+
+// A few same-sized buddy heaps plus one linear heap cut into per-frame segments.
+// Heaps are added lazily, on_new_heap lets the backend create and map the real memory.
+constexpr uint32_t MAX_UPLOAD_HEAPS = 8;
+
+typedef struct UploadAllocation {
+  uint32_t heap = 0;
+  size_t offset = UPLOAD_INVALID_OFFSET;
+  size_t size = 0;
+} UploadAllocation;
+
+typedef struct UploadAllocator {
+  size_t heap_size = 0;
+  uint32_t heap_count = 0;
+  BuddyAllocator heaps[MAX_UPLOAD_HEAPS];
+  bool (*on_new_heap)(void* user, uint32_t heap, size_t size) = nullptr;
+  void* user = nullptr;
+  size_t failures = 0;                        // Allocations no heap could take
+
+  size_t frame_segment = 0;                   // Bytes per frame slot in the linear heap
+  uint32_t frame_slots = 0;
+  LinearAllocator frames[8];
+} UploadAllocator;
+
+bool initUploadAllocator(UploadAllocator& upload, size_t heapSize, size_t frameSegment, uint32_t frameSlots) {
+  if (frameSlots > 8) return false;
+  upload = {};
+  upload.heap_size = heapSize;
+  upload.frame_segment = alignUp(frameSegment, CBV_ALIGNMENT);
+  upload.frame_slots = frameSlots;
+  for (uint32_t i = 0; i < frameSlots; i++) initLinearAllocator(upload.frames[i], upload.frame_segment);
+  return true;
+}
+
+void destroyUploadAllocator(UploadAllocator& upload) {
+  for (uint32_t i = 0; i < upload.heap_count; i++) destroyBuddyAllocator(upload.heaps[i]);
+  upload = {};
+}
+
+// Long lived allocation, first heap that fits wins. Returns an allocation with offset UPLOAD_INVALID_OFFSET on failure.
+UploadAllocation uploadAllocate(UploadAllocator& upload, size_t size, size_t alignment) {
+  UploadAllocation allocation = {};
+  allocation.size = size;
+  for (uint32_t i = 0; i < upload.heap_count; i++) {
+    size_t offset = buddyAllocate(upload.heaps[i], size, alignment);
+    if (offset != UPLOAD_INVALID_OFFSET) {
+      allocation.heap = i;
+      allocation.offset = offset;
+      return allocation;
+    }
+  }
+
+  uint32_t heap = upload.heap_count;
+  if (heap == MAX_UPLOAD_HEAPS || size > upload.heap_size || !initBuddyAllocator(upload.heaps[heap], upload.heap_size)) {
+    upload.failures++;
+    return allocation;
+  }
+  if (upload.on_new_heap && !upload.on_new_heap(upload.user, heap, upload.heap_size)) {
+    destroyBuddyAllocator(upload.heaps[heap]);
+    upload.failures++;
+    return allocation;
+  }
+  upload.heap_count++;
+  allocation.heap = heap;
+  allocation.offset = buddyAllocate(upload.heaps[heap], size, alignment);
+  return allocation;
+}
+
+void uploadFree(UploadAllocator& upload, const UploadAllocation& allocation) {
+  if (allocation.offset == UPLOAD_INVALID_OFFSET) return;
+  buddyFree(upload.heaps[allocation.heap], allocation.offset, allocation.size);
+}
+
+// Per-frame allocation, offset is relative to the start of the whole linear heap
+size_t uploadAllocateFrame(UploadAllocator& upload, uint32_t slot, size_t size, size_t alignment, size_t reserve = 0) {
+  size_t offset = linearAllocate(upload.frames[slot], size, alignment, reserve);
+  return offset == UPLOAD_INVALID_OFFSET ? offset : slot * upload.frame_segment + offset;
+}
+
+// Largest uploadAllocateFrame with this alignment and reserve that still fits in the slot
+size_t uploadFrameRoom(const UploadAllocator& upload, uint32_t slot, size_t alignment, size_t reserve = 0) {
+  const LinearAllocator& linear = upload.frames[slot];
+  const size_t offset = alignUp(linear.offset, alignment);
+  return offset + reserve < linear.capacity ? linear.capacity - offset - reserve : 0;
+}
+
+// Call once the GPU is done with the slot - right after beginFrame
+void uploadResetFrame(UploadAllocator& upload, uint32_t slot) {
+  linearReset(upload.frames[slot]);
+}
+
+typedef struct UploadStats {
+  size_t heaps = 0;
+  size_t capacity = 0;
+  size_t used = 0;
+  size_t requested = 0;
+  size_t peak_used = 0;
+  size_t allocations = 0;
+  size_t failures = 0;
+  double fragmentation = 0.0;   // Worst heap
+  size_t frame_peak = 0;        // Worst frame slot
+} UploadStats;
+
+UploadStats uploadStats(const UploadAllocator& upload) {
+  UploadStats stats = {};
+  stats.heaps = upload.heap_count;
+  stats.failures = upload.failures;
+  for (uint32_t i = 0; i < upload.heap_count; i++) {
+    const BuddyStats& b = upload.heaps[i].stats;
+    stats.capacity += b.capacity;
+    stats.used += b.used;
+    stats.requested += b.requested;
+    stats.peak_used += b.peak_used;
+    stats.allocations += b.allocations;
+    double f = buddyFragmentation(upload.heaps[i]);
+    stats.fragmentation = f > stats.fragmentation ? f : stats.fragmentation;
+  }
+  for (uint32_t i = 0; i < upload.frame_slots; i++) {
+    stats.frame_peak = upload.frames[i].peak > stats.frame_peak ? upload.frames[i].peak : stats.frame_peak;
+    stats.failures += upload.frames[i].failures;
+  }
+  return stats;
+}
+
+#endif /* _H_CORE_UPLOAD_ALLOCATOR */
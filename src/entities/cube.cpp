@@ -18,8 +18,8 @@ unsigned short cubeIndices[] = {
 };
 
 // TODO(moliwa): Can we have a function of runtime and constexpr at the same time?
-DirectX::XMFLOAT4 getRandomColor() {
-  DirectX::XMFLOAT4 temp = {}; 
+Float4 getRandomColor() {
+  Float4 temp = {}; 
   temp.x = (float)rand() / RAND_MAX;
   temp.y = (float)rand() / RAND_MAX;
   temp.z = (float)rand() / RAND_MAX;
@@ -30,28 +30,28 @@ DirectX::XMFLOAT4 getRandomColor() {
 Vertex* createDefaultCube() {
   Vertex* cubeVertices = (Vertex*)malloc(DEFAULT_CUBE_VERTICES * sizeof(Vertex));
   // TODO(moliwa): Check for failed allocation
-  cubeVertices[0].pos   = DirectX::XMFLOAT3(-0.5f, 0.5f, -0.5f);
+  cubeVertices[0].pos   = Float3{ -0.5f, 0.5f, -0.5f };
   cubeVertices[0].color = getRandomColor();
 
-  cubeVertices[1].pos   = DirectX::XMFLOAT3(0.5f, 0.5f, -0.5f);
+  cubeVertices[1].pos   = Float3{ 0.5f, 0.5f, -0.5f };
   cubeVertices[1].color = getRandomColor();
 
-  cubeVertices[2].pos   = DirectX::XMFLOAT3(0.5f, -0.5f, -0.5f);
+  cubeVertices[2].pos   = Float3{ 0.5f, -0.5f, -0.5f };
   cubeVertices[2].color = getRandomColor();
 
-  cubeVertices[3].pos   = DirectX::XMFLOAT3(-0.5f, -0.5f, -0.5f);
+  cubeVertices[3].pos   = Float3{ -0.5f, -0.5f, -0.5f };
   cubeVertices[3].color = getRandomColor();
 
-  cubeVertices[4].pos   = DirectX::XMFLOAT3(-0.5f, 0.5f, 0.5f);
+  cubeVertices[4].pos   = Float3{ -0.5f, 0.5f, 0.5f };
   cubeVertices[4].color = getRandomColor();
 
-  cubeVertices[5].pos   = DirectX::XMFLOAT3(0.5f, 0.5f, 0.5f);
+  cubeVertices[5].pos   = Float3{ 0.5f, 0.5f, 0.5f };
   cubeVertices[5].color = getRandomColor();
 
-  cubeVertices[6].pos   = DirectX::XMFLOAT3(0.5f, -0.5f, 0.5f);
+  cubeVertices[6].pos   = Float3{ 0.5f, -0.5f, 0.5f };
   cubeVertices[6].color = getRandomColor();
 
-  cubeVertices[7].pos   = DirectX::XMFLOAT3(-0.5f, -0.5f, 0.5f);
+  cubeVertices[7].pos   = Float3{ -0.5f, -0.5f, 0.5f };
   cubeVertices[7].color = getRandomColor();
 
   return cubeVertices;
@@ -0,0 +1,356 @@
+#ifndef _H_ENTITY_STORE
+#define _H_ENTITY_STORE
+
+// Data-oriented entity store - every attribute is its own dense array, entity i of every array is the same entity.
+// Handles stay valid while entities around them come and go: a handle points into a sparse slot table, the slot
+// knows the dense index, and removal swaps the last entity into the hole. A generation per slot catches stale handles.
+// World matrices are only rebuilt for dirty entities, four at a time with SSE, straight into caller memory
+// (ex. a mapped instance or constant buffer) at dense index * stride - draw entities [0, count) in one go.
+#include "../core/simd.cpp"
+#include "../core/simd_math.cpp"
+#include "../core/memory.cpp"
+#include "../core/jobs.cpp"
+#include "../core/profiler.cpp"
+#include "../hex/hex_coords.cpp"
+
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+constexpr double ENTITY_UPDATE_BUDGET_MS = 2.0;  // World matrices of 128k moving entities on one core, checked by the headless entities run
+constexpr size_t ENTITY_JOB_GRAIN = 64 * 32;     // Entities per job - whole dirty words, so jobs never share one
+
+typedef struct EntityHandle {
+  uint32_t slot = UINT32_MAX;
+  uint32_t generation = 0;
+} EntityHandle;
+
+enum EntityMatrixLayout {
+  ENTITY_MATRIX_ROWS,     // Mat4 as is - per-instance float4 rows
+  ENTITY_MATRIX_COLUMNS   // Transposed, what constant buffers get (see onUpdate)
+};
+
+typedef struct EntityStore {
+  size_t capacity = 0;
+  size_t count = 0;             // Alive entities, dense [0, count)
+  // Dense attributes
+  float* pos_x = nullptr;
+  float* pos_y = nullptr;
+  float* pos_z = nullptr;
+  float* yaw = nullptr;         // Radians around +y
+  float* scale = nullptr;       // Uniform
+  uint32_t* color = nullptr;    // RGBA8, red in the lowest byte
+  int32_t* tile_q = nullptr;    // Tile the entity stands on
+  int32_t* tile_r = nullptr;
+  uint32_t* dense_slot = nullptr;  // Dense index -> handle slot
+  uint64_t* dirty = nullptr;    // One bit per dense index
+  // Handle slots
+  uint32_t* slot_dense = nullptr;  // Slot -> dense index, next free slot while the slot is free
+  uint32_t* slot_generation = nullptr;
+  uint32_t free_slot = UINT32_MAX;
+  size_t slots_used = 0;
+} EntityStore;
+
+void destroyEntityStore(EntityStore& store) {
+  alignedFree(store.pos_x);
+  alignedFree(store.pos_y);
+  alignedFree(store.pos_z);
+  alignedFree(store.yaw);
+  alignedFree(store.scale);
+  alignedFree(store.color);
+  alignedFree(store.tile_q);
+  alignedFree(store.tile_r);
+  free(store.dense_slot);
+  free(store.dirty);
+  free(store.slot_dense);
+  free(store.slot_generation);
+  store = {};
+}
+
+// Room for capacity entities, nothing grows later - pointers handed out to systems stay put
+bool createEntityStore(EntityStore& store, size_t capacity) {
+  store = {};
+  if (capacity == 0 || capacity >= UINT32_MAX) return false;
+  store.capacity = capacity;
+  const size_t bytes = capacity * sizeof(float);
+  store.pos_x = (float*)alignedAlloc(bytes);
+  store.pos_y = (float*)alignedAlloc(bytes);
+  store.pos_z = (float*)alignedAlloc(bytes);
+  store.yaw = (float*)alignedAlloc(bytes);
+  store.scale = (float*)alignedAlloc(bytes);
+  store.color = (uint32_t*)alignedAlloc(bytes);
+  store.tile_q = (int32_t*)alignedAlloc(bytes);
+  store.tile_r = (int32_t*)alignedAlloc(bytes);
+  store.dense_slot = (uint32_t*)malloc(capacity * sizeof(uint32_t));
+  store.dirty = (uint64_t*)calloc((capacity + 63) / 64, sizeof(uint64_t));
+  store.slot_dense = (uint32_t*)malloc(capacity * sizeof(uint32_t));
+  store.slot_generation = (uint32_t*)calloc(capacity, sizeof(uint32_t));
+  if (!store.pos_x || !store.pos_y || !store.pos_z || !store.yaw || !store.scale || !store.color || !store.tile_q || !store.tile_r ||
+      !store.dense_slot || !store.dirty || !store.slot_dense || !store.slot_generation) {
+    destroyEntityStore(store);
+    return false;
+  }
+  return true;
+}
+
+inline void entityMarkDirty(EntityStore& store, size_t index) {
+  store.dirty[index / 64] |= 1ull << (index % 64);
+}
+
+// For systems that write the dense arrays directly, ex. moving every entity
+void entityMarkDirtyRange(EntityStore& store, size_t first, size_t count) {
+  for (size_t i = first; i < first + count; i++) {
+    if (i % 64 == 0 && first + count - i >= 64) {
+      store.dirty[i / 64] = ~0ull;
+      i += 63;
+    } else {
+      entityMarkDirty(store, i);
+    }
+  }
+}
+
+inline bool entityAlive(const EntityStore& store, EntityHandle handle) {
+  return handle.slot < store.slots_used && store.slot_generation[handle.slot] == handle.generation &&
+         store.slot_dense[handle.slot] < store.count && store.dense_slot[store.slot_dense[handle.slot]] == handle.slot;
+}
+
+// Dense index of a live entity - valid until the next entityDestroy
+inline size_t entityIndex(const EntityStore& store, EntityHandle handle) {
+  return store.slot_dense[handle.slot];
+}
+
+// New entity at the origin, unit scale, white. Returns an invalid handle when the store is full.
+EntityHandle entityCreate(EntityStore& store) {
+  EntityHandle handle;
+  if (store.count == store.capacity) return handle;
+  if (store.free_slot != UINT32_MAX) {
+    handle.slot = store.free_slot;
+    store.free_slot = store.slot_dense[handle.slot];
+  } else {
+    handle.slot = (uint32_t)store.slots_used++;
+  }
+  handle.generation = store.slot_generation[handle.slot];
+  const size_t i = store.count++;
+  store.slot_dense[handle.slot] = (uint32_t)i;
+  store.dense_slot[i] = handle.slot;
+  store.pos_x[i] = store.pos_y[i] = store.pos_z[i] = 0.0f;
+  store.yaw[i] = 0.0f;
+  store.scale[i] = 1.0f;
+  store.color[i] = 0xffffffffu;
+  store.tile_q[i] = store.tile_r[i] = 0;
+  entityMarkDirty(store, i);
+  return handle;
+}
+
+// The last entity moves into the hole and goes dirty, so its matrix lands in its new place on the next update
+bool entityDestroy(EntityStore& store, EntityHandle handle) {
+  if (!entityAlive(store, handle)) return false;
+  const size_t i = store.slot_dense[handle.slot];
+  const size_t last = --store.count;
+  if (i != last) {
+    store.pos_x[i] = store.pos_x[last];
+    store.pos_y[i] = store.pos_y[last];
+    store.pos_z[i] = store.pos_z[last];
+    store.yaw[i] = store.yaw[last];
+    store.scale[i] = store.scale[last];
+    store.color[i] = store.color[last];
+    store.tile_q[i] = store.tile_q[last];
+    store.tile_r[i] = store.tile_r[last];
+    store.dense_slot[i] = store.dense_slot[last];
+    store.slot_dense[store.dense_slot[i]] = (uint32_t)i;
+    entityMarkDirty(store, i);
+  }
+  store.dirty[last / 64] &= ~(1ull << (last % 64));
+  store.slot_generation[handle.slot]++;
+  store.slot_dense[handle.slot] = store.free_slot;
+  store.free_slot = handle.slot;
+  return true;
+}
+
+inline void entitySetTransform(EntityStore& store, EntityHandle handle, float x, float y, float z, float yaw, float scale) {
+  const size_t i = entityIndex(store, handle);
+  store.pos_x[i] = x;
+  store.pos_y[i] = y;
+  store.pos_z[i] = z;
+  store.yaw[i] = yaw;
+  store.scale[i] = scale;
+  entityMarkDirty(store, i);
+}
+
+inline void entitySetPosition(EntityStore& store, EntityHandle handle, float x, float y, float z) {
+  const size_t i = entityIndex(store, handle);
+  store.pos_x[i] = x;
+  store.pos_y[i] = y;
+  store.pos_z[i] = z;
+  entityMarkDirty(store, i);
+}
+
+// Color and tile do not feed the matrix, nothing goes dirty
+inline void entitySetColor(EntityStore& store, EntityHandle handle, uint32_t rgba) {
+  store.color[entityIndex(store, handle)] = rgba;
+}
+
+inline void entitySetTile(EntityStore& store, EntityHandle handle, HexAxial tile) {
+  const size_t i = entityIndex(store, handle);
+  store.tile_q[i] = tile.q;
+  store.tile_r[i] = tile.r;
+}
+
+// scale * rotationY(yaw) * translation - same bits as mat4Multiply over the three matrices, every product
+// with a zero element drops out exactly. Element order rows: m0 m2 / m5 / m8 m10 / m12 m13 m14.
+static inline void entityWorldMatrix(float x, float y, float z, float yaw, float scale, float* out, EntityMatrixLayout layout) {
+  float s, c;
+  scalarSinCos(yaw, s, c);
+  const float sc = scale * c, ss = scale * s;
+  const float rows[16] = {
+    sc, 0.0f, -ss, 0.0f,
+    0.0f, scale, 0.0f, 0.0f,
+    ss, 0.0f, sc, 0.0f,
+    x, y, z, 1.0f
+  };
+  if (layout == ENTITY_MATRIX_ROWS) {
+    memcpy(out, rows, sizeof(rows));
+  } else {
+    for (int r = 0; r < 4; r++) {
+      for (int k = 0; k < 4; k++) out[k * 4 + r] = rows[r * 4 + k];
+    }
+  }
+}
+
+#if defined(HEX_SIMD_SSE)
+// scalarSinCos on four lanes, same operations in the same order
+static inline void entitySinCos4(__m128 value, __m128& outSin, __m128& outCos) {
+  const __m128 half = _mm_set1_ps(0.5f);
+  __m128 quotient = _mm_mul_ps(_mm_set1_ps(MATH_1DIV2PI), value);
+  const __m128 positive = _mm_cmpge_ps(value, _mm_setzero_ps());
+  quotient = _mm_or_ps(_mm_and_ps(positive, _mm_add_ps(quotient, half)), _mm_andnot_ps(positive, _mm_sub_ps(quotient, half)));
+  quotient = _mm_cvtepi32_ps(_mm_cvttps_epi32(quotient));
+  __m128 y = _mm_sub_ps(value, _mm_mul_ps(_mm_set1_ps(MATH_2PI), quotient));
+
+  const __m128 above = _mm_cmpgt_ps(y, _mm_set1_ps(MATH_PIDIV2));
+  const __m128 below = _mm_cmplt_ps(y, _mm_set1_ps(-MATH_PIDIV2));
+  const __m128 folded = _mm_or_ps(above, below);
+  const __m128 mirror = _mm_or_ps(_mm_and_ps(above, _mm_set1_ps(MATH_PI)), _mm_andnot_ps(above, _mm_set1_ps(-MATH_PI)));
+  y = _mm_or_ps(_mm_and_ps(folded, _mm_sub_ps(mirror, y)), _mm_andnot_ps(folded, y));
+  const __m128 sign = _mm_or_ps(_mm_and_ps(folded, _mm_set1_ps(-1.0f)), _mm_andnot_ps(folded, _mm_set1_ps(1.0f)));
+
+  const __m128 y2 = _mm_mul_ps(y, y);
+  __m128 p = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(-2.3889859e-08f), y2), _mm_set1_ps(2.7525562e-06f));
+  p = _mm_sub_ps(_mm_mul_ps(p, y2), _mm_set1_ps(0.00019840874f));
+  p = _mm_add_ps(_mm_mul_ps(p, y2), _mm_set1_ps(0.0083333310f));
+  p = _mm_sub_ps(_mm_mul_ps(p, y2), _mm_set1_ps(0.16666667f));
+  p = _mm_add_ps(_mm_mul_ps(p, y2), _mm_set1_ps(1.0f));
+  outSin = _mm_mul_ps(p, y);
+  p = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(-2.6051615e-07f), y2), _mm_set1_ps(2.4760495e-05f));
+  p = _mm_sub_ps(_mm_mul_ps(p, y2), _mm_set1_ps(0.0013888378f));
+  p = _mm_add_ps(_mm_mul_ps(p, y2), _mm_set1_ps(0.041666638f));
+  p = _mm_sub_ps(_mm_mul_ps(p, y2), _mm_set1_ps(0.5f));
+  p = _mm_add_ps(_mm_mul_ps(p, y2), _mm_set1_ps(1.0f));
+  outCos = _mm_mul_ps(sign, p);
+}
+
+// Four entities starting at dense index i, one 4x4 transpose per output row turns lanes into matrices
+static inline void entityWorldMatrices4(const EntityStore& store, size_t i, uint8_t* out, size_t stride, EntityMatrixLayout layout) {
+  __m128 s, c;
+  entitySinCos4(_mm_loadu_ps(store.yaw + i), s, c);
+  const __m128 scale = _mm_loadu_ps(store.scale + i);
+  const __m128 sc = _mm_mul_ps(scale, c), ss = _mm_mul_ps(scale, s);
+  const __m128 zero = _mm_setzero_ps(), one = _mm_set1_ps(1.0f);
+  const __m128 negSs = _mm_xor_ps(ss, _mm_set1_ps(-0.0f));  // Sign flip like the scalar negate, 0 - ss would lose -0
+  __m128 e[16] = {
+    sc, zero, negSs, zero,
+    zero, scale, zero, zero,
+    ss, zero, sc, zero,
+    _mm_loadu_ps(store.pos_x + i), _mm_loadu_ps(store.pos_y + i), _mm_loadu_ps(store.pos_z + i), one
+  };
+  if (layout == ENTITY_MATRIX_COLUMNS) {
+    for (int r = 0; r < 4; r++) {
+      for (int k = r + 1; k < 4; k++) {
+        const __m128 t = e[r * 4 + k];
+        e[r * 4 + k] = e[k * 4 + r];
+        e[k * 4 + r] = t;
+      }
+    }
+  }
+  for (int r = 0; r < 4; r++) _MM_TRANSPOSE4_PS(e[r * 4], e[r * 4 + 1], e[r * 4 + 2], e[r * 4 + 3]);
+  // Whole matrices one after another - mapped upload memory is write-combined, full 64 byte lines in order
+  // go out as single bursts. Non-temporal when aligned, the CPU never reads these back.
+  const bool aligned = ((uintptr_t)out % 16) == 0 && stride % 16 == 0;
+  for (int lane = 0; lane < 4; lane++) {
+    float* m = (float*)(out + (i + lane) * stride);
+    for (int r = 0; r < 4; r++) {
+      if (aligned) {
+        _mm_stream_ps(m + r * 4, e[r * 4 + lane]);
+      } else {
+        _mm_storeu_ps(m + r * 4, e[r * 4 + lane]);
+      }
+    }
+  }
+}
+#endif
+
+// Rebuilds world matrices of dirty entities in [first, first + count) - first a multiple of 64. Four entities
+// with any dirty one among them are written together, clean ones come out with the same bits they had.
+static size_t entityUpdateRange(EntityStore& store, size_t first, size_t count, uint8_t* out, size_t stride, EntityMatrixLayout layout) {
+  size_t written = 0;
+  const size_t end = first + count;
+  for (size_t w = first / 64; w * 64 < end; w++) {
+    uint64_t bits = store.dirty[w];
+    if (bits == 0) continue;
+    store.dirty[w] = 0;
+    while (bits) {
+      const size_t i = w * 64 + (size_t)lowestBit64(bits);
+#if defined(HEX_SIMD_SSE)
+      const size_t group = i & ~(size_t)3;
+      if (group + 4 <= store.count) {
+        entityWorldMatrices4(store, group, out, stride, layout);
+        bits &= ~(0xfull << (group % 64));
+        written += 4;
+        continue;
+      }
+#endif
+      bits &= bits - 1;
+      if (i >= store.count) continue;
+      entityWorldMatrix(store.pos_x[i], store.pos_y[i], store.pos_z[i], store.yaw[i], store.scale[i], (float*)(out + i * stride), layout);
+      written++;
+    }
+  }
+  return written;
+}
+
+// Writes world matrices of every dirty entity to out + dense index * stride (64 bytes each, stride 256 for one
+// constant buffer per object) and clears the dirty bits. Returns matrices written.
+size_t updateEntityWorldMatrices(EntityStore& store, void* out, size_t stride, EntityMatrixLayout layout) {
+  PROFILE_SCOPE("entity matrices");
+  const size_t written = entityUpdateRange(store, 0, store.count, (uint8_t*)out, stride, layout);
+#if defined(HEX_SIMD_SSE)
+  _mm_sfence();  // Streaming stores visible before anyone submits the buffer
+#endif
+  return written;
+}
+
+// Same spread over the job system, jobs own whole dirty words
+size_t updateEntityWorldMatrices(EntityStore& store, void* out, size_t stride, EntityMatrixLayout layout, JobSystem& jobs) {
+  PROFILE_SCOPE("entity matrices");
+  const size_t blocks = (store.count + ENTITY_JOB_GRAIN - 1) / ENTITY_JOB_GRAIN;
+  std::atomic<size_t> written(0);
+  jobParallelFor(jobs, blocks, 1, [&](size_t begin, size_t end) {
+    const size_t first = begin * ENTITY_JOB_GRAIN;
+    const size_t last = end * ENTITY_JOB_GRAIN < store.count ? end * ENTITY_JOB_GRAIN : store.count;
+    written += entityUpdateRange(store, first, last - first, (uint8_t*)out, stride, layout);
+#if defined(HEX_SIMD_SSE)
+    _mm_sfence();
+#endif
+  });
+  return written.load();
+}
+
+// Plain loop over every entity, dirty or not - reference for the headless run
+void updateEntityWorldMatricesScalar(const EntityStore& store, void* out, size_t stride, EntityMatrixLayout layout) {
+  for (size_t i = 0; i < store.count; i++) {
+    entityWorldMatrix(store.pos_x[i], store.pos_y[i], store.pos_z[i], store.yaw[i], store.scale[i], (float*)((uint8_t*)out + i * stride), layout);
+  }
+}
+
+#endif /* _H_ENTITY_STORE */
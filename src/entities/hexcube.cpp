@@ -2,27 +2,40 @@
 #define _H_HEXCUBE
 
 #include "../win32_primitives.cpp"
+#include "../hex/hex_mesh.cpp"
 
-const int DEFAULT_HEXCUBE_VERTICES = 12;
+// Shared mesh of the instanced path - top stays white, sides get darker so prisms read as 3D
+const float HEXTILE_SIDE_SHADE = 0.6f;
+unsigned short hexTileIndices[HEX_PRISM_INDICES] = {};
 
-// TODO(ragnar): Get to drawing and prepare indices values
-unsigned short cubeIndices[] = {};
+// One tile at the origin, unit height (or flat) - instances move, scale and color it.
+// Half float positions are plenty for a unit tile, 12 bytes per vertex instead of 28.
+VertexHalf* createInstancedHexTile(bool extruded, int& vertexCount, int& indexCount) {
+  HexMeshDesc desc = {};
+  desc.height = extruded ? 1.0f : 0.0f;
 
-// TODO(moliwa): Can we have a function of runtime and constexpr at the same time?
-DirectX::XMFLOAT4 getRandomColor() {
-  DirectX::XMFLOAT4 temp = {}; 
-  temp.x = (float)rand() / RAND_MAX;
-  temp.y = (float)rand() / RAND_MAX;
-  temp.z = (float)rand() / RAND_MAX;
-  temp.w = 1.0f;
-  return temp;
-}
+  HexMesh mesh = {};
+  if (!createHexMesh(mesh, desc)) {
+    return nullptr;
+  }
 
-// TODO(ragnar): Use some python to calculate the values by hand for now
-Vertex* createDefaultHexcube() {
-  Vertex* hexcubeVertices = (Vertex*) malloc(DEFAULT_HEXCUBE_VERTICES * sizeof(Vertex));
+  VertexHalf* tileVertices = (VertexHalf*) malloc(mesh.vertex_count * sizeof(VertexHalf));
+  if (tileVertices != nullptr) {
+    const uint32_t sideShade = (uint32_t)(HEXTILE_SIDE_SHADE * 255.0f + 0.5f);
+    for (size_t i = 0; i < mesh.vertex_count; i++) {
+      uint32_t shade = i < HEX_FLAT_VERTICES ? 255 : sideShade;
+      mesh.color[i] = shade | (shade << 8) | (shade << 16) | 0xff000000u;
+    }
+    encodeVerticesHalf(mesh, tileVertices);
+    for (size_t i = 0; i < mesh.index_count; i++) {
+      hexTileIndices[i] = (unsigned short)mesh.indices[i];
+    }
+    vertexCount = (int)mesh.vertex_count;
+    indexCount = (int)mesh.index_count;
+  }
+  destroyHexMesh(mesh);
 
-  return hexcubeVertices;
+  return tileVertices;
 }
 
 #endif /* _H_HEXCUBE */
@@ -0,0 +1,183 @@
+#ifndef _H_GRAPHICS_MESH_OPTIMIZE
+#define _H_GRAPHICS_MESH_OPTIMIZE
+
+// Index and vertex order for the GPU caches, plus the 16/32-bit index choice.
+// - Triangle order: Tipsify (Sander, Nehab, Barczak 2007) - fans around the vertex that is most likely
+//   still in the post-transform cache, linear time, good enough next to Forsyth at a fraction of the cost.
+// - Vertex order: renumbered by first use, so fetches walk the vertex buffer front to back.
+// Triangles keep their own vertex order, the provoking (first) vertex of every triangle stays the same.
+// Used on the chunk meshes of HEX_MAP_MESHES map files. The window draws one instanced tile instead and
+// bakes its map without them, so nothing on screen goes through this yet.
+#include "../hex/hex_mesh.cpp"
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+constexpr int VERTEX_CACHE_SIZE = 16;  // What the optimizer assumes - post-transform caches are 16-32 entries
+
+enum IndexFormat {
+  INDEX_FORMAT_16,  // DXGI_FORMAT_R16_UINT
+  INDEX_FORMAT_32   // DXGI_FORMAT_R32_UINT
+};
+
+// 16 bits whenever every index fits - half the index bytes, and what most meshes here need
+inline IndexFormat chooseIndexFormat(size_t vertexCount) {
+  return vertexCount <= 0x10000 ? INDEX_FORMAT_16 : INDEX_FORMAT_32;
+}
+
+inline size_t indexFormatSize(IndexFormat format) {
+  return format == INDEX_FORMAT_16 ? sizeof(uint16_t) : sizeof(uint32_t);
+}
+
+// Writes indices in format, out can be mapped upload memory. Returns bytes written.
+size_t packIndices(const uint32_t* indices, size_t count, IndexFormat format, void* out) {
+  if (format == INDEX_FORMAT_32) {
+    memcpy(out, indices, count * sizeof(uint32_t));
+    return count * sizeof(uint32_t);
+  }
+  uint16_t* out16 = reinterpret_cast<uint16_t*>(out);
+  for (size_t i = 0; i < count; i++) out16[i] = (uint16_t)indices[i];
+  return count * sizeof(uint16_t);
+}
+
+typedef struct VertexCacheStats {
+  double acmr = 0.0;      // Vertex shader runs per triangle - 3 without reuse, about 0.5 is the best a grid gets
+  double atvr = 0.0;      // Vertex shader runs per referenced vertex - 1 means every vertex ran once
+  size_t misses = 0;
+  size_t triangles = 0;
+} VertexCacheStats;
+
+// FIFO cache of cacheSize entries, the model hardware is closest to
+VertexCacheStats analyzeVertexCache(const uint32_t* indices, size_t indexCount, size_t vertexCount, int cacheSize = VERTEX_CACHE_SIZE) {
+  VertexCacheStats stats = {};
+  std::vector<uint32_t> insertedAt(vertexCount, 0);  // Miss counter when the vertex went in, 0 never
+  std::vector<uint8_t> referenced(vertexCount, 0);
+  size_t unique = 0;
+  for (size_t i = 0; i < indexCount; i++) {
+    const uint32_t v = indices[i];
+    if (!referenced[v]) {
+      referenced[v] = 1;
+      unique++;
+    }
+    // Still cached if fewer than cacheSize misses came after it
+    if (insertedAt[v] == 0 || stats.misses - insertedAt[v] >= (size_t)cacheSize) {
+      stats.misses++;
+      insertedAt[v] = (uint32_t)stats.misses;
+    }
+  }
+  stats.triangles = indexCount / 3;
+  stats.acmr = stats.triangles ? (double)stats.misses / (double)stats.triangles : 0.0;
+  stats.atvr = unique ? (double)stats.misses / (double)unique : 0.0;
+  return stats;
+}
+
+// Reorders triangles in place for a cache of cacheSize entries
+void optimizeVertexCache(uint32_t* indices, size_t indexCount, size_t vertexCount, int cacheSize = VERTEX_CACHE_SIZE) {
+  const size_t triangleCount = indexCount / 3;
+  if (triangleCount == 0) return;
+
+  // Triangles around every vertex, CSR style
+  std::vector<uint32_t> offsets(vertexCount + 1, 0);
+  for (size_t i = 0; i < triangleCount * 3; i++) offsets[indices[i] + 1]++;
+  for (size_t v = 0; v < vertexCount; v++) offsets[v + 1] += offsets[v];
+  std::vector<uint32_t> adjacency(triangleCount * 3);
+  std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+  for (size_t t = 0; t < triangleCount; t++) {
+    for (int k = 0; k < 3; k++) adjacency[fill[indices[t * 3 + k]]++] = (uint32_t)t;
+  }
+
+  std::vector<uint32_t> live(vertexCount);
+  for (size_t v = 0; v < vertexCount; v++) live[v] = offsets[v + 1] - offsets[v];
+  std::vector<uint32_t> cachedAt(vertexCount, 0);
+  std::vector<uint8_t> emitted(triangleCount, 0);
+  std::vector<uint32_t> deadEnds;
+  std::vector<uint32_t> candidates;
+  std::vector<uint32_t> out;
+  out.reserve(triangleCount * 3);
+
+  uint32_t time = (uint32_t)cacheSize + 1;
+  size_t cursor = 0;  // Next vertex to try once the dead-end stack runs dry
+  int64_t fan = -1;
+  while (cursor < vertexCount && live[cursor] == 0) cursor++;
+  if (cursor < vertexCount) fan = (int64_t)cursor;
+
+  while (fan >= 0) {
+    candidates.clear();
+    for (uint32_t a = offsets[fan]; a < offsets[fan + 1]; a++) {
+      const uint32_t t = adjacency[a];
+      if (emitted[t]) continue;
+      emitted[t] = 1;
+      for (int k = 0; k < 3; k++) {
+        const uint32_t v = indices[t * 3 + k];
+        out.push_back(v);
+        deadEnds.push_back(v);
+        candidates.push_back(v);
+        live[v]--;
+        if (time - cachedAt[v] > (uint32_t)cacheSize) cachedAt[v] = time++;
+      }
+    }
+
+    // Next fan: the candidate that stays in cache longest while its remaining triangles go out
+    fan = -1;
+    int64_t best = -1;
+    for (uint32_t v : candidates) {
+      if (live[v] == 0) continue;
+      int64_t priority = 0;
+      if ((int64_t)time - cachedAt[v] + 2 * (int64_t)live[v] <= cacheSize) priority = (int64_t)time - cachedAt[v];
+      if (priority > best) {
+        best = priority;
+        fan = v;
+      }
+    }
+    if (fan >= 0) continue;
+    while (!deadEnds.empty()) {
+      const uint32_t v = deadEnds.back();
+      deadEnds.pop_back();
+      if (live[v] > 0) {
+        fan = v;
+        break;
+      }
+    }
+    if (fan >= 0) continue;
+    while (cursor < vertexCount && live[cursor] == 0) cursor++;
+    if (cursor < vertexCount) fan = (int64_t)cursor;
+  }
+  memcpy(indices, out.data(), out.size() * sizeof(uint32_t));
+}
+
+// Renumbers vertices in order of first use and moves the SoA streams to match. Vertices no index uses are
+// dropped. Call after optimizeVertexCache, the index order decides the vertex order.
+void optimizeVertexFetch(HexMesh& mesh) {
+  std::vector<uint32_t> remap(mesh.vertex_count, UINT32_MAX);
+  uint32_t next = 0;
+  for (size_t i = 0; i < mesh.index_count; i++) {
+    uint32_t& mapped = remap[mesh.indices[i]];
+    if (mapped == UINT32_MAX) mapped = next++;
+    mesh.indices[i] = mapped;
+  }
+  std::vector<float> scratch(next);
+  float* streams[3] = { mesh.pos_x, mesh.pos_y, mesh.pos_z };
+  for (float* stream : streams) {
+    for (size_t v = 0; v < mesh.vertex_count; v++) {
+      if (remap[v] != UINT32_MAX) scratch[remap[v]] = stream[v];
+    }
+    memcpy(stream, scratch.data(), next * sizeof(float));
+  }
+  std::vector<uint32_t> colors(next);
+  for (size_t v = 0; v < mesh.vertex_count; v++) {
+    if (remap[v] != UINT32_MAX) colors[remap[v]] = mesh.color[v];
+  }
+  memcpy(mesh.color, colors.data(), next * sizeof(uint32_t));
+  mesh.vertex_count = next;
+  mesh.vertices_per_tile = 0;
+}
+
+// Both passes, the usual way to finish a generated mesh
+inline void optimizeHexMesh(HexMesh& mesh, int cacheSize = VERTEX_CACHE_SIZE) {
+  optimizeVertexCache(mesh.indices, mesh.index_count, mesh.vertex_count, cacheSize);
+  optimizeVertexFetch(mesh);
+}
+
+#endif /* _H_GRAPHICS_MESH_OPTIMIZE */
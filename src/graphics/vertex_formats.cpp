@@ -0,0 +1,328 @@
+#ifndef _H_GRAPHICS_VERTEX_FORMATS
+#define _H_GRAPHICS_VERTEX_FORMATS
+
+// Vertex formats and their input layouts, described once next to the struct.
+// Platform-neutral - render_pipeline/win32_input_layout.cpp turns VertexLayout<T> into D3D12_INPUT_ELEMENT_DESC
+// at compile time, so nobody writes byte offsets by hand anymore.
+#include "../core/simd.cpp"
+#include "../core/simd_math.cpp"
+#include "../hex/hex_mesh.cpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+
+enum VertexAttribFormat {
+  VERTEX_ATTRIB_FLOAT1,
+  VERTEX_ATTRIB_FLOAT2,
+  VERTEX_ATTRIB_FLOAT3,
+  VERTEX_ATTRIB_FLOAT4,
+  VERTEX_ATTRIB_UINT1,
+  VERTEX_ATTRIB_HALF4,         // 4 x 16-bit float
+  VERTEX_ATTRIB_UNORM8X4,      // RGBA8, red in the lowest byte
+  VERTEX_ATTRIB_UNORM10X3_2    // 10:10:10 xyz + 2 bit w, x in the lowest bits
+};
+
+constexpr uint32_t vertexAttribSize(VertexAttribFormat format) {
+  switch (format) {
+    case VERTEX_ATTRIB_FLOAT1: return 4;
+    case VERTEX_ATTRIB_FLOAT2: return 8;
+    case VERTEX_ATTRIB_FLOAT3: return 12;
+    case VERTEX_ATTRIB_FLOAT4: return 16;
+    case VERTEX_ATTRIB_UINT1: return 4;
+    case VERTEX_ATTRIB_HALF4: return 8;
+    case VERTEX_ATTRIB_UNORM8X4: return 4;
+    case VERTEX_ATTRIB_UNORM10X3_2: return 4;
+  }
+  return 0;
+}
+
+// Field types - each one maps to exactly one attribute format
+// Float3 and Float4 come from core/simd_math.cpp
+typedef struct Half4 { uint16_t x, y, z, w; } Half4;
+typedef struct Rgba8 { uint32_t rgba; } Rgba8;
+typedef struct Unorm1010102 { uint32_t xyzw; } Unorm1010102;
+
+template <typename T> struct VertexAttribFormatOf;
+template <> struct VertexAttribFormatOf<float> { static constexpr VertexAttribFormat value = VERTEX_ATTRIB_FLOAT1; };
+template <> struct VertexAttribFormatOf<uint32_t> { static constexpr VertexAttribFormat value = VERTEX_ATTRIB_UINT1; };
+template <> struct VertexAttribFormatOf<Float3> { static constexpr VertexAttribFormat value = VERTEX_ATTRIB_FLOAT3; };
+template <> struct VertexAttribFormatOf<Float4> { static constexpr VertexAttribFormat value = VERTEX_ATTRIB_FLOAT4; };
+template <> struct VertexAttribFormatOf<Half4> { static constexpr VertexAttribFormat value = VERTEX_ATTRIB_HALF4; };
+template <> struct VertexAttribFormatOf<Rgba8> { static constexpr VertexAttribFormat value = VERTEX_ATTRIB_UNORM8X4; };
+template <> struct VertexAttribFormatOf<Unorm1010102> { static constexpr VertexAttribFormat value = VERTEX_ATTRIB_UNORM10X3_2; };
+
+typedef struct VertexAttrib {
+  const char* semantic;
+  VertexAttribFormat format;
+  uint32_t offset;
+} VertexAttrib;
+
+// Format comes from the member type, offset from offsetof - the struct is the only source of truth
+#define VERTEX_ATTRIB(Struct, member, semantic) \
+  VertexAttrib{ semantic, VertexAttribFormatOf<decltype(Struct::member)>::value, (uint32_t)offsetof(Struct, member) }
+// For attributes spanning several plain members, ex. float2 made of offset_x and offset_z
+#define VERTEX_ATTRIB_AS(Struct, member, semantic, format) \
+  VertexAttrib{ semantic, format, (uint32_t)offsetof(Struct, member) }
+
+// Specialize with `static constexpr VertexAttrib attribs[]` listed in memory order
+template <typename V> struct VertexLayout;
+
+template <typename V>
+constexpr size_t vertexAttribCount() {
+  return sizeof(VertexLayout<V>::attribs) / sizeof(VertexAttrib);
+}
+
+// Attributes in order, not overlapping and covering the whole struct - no padding gets uploaded for nothing
+template <typename V>
+constexpr bool vertexLayoutIsTight() {
+  uint32_t end = 0;
+  for (size_t i = 0; i < vertexAttribCount<V>(); i++) {
+    const VertexAttrib& a = VertexLayout<V>::attribs[i];
+    if (a.offset != end) return false;
+    end = a.offset + vertexAttribSize(a.format);
+  }
+  return end == sizeof(V);
+}
+
+// 28 bytes - what Vertex has always been, full float position and color
+typedef struct VertexFloat {
+  Float3 pos;
+  Float4 color;
+} VertexFloat;
+
+// 12 bytes - half float position with w = 1, RGBA8 color. Fine for local meshes, half has 11 bits of mantissa.
+typedef struct VertexHalf {
+  Half4 pos;
+  Rgba8 color;
+} VertexHalf;
+
+// 8 bytes - 10 bits per axis inside a VertexQuantizeBox, w always 1. The shader scales it back with the box.
+typedef struct VertexQuantized {
+  Unorm1010102 pos;
+  Rgba8 color;
+} VertexQuantized;
+
+template <> struct VertexLayout<VertexFloat> {
+  static constexpr VertexAttrib attribs[] = {
+    VERTEX_ATTRIB(VertexFloat, pos, "POSITION"),
+    VERTEX_ATTRIB(VertexFloat, color, "COLOR")
+  };
+};
+
+template <> struct VertexLayout<VertexHalf> {
+  static constexpr VertexAttrib attribs[] = {
+    VERTEX_ATTRIB(VertexHalf, pos, "POSITION"),
+    VERTEX_ATTRIB(VertexHalf, color, "COLOR")
+  };
+};
+
+template <> struct VertexLayout<VertexQuantized> {
+  static constexpr VertexAttrib attribs[] = {
+    VERTEX_ATTRIB(VertexQuantized, pos, "POSITION"),
+    VERTEX_ATTRIB(VertexQuantized, color, "COLOR")
+  };
+};
+
+static_assert(sizeof(VertexFloat) == 28 && vertexLayoutIsTight<VertexFloat>(), "VertexFloat layout");
+static_assert(sizeof(VertexHalf) == 12 && vertexLayoutIsTight<VertexHalf>(), "VertexHalf layout");
+static_assert(sizeof(VertexQuantized) == 8 && vertexLayoutIsTight<VertexQuantized>(), "VertexQuantized layout");
+
+// Round to nearest even, same result as F16C with _MM_FROUND_TO_NEAREST_INT (NaNs aside)
+inline uint16_t floatToHalf(float value) {
+  uint32_t f;
+  memcpy(&f, &value, sizeof(f));
+  uint32_t sign = f & 0x80000000u;
+  f ^= sign;
+
+  uint32_t h;
+  if (f >= (127u + 16u) << 23) {
+    h = f > 0x7f800000u ? 0x7e00 : 0x7c00;   // NaN or too big for half
+  } else if (f < 113u << 23) {
+    // Half denormal - let the FPU do the rounding by adding a magic number
+    const uint32_t magicBits = ((127u - 15u) + (23u - 10u) + 1u) << 23;
+    float magic, scaled;
+    memcpy(&magic, &magicBits, sizeof(magic));
+    memcpy(&scaled, &f, sizeof(scaled));
+    scaled += magic;
+    memcpy(&h, &scaled, sizeof(h));
+    h -= magicBits;
+  } else {
+    uint32_t mantissaOdd = (f >> 13) & 1;
+    f += ((15u - 127u) << 23) + 0xfff + mantissaOdd;
+    h = f >> 13;
+  }
+  return (uint16_t)(h | (sign >> 16));
+}
+
+inline float halfToFloat(uint16_t h) {
+  uint32_t sign = (uint32_t)(h & 0x8000) << 16;
+  uint32_t exponent = (h >> 10) & 0x1f;
+  uint32_t mantissa = h & 0x3ff;
+  float value;
+  if (exponent == 0) {
+    value = ldexpf((float)mantissa, -24);
+  } else if (exponent == 31) {
+    value = mantissa ? NAN : INFINITY;
+  } else {
+    value = ldexpf((float)(mantissa | 0x400), (int)exponent - 25);
+  }
+  uint32_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  bits |= sign;
+  memcpy(&value, &bits, sizeof(value));
+  return value;
+}
+
+// Box the quantized positions live in, extent of 0 on an axis is fine (flat meshes)
+typedef struct VertexQuantizeBox {
+  float min[3];
+  float extent[3];
+} VertexQuantizeBox;
+
+VertexQuantizeBox vertexQuantizeBoxFromMesh(const HexMesh& mesh) {
+  VertexQuantizeBox box = {};
+  if (mesh.vertex_count == 0) return box;
+  float lo[3] = { mesh.pos_x[0], mesh.pos_y[0], mesh.pos_z[0] };
+  float hi[3] = { lo[0], lo[1], lo[2] };
+  for (size_t i = 1; i < mesh.vertex_count; i++) {
+    const float p[3] = { mesh.pos_x[i], mesh.pos_y[i], mesh.pos_z[i] };
+    for (int a = 0; a < 3; a++) {
+      lo[a] = p[a] < lo[a] ? p[a] : lo[a];
+      hi[a] = p[a] > hi[a] ? p[a] : hi[a];
+    }
+  }
+  for (int a = 0; a < 3; a++) {
+    box.min[a] = lo[a];
+    box.extent[a] = hi[a] - lo[a];
+  }
+  return box;
+}
+
+inline float vertexQuantizeScale(float extent) {
+  return extent > 0.0f ? 1.0f / extent : 0.0f;
+}
+
+inline void decodeVertexQuantized(const VertexQuantized& v, const VertexQuantizeBox& box, float out[3]) {
+  for (int a = 0; a < 3; a++) {
+    out[a] = box.min[a] + (float)((v.pos.xyzw >> (10 * a)) & 0x3ff) / 1023.0f * box.extent[a];
+  }
+}
+
+// Encoders take the SoA mesh straight from the generator, out may be mapped upload memory.
+// Scalar ones are the reference the SIMD ones get checked against.
+void encodeVerticesFloat(const HexMesh& mesh, VertexFloat* out) {
+  for (size_t i = 0; i < mesh.vertex_count; i++) {
+    uint32_t c = mesh.color[i];
+    out[i].pos = Float3{ mesh.pos_x[i], mesh.pos_y[i], mesh.pos_z[i] };
+    out[i].color = Float4{
+        (float)(c & 0xff) / 255.0f,
+        (float)((c >> 8) & 0xff) / 255.0f,
+        (float)((c >> 16) & 0xff) / 255.0f,
+        (float)((c >> 24) & 0xff) / 255.0f };
+  }
+}
+
+static inline void encodeVertexHalfScalar(const HexMesh& mesh, size_t i, VertexHalf& out) {
+  out.pos.x = floatToHalf(mesh.pos_x[i]);
+  out.pos.y = floatToHalf(mesh.pos_y[i]);
+  out.pos.z = floatToHalf(mesh.pos_z[i]);
+  out.pos.w = 0x3c00;  // 1.0
+  out.color.rgba = mesh.color[i];
+}
+
+void encodeVerticesHalfScalar(const HexMesh& mesh, VertexHalf* out) {
+  for (size_t i = 0; i < mesh.vertex_count; i++) encodeVertexHalfScalar(mesh, i, out[i]);
+}
+
+void encodeVerticesHalf(const HexMesh& mesh, VertexHalf* out) {
+  size_t i = 0;
+#if defined(HEX_SIMD_F16C)
+  const __m128i one = _mm_set1_epi16(0x3c00);
+  for (; i + 4 <= mesh.vertex_count; i += 4) {
+    __m128i x = _mm_cvtps_ph(_mm_loadu_ps(mesh.pos_x + i), _MM_FROUND_TO_NEAREST_INT);
+    __m128i y = _mm_cvtps_ph(_mm_loadu_ps(mesh.pos_y + i), _MM_FROUND_TO_NEAREST_INT);
+    __m128i z = _mm_cvtps_ph(_mm_loadu_ps(mesh.pos_z + i), _MM_FROUND_TO_NEAREST_INT);
+    // x0 y0 x1 y1 .. and z0 w0 z1 w1 .., then 32-bit interleave gives whole xyzw per 64 bits
+    __m128i xy = _mm_unpacklo_epi16(x, y);
+    __m128i zw = _mm_unpacklo_epi16(z, one);
+    __m128i lo = _mm_unpacklo_epi32(xy, zw);
+    __m128i hi = _mm_unpackhi_epi32(xy, zw);
+    _mm_storel_epi64(reinterpret_cast<__m128i*>(&out[i + 0].pos), lo);
+    _mm_storeh_pd(reinterpret_cast<double*>(&out[i + 1].pos), _mm_castsi128_pd(lo));
+    _mm_storel_epi64(reinterpret_cast<__m128i*>(&out[i + 2].pos), hi);
+    _mm_storeh_pd(reinterpret_cast<double*>(&out[i + 3].pos), _mm_castsi128_pd(hi));
+    out[i + 0].color.rgba = mesh.color[i + 0];
+    out[i + 1].color.rgba = mesh.color[i + 1];
+    out[i + 2].color.rgba = mesh.color[i + 2];
+    out[i + 3].color.rgba = mesh.color[i + 3];
+  }
+#endif
+  for (; i < mesh.vertex_count; i++) encodeVertexHalfScalar(mesh, i, out[i]);
+}
+
+static inline uint32_t quantizeUnorm10(float value, float min, float scale) {
+  float t = (value - min) * scale;
+  t = t < 0.0f ? 0.0f : (t > 1.0f ? 1.0f : t);
+  return (uint32_t)lrintf(t * 1023.0f);
+}
+
+static inline void encodeVertexQuantizedScalar(const HexMesh& mesh, const VertexQuantizeBox& box, size_t i, VertexQuantized& out) {
+  uint32_t x = quantizeUnorm10(mesh.pos_x[i], box.min[0], vertexQuantizeScale(box.extent[0]));
+  uint32_t y = quantizeUnorm10(mesh.pos_y[i], box.min[1], vertexQuantizeScale(box.extent[1]));
+  uint32_t z = quantizeUnorm10(mesh.pos_z[i], box.min[2], vertexQuantizeScale(box.extent[2]));
+  out.pos.xyzw = x | (y << 10) | (z << 20) | (3u << 30);
+  out.color.rgba = mesh.color[i];
+}
+
+void encodeVerticesQuantizedScalar(const HexMesh& mesh, const VertexQuantizeBox& box, VertexQuantized* out) {
+  for (size_t i = 0; i < mesh.vertex_count; i++) encodeVertexQuantizedScalar(mesh, box, i, out[i]);
+}
+
+void encodeVerticesQuantized(const HexMesh& mesh, const VertexQuantizeBox& box, VertexQuantized* out) {
+  size_t i = 0;
+#if defined(HEX_SIMD_AVX2)
+  const __m256 minX = _mm256_set1_ps(box.min[0]), scaleX = _mm256_set1_ps(vertexQuantizeScale(box.extent[0]));
+  const __m256 minY = _mm256_set1_ps(box.min[1]), scaleY = _mm256_set1_ps(vertexQuantizeScale(box.extent[1]));
+  const __m256 minZ = _mm256_set1_ps(box.min[2]), scaleZ = _mm256_set1_ps(vertexQuantizeScale(box.extent[2]));
+  const __m256 zero = _mm256_setzero_ps(), one = _mm256_set1_ps(1.0f), range = _mm256_set1_ps(1023.0f);
+  const __m256i w = _mm256_set1_epi32((int)(3u << 30));
+  #define QUANTIZE_LANES(p, lo, scale) \
+    _mm256_cvtps_epi32(_mm256_mul_ps(_mm256_min_ps(_mm256_max_ps(_mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(p), lo), scale), zero), one), range))
+  for (; i + 8 <= mesh.vertex_count; i += 8) {
+    __m256i x = QUANTIZE_LANES(mesh.pos_x + i, minX, scaleX);
+    __m256i y = QUANTIZE_LANES(mesh.pos_y + i, minY, scaleY);
+    __m256i z = QUANTIZE_LANES(mesh.pos_z + i, minZ, scaleZ);
+    __m256i pos = _mm256_or_si256(_mm256_or_si256(x, _mm256_slli_epi32(y, 10)), _mm256_or_si256(_mm256_slli_epi32(z, 20), w));
+    __m256i color = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(mesh.color + i));
+    // Unpack works per 128-bit half, so vertices come out as 0 1 4 5 / 2 3 6 7 and get swapped back
+    __m256i lo = _mm256_unpacklo_epi32(pos, color);
+    __m256i hi = _mm256_unpackhi_epi32(pos, color);
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), _mm256_permute2x128_si256(lo, hi, 0x20));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i + 4), _mm256_permute2x128_si256(lo, hi, 0x31));
+  }
+  #undef QUANTIZE_LANES
+#elif defined(HEX_SIMD_SSE)
+  const __m128 minX = _mm_set1_ps(box.min[0]), scaleX = _mm_set1_ps(vertexQuantizeScale(box.extent[0]));
+  const __m128 minY = _mm_set1_ps(box.min[1]), scaleY = _mm_set1_ps(vertexQuantizeScale(box.extent[1]));
+  const __m128 minZ = _mm_set1_ps(box.min[2]), scaleZ = _mm_set1_ps(vertexQuantizeScale(box.extent[2]));
+  const __m128 zero = _mm_setzero_ps(), one = _mm_set1_ps(1.0f), range = _mm_set1_ps(1023.0f);
+  const __m128i w = _mm_set1_epi32((int)(3u << 30));
+  #define QUANTIZE_LANES(p, lo, scale) \
+    _mm_cvtps_epi32(_mm_mul_ps(_mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(p), lo), scale), zero), one), range))
+  for (; i + 4 <= mesh.vertex_count; i += 4) {
+    __m128i x = QUANTIZE_LANES(mesh.pos_x + i, minX, scaleX);
+    __m128i y = QUANTIZE_LANES(mesh.pos_y + i, minY, scaleY);
+    __m128i z = QUANTIZE_LANES(mesh.pos_z + i, minZ, scaleZ);
+    __m128i pos = _mm_or_si128(_mm_or_si128(x, _mm_slli_epi32(y, 10)), _mm_or_si128(_mm_slli_epi32(z, 20), w));
+    __m128i color = _mm_loadu_si128(reinterpret_cast<const __m128i*>(mesh.color + i));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), _mm_unpacklo_epi32(pos, color));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i + 2), _mm_unpackhi_epi32(pos, color));
+  }
+  #undef QUANTIZE_LANES
+#endif
+  for (; i < mesh.vertex_count; i++) encodeVertexQuantizedScalar(mesh, box, i, out[i]);
+}
+
+#endif /* _H_GRAPHICS_VERTEX_FORMATS */
@@ -0,0 +1,3106 @@
+
+#include "config.cpp"
+
+// Headless entry point - builds without <windows.h>, so the platform-neutral core
+// can be run and checked on Linux boxes. Build with build_headless.sh.
+
+#include "core/simd.cpp"
+#include "core/timer.cpp"
+#include "core/simd_math.cpp"
+#include "hex/hex_mesh.cpp"
+#include "hex/hex_world.cpp"
+#include "hex/hex_instances.cpp"
+#include "hex/hex_picking.cpp"
+#include "hex/hex_terrain.cpp"
+#include "hex/hex_map_file.cpp"
+#include "hex/hex_map_stream.cpp"
+#include "hex/hex_edit.cpp"
+#include "hex/hex_path.cpp"
+#include "hex/hex_fov.cpp"
+#include "hex/hex_occlusion.cpp"
+#include "hex/hex_commands.cpp"
+#include "hex/hex_grid.cpp"
+#include "hex/hex_animation.cpp"
+#include "entities/entity_store.cpp"
+#include "graphics/vertex_formats.cpp"
+#include "graphics/mesh_optimize.cpp"
+#include "render_pipeline/frame_pacing.cpp"
+#include "render_pipeline/shader_cache.cpp"
+#include "render_pipeline/copy_uploader.cpp"
+#include "software/sw_rasterizer.cpp"
+#include "software/sw_image.cpp"
+#include "software/sw_command_backend.cpp"
+#include "core/upload_allocator.cpp"
+#include "core/startup.cpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <thread>
+#include <chrono>
+#include <array>
+#include <algorithm>
+
+#if !defined(_WIN32)
+  #include <fcntl.h>
+  #include <unistd.h>
+#endif
+
+// Camera hovering over the middle of a columns x rows map, looking down at 45 degrees
+static void benchCamera(float viewProjection[16], int columns, int rows) {
+    float cx = HEX_DEFAULT_RADIUS * HEX_SQRT3 * (float)columns * 0.5f;
+    float cz = HEX_DEFAULT_RADIUS * 1.5f * (float)rows * 0.5f;
+    const Mat4 view = mat4LookAtLH({ cx, 20.0f, cz - 20.0f }, { cx, 0.0f, cz }, { 0.0f, 1.0f, 0.0f });
+    const Mat4 projection = mat4PerspectiveFovLH(MATH_PIDIV4, 16.0f / 9.0f, 0.1f, 100.0f);
+    memcpy(viewProjection, (view * projection).m, sizeof(float) * 16);
+}
+
+static int runMesh(int argc, char** argv) {
+    HexMeshDesc desc = {};
+    desc.columns = argc > 0 ? atoi(argv[0]) : 1000;
+    desc.rows = argc > 1 ? atoi(argv[1]) : 1000;
+    desc.height = argc > 2 ? (float)atof(argv[2]) : 0.0f;
+
+    HexMesh mesh = {};
+    double start = timerMilliseconds();
+    if (!createHexMesh(mesh, desc)) {
+        fprintf(stderr, "mesh: failed to create %dx%d mesh\n", desc.columns, desc.rows);
+        return 1;
+    }
+    double elapsed = timerMilliseconds() - start;
+
+    // Second pass into already touched memory - first one is mostly page faults
+    start = timerMilliseconds();
+    generateHexMeshTiles(mesh, desc, 0, mesh.tile_count);
+    double warm = timerMilliseconds() - start;
+
+    bool valid = validateHexMesh(mesh);
+    printf("mesh: %dx%d tiles (%s), %zu vertices, %zu indices, %.3f ms (warm %.3f ms) [%s], %s\n",
+        desc.columns, desc.rows, desc.height > 0.0f ? "extruded" : "flat",
+        mesh.vertex_count, mesh.index_count, elapsed, warm, simdName(), valid ? "valid" : "INVALID");
+
+    destroyHexMesh(mesh);
+    return valid ? 0 : 1;
+}
+
+static int runCull(int argc, char** argv) {
+    const int iterations = 1000;
+    int failures = 0;
+
+    // Map side doubles every step so we can see how the win scales with map size
+    int maxSide = argc > 0 ? atoi(argv[0]) : 8192;
+    for (int side = 256; side <= maxSide; side *= 2) {
+        HexWorldDesc desc = {};
+        desc.columns = side;
+        desc.rows = side;
+        desc.height = 1.0f;
+
+        HexWorld world = {};
+        if (!createHexWorld(world, desc)) {
+            fprintf(stderr, "cull: failed to create %dx%d world\n", side, side);
+            return 1;
+        }
+
+        float viewProjection[16];
+        benchCamera(viewProjection, side, side);
+        for (int i = 0; i < iterations; i++) cullHexWorld(world, viewProjection);
+
+        // SIMD and reference path have to agree on every chunk
+        Frustum frustum;
+        frustumFromMatrix(frustum, viewProjection);
+        uint32_t* reference = (uint32_t*) malloc(world.chunk_count * sizeof(uint32_t));
+        size_t referenceCount = cullAabbsScalar(frustum, world.bounds, reference);
+        bool match = referenceCount == world.visible_count &&
+            memcmp(reference, world.visible, referenceCount * sizeof(uint32_t)) == 0;
+        failures += match ? 0 : 1;
+        free(reference);
+
+        printf("cull: %5dx%-5d tiles, %6zu chunks tested, %4zu visible (%5.2f%%), %.4f ms per cull [%s], %s\n",
+            side, side, world.chunk_count, world.visible_count,
+            100.0 * (double)world.stats.visible / (double)world.stats.tested,
+            world.stats.time_ms / iterations, simdName(), match ? "matches scalar" : "MISMATCH");
+
+        destroyHexWorld(world);
+    }
+    return failures == 0 ? 0 : 1;
+}
+
+static int runInstances(int argc, char** argv) {
+    HexWorldDesc desc = {};
+    desc.columns = argc > 0 ? atoi(argv[0]) : 1024;
+    desc.rows = argc > 1 ? atoi(argv[1]) : 1024;
+    desc.height = 1.0f;
+
+    HexWorld world = {};
+    if (!createHexWorld(world, desc)) {
+        fprintf(stderr, "instances: failed to create world\n");
+        return 1;
+    }
+
+    HexInstanceRange* ranges = (HexInstanceRange*) malloc(world.chunk_count * sizeof(HexInstanceRange));
+    size_t total = buildHexInstanceRanges(world, ranges);
+    HexInstance* packed = (HexInstance*) alignedAlloc(total * sizeof(HexInstance));
+    HexInstance* reference = (HexInstance*) alignedAlloc(total * sizeof(HexInstance));
+
+    double start = timerMilliseconds();
+    for (size_t i = 0; i < world.chunk_count; i++) packHexChunkInstances(world, i, packed + ranges[i].first);
+    double elapsed = timerMilliseconds() - start;
+    start = timerMilliseconds();
+    for (size_t i = 0; i < world.chunk_count; i++) packHexChunkInstancesScalar(world, i, reference + ranges[i].first);
+    double elapsedScalar = timerMilliseconds() - start;
+    bool match = memcmp(packed, reference, total * sizeof(HexInstance)) == 0;
+
+    // Draw count for the same camera the cull command uses
+    float viewProjection[16];
+    benchCamera(viewProjection, desc.columns, desc.rows);
+    cullHexWorld(world, viewProjection);
+    HexInstanceRange* runs = (HexInstanceRange*) malloc(world.chunk_count * sizeof(HexInstanceRange));
+    size_t runCount = mergeVisibleInstanceRanges(world.visible, world.visible_count, ranges, runs);
+
+    // Unique mesh would be every tile's prism as 28 byte vertices plus 16-bit indices
+    double uniqueBytes = (double)total * (HEX_PRISM_VERTICES * 28.0 + HEX_PRISM_INDICES * 2.0);
+    double instancedBytes = (double)total * sizeof(HexInstance) + HEX_PRISM_VERTICES * 28.0 + HEX_PRISM_INDICES * 2.0;
+    printf("instances: %zu tiles packed in %.3f ms (scalar %.3f ms) [%s], %s\n",
+        total, elapsed, elapsedScalar, simdName(), match ? "matches scalar" : "MISMATCH");
+    printf("instances: %.1f MB instanced vs %.1f MB unique mesh, %zu visible chunks in %zu draws\n",
+        instancedBytes / (1024.0 * 1024.0), uniqueBytes / (1024.0 * 1024.0), world.visible_count, runCount);
+
+    free(runs);
+    alignedFree(reference);
+    alignedFree(packed);
+    free(ranges);
+    destroyHexWorld(world);
+    return match ? 0 : 1;
+}
+
+// Simulated frame loop - cpuMs of "recording" per frame against a GPU that needs gpuMs per frame
+static double simulateFrames(uint32_t framesInFlight, double cpuMs, double gpuMs, int frames, FramePacer& pacer) {
+    NullFrameBackend backend(gpuMs);
+    initFramePacer(pacer, &backend, framesInFlight);
+
+    double start = timerMilliseconds();
+    for (int i = 0; i < frames; i++) {
+        beginFrame(pacer);
+        std::this_thread::sleep_for(std::chrono::duration<double, std::milli>(cpuMs));
+        endFrame(pacer);
+    }
+    flushFrames(pacer);
+    return timerMilliseconds() - start;
+}
+
+static int runPacing(int argc, char** argv) {
+    double cpuMs = argc > 0 ? atof(argv[0]) : 4.0;
+    double gpuMs = argc > 1 ? atof(argv[1]) : 4.0;
+    int frames = argc > 2 ? atoi(argv[2]) : 200;
+
+    double serialized = 0.0;
+    double pipelined = 0.0;
+    for (uint32_t inFlight = 1; inFlight <= MAX_FRAMES_IN_FLIGHT; inFlight++) {
+        FramePacer pacer = {};
+        double elapsed = simulateFrames(inFlight, cpuMs, gpuMs, frames, pacer);
+        if (inFlight == 1) serialized = elapsed;
+        if (inFlight == FRAMES_IN_FLIGHT) pipelined = elapsed;
+        printf("pacing: %u in flight, cpu %.1f ms gpu %.1f ms -> %.2f ms/frame, %.1f fps, %llu stalls, %.2f ms waited per frame\n",
+            inFlight, cpuMs, gpuMs, elapsed / frames, 1000.0 * frames / elapsed,
+            (unsigned long long)pacer.stalls, pacer.wait_ms / frames);
+    }
+
+    // Overlap should buy close to min(cpu, gpu) per frame, fail if most of that is gone
+    double expected = serialized - frames * (cpuMs < gpuMs ? cpuMs : gpuMs) * 0.5;
+    bool ok = pipelined <= expected;
+    printf("pacing: %u frames in flight is %.2fx faster than serialized, %s\n",
+        FRAMES_IN_FLIGHT, serialized / pipelined, ok ? "ok" : "REGRESSION");
+    return ok ? 0 : 1;
+}
+
+// Same shared tile as createInstancedHexTile, just in SwVertex
+static bool createSwHexTile(std::vector<SwVertex>& vertices, std::vector<unsigned short>& indices) {
+    HexMeshDesc desc = {};
+    desc.height = 1.0f;
+    HexMesh mesh = {};
+    if (!createHexMesh(mesh, desc)) return false;
+
+    vertices.resize(mesh.vertex_count);
+    for (size_t i = 0; i < mesh.vertex_count; i++) {
+        float shade = i < HEX_FLAT_VERTICES ? 1.0f : 0.6f;
+        vertices[i] = { { mesh.pos_x[i], mesh.pos_y[i], mesh.pos_z[i] }, { shade, shade, shade, 1.0f } };
+    }
+    indices.assign(mesh.indices, mesh.indices + mesh.index_count);
+    destroyHexMesh(mesh);
+    return true;
+}
+
+static const float HEADLESS_CLEAR_COLOR[4] = { 0.0f, 0.0f, 0.4f, 1.0f }; // clearColor from graphics/defines.cpp
+
+typedef struct HeadlessScene {
+    HexWorld world;
+    std::vector<HexInstance> instances;
+    std::vector<HexInstanceRange> ranges;
+    std::vector<HexInstanceRange> runs;
+    std::vector<SwVertex> tile_vertices;
+    std::vector<unsigned short> tile_indices;
+    SwMVP mvp;
+} HeadlessScene;
+
+// Hex world + camera + culled instance runs, the same things onUpdate prepares for onRender
+static bool createHeadlessScene(HeadlessScene& scene, int columns, int rows) {
+    HexWorldDesc desc = {};
+    desc.columns = columns;
+    desc.rows = rows;
+    desc.height = 0.3f;
+    if (!createHexWorld(scene.world, desc) || !createSwHexTile(scene.tile_vertices, scene.tile_indices)) return false;
+
+    scene.ranges.resize(scene.world.chunk_count);
+    scene.instances.resize(buildHexInstanceRanges(scene.world, scene.ranges.data()));
+    for (size_t i = 0; i < scene.world.chunk_count; i++) {
+        packHexChunkInstances(scene.world, i, scene.instances.data() + scene.ranges[i].first);
+    }
+
+    float cx = HEX_DEFAULT_RADIUS * HEX_SQRT3 * (float)columns * 0.5f;
+    float cz = HEX_DEFAULT_RADIUS * 1.5f * (float)rows * 0.5f;
+    const Mat4 view = mat4LookAtLH({ cx, 20.0f, cz - 20.0f }, { cx, 0.0f, cz }, { 0.0f, 1.0f, 0.0f });
+    const Mat4 projection = mat4PerspectiveFovLH(MATH_PIDIV4, (float)DISPLAY_WIDTH / (float)DISPLAY_HEIGHT, 0.1f, 100.0f);
+    const Mat4 viewProjection = view * projection;
+    // Shader gets transposed matrices, so does the software path
+    memcpy(scene.mvp.world, mat4Transpose(mat4Identity()).m, sizeof(scene.mvp.world));
+    memcpy(scene.mvp.view, mat4Transpose(view).m, sizeof(scene.mvp.view));
+    memcpy(scene.mvp.projection, mat4Transpose(projection).m, sizeof(scene.mvp.projection));
+
+    cullHexWorld(scene.world, viewProjection.m);
+    scene.runs.resize(scene.world.chunk_count);
+    scene.runs.resize(mergeVisibleInstanceRanges(scene.world.visible, scene.world.visible_count, scene.ranges.data(), scene.runs.data()));
+    return true;
+}
+
+static void renderHeadlessScene(SwRasterizer& rasterizer, const HeadlessScene& scene) {
+    swClear(rasterizer, HEADLESS_CLEAR_COLOR);
+    for (const HexInstanceRange& run : scene.runs) {
+        SwDraw draw = {};
+        draw.vertices = scene.tile_vertices.data();
+        draw.indices = scene.tile_indices.data();
+        draw.index_count = scene.tile_indices.size();
+        draw.instances = scene.instances.data() + run.first;
+        draw.instance_count = run.count;
+        swDraw(rasterizer, draw, scene.mvp);
+    }
+}
+
+static int runRaster(int argc, char** argv) {
+    int frames = argc > 0 ? atoi(argv[0]) : 30;
+    int threads = argc > 1 ? atoi(argv[1]) : hardwareThreads();
+    const char* output = argc > 2 ? argv[2] : nullptr;
+
+    HeadlessScene scene = {};
+    if (!createHeadlessScene(scene, 1024, 1024)) {
+        fprintf(stderr, "raster: failed to create scene\n");
+        return 1;
+    }
+
+    SwRasterizer rasterizer = {};
+    SwRasterizer reference = {};
+    if (!createSwRasterizer(rasterizer, DISPLAY_WIDTH, DISPLAY_HEIGHT, threads) ||
+        !createSwRasterizer(reference, DISPLAY_WIDTH, DISPLAY_HEIGHT, 1)) {
+        fprintf(stderr, "raster: failed to create rasterizer\n");
+        return 1;
+    }
+
+    renderHeadlessScene(rasterizer, scene); // Warm up, first touch of every bin and pixel
+    rasterizer.stats = {};
+    double start = timerMilliseconds();
+    for (int i = 0; i < frames; i++) renderHeadlessScene(rasterizer, scene);
+    double elapsed = timerMilliseconds() - start;
+
+    // Output must not depend on thread count
+    renderHeadlessScene(reference, scene);
+    bool match = memcmp(rasterizer.color, reference.color, (size_t)rasterizer.stride * rasterizer.height * sizeof(uint32_t)) == 0;
+
+    printf("raster: %dx%d, %d threads [%s], %zu draws, %zu triangles in, %zu binned per frame\n",
+        DISPLAY_WIDTH, DISPLAY_HEIGHT, threads, simdName(), scene.runs.size(),
+        rasterizer.stats.triangles_in / frames, rasterizer.stats.triangles_binned / frames);
+    printf("raster: %.2f ms per frame (setup %.2f ms, raster %.2f ms), %.1f fps, %s\n",
+        elapsed / frames, rasterizer.stats.setup_ms / frames, rasterizer.stats.raster_ms / frames,
+        1000.0 * frames / elapsed, match ? "matches 1 thread" : "MISMATCH");
+
+    bool written = true;
+    if (output != nullptr) {
+        size_t length = strlen(output);
+        bool png = length > 4 && strcmp(output + length - 4, ".png") == 0;
+        written = png ? swWritePNG(output, rasterizer.color, rasterizer.width, rasterizer.height, rasterizer.stride)
+                      : swWritePPM(output, rasterizer.color, rasterizer.width, rasterizer.height, rasterizer.stride);
+        printf("raster: %s %s\n", written ? "wrote" : "FAILED to write", output);
+    }
+
+    destroySwRasterizer(reference);
+    destroySwRasterizer(rasterizer);
+    destroyHexWorld(scene.world);
+    return match && written ? 0 : 1;
+}
+
+// Random chunk-mesh sized allocations and frees against the upload allocator, every live range is
+// checked for overlap and alignment with a shadow map of the heaps
+static int runAlloc(int argc, char** argv) {
+    int operations = argc > 0 ? atoi(argv[0]) : 200000;
+    const size_t heapSize = 64 * 1024 * 1024;
+
+    UploadAllocator upload = {};
+    initUploadAllocator(upload, heapSize, 64 * 1024, FRAMES_IN_FLIGHT);
+    std::vector<std::vector<uint8_t>> shadow;
+    upload.user = &shadow;
+    upload.on_new_heap = [](void* user, uint32_t, size_t size) {
+        ((std::vector<std::vector<uint8_t>>*)user)->emplace_back(size / UPLOAD_MIN_BLOCK, (uint8_t)0);
+        return true;
+    };
+
+    std::vector<UploadAllocation> live;
+    uint32_t rng = 12345;
+    bool ok = true;
+    double start = timerMilliseconds();
+    for (int i = 0; i < operations && ok; i++) {
+        rng = hexHash(rng + (uint32_t)i);
+        if (live.empty() || (live.size() < 2000 && rng % 100 < 60)) {
+            // Mostly small buffers (instances, indices), sometimes a big chunk mesh
+            size_t size = rng % 8 == 0 ? 64 * 1024 + rng % (2 * 1024 * 1024) : 16 + rng % 16384;
+            size_t alignment = rng % 3 == 0 ? CBV_ALIGNMENT : 4;
+            UploadAllocation a = uploadAllocate(upload, size, alignment);
+            if (a.offset == UPLOAD_INVALID_OFFSET) continue;
+            ok = a.offset % alignment == 0 && a.offset + size <= heapSize;
+            std::vector<uint8_t>& map = shadow[a.heap];
+            for (size_t s = a.offset / UPLOAD_MIN_BLOCK; s <= (a.offset + size - 1) / UPLOAD_MIN_BLOCK && ok; s++) {
+                ok = map[s] == 0;
+                map[s] = 1;
+            }
+            live.push_back(a);
+        } else {
+            size_t index = rng % live.size();
+            UploadAllocation a = live[index];
+            std::vector<uint8_t>& map = shadow[a.heap];
+            for (size_t s = a.offset / UPLOAD_MIN_BLOCK; s <= (a.offset + a.size - 1) / UPLOAD_MIN_BLOCK; s++) map[s] = 0;
+            uploadFree(upload, a);
+            live[index] = live.back();
+            live.pop_back();
+        }
+    }
+    double elapsed = timerMilliseconds() - start;
+
+    UploadStats stats = uploadStats(upload);
+    printf("alloc: %d operations in %.2f ms (%.1f ns each), %zu heaps of %zu MB, %s\n",
+        operations, elapsed, elapsed * 1000000.0 / operations, stats.heaps, heapSize / (1024 * 1024),
+        ok ? "no overlaps" : "OVERLAP OR MISALIGNED");
+    printf("alloc: %zu live, used %.1f MB (requested %.1f MB), peak %.1f MB, fragmentation %.2f, %zu failures\n",
+        stats.allocations, stats.used / 1048576.0, stats.requested / 1048576.0, stats.peak_used / 1048576.0,
+        stats.fragmentation, stats.failures);
+
+    // Everything freed has to merge back into one block per heap
+    for (const UploadAllocation& a : live) uploadFree(upload, a);
+    for (uint32_t i = 0; i < upload.heap_count && ok; i++) ok = buddyLargestFree(upload.heaps[i]) == heapSize;
+    printf("alloc: all freed, heaps %s\n", ok ? "fully merged" : "NOT MERGED");
+
+    // Per-frame linear mode - CBV sized constants until the segment is full
+    size_t constants = 0;
+    uploadResetFrame(upload, 0);
+    while (uploadAllocateFrame(upload, 0, 192, CBV_ALIGNMENT) != UPLOAD_INVALID_OFFSET) constants++;
+    printf("alloc: %zu constant buffers fit a %zu KB frame segment\n", constants, upload.frame_segment / 1024);
+
+    destroyUploadAllocator(upload);
+    return ok ? 0 : 1;
+}
+
+// Encodes one chunk mesh for every chunk of the map in each vertex format, like a full rebuild would
+static int runVertex(int argc, char** argv) {
+    HexWorldDesc desc = {};
+    desc.columns = argc > 0 ? atoi(argv[0]) : 256;
+    desc.rows = argc > 1 ? atoi(argv[1]) : 256;
+    desc.height = 0.25f;
+
+    HexWorld world = {};
+    if (!createHexWorld(world, desc)) {
+        fprintf(stderr, "vertex: failed to create world\n");
+        return 1;
+    }
+
+    // Chunk-local mesh - packed formats only hold positions near the origin well
+    HexMeshDesc meshDesc = {};
+    meshDesc.columns = desc.chunk_size;
+    meshDesc.rows = desc.chunk_size;
+    meshDesc.height = desc.height;
+    HexMesh mesh = {};
+    if (!createHexMesh(mesh, meshDesc)) {
+        fprintf(stderr, "vertex: failed to create chunk mesh\n");
+        destroyHexWorld(world);
+        return 1;
+    }
+    VertexQuantizeBox box = vertexQuantizeBoxFromMesh(mesh);
+
+    const size_t n = mesh.vertex_count;
+    VertexFloat* full = (VertexFloat*) alignedAlloc(n * sizeof(VertexFloat));
+    VertexHalf* half = (VertexHalf*) alignedAlloc(n * sizeof(VertexHalf));
+    VertexHalf* halfReference = (VertexHalf*) alignedAlloc(n * sizeof(VertexHalf));
+    VertexQuantized* quantized = (VertexQuantized*) alignedAlloc(n * sizeof(VertexQuantized));
+    VertexQuantized* quantizedReference = (VertexQuantized*) alignedAlloc(n * sizeof(VertexQuantized));
+
+    double start = timerMilliseconds();
+    for (size_t c = 0; c < world.chunk_count; c++) encodeVerticesFloat(mesh, full);
+    double fullMs = timerMilliseconds() - start;
+    start = timerMilliseconds();
+    for (size_t c = 0; c < world.chunk_count; c++) encodeVerticesHalf(mesh, half);
+    double halfMs = timerMilliseconds() - start;
+    start = timerMilliseconds();
+    for (size_t c = 0; c < world.chunk_count; c++) encodeVerticesQuantized(mesh, box, quantized);
+    double quantizedMs = timerMilliseconds() - start;
+
+    encodeVerticesHalfScalar(mesh, halfReference);
+    encodeVerticesQuantizedScalar(mesh, box, quantizedReference);
+    bool match = memcmp(half, halfReference, n * sizeof(VertexHalf)) == 0 &&
+                 memcmp(quantized, quantizedReference, n * sizeof(VertexQuantized)) == 0;
+
+    float halfError = 0.0f, quantizedError = 0.0f;
+    for (size_t i = 0; i < n; i++) {
+        const float p[3] = { mesh.pos_x[i], mesh.pos_y[i], mesh.pos_z[i] };
+        const float h[3] = { halfToFloat(half[i].pos.x), halfToFloat(half[i].pos.y), halfToFloat(half[i].pos.z) };
+        float q[3];
+        decodeVertexQuantized(quantized[i], box, q);
+        for (int a = 0; a < 3; a++) {
+            halfError = fmaxf(halfError, fabsf(h[a] - p[a]));
+            quantizedError = fmaxf(quantizedError, fabsf(q[a] - p[a]));
+        }
+    }
+
+    // Vertex fetch per frame for the chunked path - every visible chunk's mesh once
+    float viewProjection[16];
+    benchCamera(viewProjection, desc.columns, desc.rows);
+    cullHexWorld(world, viewProjection);
+    const double visibleVertices = (double)world.visible_count * (double)n;
+    const double mb = 1024.0 * 1024.0;
+
+    printf("vertex: %zu chunks of %zu vertices, %zu visible [%s]\n", world.chunk_count, n, world.visible_count, simdName());
+    printf("vertex: float     %2zu B  %7.2f MB/frame  encode %8.3f ms\n",
+        sizeof(VertexFloat), visibleVertices * sizeof(VertexFloat) / mb, fullMs);
+    printf("vertex: half      %2zu B  %7.2f MB/frame  encode %8.3f ms  max error %.5f\n",
+        sizeof(VertexHalf), visibleVertices * sizeof(VertexHalf) / mb, halfMs, halfError);
+    printf("vertex: quantized %2zu B  %7.2f MB/frame  encode %8.3f ms  max error %.5f\n",
+        sizeof(VertexQuantized), visibleVertices * sizeof(VertexQuantized) / mb, quantizedMs, quantizedError);
+    printf("vertex: SIMD encoders %s\n", match ? "match scalar" : "MISMATCH");
+
+    alignedFree(quantizedReference);
+    alignedFree(quantized);
+    alignedFree(halfReference);
+    alignedFree(half);
+    alignedFree(full);
+    destroyHexMesh(mesh);
+    destroyHexWorld(world);
+    return match ? 0 : 1;
+}
+
+// Stand-in for D3DCompile - deterministic "bytecode" and a fixed cost, enough to exercise the cache
+static bool stubCompile(const char* source, const char* entryPoint, uint32_t flags, std::vector<uint8_t>& out) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    uint64_t hash = cacheHashValue(cacheHashString(cacheHashString(CACHE_HASH_SEED, source), entryPoint), flags);
+    out.resize(1024 + (size_t)(hash % 1024));
+    for (size_t i = 0; i < out.size(); i++) {
+        hash = hash * 6364136223846793005ull + 1442695040888963407ull;
+        out[i] = (uint8_t)(hash >> 56);
+    }
+    return true;
+}
+
+// One fake startup - two shaders and a pipeline blob built from their bytecode. Returns false if anything looked wrong.
+static bool stubStartup(ShaderCache& cache, uint32_t flags, std::vector<uint8_t>& pipelineOut) {
+    const char* source = "float4 VSMain() : SV_Position { return 0; } float4 PSMain() : SV_Target { return 1; }";
+    const std::vector<uint8_t>* vs = shaderCacheGetOrCompile(cache, shaderBytecodeKey(source, "VSMain", "vs_5_0", flags, 47), SHADER_CACHE_BYTECODE,
+        [&](std::vector<uint8_t>& out) { return stubCompile(source, "VSMain", flags, out); });
+    if (vs == nullptr) return false;
+    const std::vector<uint8_t> vsCopy = *vs;
+    const std::vector<uint8_t>* ps = shaderCacheGetOrCompile(cache, shaderBytecodeKey(source, "PSMain", "ps_5_0", flags, 47), SHADER_CACHE_BYTECODE,
+        [&](std::vector<uint8_t>& out) { return stubCompile(source, "PSMain", flags, out); });
+    if (ps == nullptr) return false;
+
+    uint64_t pipelineKey = cacheHashBytes(cacheHashBytes(CACHE_HASH_SEED, vsCopy.data(), vsCopy.size()), ps->data(), ps->size());
+    const std::vector<uint8_t>* pipeline = shaderCacheGetOrCompile(cache, pipelineKey, SHADER_CACHE_PIPELINE,
+        [&](std::vector<uint8_t>& out) { return stubCompile("pipeline", "", flags, out); });
+    if (pipeline == nullptr) return false;
+    pipelineOut = *pipeline;
+    return true;
+}
+
+static bool patchFile(const char* path, long offset, const void* data, size_t size) {
+    FILE* file = fopen(path, "r+b");
+    if (file == nullptr) return false;
+    bool ok = fseek(file, offset, SEEK_SET) == 0 && fwrite(data, size, 1, file) == 1;
+    fclose(file);
+    return ok;
+}
+
+static int runShaderCache(int argc, char** argv) {
+    const char* path = argc > 0 ? argv[0] : "shader_cache_test.bin";
+    remove(path);
+    bool ok = true;
+    std::vector<uint8_t> pipeline, pipelineWarm;
+
+    #define CHECK(cond, what) do { if (!(cond)) { printf("shadercache: FAILED %s\n", what); ok = false; } } while (0)
+
+    ShaderCache cold = {};
+    double start = timerMilliseconds();
+    CHECK(!loadShaderCache(cold, path), "missing file should not load");
+    CHECK(stubStartup(cold, 0, pipeline), "cold startup");
+    CHECK(saveShaderCache(cold), "save");
+    double coldMs = timerMilliseconds() - start;
+    CHECK(cold.stats.misses == 3 && cold.stats.hits == 0, "cold run should miss everything");
+
+    ShaderCache warm = {};
+    start = timerMilliseconds();
+    CHECK(loadShaderCache(warm, path), "load");
+    CHECK(stubStartup(warm, 0, pipelineWarm), "warm startup");
+    CHECK(saveShaderCache(warm), "save");
+    double warmMs = timerMilliseconds() - start;
+    CHECK(warm.stats.hits == 3 && warm.stats.misses == 0 && warm.stats.compile_ms == 0.0, "warm run should hit everything");
+    CHECK(pipeline == pipelineWarm, "cached pipeline differs");
+    std::vector<uint8_t> pipelineFresh;
+    stubCompile("pipeline", "", 0, pipelineFresh);
+    CHECK(pipelineWarm == pipelineFresh, "cached pipeline is not what the compiler made");
+
+    printf("shadercache: cold %.2f ms (compile %.2f, save %.2f), warm %.2f ms (load %.2f, save %.2f)\n",
+        coldMs, cold.stats.compile_ms, cold.stats.save_ms, warmMs, warm.stats.load_ms, warm.stats.save_ms);
+
+    // Different flags (debug build) - new keys, old entries stay
+    ShaderCache debug = {};
+    loadShaderCache(debug, path);
+    CHECK(stubStartup(debug, 1, pipeline) && debug.stats.misses == 3, "flags have to be part of the key");
+    CHECK(debug.entries.size() == 6, "both flag sets should be kept");
+
+    // Driver refused the pipeline blob - rejected, rebuilt next time
+    uint64_t pipelineKey = 0;
+    for (const auto& it : debug.entries) if (it.second.kind == SHADER_CACHE_PIPELINE) pipelineKey = it.first;
+    shaderCacheReject(debug, pipelineKey);
+    CHECK(saveShaderCache(debug), "save");
+    ShaderCache afterReject = {};
+    loadShaderCache(afterReject, path);
+    CHECK(afterReject.entries.size() == 5, "rejected entry should be gone from disk");
+
+    // Flipped byte in the first entry's data - only that entry goes
+    uint8_t garbage = 0xa5;
+    CHECK(patchFile(path, (long)(sizeof(ShaderCacheFileHeader) + sizeof(ShaderCacheFileEntry) + 10), &garbage, 1), "patch");
+    ShaderCache corrupt = {};
+    loadShaderCache(corrupt, path);
+    CHECK(corrupt.stats.rejected == 1 && corrupt.entries.size() == 4, "corrupt entry should be rejected alone");
+
+    // Newer file format - nothing trusted
+    uint32_t version = SHADER_CACHE_VERSION + 1;
+    CHECK(patchFile(path, (long)offsetof(ShaderCacheFileHeader, version), &version, sizeof(version)), "patch");
+    ShaderCache foreign = {};
+    CHECK(!loadShaderCache(foreign, path) && foreign.entries.empty(), "other version should not load");
+
+    // Unused entries age out after SHADER_CACHE_MAX_AGE saves
+    ShaderCache aging = {};
+    stubStartup(aging, 0, pipeline);
+    aging.path = path;
+    saveShaderCache(aging);
+    for (uint32_t run = 0; run <= SHADER_CACHE_MAX_AGE; run++) {
+        ShaderCache next = {};
+        loadShaderCache(next, path);
+        saveShaderCache(next);
+        aging.stats.evicted += next.stats.evicted;
+        CHECK(next.entries.size() == (run < SHADER_CACHE_MAX_AGE ? 3u : 0u), "aging");
+    }
+    CHECK(aging.stats.evicted == 3, "unused entries should be evicted");
+
+    #undef CHECK
+    remove(path);
+    printf("shadercache: keys, invalidation, corruption and aging %s\n", ok ? "ok" : "FAILED");
+    return ok ? 0 : 1;
+}
+
+static int runPick(int argc, char** argv) {
+    const size_t queries = argc > 0 ? (size_t)atol(argv[0]) : 100000;
+    HexWorldDesc desc = {};
+    desc.height = 1.0f;
+    HexWorld world = {};
+    if (!createHexWorld(world, desc)) {
+        fprintf(stderr, "pick: failed to create world\n");
+        return 1;
+    }
+    const HexPickPlane plane = hexPickPlane(world);
+    bool ok = true;
+
+    // Rays dropped straight onto random points inside random tiles have to come back with that tile
+    size_t wrong = 0;
+    uint32_t seed = 1;
+    for (size_t i = 0; i < queries; i++) {
+        int col = (int)(hexHash(seed++) % (uint32_t)desc.columns);
+        int row = (int)(hexHash(seed++) % (uint32_t)desc.rows);
+        float cx, cz;
+        hexOffsetToWorld(col, row, desc.radius, cx, cz);
+        // Inside the inscribed circle, a bit short of the edge so float error cannot flip it
+        float angle = (float)(hexHash(seed++) % 6283) / 1000.0f;
+        float distance = (float)(hexHash(seed++) % 1000) / 1000.0f * desc.radius * HEX_SQRT3 * 0.5f * 0.98f;
+        float px = cx + cosf(angle) * distance, pz = cz + sinf(angle) * distance;
+        float dx = ((float)(hexHash(seed++) % 2001) - 1000.0f) / 1000.0f, dz = ((float)(hexHash(seed++) % 2001) - 1000.0f) / 1000.0f;
+        HexRay ray = { { px - dx * 10.0f, plane.y + 10.0f, pz - dz * 10.0f }, { dx, -1.0f, dz } };
+        HexPick pick;
+        if (!hexPickRay(plane, ray, pick) || pick.column != col || pick.row != row) wrong++;
+    }
+    printf("pick: %zu rays into random points of random tiles, %zu wrong\n", queries, wrong);
+    ok = ok && wrong == 0;
+
+    // Single query latency - cursor ray plus plane hit, like onUpdate does every frame
+    float viewProjection[16], inverse[16];
+    benchCamera(viewProjection, desc.columns, desc.rows);
+    matrixInverse(inverse, viewProjection);
+    size_t hits = 0;
+    double start = timerMilliseconds();
+    for (size_t i = 0; i < queries; i++) {
+        HexRay ray;
+        HexPick pick;
+        float px = (float)(hexHash((uint32_t)i) % DISPLAY_WIDTH), py = (float)(hexHash((uint32_t)i + 7) % DISPLAY_HEIGHT);
+        if (hexRayFromScreen(inverse, px, py, DISPLAY_WIDTH, DISPLAY_HEIGHT, ray) && hexPickRay(plane, ray, pick)) hits++;
+    }
+    double singleMs = timerMilliseconds() - start;
+    printf("pick: single query %.1f ns (%zu of %zu hit)\n", singleMs * 1e6 / (double)queries, hits, queries);
+
+    // Batch throughput - one ray per pixel of the whole screen
+    HexRayBatch batch = {};
+    const size_t pixels = (size_t)DISPLAY_WIDTH * DISPLAY_HEIGHT;
+    allocateHexRayBatch(batch, pixels);
+    hexRaysFromScreenRect(inverse, 0, 0, DISPLAY_WIDTH, DISPLAY_HEIGHT, 1, DISPLAY_WIDTH, DISPLAY_HEIGHT, batch);
+    int32_t* q = (int32_t*)alignedAlloc(pixels * sizeof(int32_t));
+    int32_t* r = (int32_t*)alignedAlloc(pixels * sizeof(int32_t));
+    int32_t* referenceQ = (int32_t*)alignedAlloc(pixels * sizeof(int32_t));
+    int32_t* referenceR = (int32_t*)alignedAlloc(pixels * sizeof(int32_t));
+    start = timerMilliseconds();
+    size_t batchHits = hexPickRays(plane, batch, q, r);
+    double batchMs = timerMilliseconds() - start;
+    start = timerMilliseconds();
+    size_t referenceHits = hexPickRaysScalar(plane, batch, referenceQ, referenceR);
+    double scalarMs = timerMilliseconds() - start;
+    bool match = batchHits == referenceHits &&
+                 memcmp(q, referenceQ, pixels * sizeof(int32_t)) == 0 && memcmp(r, referenceR, pixels * sizeof(int32_t)) == 0;
+    printf("pick: batch of %zu rays in %.3f ms (%.1f Mrays/s), scalar %.3f ms [%s], %s\n",
+        batch.count, batchMs, (double)batch.count / batchMs / 1000.0, scalarMs, simdName(), match ? "matches scalar" : "MISMATCH");
+    ok = ok && match;
+
+    // Box selection - middle quarter of the screen, one ray per 4x4 pixels
+    std::vector<uint64_t> scratch;
+    start = timerMilliseconds();
+    hexRaysFromScreenRect(inverse, DISPLAY_WIDTH / 4, DISPLAY_HEIGHT / 4, DISPLAY_WIDTH * 3 / 4, DISPLAY_HEIGHT * 3 / 4, 4,
+                          DISPLAY_WIDTH, DISPLAY_HEIGHT, batch);
+    hexPickRays(plane, batch, q, r);
+    size_t selected = hexUniquePicks(q, r, batch.count, scratch);
+    double selectMs = timerMilliseconds() - start;
+    printf("pick: box selection %zu rays -> %zu tiles in %.3f ms\n", batch.count, selected, selectMs);
+
+    alignedFree(referenceR);
+    alignedFree(referenceQ);
+    alignedFree(r);
+    alignedFree(q);
+    destroyHexRayBatch(batch);
+    destroyHexWorld(world);
+    return ok ? 0 : 1;
+}
+
+// Same frame work as the other commands, fanned out over a job system with 1, 2, 4 ... maxThreads workers.
+// Every run is checked against the serial result, so a scheduling bug shows up as a mismatch, not a number.
+static int runJobs(int argc, char** argv) {
+    int maxThreads = argc > 0 ? atoi(argv[0]) : JOB_MAX_WORKERS;
+    maxThreads = maxThreads < 1 ? 1 : (maxThreads > JOB_MAX_WORKERS ? JOB_MAX_WORKERS : maxThreads);
+    // Every short lived worker would take a profiler track otherwise
+    profiler.enabled.store(false);
+    const int cullIterations = 100;
+    const int tinyRounds = 200;
+
+    // Mesh building - one big extruded plane, generated in tile ranges
+    HexMeshDesc meshDesc = {};
+    meshDesc.columns = 512;
+    meshDesc.rows = 512;
+    meshDesc.height = 1.0f;
+    HexMesh mesh = {}, referenceMesh = {};
+    // Culling - a map big enough that the chunk list is worth slicing
+    HexWorldDesc cullDesc = {};
+    cullDesc.columns = 16384;
+    cullDesc.rows = 16384;
+    cullDesc.height = 1.0f;
+    HexWorld cullWorld = {};
+    // Instance packing - one job per chunk
+    HexWorldDesc packDesc = {};
+    packDesc.columns = 2048;
+    packDesc.rows = 2048;
+    packDesc.height = 1.0f;
+    HexWorld packWorld = {};
+    if (!createHexMesh(referenceMesh, meshDesc) || !allocateHexMesh(mesh, meshDesc) ||
+        !createHexWorld(cullWorld, cullDesc) || !createHexWorld(packWorld, packDesc)) {
+        fprintf(stderr, "jobs: failed to allocate workloads\n");
+        return 1;
+    }
+
+    float viewProjection[16];
+    benchCamera(viewProjection, cullDesc.columns, cullDesc.rows);
+    cullHexWorld(cullWorld, viewProjection);
+    std::vector<uint32_t> referenceVisible(cullWorld.visible, cullWorld.visible + cullWorld.visible_count);
+
+    HexInstanceRange* ranges = (HexInstanceRange*) malloc(packWorld.chunk_count * sizeof(HexInstanceRange));
+    const size_t instanceCount = buildHexInstanceRanges(packWorld, ranges);
+    HexInstance* packed = (HexInstance*) alignedAlloc(instanceCount * sizeof(HexInstance));
+    HexInstance* referencePacked = (HexInstance*) alignedAlloc(instanceCount * sizeof(HexInstance));
+    for (size_t i = 0; i < packWorld.chunk_count; i++) packHexChunkInstances(packWorld, i, referencePacked + ranges[i].first);
+
+    printf("jobs: %d hardware threads, mesh %dx%d, cull %zu chunks, pack %zu chunks [%s]\n",
+        hardwareThreads(), meshDesc.columns, meshDesc.rows, cullWorld.chunk_count, packWorld.chunk_count, simdName());
+    printf("jobs: threads   mesh ms  speedup   pack ms  speedup   cull ms  speedup  tiny Mjobs/s  stolen  result\n");
+
+    bool ok = true;
+    double baseMesh = 0.0, basePack = 0.0, baseCull = 0.0;
+    for (int threads = 1; threads <= maxThreads; threads = threads < maxThreads && threads * 2 > maxThreads ? maxThreads : threads * 2) {
+        JobSystem jobs;
+        if (!createJobSystem(jobs, threads)) {
+            fprintf(stderr, "jobs: failed to start %d workers\n", threads);
+            return 1;
+        }
+
+        // Warm pass first, the allocations are fresh and the first touch is all page faults
+        const size_t tilesPerJob = 1024;
+        for (int pass = 0; pass < 2; pass++) {
+            jobParallelFor(jobs, mesh.tile_count, tilesPerJob, [&](size_t begin, size_t end) {
+                generateHexMeshTiles(mesh, meshDesc, begin, end - begin);
+            });
+        }
+        double start = timerMilliseconds();
+        jobParallelFor(jobs, mesh.tile_count, tilesPerJob, [&](size_t begin, size_t end) {
+            generateHexMeshTiles(mesh, meshDesc, begin, end - begin);
+        });
+        double meshMs = timerMilliseconds() - start;
+        bool match = memcmp(mesh.pos_x, referenceMesh.pos_x, mesh.vertex_count * sizeof(float)) == 0 &&
+                     memcmp(mesh.pos_y, referenceMesh.pos_y, mesh.vertex_count * sizeof(float)) == 0 &&
+                     memcmp(mesh.pos_z, referenceMesh.pos_z, mesh.vertex_count * sizeof(float)) == 0 &&
+                     memcmp(mesh.color, referenceMesh.color, mesh.vertex_count * sizeof(uint32_t)) == 0 &&
+                     memcmp(mesh.indices, referenceMesh.indices, mesh.index_count * sizeof(uint32_t)) == 0;
+
+        auto pack = [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++) packHexChunkInstances(packWorld, i, packed + ranges[i].first);
+        };
+        jobParallelFor(jobs, packWorld.chunk_count, 1, pack);
+        start = timerMilliseconds();
+        jobParallelFor(jobs, packWorld.chunk_count, 1, pack);
+        double packMs = timerMilliseconds() - start;
+        match = match && memcmp(packed, referencePacked, instanceCount * sizeof(HexInstance)) == 0;
+
+        start = timerMilliseconds();
+        for (int i = 0; i < cullIterations; i++) cullHexWorld(cullWorld, viewProjection, jobs);
+        double cullMs = (timerMilliseconds() - start) / cullIterations;
+        match = match && cullWorld.visible_count == referenceVisible.size() &&
+                memcmp(cullWorld.visible, referenceVisible.data(), referenceVisible.size() * sizeof(uint32_t)) == 0;
+
+        // Scheduler overhead - empty leaves, one nested parallel for inside each outer range
+        resetJobSystemStats(jobs);
+        std::atomic<uint64_t> sum(0);
+        start = timerMilliseconds();
+        for (int round = 0; round < tinyRounds; round++) {
+            jobParallelFor(jobs, 64, 1, [&](size_t begin, size_t end) {
+                for (size_t outer = begin; outer < end; outer++) {
+                    jobParallelFor(jobs, 16, 1, [&](size_t b, size_t e) { sum.fetch_add(e - b, std::memory_order_relaxed); });
+                }
+            });
+        }
+        double tinyMs = timerMilliseconds() - start;
+        JobWorkerStats stats = jobSystemStats(jobs);
+        match = match && sum.load() == (uint64_t)tinyRounds * 64 * 16;
+        destroyJobSystem(jobs);
+
+        if (threads == 1) {
+            baseMesh = meshMs;
+            basePack = packMs;
+            baseCull = cullMs;
+        }
+        printf("jobs: %7d %9.3f %7.2fx %9.3f %7.2fx %9.4f %7.2fx %13.2f %7llu  %s\n",
+            threads, meshMs, baseMesh / meshMs, packMs, basePack / packMs, cullMs, baseCull / cullMs,
+            (double)stats.executed / tinyMs / 1000.0, (unsigned long long)stats.stolen, match ? "matches serial" : "MISMATCH");
+        ok = ok && match;
+        if (threads == maxThreads) break;
+    }
+
+    alignedFree(referencePacked);
+    alignedFree(packed);
+    free(ranges);
+    destroyHexWorld(packWorld);
+    destroyHexWorld(cullWorld);
+    destroyHexMesh(referenceMesh);
+    destroyHexMesh(mesh);
+    return ok ? 0 : 1;
+}
+
+// Frame loop shaped like the window's - paced against a simulated GPU, culling and instance packing on jobs -
+// with the profiler on. Writes a Chrome trace and prints rolling frame stats plus the cost of one scope.
+static int runProfile(int argc, char** argv) {
+    const int frames = argc > 0 ? atoi(argv[0]) : 300;
+    const char* tracePath = argc > 1 ? argv[1] : PROFILE_TRACE_PATH;
+    const double gpuMs = 2.0;
+    profilerSetThreadName("frame thread");
+
+    HexWorldDesc desc = {};
+    desc.columns = 8192;
+    desc.rows = 8192;
+    desc.height = 1.0f;
+    HexWorld world = {};
+    JobSystem jobs;
+    if (!createHexWorld(world, desc) || !createJobSystem(jobs, hardwareThreads() < 4 ? 4 : hardwareThreads())) {
+        fprintf(stderr, "profile: failed to create world\n");
+        return 1;
+    }
+    HexInstanceRange* ranges = (HexInstanceRange*) malloc(world.chunk_count * sizeof(HexInstanceRange));
+    HexInstanceRange* runs = (HexInstanceRange*) malloc(world.chunk_count * sizeof(HexInstanceRange));
+    const size_t instanceCount = buildHexInstanceRanges(world, ranges);
+    HexInstance* instances = (HexInstance*) alignedAlloc(instanceCount * sizeof(HexInstance));
+
+    NullFrameBackend backend(gpuMs);
+    FramePacer pacer = {};
+    initFramePacer(pacer, &backend);
+    float viewProjection[16];
+    benchCamera(viewProjection, desc.columns, desc.rows);
+
+    size_t draws = 0;
+    for (int frame = 0; frame < frames; frame++) {
+        beginFrame(pacer);
+        {
+            PROFILE_SCOPE("update");
+            // Camera drifts along the map so the visible set keeps changing
+            float moved[16];
+            memcpy(moved, viewProjection, sizeof(moved));
+            moved[12] -= (float)(frame % 200) * 0.05f * viewProjection[0];
+            {
+                PROFILE_SCOPE("cull");
+                cullHexWorld(world, moved, jobs);
+            }
+            draws = mergeVisibleInstanceRanges(world.visible, world.visible_count, ranges, runs);
+        }
+        {
+            PROFILE_SCOPE("render");
+            // Stand-in for recording - visible chunks repacked on the jobs, like a streaming upload would
+            jobParallelFor(jobs, world.visible_count, 1, [&](size_t begin, size_t end) {
+                PROFILE_SCOPE("pack chunks");
+                for (size_t i = begin; i < end; i++) {
+                    size_t chunk = world.visible[i];
+                    packHexChunkInstances(world, chunk, instances + ranges[chunk].first);
+                }
+            });
+        }
+        {
+            PROFILE_SCOPE("present");
+            endFrame(pacer);
+        }
+        profilerEndFrame();
+    }
+    flushFrames(pacer);
+
+    ProfileFrameStats stats = rollingStatsSummary(profiler.cpu_frames);
+    long events = profilerWriteChromeTrace(tracePath);
+
+    // Bare scope cost - what every PROFILE_SCOPE adds, mostly the two clock reads
+    const int scopes = 1000000;
+    double start = timerMilliseconds();
+    for (int i = 0; i < scopes; i++) {
+        PROFILE_SCOPE("empty");
+    }
+    double scopeNs = (timerMilliseconds() - start) * 1e6 / scopes;
+    uint64_t clockFirst = timerNanoseconds(), clockLast = clockFirst;
+    for (int i = 0; i < scopes; i++) clockLast = timerNanoseconds();
+    double clockNs = (double)(clockLast - clockFirst) / scopes;
+
+    printf("profile: %d frames against a %.1f ms GPU, %zu draws, %d workers [%s]\n", frames, gpuMs, draws, jobs.worker_count, simdName());
+    printf("profile: frame p50 %.3f ms, p99 %.3f ms, max %.3f ms over the last %u frames, fence wait %.3f ms per frame\n",
+        stats.p50_ms, stats.p99_ms, stats.max_ms, stats.frames, pacer.wait_ms / frames);
+    printf("profile: %.1f ns per scope (clock read %.1f ns), %ld events in %s\n", scopeNs, clockNs, events, tracePath);
+
+    destroyJobSystem(jobs);
+    alignedFree(instances);
+    free(runs);
+    free(ranges);
+    destroyHexWorld(world);
+    return events >= 0 ? 0 : 1;
+}
+
+// Terrain generation - noise throughput per core, SIMD against scalar, and the same map for every thread count
+static int runTerrain(int argc, char** argv) {
+    HexWorldDesc desc = {};
+    desc.columns = argc > 0 ? atoi(argv[0]) : 2048;
+    desc.rows = argc > 1 ? atoi(argv[1]) : 2048;
+    desc.height = 1.0f;
+    desc.seed = argc > 2 ? (uint32_t)strtoul(argv[2], nullptr, 10) : 1234u;
+    HexWorld world = {};
+    if (!createHexWorld(world, desc)) {
+        fprintf(stderr, "terrain: failed to create world\n");
+        return 1;
+    }
+    const HexTerrainDesc terrainDesc = hexTerrainDesc(desc.seed);
+    const size_t tiles = (size_t)desc.columns * (size_t)desc.rows;
+    bool ok = true;
+
+    // Raw noise - one fBm field over a strip of tile centers, wide coordinates included
+    const size_t samples = 1 << 20;
+    float* xs = (float*)alignedAlloc((samples + 8) * sizeof(float));
+    float* zs = (float*)alignedAlloc((samples + 8) * sizeof(float));
+    float* noise = (float*)alignedAlloc((samples + 8) * sizeof(float));
+    float* reference = (float*)alignedAlloc((samples + 8) * sizeof(float));
+    for (size_t i = 0; i < samples + 8; i++) {
+        xs[i] = ((float)(hexHash((uint32_t)i) % 2000000) - 1000000.0f) * 0.01f;
+        zs[i] = ((float)(hexHash((uint32_t)i + 77) % 2000000) - 1000000.0f) * 0.01f;
+    }
+    double start = timerMilliseconds();
+    hexNoiseFbm(terrainDesc.elevation, xs, zs, noise, samples);
+    double noiseMs = timerMilliseconds() - start;
+    start = timerMilliseconds();
+    hexNoiseFbmScalar(terrainDesc.elevation, xs, zs, reference, samples);
+    double scalarMs = timerMilliseconds() - start;
+    float lo = noise[0], hi = noise[0];
+    for (size_t i = 0; i < samples; i++) {
+        lo = noise[i] < lo ? noise[i] : lo;
+        hi = noise[i] > hi ? noise[i] : hi;
+    }
+    bool match = memcmp(noise, reference, samples * sizeof(float)) == 0;
+    printf("terrain: %d octave fBm %.1f M samples/s, scalar %.1f M samples/s [%s], range [%.3f, %.3f], %s\n",
+        terrainDesc.elevation.octaves, samples / noiseMs / 1000.0, samples / scalarMs / 1000.0, simdName(), lo, hi,
+        match ? "matches scalar" : "MISMATCH");
+    ok = ok && match;
+
+    // Whole map on growing worker counts - every run has to produce the exact same bytes
+    HexTerrain first = {}, terrain = {};
+    if (!allocateHexTerrain(first, world, terrainDesc) || !allocateHexTerrain(terrain, world, terrainDesc)) {
+        fprintf(stderr, "terrain: failed to allocate %zu tiles\n", tiles);
+        return 1;
+    }
+    const int maxThreads = hardwareThreads() > 4 ? hardwareThreads() : 4;
+    double perCore = 0.0;
+    for (int threads = 1; threads <= maxThreads; threads *= 2) {
+        JobSystem jobs;
+        createJobSystem(jobs, threads);
+        HexTerrain& out = threads == 1 ? first : terrain;
+        generateHexTerrain(out, world, jobs);  // Warm, first touch of the arrays
+        start = timerMilliseconds();
+        generateHexTerrain(out, world, jobs);
+        double ms = timerMilliseconds() - start;
+        destroyJobSystem(jobs);
+        bool same = threads == 1 ||
+            (memcmp(first.height, terrain.height, tiles * sizeof(float)) == 0 &&
+             memcmp(first.biome, terrain.biome, tiles) == 0 &&
+             memcmp(first.color, terrain.color, tiles * sizeof(uint32_t)) == 0);
+        if (threads == 1) perCore = tiles / ms / 1000.0;
+        printf("terrain: %zu tiles on %2d workers in %8.3f ms, %6.2f M tiles/s, %s\n",
+            tiles, threads, ms, tiles / ms / 1000.0, threads == 1 ? "reference" : (same ? "identical" : "DIFFERENT"));
+        ok = ok && same;
+    }
+    printf("terrain: %.2f M tiles/s per core, a %dx%d map regenerates in %.1f ms on one\n",
+        perCore, desc.columns, desc.rows, tiles / perCore / 1000.0);
+
+    // Biome mix, a map that is all water means the thresholds are off
+    size_t histogram[HEX_BIOME_COUNT] = {};
+    for (size_t i = 0; i < tiles; i++) histogram[first.biome[i]]++;
+    static const char* biomeNames[HEX_BIOME_COUNT] = { "forest", "grass", "sand", "dirt", "rock", "snow", "shallow", "deep" };
+    printf("terrain: biomes");
+    for (int b = 0; b < HEX_BIOME_COUNT; b++) printf(" %s %.1f%%", biomeNames[b], 100.0 * (double)histogram[b] / (double)tiles);
+    printf("\n");
+
+    // Instance packing off the terrain
+    HexInstanceRange* ranges = (HexInstanceRange*) malloc(world.chunk_count * sizeof(HexInstanceRange));
+    size_t total = buildHexInstanceRanges(world, ranges);
+    HexInstance* packed = (HexInstance*) alignedAlloc(total * sizeof(HexInstance));
+    HexInstance* packedReference = (HexInstance*) alignedAlloc(total * sizeof(HexInstance));
+    for (size_t i = 0; i < world.chunk_count; i++) {
+        packHexChunkTerrainInstances(world, first, i, packed + ranges[i].first);
+        packHexChunkTerrainInstancesScalar(world, first, i, packedReference + ranges[i].first);
+    }
+    match = memcmp(packed, packedReference, total * sizeof(HexInstance)) == 0;
+    printf("terrain: %zu instances packed from terrain, %s\n", total, match ? "matches scalar" : "MISMATCH");
+    ok = ok && match;
+
+    alignedFree(packedReference);
+    alignedFree(packed);
+    free(ranges);
+    destroyHexTerrain(terrain);
+    destroyHexTerrain(first);
+    alignedFree(reference);
+    alignedFree(noise);
+    alignedFree(zs);
+    alignedFree(xs);
+    destroyHexWorld(world);
+    return ok ? 0 : 1;
+}
+
+// Drops a file from the page cache, so the next read comes from the disk. False where that is not possible.
+static bool dropFileCache(const char* path) {
+#if defined(_WIN32)
+    (void)path;
+    return false;
+#else
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return false;
+    bool ok = fdatasync(fd) == 0 && posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED) == 0;
+    close(fd);
+    return ok;
+#endif
+}
+
+// Map file round trip on a small map with meshes, then a multi-GB synthetic map streamed under a moving camera
+static int runMap(int argc, char** argv) {
+    const double gigabytes = argc > 0 ? atof(argv[0]) : 2.5;
+    const char* path = argc > 1 ? argv[1] : "hexmap_stream_test.bin";
+    const int frames = argc > 2 ? atoi(argv[2]) : 600;
+    const double frameMs = 4.0;
+    bool ok = true;
+
+    // Round trip - terrain tiles and baked chunk meshes come back exactly as written, prisms and shared flat tiles
+    for (float height : { 1.0f, 0.0f }) {
+        HexWorldDesc desc = {};
+        desc.columns = 100;
+        desc.rows = 70;
+        desc.height = height;
+        desc.seed = 99;
+        HexWorld world = {};
+        HexTerrain terrain = {};
+        JobSystem jobs;
+        createJobSystem(jobs, 1);
+        if (!createHexWorld(world, desc) || !allocateHexTerrain(terrain, world, hexTerrainDesc(desc.seed))) {
+            fprintf(stderr, "map: failed to create world\n");
+            return 1;
+        }
+        generateHexTerrain(terrain, world, jobs);
+        bool written = writeHexMap(path, world, HEX_MAP_MESHES, [&](size_t chunk, HexInstance* out) {
+            packHexChunkTerrainInstances(world, terrain, chunk, out);
+        });
+        HexMap map = {};
+        bool opened = written && openHexMap(map, path);
+        bool same = opened && map.header->chunk_count == world.chunk_count && (map.header->flags & HEX_MAP_MESHES) != 0;
+        size_t meshVertices = 0, meshIndices = 0;
+        std::vector<HexInstance> expected(HEX_CHUNK_SIZE * HEX_CHUNK_SIZE);
+        for (size_t chunk = 0; same && chunk < world.chunk_count; chunk++) {
+            const HexMapChunkEntry& entry = map.chunks[chunk];
+            packHexChunkTerrainInstances(world, terrain, chunk, expected.data());
+            same = memcmp(hexMapChunkTiles(map, chunk), expected.data(), entry.tile_count * sizeof(HexInstance)) == 0;
+            // Vertices are reordered, so tile centers are found by position - every tile has exactly one at its
+            // height. Indices stay inside the chunk, in whatever width the chunk picked.
+            const VertexHalf* vertices = hexMapChunkVertices(map, chunk);
+            const HexChunk& c = world.chunks[chunk];
+            uint32_t centersFound = 0;
+            for (uint32_t v = 0; same && v < entry.vertex_count; v++) {
+                // Nearest tile center, corners are a whole radius away from any
+                const float x = halfToFloat(vertices[v].pos.x) + entry.origin_x;
+                const float z = halfToFloat(vertices[v].pos.z) + entry.origin_z;
+                const int row = (int)lroundf(z / (desc.radius * 1.5f));
+                const int col = (int)lroundf(x / (desc.radius * HEX_SQRT3) - 0.5f * (float)(row & 1));
+                const uint32_t t = (uint32_t)((row - c.first_row) * c.columns + (col - c.first_column));
+                float cx, cz;
+                hexOffsetToWorld(col, row, desc.radius, cx, cz);
+                if (fabsf(x - cx) > 1.0f / 32.0f || fabsf(z - cz) > 1.0f / 32.0f) continue;
+                same = t < entry.tile_count && fabsf(halfToFloat(vertices[v].pos.y) - expected[t].height) <= 1.0f / 1024.0f;
+                centersFound++;
+            }
+            same = same && centersFound == entry.tile_count;
+            const bool wide = hexMapChunkIndexFormat(map, chunk) == INDEX_FORMAT_32;
+            same = same && wide == (chooseIndexFormat(entry.vertex_count) == INDEX_FORMAT_32);
+            const uint16_t* indices16 = static_cast<const uint16_t*>(hexMapChunkIndices(map, chunk));
+            const uint32_t* indices32 = static_cast<const uint32_t*>(hexMapChunkIndices(map, chunk));
+            for (uint32_t i = 0; same && i < entry.index_count; i++) same = (wide ? indices32[i] : indices16[i]) < entry.vertex_count;
+            meshVertices += entry.vertex_count;
+            meshIndices += entry.index_count;
+        }
+        closeHexMap(map);
+
+        // Anything this build did not write has to be refused - version bumped in place
+        bool refused = false;
+        if (FILE* file = fopen(path, "r+b")) {
+            const uint32_t futureVersion = HEX_MAP_VERSION + 1;
+            fseek(file, offsetof(HexMapHeader, version), SEEK_SET);
+            fwrite(&futureVersion, sizeof(futureVersion), 1, file);
+            fclose(file);
+            refused = !openHexMap(map, path);
+            closeHexMap(map);
+        }
+        remove(path);
+        printf("map: %dx%d %s round trip with %zu mesh vertices and %zu indices - %s, newer version %s\n",
+            desc.columns, desc.rows, height > 0.0f ? "prism" : "flat", meshVertices, meshIndices, same ? "identical" : "MISMATCH", refused ? "refused" : "ACCEPTED");
+        ok = ok && same && refused;
+        destroyHexTerrain(terrain);
+        destroyHexWorld(world);
+        destroyJobSystem(jobs);
+    }
+
+    // Synthetic map - tiles only, whole chunks of 1024 tiles are exactly four pages each
+    HexWorldDesc desc = {};
+    const double tiles = gigabytes * 1024.0 * 1024.0 * 1024.0 / sizeof(HexInstance);
+    desc.columns = ((int)sqrt(tiles) + HEX_CHUNK_SIZE - 1) / HEX_CHUNK_SIZE * HEX_CHUNK_SIZE;
+    desc.rows = desc.columns;
+    desc.height = 1.0f;
+    desc.seed = 7;
+    HexWorld world = {};
+    if (!createHexWorld(world, desc)) {
+        fprintf(stderr, "map: failed to create world\n");
+        return 1;
+    }
+    double start = timerMilliseconds();
+    if (!writeHexMap(path, world, 0, [&](size_t chunk, HexInstance* out) { packHexChunkInstances(world, chunk, out); })) {
+        fprintf(stderr, "map: failed to write %s\n", path);
+        return 1;
+    }
+    double writeMs = timerMilliseconds() - start;
+    bool cold = dropFileCache(path);
+
+    const uint64_t baseRss = processResidentBytes();
+    HexMap map = {};
+    start = timerMilliseconds();
+    if (!openHexMap(map, path)) {
+        fprintf(stderr, "map: failed to open %s\n", path);
+        remove(path);
+        return 1;
+    }
+    double openMs = timerMilliseconds() - start;
+    const double fileMb = (double)map.file.size / (1024.0 * 1024.0);
+    printf("map: %dx%d tiles, %zu chunks, %.1f MB written in %.0f ms (%.0f MB/s), opened in %.3f ms, page cache %s\n",
+        desc.columns, desc.rows, world.chunk_count, fileMb, writeMs, fileMb * 1000.0 / writeMs, openMs, cold ? "dropped" : "warm");
+
+    // Camera flies diagonally over the map, every frame copies what is resident around it into "upload" memory
+    const float cameraSpeed = 1.0f;  // World units per frame, a chunk is about 14 wide
+    HexMapStreamDesc streamDesc = {};
+    streamDesc.load_radius = 48.0f;
+    streamDesc.evict_radius = 64.0f;
+    HexMapStreamer streamer;
+    if (!startHexMapStreamer(streamer, map, world, streamDesc)) {
+        fprintf(stderr, "map: failed to start streamer\n");
+        return 1;
+    }
+    const float worldX = HEX_DEFAULT_RADIUS * HEX_SQRT3 * (float)desc.columns;
+    const float worldZ = HEX_DEFAULT_RADIUS * 1.5f * (float)desc.rows;
+    std::vector<HexInstance> upload(HEX_CHUNK_SIZE * HEX_CHUNK_SIZE * 64);
+    std::vector<HexInstance> expected(HEX_CHUNK_SIZE * HEX_CHUNK_SIZE);
+    std::vector<uint8_t> checked(world.chunk_count, 0);
+    size_t wantedTotal = 0, missing = 0, copied = 0, copiedBytes = 0;
+    uint64_t peakRss = 0;
+    double copyMs = 0.0;
+    bool copiesMatch = true;
+    for (int frame = 0; frame < frames; frame++) {
+        double frameStart = timerMilliseconds();
+        const float fx = worldX * 0.1f + cameraSpeed * (float)frame, fz = worldZ * 0.1f + cameraSpeed * (float)frame;
+        hexMapStreamFocus(streamer, fx, fz);
+
+        size_t used = 0;
+        double copyStart = timerMilliseconds();
+        for (size_t chunk = 0; chunk < world.chunk_count; chunk++) {
+            // Same test the streamer uses, on the chunk rows near the camera only
+            const HexChunk& c = world.chunks[chunk];
+            const float cz = HEX_DEFAULT_RADIUS * 1.5f * (float)c.first_row;
+            if (cz < fz - 96.0f) { chunk += world.chunks_x - 1; continue; }
+            if (cz > fz + 96.0f) break;
+            if (hexChunkDistanceSq(world, chunk, fx, fz) > streamDesc.load_radius * streamDesc.load_radius) continue;
+            wantedTotal++;
+            if (!hexMapChunkResident(streamer, chunk)) {
+                missing++;
+                continue;
+            }
+            if (used + map.chunks[chunk].tile_count > upload.size()) used = 0;
+            size_t n = copyHexMapChunkTiles(map, chunk, upload.data() + used);
+            if (!checked[chunk]) {
+                checked[chunk] = 1;
+                packHexChunkInstances(world, chunk, expected.data());
+                copiesMatch = copiesMatch && memcmp(upload.data() + used, expected.data(), n * sizeof(HexInstance)) == 0;
+            }
+            used += n;
+            copied++;
+            copiedBytes += n * sizeof(HexInstance);
+        }
+        copyMs += timerMilliseconds() - copyStart;
+        uint64_t rss = processResidentBytes();
+        peakRss = rss > peakRss ? rss : peakRss;
+
+        double elapsed = timerMilliseconds() - frameStart;
+        if (elapsed < frameMs) std::this_thread::sleep_for(std::chrono::microseconds((int)((frameMs - elapsed) * 1000.0)));
+    }
+    HexMapStreamStats stats = hexMapStreamStats(streamer);
+    stopHexMapStreamer(streamer);
+    closeHexMap(map);
+    remove(path);
+
+    const double peakMb = (double)(peakRss > baseRss ? peakRss - baseRss : 0) / (1024.0 * 1024.0);
+    printf("map: %d frames, %llu chunks loaded (%.1f MB), %llu evicted, %u resident (%.1f MB) at the end\n",
+        frames, (unsigned long long)stats.loaded, stats.loaded_bytes / (1024.0 * 1024.0), (unsigned long long)stats.evicted,
+        stats.resident, stats.resident_bytes / (1024.0 * 1024.0));
+    printf("map: load latency p50 %.3f ms, p99 %.3f ms, max %.3f ms over the last %u loads\n",
+        stats.latency.p50_ms, stats.latency.p99_ms, stats.latency.max_ms, stats.latency.frames);
+    printf("map: %zu chunk copies (%.1f MB) at %.2f GB/s, %.2f%% of wanted chunks not resident yet, copies %s\n",
+        copied, copiedBytes / (1024.0 * 1024.0), copiedBytes / (copyMs * 1e6), wantedTotal ? 100.0 * missing / wantedTotal : 0.0,
+        copiesMatch ? "match" : "MISMATCH");
+    printf("map: resident set grew by %.1f MB at most for a %.1f MB map (%.2f%%)\n", peakMb, fileMb, 100.0 * peakMb / fileMb);
+    // The whole point - what stays resident follows the camera, not the file size
+    ok = ok && copiesMatch && stats.loaded > 0 && peakMb < fileMb * 0.25;
+
+    destroyHexWorld(world);
+    return ok ? 0 : 1;
+}
+
+static void packChunkSource(void* user, size_t chunk, HexInstance* out) {
+    packHexChunkInstances(*reinterpret_cast<const HexWorld*>(user), chunk, out);
+}
+
+// Tile edits - dirty range uploads against rebuilding and re-uploading the whole instance stream every frame
+static int runEdit(int argc, char** argv) {
+    const int frames = argc > 0 ? atoi(argv[0]) : 2000;
+    const int editsPerFrame = argc > 1 ? atoi(argv[1]) : 64;
+    HexWorldDesc desc = {};
+    desc.columns = 1024;
+    desc.rows = 1024;
+    desc.height = 1.0f;
+    desc.seed = 5;
+    HexWorld world = {};
+    if (!createHexWorld(world, desc)) {
+        fprintf(stderr, "edit: failed to create world\n");
+        return 1;
+    }
+    HexInstanceRange* ranges = (HexInstanceRange*) malloc(world.chunk_count * sizeof(HexInstanceRange));
+    const size_t instanceCount = buildHexInstanceRanges(world, ranges);
+    const size_t streamBytes = instanceCount * sizeof(HexInstance);
+    // gpu stands in for the mapped instance buffer, reference gets every edit applied directly
+    HexInstance* gpu = (HexInstance*) alignedAlloc(streamBytes);
+    HexInstance* reference = (HexInstance*) alignedAlloc(streamBytes);
+    for (size_t i = 0; i < world.chunk_count; i++) packHexChunkInstances(world, i, gpu + ranges[i].first);
+    memcpy(reference, gpu, streamBytes);
+
+    // Full rebuild - what an edit cost before, every chunk repacked and the whole stream uploaded
+    double start = timerMilliseconds();
+    const int fullRuns = 10;
+    for (int run = 0; run < fullRuns; run++) {
+        for (size_t i = 0; i < world.chunk_count; i++) packHexChunkInstances(world, i, reference + ranges[i].first);
+        memcpy(gpu, reference, streamBytes);
+    }
+    const double fullMs = (timerMilliseconds() - start) / fullRuns;
+
+    bool ok = true;
+    static const char* patterns[] = { "scattered", "brush" };
+    for (int pattern = 0; pattern < 2; pattern++) {
+        HexTileEditor editor;
+        if (!createHexTileEditor(editor, world, ranges, packChunkSource, &world)) {
+            fprintf(stderr, "edit: failed to create editor\n");
+            return 1;
+        }
+        auto upload = [&](size_t, size_t offset, const void* data, size_t size) {
+            memcpy(reinterpret_cast<uint8_t*>(gpu) + offset, data, size);
+        };
+        uint32_t rng = 12345u + (uint32_t)pattern;
+        double editMs = 0.0;
+        size_t flushFrames = 0;
+        for (int frame = 0; frame < frames; frame++) {
+            // Scattered edits land anywhere, brush edits stay within a few tiles of a point that wanders
+            const int brushCol = (int)(hexHash((uint32_t)frame / 16 + 77) % (uint32_t)desc.columns);
+            const int brushRow = (int)(hexHash((uint32_t)frame / 16 + 99) % (uint32_t)desc.rows);
+            start = timerMilliseconds();
+            for (int e = 0; e < editsPerFrame; e++) {
+                rng = hexHash(rng);
+                int col = (int)(rng % (uint32_t)desc.columns);
+                int row = (int)((rng >> 12) % (uint32_t)desc.rows);
+                if (pattern == 1) {
+                    col = brushCol + (int)(rng % 7) - 3;
+                    row = brushRow + (int)((rng >> 8) % 7) - 3;
+                }
+                HexTileEdit edit;
+                edit.fields = HEX_EDIT_HEIGHT | ((rng & 1) ? (uint32_t)HEX_EDIT_TYPE : 0u);
+                edit.height = (float)(rng >> 24) / 255.0f;
+                edit.type = rng >> 29;
+                if (!hexEditTile(editor, hexOffsetToAxial(col, row), edit)) continue;
+                HexInstance& tile = reference[ranges[(size_t)(row / HEX_CHUNK_SIZE) * world.chunks_x + col / HEX_CHUNK_SIZE].first +
+                                              (size_t)(row % HEX_CHUNK_SIZE) * HEX_CHUNK_SIZE + col % HEX_CHUNK_SIZE];
+                tile.height = edit.height;
+                if (edit.fields & HEX_EDIT_TYPE) tile.color_index = edit.type;
+            }
+            flushHexTileEdits(editor, HEX_EDIT_BUDGET_MS, upload);
+            editMs += timerMilliseconds() - start;
+        }
+        // Budget may leave chunks queued, frames keep flushing until it is drained
+        while (hexEditPending(editor) > 0) {
+            start = timerMilliseconds();
+            flushHexTileEdits(editor, HEX_EDIT_BUDGET_MS, upload);
+            editMs += timerMilliseconds() - start;
+            flushFrames++;
+        }
+        const HexEditStats& stats = editor.stats;
+        bool same = memcmp(gpu, reference, streamBytes) == 0;
+        const double editsPerSecond = stats.edits / (editMs / 1000.0);
+        const double fullEditsPerSecond = editsPerFrame / (fullMs / 1000.0);
+        printf("edit: %-9s %llu edits, %.2f M edits/s (full rebuild %.0f k edits/s, %.0fx), %.1f bytes uploaded per edit (full %.0f), %.2f ranges per chunk, %s\n",
+            patterns[pattern], (unsigned long long)stats.edits, editsPerSecond / 1e6, fullEditsPerSecond / 1e3, editsPerSecond / fullEditsPerSecond,
+            (double)stats.bytes / (double)stats.edits, (double)streamBytes / editsPerFrame,
+            stats.chunks_flushed ? (double)stats.ranges / (double)stats.chunks_flushed : 0.0, same ? "matches reference" : "MISMATCH");
+        printf("edit: %-9s %.4f ms per frame for %d edits, %zu extra frames to drain the budget\n",
+            patterns[pattern], editMs / (frames + flushFrames), editsPerFrame, flushFrames);
+        ok = ok && same;
+        destroyHexTileEditor(editor);
+    }
+
+    // One huge batch against a small budget - has to spread over frames instead of blowing one
+    {
+        HexTileEditor editor;
+        createHexTileEditor(editor, world, ranges, packChunkSource, &world);
+        for (int row = 0; row < desc.rows; row += 2) {
+            for (int col = 0; col < desc.columns; col += 3) hexEditHeight(editor, hexOffsetToAxial(col, row), 0.25f);
+        }
+        const size_t queued = hexEditPending(editor);
+        double worstMs = 0.0;
+        size_t flushes = 0;
+        while (hexEditPending(editor) > 0) {
+            start = timerMilliseconds();
+            flushHexTileEdits(editor, 0.1, [&](size_t, size_t offset, const void* data, size_t size) {
+                memcpy(reinterpret_cast<uint8_t*>(gpu) + offset, data, size);
+            });
+            double ms = timerMilliseconds() - start;
+            worstMs = ms > worstMs ? ms : worstMs;
+            flushes++;
+        }
+        printf("edit: %llu edits in %zu dirty chunks drained in %zu frames at a 0.1 ms budget, worst frame %.3f ms\n",
+            (unsigned long long)editor.stats.edits, queued, flushes, worstMs);
+        destroyHexTileEditor(editor);
+    }
+    printf("edit: full rebuild of %zu tiles is %.3f ms and %.1f MB per frame\n", instanceCount, fullMs, streamBytes / (1024.0 * 1024.0));
+
+    alignedFree(reference);
+    alignedFree(gpu);
+    free(ranges);
+    destroyHexWorld(world);
+    return ok ? 0 : 1;
+}
+
+// Triangles as position triples in their own vertex order, sorted - equal lists mean the same geometry
+// with the same winding and provoking vertex, however triangles and vertices got renumbered
+static std::vector<std::array<float, 9>> sortedTriangles(const HexMesh& mesh) {
+    std::vector<std::array<float, 9>> triangles(mesh.index_count / 3);
+    for (size_t t = 0; t < triangles.size(); t++) {
+        for (int k = 0; k < 3; k++) {
+            const uint32_t v = mesh.indices[t * 3 + k];
+            triangles[t][k * 3 + 0] = mesh.pos_x[v];
+            triangles[t][k * 3 + 1] = mesh.pos_y[v];
+            triangles[t][k * 3 + 2] = mesh.pos_z[v];
+        }
+    }
+    std::sort(triangles.begin(), triangles.end());
+    return triangles;
+}
+
+// Vertex cache optimization on chunk sized meshes - ACMR/ATVR before and after, build time, index width
+static int runOptimize(int argc, char** argv) {
+    const int maxSide = argc > 0 ? atoi(argv[0]) : 256;
+    bool ok = true;
+
+    printf("optimize: FIFO cache of %d, ACMR is vertex shader runs per triangle, ATVR per vertex [%s]\n", VERTEX_CACHE_SIZE, simdName());
+    for (int side = 16; side <= maxSide; side *= 2) {
+        for (int topology = 0; topology < 3; topology++) {
+            // Prisms, flat tiles with their own corners, flat tiles sharing corners
+            HexMeshDesc desc = {};
+            desc.columns = side;
+            desc.rows = side;
+            desc.first_row = 1;  // Odd first row, chunks rarely start on row 0
+            desc.height = topology == 0 ? 1.0f : 0.0f;
+            const char* name = topology == 0 ? "prism" : topology == 1 ? "flat" : "shared";
+
+            HexMesh mesh = {};
+            double start = timerMilliseconds();
+            bool created = topology == 2 ? createSharedHexMesh(mesh, desc) : createHexMesh(mesh, desc);
+            const double buildMs = timerMilliseconds() - start;
+            if (!created) {
+                fprintf(stderr, "optimize: failed to create %dx%d %s mesh\n", side, side, name);
+                return 1;
+            }
+            const std::vector<std::array<float, 9>> before = sortedTriangles(mesh);
+            const VertexCacheStats in = analyzeVertexCache(mesh.indices, mesh.index_count, mesh.vertex_count);
+
+            start = timerMilliseconds();
+            optimizeVertexCache(mesh.indices, mesh.index_count, mesh.vertex_count);
+            const double cacheMs = timerMilliseconds() - start;
+            start = timerMilliseconds();
+            optimizeVertexFetch(mesh);
+            const double fetchMs = timerMilliseconds() - start;
+
+            const VertexCacheStats out = analyzeVertexCache(mesh.indices, mesh.index_count, mesh.vertex_count);
+            const IndexFormat format = chooseIndexFormat(mesh.vertex_count);
+            const bool same = validateHexMesh(mesh) && sortedTriangles(mesh) == before;
+            printf("  %4dx%-4d %-6s %7zu vertices  ACMR %.3f -> %.3f  ATVR %.3f -> %.3f  build %.2f ms, tipsify %.2f ms, fetch %.2f ms, %s indices (%zu KB), %s\n",
+                side, side, name, mesh.vertex_count, in.acmr, out.acmr, in.atvr, out.atvr, buildMs, cacheMs, fetchMs,
+                format == INDEX_FORMAT_16 ? "16-bit" : "32-bit", mesh.index_count * indexFormatSize(format) / 1024,
+                same ? "same triangles" : "MISMATCH");
+            ok = ok && same && out.acmr <= in.acmr;
+            destroyHexMesh(mesh);
+        }
+    }
+    return ok ? 0 : 1;
+}
+
+// Portable math layer - SIMD batches bit for bit against scalar code, known camera matrices, and throughput
+static int runMath(int argc, char** argv) {
+    const size_t matrices = argc > 0 ? (size_t)atol(argv[0]) : 20000;    // Fits in L2 - measures math, not memory
+    const size_t points = argc > 1 ? (size_t)atol(argv[1]) : 200000;
+    const int repeats = 20;
+    bool ok = true;
+
+    // Sine and cosine polynomials against libm over a few turns either way
+    double sinCosError = 0.0;
+    for (int i = -20000; i <= 20000; i++) {
+        const float angle = (float)i * 0.001f;
+        float s, c;
+        scalarSinCos(angle, s, c);
+        sinCosError = std::max(sinCosError, std::max(fabs(s - sin((double)angle)), fabs(c - cos((double)angle))));
+    }
+    // Camera from prepareCamera against the same matrices worked out in double precision
+    const Mat4 view = mat4LookAtLH({ 2.0f, 2.0f, -2.0f }, { 0.0f, 0.0f, 0.0f }, { 0.0f, 1.0f, 0.0f });
+    const Mat4 projection = mat4PerspectiveFovLH(MATH_PIDIV4, 16.0f / 9.0f, 0.1f, 100.0f);
+    const double s2 = sqrt(0.5), s3 = sqrt(1.0 / 3.0), s6 = sqrt(1.0 / 6.0), h = 1.0 / tan(3.14159265358979 / 8.0);
+    const double expectedView[16] = { s2, -s6, -s3, 0, 0, 2 * s6, -s3, 0, s2, s6, s3, 0, 0, 0, 2 * sqrt(3.0), 1 };
+    const double expectedProjection[16] = { h * 9.0 / 16.0, 0, 0, 0, 0, h, 0, 0, 0, 0, 100.0 / 99.9, 1, 0, 0, -10.0 / 99.9, 0 };
+    double cameraError = 0.0;
+    for (int i = 0; i < 16; i++) {
+        cameraError = std::max(cameraError, fabs(view.m[i] - expectedView[i]));
+        cameraError = std::max(cameraError, fabs(projection.m[i] - expectedProjection[i]));
+    }
+    Mat4 inverse;
+    const Mat4 viewProjection = view * projection;
+    const bool inverted = mat4Inverse(inverse, viewProjection);
+    const Mat4 product = viewProjection * inverse;
+    double inverseError = 0.0;
+    for (int i = 0; i < 16; i++) inverseError = std::max(inverseError, fabs(product.m[i] - (i % 5 == 0 ? 1.0 : 0.0)));
+    printf("math: sincos error %.2e, camera matrices error %.2e, inverse error %.2e [%s]\n", sinCosError, cameraError, inverseError, simdName());
+    ok = ok && sinCosError < 1e-6 && cameraError < 1e-5 && inverted && inverseError < 1e-4;
+
+    // Random world matrices and points, same inputs for both paths
+    std::vector<Mat4> world(matrices), simdOut(matrices), scalarOut(matrices);
+    uint32_t seed = 1;
+    for (size_t i = 0; i < matrices; i++) {
+        const float angle = (float)(hexHash(seed++) % 6283) * 0.001f;
+        world[i] = mat4RotationY(angle) * mat4RotationX(angle * 0.5f);
+        world[i].m[12] = (float)(hexHash(seed++) % 1000);
+        world[i].m[14] = (float)(hexHash(seed++) % 1000);
+    }
+    std::vector<float> xs(points), ys(points), zs(points);
+    std::vector<float> simdX(points), simdY(points), simdZ(points), scalarX(points), scalarY(points), scalarZ(points);
+    for (size_t i = 0; i < points; i++) {
+        xs[i] = (float)(hexHash(seed++) % 100000) * 0.01f;
+        ys[i] = (float)(hexHash(seed++) % 1000) * 0.01f;
+        zs[i] = (float)(hexHash(seed++) % 100000) * 0.01f;
+    }
+
+    double simdMs = 1e30, scalarMs = 1e30;
+    for (int r = 0; r < repeats; r++) {
+        double start = timerMilliseconds();
+        mat4MultiplyBatch(world.data(), viewProjection, simdOut.data(), matrices);
+        simdMs = std::min(simdMs, timerMilliseconds() - start);
+        start = timerMilliseconds();
+        mat4MultiplyBatchScalar(world.data(), viewProjection, scalarOut.data(), matrices);
+        scalarMs = std::min(scalarMs, timerMilliseconds() - start);
+    }
+    bool same = memcmp(simdOut.data(), scalarOut.data(), matrices * sizeof(Mat4)) == 0;
+    printf("math: %zu matrix multiplies - %.1f M/s vs scalar %.1f M/s (%.2fx), %s\n", matrices,
+        (double)matrices / simdMs / 1000.0, (double)matrices / scalarMs / 1000.0, scalarMs / simdMs, same ? "bit identical" : "MISMATCH");
+    ok = ok && same;
+
+    simdMs = scalarMs = 1e30;
+    for (int r = 0; r < repeats; r++) {
+        double start = timerMilliseconds();
+        transformPoints(viewProjection, xs.data(), ys.data(), zs.data(), simdX.data(), simdY.data(), simdZ.data(), points);
+        simdMs = std::min(simdMs, timerMilliseconds() - start);
+        start = timerMilliseconds();
+        transformPointsScalar(viewProjection, xs.data(), ys.data(), zs.data(), scalarX.data(), scalarY.data(), scalarZ.data(), points);
+        scalarMs = std::min(scalarMs, timerMilliseconds() - start);
+    }
+    same = memcmp(simdX.data(), scalarX.data(), points * sizeof(float)) == 0 && memcmp(simdY.data(), scalarY.data(), points * sizeof(float)) == 0 &&
+           memcmp(simdZ.data(), scalarZ.data(), points * sizeof(float)) == 0;
+    printf("math: %zu point transforms - %.1f M/s vs scalar %.1f M/s (%.2fx), %s\n", points,
+        (double)points / simdMs / 1000.0, (double)points / scalarMs / 1000.0, scalarMs / simdMs, same ? "bit identical" : "MISMATCH");
+    ok = ok && same;
+    return ok ? 0 : 1;
+}
+
+// Entity store - handle churn, then every entity and a tenth of them moving each frame, matrices written
+// into a stand-in for mapped instance memory and checked against a full scalar rebuild
+static int runEntities(int argc, char** argv) {
+    const size_t count = argc > 0 ? (size_t)atol(argv[0]) : 131072;
+    const int frames = argc > 1 ? atoi(argv[1]) : 300;
+    bool ok = true;
+
+    EntityStore store;
+    JobSystem jobs;
+    float* gpu = (float*)alignedAlloc(count * sizeof(Mat4));
+    float* reference = (float*)alignedAlloc(count * sizeof(Mat4));
+    std::vector<EntityHandle> handles(count);
+    if (!createEntityStore(store, count) || !createJobSystem(jobs, hardwareThreads()) || gpu == nullptr || reference == nullptr) {
+        fprintf(stderr, "entities: failed to create store\n");
+        return 1;
+    }
+
+    // Handles survive churn - every third entity destroyed and made again, stale handles refused, live ones
+    // still find their own data
+    uint32_t seed = 3;
+    for (size_t i = 0; i < count; i++) {
+        handles[i] = entityCreate(store);
+        entitySetTransform(store, handles[i], (float)(i % 512), 0.0f, (float)(i / 512), (float)(hexHash(seed++) % 6283) * 0.001f, 1.0f);
+        entitySetTile(store, handles[i], { (int32_t)i, 0 });
+    }
+    size_t stale = 0;
+    for (size_t i = 0; i < count; i += 3) {
+        const EntityHandle old = handles[i];
+        entityDestroy(store, old);
+        stale += entityDestroy(store, old) ? 0 : 1;
+        handles[i] = entityCreate(store);
+        stale += entityAlive(store, old) ? 0 : 1;
+        entitySetTransform(store, handles[i], (float)(i % 512), 0.0f, (float)(i / 512), 0.0f, 1.0f);
+        entitySetTile(store, handles[i], { (int32_t)i, 0 });
+    }
+    bool found = stale == 2 * ((count + 2) / 3) && store.count == count;
+    for (size_t i = 0; found && i < count; i++) {
+        found = entityAlive(store, handles[i]) && store.tile_q[entityIndex(store, handles[i])] == (int32_t)i;
+    }
+    printf("entities: %zu entities, %zu destroyed and made again - stale handles %s, live handles %s\n",
+        count, (count + 2) / 3, stale == 2 * ((count + 2) / 3) ? "refused" : "ACCEPTED", found ? "intact" : "BROKEN");
+    ok = ok && found;
+
+    std::vector<float> velocity(count);
+    for (size_t i = 0; i < count; i++) velocity[i] = ((float)(hexHash(seed++) % 200) - 100.0f) * 0.0001f;
+    const char* patterns[] = { "all", "tenth" };
+    for (int pattern = 0; pattern < 2; pattern++) {
+        for (int threaded = 0; threaded < 2; threaded++) {
+            RollingStats frameStats = {};
+            size_t written = 0;
+            updateEntityWorldMatrices(store, gpu, sizeof(Mat4), ENTITY_MATRIX_COLUMNS);
+            for (int frame = 0; frame < frames; frame++) {
+                // Movement system - straight on the dense arrays
+                const size_t step = pattern == 0 ? 1 : 10;
+                for (size_t i = (size_t)frame % step; i < store.count; i += step) {
+                    store.pos_x[i] += velocity[i];
+                    store.pos_z[i] -= velocity[i];
+                    store.yaw[i] += velocity[i];
+                    if (step > 1) entityMarkDirty(store, i);
+                }
+                if (step == 1) entityMarkDirtyRange(store, 0, store.count);
+                const double start = timerMilliseconds();
+                written += threaded ? updateEntityWorldMatrices(store, gpu, sizeof(Mat4), ENTITY_MATRIX_COLUMNS, jobs)
+                                    : updateEntityWorldMatrices(store, gpu, sizeof(Mat4), ENTITY_MATRIX_COLUMNS);
+                rollingStatsAdd(frameStats, (float)(timerMilliseconds() - start));
+            }
+            updateEntityWorldMatricesScalar(store, reference, sizeof(Mat4), ENTITY_MATRIX_COLUMNS);
+            const bool same = memcmp(gpu, reference, store.count * sizeof(Mat4)) == 0;
+            const ProfileFrameStats stats = rollingStatsSummary(frameStats);
+            printf("entities: %-5s moving, %-7s %7.0f matrices/frame  p50 %.3f ms  p99 %.3f ms (budget %.1f ms, %s) [%s], %s\n",
+                patterns[pattern], threaded ? "jobs" : "1 thread", (double)written / frames, stats.p50_ms, stats.p99_ms, ENTITY_UPDATE_BUDGET_MS,
+                stats.p99_ms <= ENTITY_UPDATE_BUDGET_MS ? "within" : "OVER", simdName(), same ? "matches scalar" : "MISMATCH");
+            ok = ok && same;
+        }
+    }
+
+    // Full rebuild of every matrix with the plain loop, for scale
+    double start = timerMilliseconds();
+    for (int frame = 0; frame < 10; frame++) updateEntityWorldMatricesScalar(store, reference, sizeof(Mat4), ENTITY_MATRIX_COLUMNS);
+    printf("entities: scalar full rebuild %.3f ms per frame\n", (timerMilliseconds() - start) / 10.0);
+
+    alignedFree(reference);
+    alignedFree(gpu);
+    destroyJobSystem(jobs);
+    destroyEntityStore(store);
+    return ok ? 0 : 1;
+}
+
+// Checks a path is a chain of neighbours from start to goal and returns what walking it costs
+static uint32_t walkedCost(const HexPathGrid& grid, const std::vector<uint32_t>& path, uint32_t start, uint32_t goal) {
+    if (path.empty() || path.front() != start || path.back() != goal) return HEX_PATH_UNREACHABLE;
+    uint32_t cost = 0;
+    for (size_t i = 1; i < path.size(); i++) {
+        bool adjacent = false;
+        for (int d = 0; d < 6; d++) adjacent = adjacent || path[i - 1] + (uint32_t)grid.step[hexPathNodeParity(grid, path[i - 1])][d] == path[i];
+        if (!adjacent || !grid.cost[path[i]]) return HEX_PATH_UNREACHABLE;
+        cost += grid.cost[path[i]];
+    }
+    return cost;
+}
+
+static int runPath(int argc, char** argv) {
+    HexWorldDesc desc = {};
+    desc.columns = argc > 0 ? atoi(argv[0]) : 1000;
+    desc.rows = argc > 1 ? atoi(argv[1]) : 1000;
+    const size_t queryCount = argc > 2 ? (size_t)atol(argv[2]) : 200;
+    desc.height = 1.0f;
+    desc.seed = 1234u;
+    bool ok = true;
+
+    HexWorld world = {};
+    HexTerrain terrain = {};
+    HexPathGrid grid = {};
+    JobSystem jobs;
+    const int maxThreads = hardwareThreads() > 4 ? hardwareThreads() : 4;
+    if (!createHexWorld(world, desc) || !allocateHexTerrain(terrain, world, hexTerrainDesc(desc.seed)) || !createJobSystem(jobs, maxThreads)) {
+        fprintf(stderr, "path: failed to create world\n");
+        return 1;
+    }
+    generateHexTerrain(terrain, world, jobs);
+    if (!createHexPathGrid(grid, world, terrain)) {
+        fprintf(stderr, "path: failed to create grid\n");
+        return 1;
+    }
+
+    // Neighbour steps against the axial directions, on both row parities and every direction
+    bool neighbours = true;
+    for (int row = 1; row < 3; row++) {
+        for (int d = 0; d < 6; d++) {
+            int col, nextRow;
+            hexAxialToOffset(hexNeighbour(hexOffsetToAxial(5, row), d), col, nextRow);
+            neighbours = neighbours && hexPathNode(grid, 5, row) + (uint32_t)grid.step[row & 1][d] == hexPathNode(grid, col, nextRow);
+        }
+    }
+
+    // Connected regions, so queries mostly ask for routes that exist
+    std::vector<uint32_t> region(grid.node_count, 0);
+    std::vector<uint32_t> stack;
+    uint32_t regions = 0;
+    size_t passable = 0;
+    for (uint32_t node = 0; node < grid.node_count; node++) {
+        if (!grid.cost[node] || region[node]) continue;
+        region[node] = ++regions;
+        stack.push_back(node);
+        while (!stack.empty()) {
+            const uint32_t n = stack.back();
+            stack.pop_back();
+            passable++;
+            for (int d = 0; d < 6; d++) {
+                const uint32_t next = n + (uint32_t)grid.step[hexPathNodeParity(grid, n)][d];
+                if (grid.cost[next] && !region[next]) {
+                    region[next] = regions;
+                    stack.push_back(next);
+                }
+            }
+        }
+    }
+    printf("path: %dx%d map, %.1f%% passable in %u regions, neighbour steps %s\n", desc.columns, desc.rows,
+        100.0 * (double)passable / ((double)desc.columns * (double)desc.rows), regions, neighbours ? "match axial" : "WRONG");
+    ok = ok && neighbours;
+
+    uint32_t seed = 99;
+    auto randomTile = [&]() {
+        for (;;) {
+            const int col = (int)(hexHash(seed++) % (uint32_t)desc.columns);
+            const uint32_t node = hexPathNode(grid, col, (int)(hexHash(seed++) % (uint32_t)desc.rows));
+            if (grid.cost[node]) return node;
+        }
+    };
+    std::vector<HexPathQuery> queries(queryCount);
+    for (size_t q = 0; q < queryCount; q++) {
+        queries[q].start = randomTile();
+        // Every tenth goal anywhere, unreachable ones included
+        do queries[q].goal = randomTile();
+        while (q % 10 != 0 && region[queries[q].goal] != region[queries[q].start]);
+    }
+
+    HexPathSearch search;
+    createHexPathSearch(search, grid);
+    HexPathHierarchy hierarchy;
+    double start = timerMilliseconds();
+    buildHexPathHierarchy(hierarchy, grid, jobs);
+    const double hierarchyMs = timerMilliseconds() - start;
+    printf("path: portal graph %zu nodes, %zu edges over %zu chunks, built in %.1f ms on %d workers\n",
+        hierarchy.node_tile.size(), hierarchy.edge_target.size(), grid.chunk_count, hierarchyMs, jobs.worker_count);
+
+    // A* on one thread - paths walk, costs add up, reachability agrees with the regions
+    std::vector<uint32_t> optimal(queryCount);
+    std::vector<uint32_t> path;
+    bool valid = true;
+    size_t pathTiles = 0;
+    search.expanded = 0;
+    start = timerMilliseconds();
+    for (size_t q = 0; q < queryCount; q++) {
+        optimal[q] = hexFindPath(search, grid, queries[q].start, queries[q].goal, &path);
+        const bool reachable = region[queries[q].start] == region[queries[q].goal];
+        valid = valid && (optimal[q] == HEX_PATH_UNREACHABLE ? !reachable && path.empty()
+                                                              : reachable && walkedCost(grid, path, queries[q].start, queries[q].goal) == optimal[q]);
+        pathTiles += path.size();
+    }
+    double ms = timerMilliseconds() - start;
+    printf("path: A*          %8.1f queries/s, %7.0f nodes expanded and %5.0f tiles per path, %s\n",
+        queryCount / ms * 1000.0, (double)search.expanded / queryCount, (double)pathTiles / queryCount, valid ? "paths valid" : "INVALID");
+    ok = ok && valid;
+
+    // Portal graph - never cheaper than the optimum, finds the same routes, refined paths walk
+    search.expanded = 0;
+    start = timerMilliseconds();
+    std::vector<uint32_t> coarse(queryCount);
+    for (size_t q = 0; q < queryCount; q++) coarse[q] = hexFindPathHierarchical(search, grid, hierarchy, queries[q].start, queries[q].goal, nullptr);
+    ms = timerMilliseconds() - start;
+    const double coarseExpanded = (double)search.expanded / queryCount;
+    start = timerMilliseconds();
+    double excess = 0.0, refinedExcess = 0.0;
+    size_t found = 0;
+    valid = true;
+    for (size_t q = 0; q < queryCount; q++) {
+        const uint32_t refined = hexFindPathHierarchical(search, grid, hierarchy, queries[q].start, queries[q].goal, &path);
+        if (optimal[q] == HEX_PATH_UNREACHABLE) {
+            valid = valid && coarse[q] == HEX_PATH_UNREACHABLE && refined == HEX_PATH_UNREACHABLE;
+            continue;
+        }
+        valid = valid && coarse[q] >= optimal[q] && refined >= optimal[q] && refined <= coarse[q] &&
+            walkedCost(grid, path, queries[q].start, queries[q].goal) == refined;
+        excess += optimal[q] ? (double)coarse[q] / optimal[q] - 1.0 : 0.0;
+        refinedExcess += optimal[q] ? (double)refined / optimal[q] - 1.0 : 0.0;
+        found++;
+    }
+    const double refinedMs = timerMilliseconds() - start;
+    printf("path: portal A*   %8.1f queries/s, %7.0f nodes expanded, %.1f%% over optimal; refined %.1f queries/s, %.1f%% over, %s\n",
+        queryCount / ms * 1000.0, coarseExpanded, 100.0 * excess / (found ? found : 1), queryCount / refinedMs * 1000.0,
+        100.0 * refinedExcess / (found ? found : 1), valid ? "paths valid" : "INVALID");
+    ok = ok && valid;
+
+    // Batches across workers, same answers on any count
+    const size_t batchCount = queryCount * 4;
+    std::vector<HexPathQuery> batch(batchCount);
+    std::vector<uint32_t> costs(batchCount), firstCosts(batchCount);
+    for (size_t q = 0; q < batchCount; q++) batch[q] = queries[q % queryCount];
+    std::vector<HexPathSearch> searches(maxThreads);
+    for (HexPathSearch& s : searches) createHexPathSearch(s, grid);
+    for (int threads = 1; threads <= maxThreads; threads *= 2) {
+        JobSystem pool;
+        createJobSystem(pool, threads);
+        start = timerMilliseconds();
+        hexFindPaths(searches.data(), (size_t)threads, grid, &hierarchy, batch.data(), costs.data(), batchCount, pool);
+        ms = timerMilliseconds() - start;
+        destroyJobSystem(pool);
+        if (threads == 1) firstCosts = costs;
+        const bool same = costs == firstCosts;
+        printf("path: portal A* batch of %zu on %2d workers %9.1f queries/s, %s\n",
+            batchCount, threads, batchCount / ms * 1000.0, threads == 1 ? "reference" : (same ? "identical" : "DIFFERENT"));
+        ok = ok && same;
+    }
+    for (HexPathSearch& s : searches) destroyHexPathSearch(s);
+
+    // Flow field to the map center against a plain whole-map Dijkstra
+    const uint32_t goal = [&]() {
+        for (int r = 0; r < desc.rows; r++) {
+            const uint32_t node = hexPathNode(grid, desc.columns / 2, (desc.rows / 2 + r) % desc.rows);
+            if (grid.cost[node]) return node;
+        }
+        return randomTile();
+    }();
+    std::vector<uint32_t> reference(grid.node_count, HEX_PATH_UNREACHABLE);
+    std::vector<uint64_t> open;
+    reference[goal] = 0;
+    open.push_back(goal);
+    start = timerMilliseconds();
+    while (!open.empty()) {
+        std::pop_heap(open.begin(), open.end(), std::greater<uint64_t>());
+        const uint64_t key = open.back();
+        open.pop_back();
+        const uint32_t n = (uint32_t)key;
+        if ((uint32_t)(key >> 32) != reference[n]) continue;
+        for (int d = 0; d < 6; d++) {
+            const uint32_t next = n + (uint32_t)grid.step[hexPathNodeParity(grid, n)][d];
+            if (!grid.cost[next] || reference[n] + grid.cost[n] >= reference[next]) continue;
+            reference[next] = reference[n] + grid.cost[n];
+            open.push_back((uint64_t)reference[next] << 32 | next);
+            std::push_heap(open.begin(), open.end(), std::greater<uint64_t>());
+        }
+    }
+    const double dijkstraMs = timerMilliseconds() - start;
+
+    HexFlowField field, firstField;
+    createHexFlowField(field, grid);
+    createHexFlowField(firstField, grid);
+    for (int threads = 1; threads <= maxThreads; threads *= 2) {
+        JobSystem pool;
+        createJobSystem(pool, threads);
+        HexFlowField& out = threads == 1 ? firstField : field;
+        buildHexFlowField(out, grid, goal, pool);  // Warm
+        start = timerMilliseconds();
+        buildHexFlowField(out, grid, goal, pool);
+        ms = timerMilliseconds() - start;
+        destroyJobSystem(pool);
+        const bool same = threads == 1
+            ? memcmp(out.integration, reference.data(), grid.node_count * sizeof(uint32_t)) == 0
+            : memcmp(out.integration, firstField.integration, grid.node_count * sizeof(uint32_t)) == 0 &&
+              memcmp(out.direction, firstField.direction, grid.node_count) == 0;
+        printf("path: flow field on %2d workers %8.1f ms, %d sweeps, %zu chunk passes (Dijkstra %.1f ms), %s\n",
+            threads, ms, out.sweeps, out.chunk_runs, dijkstraMs, threads == 1 ? (same ? "matches Dijkstra" : "MISMATCH") : (same ? "identical" : "DIFFERENT"));
+        ok = ok && same;
+    }
+
+    // Units - one field, every unit a single lookup per step, they walk exactly the integrated cost
+    const size_t unitCount = 100000;
+    std::vector<uint32_t> units(unitCount), walked(unitCount, 0), expected(unitCount);
+    for (size_t u = 0; u < unitCount; u++) {
+        do units[u] = randomTile();
+        while (firstField.integration[units[u]] == HEX_PATH_UNREACHABLE);
+        expected[u] = firstField.integration[units[u]];
+    }
+    size_t steps = 0;
+    start = timerMilliseconds();
+    for (bool moving = true; moving; ) {
+        moving = false;
+        for (size_t u = 0; u < unitCount; u++) {
+            const uint32_t next = hexFlowFieldStep(firstField, grid, units[u]);
+            if (next == units[u]) continue;
+            walked[u] += grid.cost[next];
+            units[u] = next;
+            moving = true;
+            steps++;
+        }
+    }
+    ms = timerMilliseconds() - start;
+    bool arrived = true;
+    for (size_t u = 0; u < unitCount; u++) arrived = arrived && units[u] == goal && walked[u] == expected[u];
+    printf("path: %zu units walked %zu steps to the goal, %.1f M steps/s, %s\n",
+        unitCount, steps, steps / ms / 1000.0, arrived ? "all arrived at integrated cost" : "LOST");
+    ok = ok && arrived;
+
+    destroyHexFlowField(firstField);
+    destroyHexFlowField(field);
+    destroyHexPathSearch(search);
+    destroyHexPathGrid(grid);
+    destroyJobSystem(jobs);
+    destroyHexTerrain(terrain);
+    destroyHexWorld(world);
+    return ok ? 0 : 1;
+}
+
+// Ray per tile, the obvious way - walks the hex line to every tile in range and keeps the steepest slope
+static void naiveFov(const HexFov& fov, const HexFovObserver& o, std::vector<uint8_t>& seen, int& baseCol, int& baseRow) {
+    const int r = o.radius;
+    const int side = 2 * r + 1;
+    baseCol = o.col - r;
+    baseRow = o.row - r;
+    seen.assign((size_t)side * (size_t)side, 0);
+    auto height = [&](int col, int row) { return hexGridAt(fov.height, col, row); };
+    const float eye = height(o.col, o.row) + o.eye;
+    const HexAxial center = hexOffsetToAxial(o.col, o.row);
+    for (int row = baseRow; row < baseRow + side; row++) {
+        for (int col = baseCol; col < baseCol + side; col++) {
+            if (col < 0 || row < 0 || col >= fov.columns || row >= fov.rows) continue;
+            const HexAxial target = hexOffsetToAxial(col, row);
+            const int n = hexDistance(center, target);
+            if (n > r) continue;
+            float steepest = -FLT_MAX;
+            for (int i = 1; i < n; i++) {
+                // Cube lerp, nudged off the edges, rounded back to a tile
+                const float t = (float)i / (float)n;
+                const float q = center.q + (target.q - center.q) * t + 1e-4f;
+                const float rr = center.r + (target.r - center.r) * t + 1e-4f;
+                const float s = -q - rr;
+                float rq = roundf(q), rr2 = roundf(rr), rs = roundf(s);
+                const float dq = fabsf(rq - q), dr = fabsf(rr2 - rr), ds = fabsf(rs - s);
+                if (dq > dr && dq > ds) rq = -rr2 - rs;
+                else if (dr > ds) rr2 = -rq - rs;
+                int c, w;
+                hexAxialToOffset({ (int)rq, (int)rr2 }, c, w);
+                if (c < 0 || w < 0 || c >= fov.columns || w >= fov.rows) continue;
+                const float slope = (height(c, w) - eye) / (float)i;
+                steepest = slope > steepest ? slope : steepest;
+            }
+            if (n == 0 || (height(col, row) - eye) / (float)n >= steepest) seen[(size_t)(row - baseRow) * side + (col - baseCol)] = 1;
+        }
+    }
+}
+
+static bool sameVisibility(const HexFov& a, const HexFov& b) {
+    return memcmp(a.visible, b.visible, a.chunk_count * (size_t)a.chunk_size * sizeof(uint64_t)) == 0;
+}
+
+static int runFov(int argc, char** argv) {
+    const size_t observerCount = argc > 0 ? (size_t)atol(argv[0]) : 10000;
+    const int radius = argc > 1 ? atoi(argv[1]) : 12;
+    const int frames = argc > 2 ? atoi(argv[2]) : 100;
+    const int side = argc > 3 ? atoi(argv[3]) : 1024;  // The checks below put things around tile (512, 512)
+    if (side < 1024) {
+        fprintf(stderr, "fov: the map side has to be 1024 or more\n");
+        return 1;
+    }
+    HexWorldDesc desc = {};
+    desc.columns = side;
+    desc.rows = side;
+    desc.height = 6.0f;
+    desc.seed = 1234u;
+    bool ok = true;
+
+    HexWorld world = {};
+    HexTerrain terrain = {};
+    JobSystem jobs;
+    if (!createHexWorld(world, desc) || !allocateHexTerrain(terrain, world, hexTerrainDesc(desc.seed)) || !createJobSystem(jobs, hardwareThreads())) {
+        fprintf(stderr, "fov: failed to create world\n");
+        return 1;
+    }
+    generateHexTerrain(terrain, world, jobs);
+    const size_t tiles = (size_t)desc.columns * (size_t)desc.rows;
+
+    // Flat map - a lone observer sees its whole disc, 3r(r + 1) + 1 tiles
+    HexTerrain flat = {};
+    HexFov fov, reference;
+    allocateHexTerrain(flat, world, terrain.desc);
+    for (size_t i = 0; i < tiles; i++) flat.height[i] = 0.5f;
+    createHexFov(fov, world, flat, 1);
+    hexFovAddObserver(fov, 500, 501, radius, 0.5f);
+    updateHexFov(fov, jobs);
+    size_t seen = 0;
+    for (int row = 0; row < desc.rows; row++) {
+        for (int col = 0; col < desc.columns; col++) seen += hexFovVisible(fov, col, row) ? 1 : 0;
+    }
+    const size_t disc = 3 * (size_t)radius * (size_t)(radius + 1) + 1;
+    printf("fov: flat map, radius %d sees %zu tiles of %zu, %s\n", radius, seen, disc, seen == disc ? "whole disc" : "WRONG");
+    ok = ok && seen == disc;
+    destroyHexFov(fov);
+
+    // Observers all over the terrain
+    std::vector<int> cols(observerCount), rows(observerCount);
+    uint32_t seed = 5;
+    for (size_t i = 0; i < observerCount; i++) {
+        cols[i] = (int)(hexHash(seed++) % (uint32_t)desc.columns);
+        rows[i] = (int)(hexHash(seed++) % (uint32_t)desc.rows);
+    }
+    createHexFov(fov, world, terrain, observerCount);
+    createHexFov(reference, world, terrain, observerCount);
+    for (size_t i = 0; i < observerCount; i++) hexFovAddObserver(fov, cols[i], rows[i], radius, 0.5f);
+
+    // Against a ray per tile on a sample - same rule, so they should mostly agree, at a fraction of the cost
+    const size_t sample = observerCount < 1000 ? observerCount : 1000;
+    std::vector<uint64_t> window(HEX_FOV_WINDOW_WORDS);
+    std::vector<uint8_t> naive;
+    size_t agree = 0, compared = 0;
+    double castMs = 0.0, naiveMs = 0.0;
+    for (size_t i = 0; i < sample; i++) {
+        double start = timerMilliseconds();
+        hexFovCast(fov, fov.observers[i], window.data());
+        castMs += timerMilliseconds() - start;
+        int baseCol, baseRow;
+        start = timerMilliseconds();
+        naiveFov(fov, fov.observers[i], naive, baseCol, baseRow);
+        naiveMs += timerMilliseconds() - start;
+        const HexAxial center = hexOffsetToAxial(cols[i], rows[i]);
+        for (int y = 0; y <= 2 * radius; y++) {
+            for (int x = 0; x <= 2 * radius; x++) {
+                const int col = baseCol + x, row = baseRow + y;
+                if (col < 0 || row < 0 || col >= desc.columns || row >= desc.rows || hexDistance(center, hexOffsetToAxial(col, row)) > radius) continue;
+                agree += ((window[y] >> x) & 1) == naive[(size_t)y * (2 * radius + 1) + x] ? 1 : 0;
+                compared++;
+            }
+        }
+    }
+    printf("fov: shadowcast %.2f us per observer, ray per tile %.2f us (%.1fx), %.2f%% of %zu tiles agree\n",
+        castMs * 1000.0 / sample, naiveMs * 1000.0 / sample, naiveMs / castMs, 100.0 * agree / compared, compared);
+
+    // Everything from scratch, 1 thread and all of them - one row when that is the same count
+    const int sweeps = jobs.worker_count > 1 ? 2 : 1;
+    for (int threaded = 0; threaded < sweeps; threaded++) {
+        JobSystem single;
+        createJobSystem(single, 1);
+        HexFov& out = threaded ? fov : reference;
+        if (!threaded) {
+            for (size_t i = 0; i < observerCount; i++) hexFovAddObserver(reference, cols[i], rows[i], radius, 0.5f);
+        }
+        const double start = timerMilliseconds();
+        updateHexFov(out, threaded ? jobs : single);
+        const double ms = timerMilliseconds() - start;
+        destroyJobSystem(single);
+        size_t visible = 0;
+        for (size_t w = 0; w < out.chunk_count * (size_t)out.chunk_size; w++) visible += (size_t)__builtin_popcountll(out.visible[w]);
+        printf("fov: %zu observers radius %d from scratch on %2d workers %8.3f ms, %.1f M tiles/s, %.1f%% of the map visible%s\n",
+            observerCount, radius, threaded ? jobs.worker_count : 1, ms, out.stats.tiles_cast / ms / 1000.0, 100.0 * visible / tiles,
+            threaded ? (sameVisibility(fov, reference) ? ", identical" : ", DIFFERENT") : "");
+        ok = ok && (!threaded || sameVisibility(fov, reference));
+    }
+    if (sweeps == 1) {
+        // Same single worker, fov still has to hold the cast for the ticks below
+        updateHexFov(fov, jobs);
+        ok = ok && sameVisibility(fov, reference);
+    }
+
+    // Ticks - a tenth of the observers step to a neighbour tile, only they are cast again
+    RollingStats tickStats = {};
+    size_t cast = 0, merged = 0;
+    for (int frame = 0; frame < frames; frame++) {
+        for (size_t i = (size_t)frame % 10; i < observerCount; i += 10) {
+            const int d = (int)(hexHash(seed++) % 6);
+            int col, row;
+            hexAxialToOffset(hexNeighbour(hexOffsetToAxial(cols[i], rows[i]), d), col, row);
+            if (col < 0 || row < 0 || col >= desc.columns || row >= desc.rows) continue;
+            cols[i] = col;
+            rows[i] = row;
+            hexFovMoveObserver(fov, i, col, row);
+        }
+        const double start = timerMilliseconds();
+        updateHexFov(fov, jobs);
+        rollingStatsAdd(tickStats, (float)(timerMilliseconds() - start));
+        cast += fov.stats.observers_cast;
+        merged += fov.stats.chunks_merged;
+    }
+    for (size_t i = 0; i < observerCount; i++) hexFovMoveObserver(reference, i, cols[i], rows[i]);
+    updateHexFov(reference, jobs);
+    ProfileFrameStats stats = rollingStatsSummary(tickStats);
+    bool same = sameVisibility(fov, reference);
+    printf("fov: %d ticks moving a tenth, %.0f observers and %.0f chunks per tick, p50 %.3f ms p99 %.3f ms, %s\n",
+        frames, (double)cast / frames, (double)merged / frames, stats.p50_ms, stats.p99_ms, same ? "matches a fresh cast" : "STALE");
+    ok = ok && same;
+
+    // Terrain edit - a wall goes up, only observers that can see the spot are cast again
+    for (int row = 480; row < 544; row++) {
+        for (int col = 510; col < 514; col++) terrain.height[(size_t)row * (size_t)desc.columns + (size_t)col] = 1.0f;
+    }
+    hexFovInvalidate(fov, 510, 480, 4, 64);
+    double start = timerMilliseconds();
+    updateHexFov(fov, jobs);
+    const double editMs = timerMilliseconds() - start;
+    const size_t editCast = fov.stats.observers_cast;
+    hexFovInvalidate(reference, 510, 480, 4, 64);
+    for (size_t i = 0; i < observerCount; i++) reference.observers[i].dirty = true;
+    updateHexFov(reference, jobs);
+    same = sameVisibility(fov, reference);
+    printf("fov: wall raised, %zu observers cast again in %.3f ms, %s\n", editCast, editMs, same ? "matches a fresh cast" : "STALE");
+    ok = ok && same;
+
+    // Removal hands the last observer's window to the hole
+    hexFovRemoveObserver(fov, 0);
+    hexFovRemoveObserver(reference, 0);
+    updateHexFov(fov, jobs);
+    for (size_t i = 0; i < reference.observer_count; i++) reference.observers[i].dirty = true;
+    updateHexFov(reference, jobs);
+    same = sameVisibility(fov, reference);
+    printf("fov: observer removed, %s\n", same ? "matches a fresh cast" : "STALE");
+    ok = ok && same;
+
+    destroyHexFov(reference);
+    destroyHexFov(fov);
+    destroyHexTerrain(flat);
+    destroyHexTerrain(terrain);
+    destroyJobSystem(jobs);
+    destroyHexWorld(world);
+    return ok ? 0 : 1;
+}
+
+// Low camera flying over hilly terrain - frustum culling against frustum plus occlusion culling, and the
+// software rasterizer as the judge: the kept chunks have to produce the same depth buffer as all of them
+static int runOcclusion(int argc, char** argv) {
+    const int frames = argc > 0 ? atoi(argv[0]) : 240;
+    const int validateEvery = 30;
+    const double minCulled = 3.0;  // % of frustum-visible chunks, below it the pass costs more than it saves
+    HexWorldDesc desc = {};
+    desc.columns = 512;
+    desc.rows = 512;
+    desc.height = 10.0f;  // Tall hills, the kind of map where there is something to hide behind
+    desc.seed = 1234u;
+    bool ok = true;
+
+    HexWorld world = {};
+    HexTerrain terrain = {};
+    HexOccluders occ = {};
+    JobSystem jobs;
+    if (!createHexWorld(world, desc) || !allocateHexTerrain(terrain, world, hexTerrainDesc(desc.seed)) || !createJobSystem(jobs, hardwareThreads()) ||
+        !createHexOccluders(occ, world, OCCLUSION_WIDTH, OCCLUSION_HEIGHT)) {
+        fprintf(stderr, "occlusion: failed to create world\n");
+        return 1;
+    }
+    generateHexTerrain(terrain, world, jobs);
+
+    std::vector<HexInstanceRange> ranges(world.chunk_count), runs(world.chunk_count);
+    std::vector<HexInstance> instances(buildHexInstanceRanges(world, ranges.data()));
+    double start = timerMilliseconds();
+    for (size_t i = 0; i < world.chunk_count; i++) {
+        packHexChunkTerrainInstances(world, terrain, i, instances.data() + ranges[i].first);
+        updateHexChunkOccluder(occ, world, i, instances.data() + ranges[i].first);
+    }
+    printf("occlusion: %dx%d map, %zu chunks, instances and occluders in %.2f ms, buffer %dx%d [%s]\n",
+        desc.columns, desc.rows, world.chunk_count, timerMilliseconds() - start, OCCLUSION_WIDTH, OCCLUSION_HEIGHT, simdName());
+
+    SwRasterizer rasterizer = {};
+    std::vector<SwVertex> tileVertices;
+    std::vector<unsigned short> tileIndices;
+    if (!createSwRasterizer(rasterizer, DISPLAY_WIDTH, DISPLAY_HEIGHT, hardwareThreads()) || !createSwHexTile(tileVertices, tileIndices)) {
+        fprintf(stderr, "occlusion: failed to create rasterizer\n");
+        return 1;
+    }
+    rasterizer.depth_test = true;
+    const size_t pixels = (size_t)rasterizer.stride * rasterizer.height;
+    std::vector<float> fullDepth(pixels);
+    std::vector<uint32_t> frustumVisible;
+    auto render = [&](const uint32_t* visible, size_t count, const SwMVP& mvp) {
+        static const float clear[4] = { 0.0f, 0.0f, 0.4f, 1.0f };
+        swClear(rasterizer, clear);
+        runs.resize(world.chunk_count);
+        runs.resize(mergeVisibleInstanceRanges(visible, count, ranges.data(), runs.data()));
+        for (const HexInstanceRange& run : runs) {
+            SwDraw draw = {};
+            draw.vertices = tileVertices.data();
+            draw.indices = tileIndices.data();
+            draw.index_count = tileIndices.size();
+            draw.instances = instances.data() + run.first;
+            draw.instance_count = run.count;
+            swDraw(rasterizer, draw, mvp);
+        }
+    };
+
+    const float mapX = desc.radius * HEX_SQRT3 * (float)desc.columns;
+    const float mapZ = desc.radius * 1.5f * (float)desc.rows;
+    const Mat4 projection = mat4PerspectiveFovLH(MATH_PIDIV4, (float)DISPLAY_WIDTH / (float)DISPLAY_HEIGHT, 0.1f, 100.0f);
+    RollingStats frameStats = {};
+    size_t frustumTotal = 0, keptTotal = 0, validated = 0, wrongPixels = 0, coveredPixels = 0, hiddenTotal = 0, culledTotal = 0;
+    for (int f = 0; f < frames; f++) {
+        // Straight line across the map a couple of units over the ground, looking ahead and swaying left and right
+        const float t = (float)f / (float)(frames > 1 ? frames - 1 : 1);
+        const float eyeX = mapX * (0.3f + 0.4f * t), eyeZ = mapZ * (0.1f + 0.6f * t);
+        const int eyeRow = (int)(eyeZ / (desc.radius * 1.5f)), eyeColumn = (int)(eyeX / (desc.radius * HEX_SQRT3));
+        const float ground = desc.height * terrain.height[(size_t)eyeRow * desc.columns + eyeColumn];
+        const float yaw = 0.6f * sinf(6.0f * t);
+        const Float3 eye = { eyeX, ground + 1.5f, eyeZ };
+        const Float3 target = { eyeX + 30.0f * sinf(yaw), ground, eyeZ + 30.0f * cosf(yaw) };
+        const Mat4 view = mat4LookAtLH(eye, target, { 0.0f, 1.0f, 0.0f });
+        const Mat4 viewProjection = view * projection;
+
+        cullHexWorld(world, viewProjection.m);
+        frustumVisible.assign(world.visible, world.visible + world.visible_count);
+        const double occlusionStart = timerMilliseconds();
+        occludeHexWorld(occ, world, viewProjection.m);
+        rollingStatsAdd(frameStats, timerMilliseconds() - occlusionStart);
+        frustumTotal += frustumVisible.size();
+        keptTotal += world.visible_count;
+
+        if (f % validateEvery != validateEvery - 1 && f != frames - 1) continue;
+        SwMVP mvp;
+        memcpy(mvp.world, mat4Transpose(mat4Identity()).m, sizeof(mvp.world));
+        memcpy(mvp.view, mat4Transpose(view).m, sizeof(mvp.view));
+        memcpy(mvp.projection, mat4Transpose(projection).m, sizeof(mvp.projection));
+        render(frustumVisible.data(), frustumVisible.size(), mvp);
+        memcpy(fullDepth.data(), rasterizer.depth, pixels * sizeof(float));
+        render(world.visible, world.visible_count, mvp);
+        size_t wrong = 0, covered = 0;
+        for (size_t i = 0; i < pixels; i++) {
+            covered += fullDepth[i] < 1.0f ? 1 : 0;
+            wrong += fullDepth[i] != rasterizer.depth[i] ? 1 : 0;
+        }
+        // Chunks that really are hidden - alone they never reach the depth the whole set ends up with
+        size_t hidden = 0;
+        for (uint32_t chunk : frustumVisible) {
+            render(&chunk, 1, mvp);
+            bool drawn = false, seen = false;
+            for (size_t i = 0; i < pixels && !seen; i++) {
+                drawn = drawn || rasterizer.depth[i] < 1.0f;
+                seen = rasterizer.depth[i] < 1.0f && rasterizer.depth[i] <= fullDepth[i];
+            }
+            hidden += drawn && !seen ? 1 : 0;
+        }
+        printf("occlusion: frame %3d, %4zu chunks in the frustum, %4zu kept, %3zu really hidden, %zu of %zu covered pixels differ\n",
+            f, frustumVisible.size(), world.visible_count, hidden, wrong, covered);
+        validated++;
+        hiddenTotal += hidden;
+        culledTotal += frustumVisible.size() - world.visible_count;
+        wrongPixels += wrong;
+        coveredPixels += covered;
+    }
+
+    const OcclusionStats& stats = occ.buffer.stats;
+    const ProfileFrameStats cost = rollingStatsSummary(frameStats);
+    const double culled = frustumTotal > 0 ? 100.0 * (double)(frustumTotal - keptTotal) / (double)frustumTotal : 0.0;
+    printf("occlusion: %d frames, %.1f occluder boxes and %.1f box tests per frame, %.1f%% of frustum-visible chunks culled%s\n",
+        frames, (double)stats.occluders / frames, (double)stats.tested / frames, culled, culled >= minCulled ? "" : " - TOO FEW");
+    printf("occlusion: p50 %.3f ms p99 %.3f ms per frame (raster %.3f ms, HiZ + tests %.3f ms on average)\n",
+        cost.p50_ms, cost.p99_ms, stats.raster_ms / frames, stats.test_ms / frames);
+    // Pixel-center occluder depth may let an edge pixel of a hidden chunk through, never more than a sliver
+    const double wrongShare = coveredPixels > 0 ? (double)wrongPixels / (double)coveredPixels : 0.0;
+    const bool exact = wrongShare < 0.001;
+    printf("occlusion: %zu frames rendered both ways, %zu of %zu really hidden chunks culled, %.4f%% of covered pixels differ, %s\n",
+        validated, culledTotal, hiddenTotal, 100.0 * wrongShare, exact ? "ok" : "OCCLUDED VISIBLE CHUNKS");
+    ok = ok && exact && culled >= minCulled;
+
+    destroySwRasterizer(rasterizer);
+    destroyHexOccluders(occ);
+    destroyHexTerrain(terrain);
+    destroyJobSystem(jobs);
+    destroyHexWorld(world);
+    return ok ? 0 : 1;
+}
+
+// Pans the headless scene camera and re-culls, offset 0 is exactly the camera createHeadlessScene set up
+static void panHeadlessScene(HeadlessScene& scene, float offsetX, float offsetZ) {
+    const int columns = scene.world.desc.columns;
+    const int rows = scene.world.desc.rows;
+    float cx = HEX_DEFAULT_RADIUS * HEX_SQRT3 * (float)columns * 0.5f + offsetX;
+    float cz = HEX_DEFAULT_RADIUS * 1.5f * (float)rows * 0.5f + offsetZ;
+    const Mat4 view = mat4LookAtLH({ cx, 20.0f, cz - 20.0f }, { cx, 0.0f, cz }, { 0.0f, 1.0f, 0.0f });
+    const Mat4 projection = mat4PerspectiveFovLH(MATH_PIDIV4, (float)DISPLAY_WIDTH / (float)DISPLAY_HEIGHT, 0.1f, 100.0f);
+    const Mat4 viewProjection = view * projection;
+    memcpy(scene.mvp.view, mat4Transpose(view).m, sizeof(scene.mvp.view));
+    cullHexWorld(scene.world, viewProjection.m);
+    scene.runs.resize(scene.world.chunk_count);
+    scene.runs.resize(mergeVisibleInstanceRanges(scene.world.visible, scene.world.visible_count, scene.ranges.data(), scene.runs.data()));
+}
+
+// Records a panning camera over the raster scene into a capture, the way onRender records - buffers
+// written up front, one chunk re-uploaded every frame like streaming does
+static bool writeSyntheticCapture(HeadlessScene& scene, const char* path, int frames, RollingStats& recordStats) {
+    HexTileBuffers buffers = {};
+    buffers.vertex_size = (uint32_t)(scene.tile_vertices.size() * sizeof(SwVertex));
+    buffers.vertex_stride = sizeof(SwVertex);
+    buffers.index_size = (uint32_t)(scene.tile_indices.size() * sizeof(unsigned short));
+    buffers.index_count = (uint32_t)scene.tile_indices.size();
+    buffers.instance_size = (uint32_t)(scene.instances.size() * sizeof(HexInstance));
+
+    CommandCapture capture;
+    if (!beginCommandCapture(capture, path)) return false;
+    CommandStream stream;
+    stream.record_writes = true;
+    stream.bytes.reserve(buffers.vertex_size + buffers.index_size + buffers.instance_size + 64 * 1024); // Never grows under the timer
+    bool ok = true;
+    for (int f = 0; f < frames && ok; f++) {
+        resetCommandStream(stream);
+        if (f == 0) {
+            cmdWriteBuffer(stream, HEX_BUFFER_TILE_VERTICES, 0, scene.tile_vertices.data(), buffers.vertex_size);
+            cmdWriteBuffer(stream, HEX_BUFFER_TILE_INDICES, 0, scene.tile_indices.data(), buffers.index_size);
+            cmdWriteBuffer(stream, HEX_BUFFER_INSTANCES, 0, scene.instances.data(), buffers.instance_size);
+        } else {
+            const HexInstanceRange& chunk = scene.ranges[(size_t)f % scene.ranges.size()];
+            cmdWriteBuffer(stream, HEX_BUFFER_INSTANCES, (uint64_t)chunk.first * sizeof(HexInstance),
+                           scene.instances.data() + chunk.first, chunk.count * sizeof(HexInstance));
+        }
+        panHeadlessScene(scene, 30.0f * sinf((float)f * 0.05f), 10.0f * (1.0f - cosf((float)f * 0.03f)));
+        const uint64_t start = timerNanoseconds();
+        recordHexTilePass(stream, HEADLESS_CLEAR_COLOR, DISPLAY_WIDTH, DISPLAY_HEIGHT, buffers, &scene.mvp, sizeof(scene.mvp), scene.runs.data(), scene.runs.size());
+        rollingStatsAdd(recordStats, (float)((double)(timerNanoseconds() - start) / 1000000.0));
+        ok = captureCommandFrame(capture, stream);
+    }
+    panHeadlessScene(scene, 0.0f, 0.0f);
+    return endCommandCapture(capture) && ok;
+}
+
+static int runReplay(int argc, char** argv) {
+    int frames = argc > 0 ? atoi(argv[0]) : 120;
+    const char* path = argc > 1 ? argv[1] : nullptr;
+    const char* syntheticPath = "command_capture_test.bin";
+    const int swFrames = 8;  // The software path is slow, only the first few frames go through it
+
+    HeadlessScene scene = {};
+    if (path == nullptr) {
+        if (frames < 1 || !createHeadlessScene(scene, 1024, 1024)) {
+            fprintf(stderr, "replay: failed to create scene\n");
+            return 1;
+        }
+        RollingStats recordStats;
+        if (!writeSyntheticCapture(scene, syntheticPath, frames, recordStats)) {
+            fprintf(stderr, "replay: failed to write %s\n", syntheticPath);
+            remove(syntheticPath);
+            return 1;
+        }
+        const ProfileFrameStats record = rollingStatsSummary(recordStats);
+        printf("replay: recorded %d synthetic frames, %.1f draws per frame, record p50 %.4f ms p99 %.4f ms\n",
+            frames, (double)scene.runs.size(), record.p50_ms, record.p99_ms);
+    }
+
+    CommandReplay replay;
+    if (!openCommandReplay(replay, path != nullptr ? path : syntheticPath) || replay.frames.empty()) {
+        fprintf(stderr, "replay: %s is not a command capture\n", path != nullptr ? path : syntheticPath);
+        return 1;
+    }
+
+    // Null backend - decode and dispatch only, once to warm up, then timed per frame
+    bool ok = true;
+    NullCommandBackend null;
+    size_t commands = 0;
+    size_t bytes = 0;
+    for (size_t f = 0; f < replay.frames.size(); f++) {
+        size_t size = 0;
+        const uint8_t* stream = commandReplayFrame(replay, f, size);
+        ok = executeCommands(stream, size, null) && ok;
+    }
+    null.stats = {};
+    RollingStats replayStats;
+    double total = 0.0;
+    for (size_t f = 0; f < replay.frames.size(); f++) {
+        size_t size = 0, executed = 0;
+        const uint8_t* stream = commandReplayFrame(replay, f, size);
+        const uint64_t start = timerNanoseconds();
+        ok = executeCommands(stream, size, null, &executed) && ok;
+        const double ms = (double)(timerNanoseconds() - start) / 1000000.0;
+        rollingStatsAdd(replayStats, (float)ms);
+        total += ms;
+        commands += executed;
+        bytes += size;
+    }
+    const size_t replayed = replay.frames.size();
+    const ProfileFrameStats cost = rollingStatsSummary(replayStats);
+    printf("replay: %zu frames, %.1f commands %.1f draws %.0f instances per frame, %.1f KB per frame (%.1f MB of buffer writes)\n",
+        replayed, (double)commands / replayed, (double)null.stats.draws / replayed, (double)null.stats.instances / replayed,
+        bytes / 1024.0 / replayed, null.stats.write_bytes / (1024.0 * 1024.0));
+    printf("replay: null backend p50 %.4f ms p99 %.4f ms max %.4f ms per frame, %.1f M commands/s [%llx]\n",
+        cost.p50_ms, cost.p99_ms, cost.max_ms, total > 0.0 ? (double)commands / total / 1000.0 : 0.0, (unsigned long long)null.checksum);
+
+    // Software backend - the first frames drawn, the synthetic first frame has to be the raster scene exactly
+    SwRasterizer rasterizer = {};
+    SwRasterizer reference = {};
+    if (!createSwRasterizer(rasterizer, DISPLAY_WIDTH, DISPLAY_HEIGHT, hardwareThreads()) ||
+        !createSwRasterizer(reference, DISPLAY_WIDTH, DISPLAY_HEIGHT, hardwareThreads())) {
+        fprintf(stderr, "replay: failed to create rasterizer\n");
+        return 1;
+    }
+    SwCommandBackend software;
+    software.rasterizer = &rasterizer;
+    bool match = true;
+    const size_t drawn = replayed < (size_t)swFrames ? replayed : (size_t)swFrames;
+    double swMs = 0.0;
+    for (size_t f = 0; f < drawn; f++) {
+        size_t size = 0;
+        const uint8_t* stream = commandReplayFrame(replay, f, size);
+        const double start = timerMilliseconds();
+        ok = executeCommands(stream, size, software) && ok;
+        swMs += timerMilliseconds() - start;
+        if (f == 0 && path == nullptr) {
+            renderHeadlessScene(reference, scene);
+            match = memcmp(rasterizer.color, reference.color, (size_t)rasterizer.stride * rasterizer.height * sizeof(uint32_t)) == 0;
+        }
+    }
+    printf("replay: software backend %.2f ms per frame over %zu frames, %zu draws skipped%s\n",
+        swMs / drawn, drawn, software.skipped, path == nullptr ? (match ? ", first frame matches raster" : ", first frame MISMATCH") : "");
+    printf("replay: %s\n", ok ? "stream ok" : "MALFORMED STREAM");
+
+    destroySwRasterizer(reference);
+    destroySwRasterizer(rasterizer);
+    closeCommandReplay(replay);
+    if (path == nullptr) {
+        remove(syntheticPath);
+        destroyHexWorld(scene.world);
+    }
+    return ok && match && software.skipped == 0 ? 0 : 1;
+}
+
+// Headless stand-ins for the window's startup stages - map bake, terrain, tile mesh, shader cache and the
+// first frame are the real thing, the stages that need a GPU or a window sleep for about what they take
+typedef struct HeadlessStartup {
+    const char* cache_path;
+    const char* map_path;
+    HexWorldDesc world_desc;
+    bool fail_shaders;                  // Failure injection, dependents have to be skipped
+    JobSystem* jobs;
+    ShaderCache cache;
+    std::vector<uint8_t> pipeline;
+    HexMap map;
+    HeadlessScene scene;
+    SwRasterizer rasterizer;
+} HeadlessStartup;
+
+static bool headlessStartupSleep(void* user, StartupTask&) {
+    std::this_thread::sleep_for(std::chrono::milliseconds((int)(intptr_t)user));
+    return true;
+}
+
+static bool headlessStartupCache(void* user, StartupTask&) {
+    HeadlessStartup& st = *reinterpret_cast<HeadlessStartup*>(user);
+    loadShaderCache(st.cache, st.cache_path);
+    return true;
+}
+
+static bool headlessStartupShaders(void* user, StartupTask& task) {
+    HeadlessStartup& st = *reinterpret_cast<HeadlessStartup*>(user);
+    if (st.fail_shaders) {
+        snprintf(task.error, sizeof(task.error), "injected compile error");
+        return false;
+    }
+    return stubStartup(st.cache, 0, st.pipeline);
+}
+
+static bool headlessStartupPipeline(void* user, StartupTask&) {
+    HeadlessStartup& st = *reinterpret_cast<HeadlessStartup*>(user);
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));  // PSO from the cached blob
+    return saveShaderCache(st.cache);
+}
+
+// Bakes the map from noise terrain when there is none, like openHexWorld
+static bool headlessStartupMap(void* user, StartupTask& task) {
+    HeadlessStartup& st = *reinterpret_cast<HeadlessStartup*>(user);
+    if (openHexMap(st.map, st.map_path)) return true;
+    HexWorld world = {};
+    HexTerrain terrain = {};
+    bool baked = createHexWorld(world, st.world_desc) && allocateHexTerrain(terrain, world, hexTerrainDesc(st.world_desc.seed));
+    if (baked) {
+        generateHexTerrain(terrain, world, *st.jobs);
+        baked = writeHexMap(st.map_path, world, 0, [&](size_t chunk, HexInstance* out) {
+            packHexChunkTerrainInstances(world, terrain, chunk, out);
+        });
+    }
+    destroyHexTerrain(terrain);
+    destroyHexWorld(world);
+    if (!baked || !openHexMap(st.map, st.map_path)) {
+        snprintf(task.error, sizeof(task.error), "cannot open or bake %s", st.map_path);
+        return false;
+    }
+    return true;
+}
+
+// Raster scene camera over the baked map's tiles
+static bool headlessStartupWorld(void* user, StartupTask& task) {
+    HeadlessStartup& st = *reinterpret_cast<HeadlessStartup*>(user);
+    HeadlessScene& scene = st.scene;
+    if (!createHexWorld(scene.world, hexMapWorldDesc(*st.map.header)) || !createSwHexTile(scene.tile_vertices, scene.tile_indices)) {
+        snprintf(task.error, sizeof(task.error), "out of memory");
+        return false;
+    }
+    scene.ranges.resize(scene.world.chunk_count);
+    scene.instances.resize(buildHexInstanceRanges(scene.world, scene.ranges.data()));
+    for (size_t i = 0; i < scene.world.chunk_count; i++) copyHexMapChunkTiles(st.map, i, scene.instances.data() + scene.ranges[i].first);
+    memcpy(scene.mvp.world, mat4Transpose(mat4Identity()).m, sizeof(scene.mvp.world));
+    memcpy(scene.mvp.projection, mat4Transpose(mat4PerspectiveFovLH(MATH_PIDIV4, (float)DISPLAY_WIDTH / (float)DISPLAY_HEIGHT, 0.1f, 100.0f)).m,
+           sizeof(scene.mvp.projection));
+    panHeadlessScene(scene, 0.0f, 0.0f);
+    return true;
+}
+
+static bool headlessStartupRasterizer(void* user, StartupTask& task) {
+    HeadlessStartup& st = *reinterpret_cast<HeadlessStartup*>(user);
+    if (!createSwRasterizer(st.rasterizer, DISPLAY_WIDTH, DISPLAY_HEIGHT, hardwareThreads())) {
+        snprintf(task.error, sizeof(task.error), "out of memory");
+        return false;
+    }
+    return true;
+}
+
+static bool headlessStartupFrame(void* user, StartupTask&) {
+    HeadlessStartup& st = *reinterpret_cast<HeadlessStartup*>(user);
+    renderHeadlessScene(st.rasterizer, st.scene);
+    return true;
+}
+
+// Same stages and edges as WinMain
+static void buildHeadlessStartup(StartupGraph& graph, HeadlessStartup& st) {
+    const int window = addStartupTask(graph, "window", headlessStartupSleep, (void*)(intptr_t)15, {}, true);
+    const int device = addStartupTask(graph, "device", headlessStartupSleep, (void*)(intptr_t)60);
+    const int cacheLoad = addStartupTask(graph, "shader cache", headlessStartupCache, &st);
+    const int shaderCompile = addStartupTask(graph, "shaders", headlessStartupShaders, &st, { cacheLoad });
+    const int map = addStartupTask(graph, "map", headlessStartupMap, &st);
+    const int swapChain = addStartupTask(graph, "swap chain", headlessStartupSleep, (void*)(intptr_t)10, { window, device }, true);
+    const int pipeline = addStartupTask(graph, "pipeline", headlessStartupPipeline, &st, { device, shaderCompile });
+    const int uploads = addStartupTask(graph, "upload heaps", headlessStartupRasterizer, &st, { device });
+    const int world = addStartupTask(graph, "hex world", headlessStartupWorld, &st, { map, uploads });
+    addStartupTask(graph, "first frame", headlessStartupFrame, &st, { swapChain, pipeline, world }, true);
+}
+
+static void destroyHeadlessStartup(HeadlessStartup& st) {
+    destroySwRasterizer(st.rasterizer);
+    destroyHexWorld(st.scene.world);
+    closeHexMap(st.map);
+    remove(st.map_path);
+    remove(st.cache_path);
+}
+
+static int runStartup(int argc, char** argv) {
+    const int threads = argc > 0 ? atoi(argv[0]) : (hardwareThreads() > 4 ? hardwareThreads() : 4);
+    const int side = argc > 1 ? atoi(argv[1]) : 512;
+    bool ok = true;
+
+    // Cold start both ways - no map and no shader cache, everything gets built
+    double firstFrame[2] = {};
+    std::vector<uint32_t> frames[2];
+    for (int run = 0; run < 2; run++) {
+        JobSystem jobs;
+        if (!createJobSystem(jobs, run == 0 ? 1 : threads)) {
+            fprintf(stderr, "startup: failed to create job system\n");
+            return 1;
+        }
+        HeadlessStartup* st = new HeadlessStartup();
+        st->cache_path = "startup_cache_test.bin";
+        st->map_path = "startup_map_test.bin";
+        st->world_desc.columns = side;
+        st->world_desc.rows = side;
+        st->world_desc.height = 0.3f;
+        st->world_desc.seed = 4321u;
+        st->jobs = &jobs;
+        remove(st->map_path);
+        remove(st->cache_path);
+        StartupGraph* graph = new StartupGraph();
+        buildHeadlessStartup(*graph, *st);
+        const bool started = runStartupGraph(*graph, jobs);
+        firstFrame[run] = graph->tasks[graph->count - 1].end_ms;
+        if (started) frames[run].assign(st->rasterizer.color, st->rasterizer.color + (size_t)st->rasterizer.stride * st->rasterizer.height);
+        if (run == 1 || !started) {
+            char report[2048];
+            formatStartupReport(*graph, report, sizeof(report));
+            fputs(report, stdout);
+        }
+        ok = ok && started;
+        destroyHeadlessStartup(*st);
+        delete graph;
+        delete st;
+        destroyJobSystem(jobs);
+    }
+    const bool same = frames[0] == frames[1] && !frames[0].empty();
+    printf("startup: time to first frame %.2f ms in sequence, %.2f ms as a graph on %d threads, %.2fx, first frames %s\n",
+        firstFrame[0], firstFrame[1], threads, firstFrame[1] > 0.0 ? firstFrame[0] / firstFrame[1] : 0.0, same ? "match" : "DIFFER");
+    ok = ok && same;
+
+    // A failed stage takes down what depends on it and nothing else
+    {
+        JobSystem jobs;
+        if (!createJobSystem(jobs, threads)) return 1;
+        HeadlessStartup* st = new HeadlessStartup();
+        st->cache_path = "startup_cache_test.bin";
+        st->map_path = "startup_map_test.bin";
+        st->world_desc.columns = 64;
+        st->world_desc.rows = 64;
+        st->world_desc.height = 0.3f;
+        st->jobs = &jobs;
+        st->fail_shaders = true;
+        StartupGraph* graph = new StartupGraph();
+        buildHeadlessStartup(*graph, *st);
+        const bool started = runStartupGraph(*graph, jobs);
+        uint32_t status[STARTUP_MAX_TASKS];
+        for (int i = 0; i < graph->count; i++) status[i] = graph->tasks[i].status.load();
+        const StartupTask* failed = firstStartupFailure(*graph);
+        // shaders 3, pipeline 6, first frame 9 - the map, world and device still come up
+        const bool contained = !started && failed == &graph->tasks[3] && status[6] == STARTUP_SKIPPED && status[9] == STARTUP_SKIPPED &&
+                               status[4] == STARTUP_OK && status[8] == STARTUP_OK && status[1] == STARTUP_OK;
+        printf("startup: injected failure in %s (%s), pipeline %s (%s), %s\n",
+            failed != nullptr ? failed->name : "-", failed != nullptr ? failed->error : "-",
+            startupStatusName(status[6]), graph->tasks[6].error, contained ? "contained" : "NOT CONTAINED");
+        ok = ok && contained;
+        destroyHeadlessStartup(*st);
+        delete graph;
+        delete st;
+        destroyJobSystem(jobs);
+    }
+    return ok ? 0 : 1;
+}
+
+typedef struct CopyRun {
+    double ms;
+    CopyStats stats;
+    bool match;
+} CopyRun;
+
+// Streams frames of chunk-sized uploads, a few in-place edits and the odd big buffer through the uploader,
+// keeping a CPU copy of what every destination should end up holding
+static CopyRun simulateCopies(size_t ringSize, int frames, double gigabytesPerSecond, bool flushEveryUpload) {
+    constexpr uint32_t COPY_TEST_BUFFERS = 3;
+    constexpr size_t COPY_TEST_BUFFER_SIZE = 32 * 1024 * 1024;
+    constexpr size_t CHUNK_BYTES = 1024 * sizeof(HexInstance);
+    constexpr int CHUNKS_PER_FRAME = 48;
+    std::vector<uint8_t> staging(ringSize);
+    std::vector<uint8_t> expected[COPY_TEST_BUFFERS];
+    for (uint32_t i = 0; i < COPY_TEST_BUFFERS; i++) expected[i].assign(COPY_TEST_BUFFER_SIZE, 0);
+    std::vector<uint8_t> big(2 * 1024 * 1024);
+    NullCopyBackend backend(staging.data(), gigabytesPerSecond, 0.02);
+    for (uint32_t i = 0; i < COPY_TEST_BUFFERS; i++) backend.buffers[i].assign(COPY_TEST_BUFFER_SIZE, 0);
+    CopyUploader* uploader = new CopyUploader();
+    initCopyUploader(*uploader, &backend, staging.data(), ringSize);
+
+    uint32_t seed = 7;
+    const double start = timerMilliseconds();
+    for (int frame = 0; frame < frames; frame++) {
+        for (int c = 0; c < CHUNKS_PER_FRAME; c++) {
+            const uint32_t buffer = hexHash(seed++) % COPY_TEST_BUFFERS;
+            const size_t offset = (size_t)(hexHash(seed++) % (COPY_TEST_BUFFER_SIZE / CHUNK_BYTES)) * CHUNK_BYTES;
+            uint8_t* out = copyAllocate(*uploader, buffer, offset, CHUNK_BYTES);
+            uint8_t* reference = expected[buffer].data() + offset;
+            for (size_t b = 0; b < CHUNK_BYTES; b += 4) {
+                const uint32_t value = hexHash(seed + (uint32_t)b);
+                memcpy(reference + b, &value, 4);
+            }
+            seed++;
+            memcpy(out, reference, CHUNK_BYTES);
+            if (flushEveryUpload) copyFlush(*uploader);
+        }
+        // Edits land on tiles that were just written, often in the same batch
+        for (int e = 0; e < 8; e++) {
+            const uint32_t buffer = hexHash(seed++) % COPY_TEST_BUFFERS;
+            const size_t offset = (size_t)(hexHash(seed++) % (COPY_TEST_BUFFER_SIZE / sizeof(HexInstance))) * sizeof(HexInstance);
+            HexInstance tile = { (float)frame, (float)e, 1.0f, hexHash(seed++) };
+            memcpy(expected[buffer].data() + offset, &tile, sizeof(tile));
+            copyUpload(*uploader, buffer, offset, &tile, sizeof(tile), true);
+            if (flushEveryUpload) copyFlush(*uploader);
+        }
+        if (frame % 16 == 0) {
+            for (size_t b = 0; b < big.size(); b++) big[b] = (uint8_t)(hexHash(seed + (uint32_t)b) >> 8);
+            seed++;
+            const size_t offset = (size_t)(hexHash(seed++) % (COPY_TEST_BUFFER_SIZE / big.size())) * big.size();
+            memcpy(expected[0].data() + offset, big.data(), big.size());
+            copyUpload(*uploader, 0, offset, big.data(), big.size());
+        }
+        copyFlush(*uploader);  // Once per frame, like onRender
+    }
+    copyWaitIdle(*uploader);
+
+    CopyRun run = {};
+    run.ms = timerMilliseconds() - start;
+    run.stats = uploader->stats;
+    run.match = true;
+    for (uint32_t i = 0; i < COPY_TEST_BUFFERS; i++) run.match = run.match && backend.buffers[i] == expected[i];
+    delete uploader;
+    return run;
+}
+
+static int runCopyQueue(int argc, char** argv) {
+    const int frames = argc > 0 ? atoi(argv[0]) : 240;
+    const double gigabytesPerSecond = argc > 1 ? atof(argv[1]) : 12.0;
+    bool ok = true;
+
+    // Small rings have to wait on the queue, past a frame or two of uploads they never should
+    const size_t rings[] = { 256 * 1024, 1024 * 1024, 4 * 1024 * 1024, 16 * 1024 * 1024 };
+    uint64_t largestRingStalls = 0;
+    for (size_t ring : rings) {
+        const CopyRun run = simulateCopies(ring, frames, gigabytesPerSecond, false);
+        printf("copyqueue: %5zu KB ring, %.1f MB in %.1f ms - %.0f MB/s, %llu batches, %.1f regions/batch, %llu splits, %llu stalls %.2f ms, peak %zu KB, %s\n",
+            ring / 1024, run.stats.bytes / (1024.0 * 1024.0), run.ms, run.stats.bytes / (1024.0 * 1024.0) / (run.ms / 1000.0),
+            (unsigned long long)run.stats.batches, run.stats.batches > 0 ? (double)run.stats.regions / run.stats.batches : 0.0,
+            (unsigned long long)run.stats.splits, (unsigned long long)run.stats.stalls, run.stats.stall_ms, run.stats.peak_used / 1024,
+            run.match ? "buffers match" : "BUFFERS DIFFER");
+        ok = ok && run.match;
+        largestRingStalls = run.stats.stalls;
+    }
+
+    // Same uploads, one submit each - what batching saves in queue latency
+    const CopyRun batched = simulateCopies(rings[2], frames, gigabytesPerSecond, false);
+    const CopyRun single = simulateCopies(rings[2], frames, gigabytesPerSecond, true);
+    printf("copyqueue: batched %.1f ms in %llu submits, one submit per upload %.1f ms in %llu submits, %.2fx, %s\n",
+        batched.ms, (unsigned long long)batched.stats.batches, single.ms, (unsigned long long)single.stats.batches,
+        batched.ms > 0.0 ? single.ms / batched.ms : 0.0, single.match ? "buffers match" : "BUFFERS DIFFER");
+    ok = ok && single.match && batched.stats.batches < single.stats.batches;
+    if (largestRingStalls > 0) printf("copyqueue: %zu KB ring still stalled %llu times\n", rings[3] / 1024, (unsigned long long)largestRingStalls);
+    return ok ? 0 : 1;
+}
+
+// Row-major neighbour lookup, the way a plain std::vector map does it
+static inline size_t rowMajorNeighbour(int columns, int rows, int col, int row, int direction) {
+    const int nextCol = col + HEX_OFFSET_COLUMN_STEP[row & 1][direction];
+    const int nextRow = row + HEX_DIRECTIONS[direction].r;
+    if (nextCol < 0 || nextRow < 0 || nextCol >= columns || nextRow >= rows) return HEX_GRID_NONE;
+    return (size_t)nextRow * (size_t)columns + (size_t)nextCol;
+}
+
+static int runGrid(int argc, char** argv) {
+    const int columns = argc > 0 ? atoi(argv[0]) : 4096;
+    const int rows = argc > 1 ? atoi(argv[1]) : 4096;
+    const size_t queries = argc > 2 ? (size_t)atoll(argv[2]) : 4000000;
+    bool ok = true;
+
+    // Layout first, on a map whose edges cut through chunks
+    {
+        HexGridShape shape;
+        initHexGridShape(shape, 1000, 777);
+        size_t wrong = 0;
+        for (int row = 0; row < shape.rows; row++) {
+            for (int col = 0; col < shape.columns; col++) {
+                const size_t index = hexGridIndex(shape, col, row);
+                int backCol, backRow;
+                hexGridOffset(shape, index, backCol, backRow);
+                wrong += backCol != col || backRow != row || index != hexGridIndex(shape, hexOffsetToAxial(col, row));
+                size_t gathered[6];
+                hexGridNeighbours(shape, index, col, row, gathered);
+                for (int d = 0; d < 6; d++) {
+                    const size_t next = hexGridNeighbour(shape, col, row, d);
+                    wrong += gathered[d] != next;
+                    const size_t expected = rowMajorNeighbour(shape.columns, shape.rows, col, row, d);
+                    if (expected == HEX_GRID_NONE) {
+                        wrong += next != HEX_GRID_NONE;
+                    } else {
+                        wrong += next != hexGridIndex(shape, (int)(expected % (size_t)shape.columns), (int)(expected / (size_t)shape.columns));
+                    }
+                }
+            }
+        }
+        printf("grid: 1000x777 layout - index, axial and neighbour lookups %s\n", wrong == 0 ? "match row-major" : "WRONG");
+        ok = ok && wrong == 0;
+    }
+
+    HexGridShape shape;
+    HexGrid<uint32_t> grid;
+    if (!initHexGridShape(shape, columns, rows) || !createHexGrid(grid, shape)) {
+        fprintf(stderr, "grid: failed to allocate %dx%d\n", columns, rows);
+        return 1;
+    }
+    const size_t tiles = (size_t)columns * (size_t)rows;
+    std::vector<uint32_t> naive(tiles);
+    for (size_t i = 0; i < tiles; i++) naive[i] = hexHash((uint32_t)i) & 0xffff;
+    copyHexGridFromRowMajor(grid, naive.data());
+    std::vector<uint32_t> back(tiles);
+    copyHexGridToRowMajor(grid, back.data());
+    const bool roundTrip = back == naive;
+    printf("grid: %dx%d uint32 tiles, %.1f MB row-major, %.1f MB in %d tile chunks, row-major round trip %s\n", columns, rows,
+        tiles * 4.0 / (1024.0 * 1024.0), shape.tile_count * 4.0 / (1024.0 * 1024.0), shape.chunk_size, roundTrip ? "ok" : "WRONG");
+    ok = ok && roundTrip;
+
+    // Full sweep - both are one pass over memory, the grid just walks it in chunk rows
+    double start = timerMilliseconds();
+    uint64_t naiveSum = 0;
+    for (int row = 0; row < rows; row++) {
+        const uint32_t* line = naive.data() + (size_t)row * (size_t)columns;
+        for (int col = 0; col < columns; col++) naiveSum += line[col];
+    }
+    const double naiveSweep = timerMilliseconds() - start;
+    start = timerMilliseconds();
+    uint64_t gridSum = 0;
+    forEachHexGridRow(grid, [&](uint32_t* line, int, int, int count) {
+        for (int i = 0; i < count; i++) gridSum += line[i];
+    });
+    const double gridSweep = timerMilliseconds() - start;
+    printf("grid: full sweep - row-major %.2f ms (%.0f Mtiles/s), grid %.2f ms (%.0f Mtiles/s), %s\n",
+        naiveSweep, tiles / naiveSweep / 1000.0, gridSweep, tiles / gridSweep / 1000.0, naiveSum == gridSum ? "same sum" : "DIFFERENT SUM");
+    ok = ok && naiveSum == gridSum;
+
+    // Six neighbours of tiles in no particular order - what picking, pathfinding and FOV queries look like.
+    // With 4 byte tiles chunk rows are 128 bytes apart, so the rows above and below are other cache lines
+    // either way; with byte tiles (costs, biomes) all six sit in one or two lines of the grid.
+    std::vector<uint32_t> queryCol(queries);
+    std::vector<uint32_t> queryRow(queries);
+    uint32_t seed = 5;
+    for (size_t i = 0; i < queries; i++) {
+        queryCol[i] = hexHash(seed++) % (uint32_t)columns;
+        queryRow[i] = hexHash(seed++) % (uint32_t)rows;
+    }
+    auto naiveQueries = [&](const auto* tilesData) {
+        uint64_t sum = 0;
+        for (size_t i = 0; i < queries; i++) {
+            for (int d = 0; d < 6; d++) {
+                const size_t next = rowMajorNeighbour(columns, rows, (int)queryCol[i], (int)queryRow[i], d);
+                if (next != HEX_GRID_NONE) sum += tilesData[next];
+            }
+        }
+        return sum;
+    };
+    auto gridQueries = [&](const auto* tilesData) {
+        uint64_t sum = 0;
+        for (size_t i = 0; i < queries; i++) {
+            size_t next[6];
+            hexGridNeighbours(shape, hexGridIndex(shape, (int)queryCol[i], (int)queryRow[i]), (int)queryCol[i], (int)queryRow[i], next);
+            for (int d = 0; d < 6; d++) {
+                if (next[d] != HEX_GRID_NONE) sum += tilesData[next[d]];
+            }
+        }
+        return sum;
+    };
+    std::vector<uint8_t> naiveBytes(tiles);
+    for (size_t i = 0; i < tiles; i++) naiveBytes[i] = (uint8_t)naive[i];
+    HexGrid<uint8_t> gridBytes;
+    createHexGrid(gridBytes, shape);
+    copyHexGridFromRowMajor(gridBytes, naiveBytes.data());
+    for (int width = 4; width >= 1; width -= 3) {
+        start = timerMilliseconds();
+        naiveSum = width == 4 ? naiveQueries(naive.data()) : naiveQueries(naiveBytes.data());
+        const double naiveRandom = timerMilliseconds() - start;
+        start = timerMilliseconds();
+        gridSum = width == 4 ? gridQueries(grid.tiles) : gridQueries(gridBytes.tiles);
+        const double gridRandom = timerMilliseconds() - start;
+        printf("grid: %zu random neighbour queries, %d byte tiles - row-major %.2f ms (%.1f Mq/s), grid %.2f ms (%.1f Mq/s), %.2fx, %s\n",
+            queries, width, naiveRandom, queries / naiveRandom / 1000.0, gridRandom, queries / gridRandom / 1000.0,
+            naiveRandom / gridRandom, naiveSum == gridSum ? "same sum" : "DIFFERENT SUM");
+        ok = ok && naiveSum == gridSum;
+    }
+    destroyHexGrid(gridBytes);
+
+    // Breadth-first flood from the middle, the access pattern of a Dijkstra or flow field build
+    std::vector<uint8_t> seen(tiles, 0);
+    std::vector<uint32_t> queue(tiles);
+    start = timerMilliseconds();
+    naiveSum = 0;
+    size_t head = 0, tail = 0;
+    queue[tail++] = (uint32_t)((size_t)(rows / 2) * (size_t)columns + (size_t)(columns / 2));
+    seen[queue[0]] = 1;
+    while (head < tail) {
+        const uint32_t node = queue[head++];
+        naiveSum += naive[node];
+        const int col = (int)(node % (uint32_t)columns);
+        const int row = (int)(node / (uint32_t)columns);
+        for (int d = 0; d < 6; d++) {
+            const size_t next = rowMajorNeighbour(columns, rows, col, row, d);
+            if (next != HEX_GRID_NONE && !seen[next]) {
+                seen[next] = 1;
+                queue[tail++] = (uint32_t)next;
+            }
+        }
+    }
+    const double naiveFlood = timerMilliseconds() - start;
+    HexGrid<uint8_t> gridSeen;
+    createHexGrid(gridSeen, shape);
+    start = timerMilliseconds();
+    gridSum = 0;
+    head = tail = 0;
+    queue[tail++] = (uint32_t)hexGridIndex(shape, columns / 2, rows / 2);
+    gridSeen.tiles[queue[0]] = 1;
+    while (head < tail) {
+        const uint32_t node = queue[head++];
+        gridSum += grid.tiles[node];
+        int col, row;
+        hexGridOffset(shape, node, col, row);
+        size_t next[6];
+        hexGridNeighbours(shape, node, col, row, next);
+        for (int d = 0; d < 6; d++) {
+            if (next[d] != HEX_GRID_NONE && !gridSeen.tiles[next[d]]) {
+                gridSeen.tiles[next[d]] = 1;
+                queue[tail++] = (uint32_t)next[d];
+            }
+        }
+    }
+    const double gridFlood = timerMilliseconds() - start;
+    printf("grid: flood fill of %zu tiles - row-major %.2f ms, grid %.2f ms, %.2fx, %s\n",
+        tail, naiveFlood, gridFlood, naiveFlood / gridFlood, naiveSum == gridSum && tail == tiles ? "same sum" : "DIFFERENT SUM");
+    ok = ok && naiveSum == gridSum && tail == tiles;
+    destroyHexGrid(gridSeen);
+
+    // 2 bit column against a byte per tile
+    HexGridBits column;
+    createHexGridBits(column, shape, 2);
+    size_t wrong = 0;
+    for (int row = 0; row < rows; row++) {
+        for (int col = 0; col < columns; col++) hexGridBitsSet(column, hexGridIndex(shape, col, row), naive[(size_t)row * (size_t)columns + (size_t)col] & 3);
+    }
+    for (int row = 0; row < rows; row++) {
+        for (int col = 0; col < columns; col++) {
+            wrong += hexGridBitsGet(column, hexGridIndex(shape, col, row)) != (naive[(size_t)row * (size_t)columns + (size_t)col] & 3);
+        }
+    }
+    printf("grid: 2 bit column %.1f MB against %.1f MB of bytes, %s\n", (shape.tile_count * 2 / 8) / (1024.0 * 1024.0),
+        tiles / (1024.0 * 1024.0), wrong == 0 ? "values match" : "WRONG VALUES");
+    ok = ok && wrong == 0;
+    destroyHexGridBits(column);
+
+    // Fewer bits than a byte still get a whole word
+    HexGridShape tiny;
+    initHexGridShape(tiny, 1, 1, 2);
+    const bool tinyOk = createHexGridBits(column, tiny, 1) && column.word_count == 1;
+    if (tinyOk) hexGridBitsSet(column, 0, 1);
+    printf("grid: 1 bit column on a 2x2 chunk, %zu word%s\n", column.word_count, tinyOk && hexGridBitsGet(column, 0) == 1 ? ", value round trip" : " - WRONG");
+    ok = ok && tinyOk && hexGridBitsGet(column, 0) == 1;
+    destroyHexGridBits(column);
+    destroyHexGrid(grid);
+    return ok ? 0 : 1;
+}
+
+typedef struct AnimationBase {
+    const HexInstance* tiles;
+    const HexInstanceRange* ranges;
+} AnimationBase;
+
+static const HexInstance* animationBaseTiles(void* user, size_t chunk) {
+    const AnimationBase& base = *reinterpret_cast<AnimationBase*>(user);
+    return base.tiles + base.ranges[chunk].first;
+}
+
+static int runAnimate(int argc, char** argv) {
+    HexWorldDesc desc = {};
+    desc.columns = argc > 0 ? atoi(argv[0]) : 640;
+    desc.rows = argc > 1 ? atoi(argv[1]) : 640;
+    const int frames = argc > 2 ? atoi(argv[2]) : 120;
+    desc.height = 1.0f;
+
+    HexWorld world = {};
+    HexAnimator animator;
+    JobSystem jobs;
+    if (!createHexWorld(world, desc) || !createHexAnimator(animator, world) || !createJobSystem(jobs, hardwareThreads())) {
+        fprintf(stderr, "animate: failed to create world\n");
+        return 1;
+    }
+    std::vector<HexInstanceRange> ranges(world.chunk_count);
+    const size_t tiles = buildHexInstanceRanges(world, ranges.data());
+    HexInstance* base = (HexInstance*)alignedAlloc(tiles * sizeof(HexInstance));
+    HexInstance* out = (HexInstance*)alignedAlloc(tiles * sizeof(HexInstance));        // Stands in for the mapped frame range
+    HexInstance* reference = (HexInstance*)alignedAlloc(tiles * sizeof(HexInstance));
+    HexInstance* scratch = (HexInstance*)alignedAlloc(tiles * sizeof(HexInstance));
+    for (size_t i = 0; i < world.chunk_count; i++) packHexChunkInstances(world, i, base + ranges[i].first);
+    // Touched once up front, so no timing below pays for first-touch page faults
+    memset(out, 0, tiles * sizeof(HexInstance));
+    memset(reference, 0, tiles * sizeof(HexInstance));
+    memset(scratch, 0, tiles * sizeof(HexInstance));
+    AnimationBase source = { base, ranges.data() };
+    std::vector<uint32_t> all(world.chunk_count), animated(world.chunk_count), idle(world.chunk_count);
+    for (size_t i = 0; i < world.chunk_count; i++) all[i] = (uint32_t)i;
+    bool ok = true;
+
+    // Nothing going on - every chunk is skipped
+    beginHexAnimation(animator, 0.0f);
+    size_t idleCount = 0;
+    double start = timerMilliseconds();
+    size_t active = selectAnimatedChunks(animator, all.data(), all.size(), animated.data(), idle.data(), idleCount);
+    const double selectMs = timerMilliseconds() - start;
+    printf("animate: %dx%d map, %zu tiles in %zu chunks [%s, %d threads]\n", desc.columns, desc.rows, tiles, world.chunk_count, simdName(), hardwareThreads());
+    printf("animate: idle map - %zu of %zu chunks animated, selecting took %.4f ms\n", active, world.chunk_count, selectMs);
+    ok = ok && active == 0;
+
+    // A selected block and four ripples that cross the whole map in 4 seconds
+    const float width = desc.radius * HEX_SQRT3 * (float)desc.columns;
+    const float depth = desc.radius * 1.5f * (float)desc.rows;
+    for (int row = desc.rows / 2 - 32; row < desc.rows / 2 + 32; row++) {
+        for (int col = desc.columns / 2 - 32; col < desc.columns / 2 + 32; col++) hexSetHighlight(animator, col, row, true);
+    }
+    const float centers[4][2] = { { 0.25f, 0.25f }, { 0.75f, 0.3f }, { 0.4f, 0.8f }, { 0.5f, 0.5f } };
+    for (int i = 0; i < 4; i++) {
+        HexRipple ripple;
+        ripple.x = centers[i][0] * width;
+        ripple.z = centers[i][1] * depth;
+        ripple.start = 0.25f * (float)i;
+        ripple.amplitude = 0.6f;
+        ripple.speed = (width > depth ? width : depth) / 4.0f;
+        ripple.width = 2.0f * desc.radius;
+        ripple.duration = 4.0f;
+        hexAddRipple(animator, ripple);
+    }
+
+    // Every chunk, four live ripples - the worst a frame can get. SIMD against the scalar reference, then
+    // straight into the output against animating into scratch and copying it over.
+    beginHexAnimation(animator, 1.5f);
+    const double perTiles = 100000.0 / (double)tiles;
+    const int repeats = 10;
+    start = timerMilliseconds();
+    for (int r = 0; r < repeats; r++) {
+        for (size_t i = 0; i < world.chunk_count; i++) animateHexChunk(animator, i, base + ranges[i].first, out + ranges[i].first);
+    }
+    const double simdMs = (timerMilliseconds() - start) / repeats;
+    start = timerMilliseconds();
+    for (int r = 0; r < repeats; r++) {
+        for (size_t i = 0; i < world.chunk_count; i++) animateHexChunkScalar(animator, i, base + ranges[i].first, reference + ranges[i].first);
+    }
+    const double scalarMs = (timerMilliseconds() - start) / repeats;
+    const bool match = memcmp(out, reference, tiles * sizeof(HexInstance)) == 0;
+    start = timerMilliseconds();
+    for (int r = 0; r < repeats; r++) {
+        for (size_t i = 0; i < world.chunk_count; i++) animateHexChunk(animator, i, base + ranges[i].first, scratch + ranges[i].first);
+        memcpy(out, scratch, tiles * sizeof(HexInstance));
+    }
+    const double copiedMs = (timerMilliseconds() - start) / repeats;
+    start = timerMilliseconds();
+    for (int r = 0; r < repeats; r++) animateHexChunks(animator, all.data(), all.size(), animationBaseTiles, &source, out, jobs);
+    const double jobsMs = (timerMilliseconds() - start) / repeats;
+    printf("animate: %d ripples on every tile - %.3f ms per 100k tiles (scalar %.3f, %.2fx), %s\n",
+        animator.live, simdMs * perTiles, scalarMs * perTiles, scalarMs / simdMs, match ? "matches scalar" : "MISMATCH");
+    printf("animate: direct %.3f ms against scratch + memcpy %.3f ms per 100k tiles, %.3f ms on %d threads\n",
+        simdMs * perTiles, copiedMs * perTiles, jobsMs * perTiles, hardwareThreads());
+    ok = ok && match;
+
+    // Frames over the ripples' lifetime and past it - only chunks something happens in get animated, and
+    // the ones left out would not have changed
+    animator.stats = {};
+    size_t wrongSkips = 0;
+    size_t lastActive = 0;
+    size_t lifted = 0, outOfBox = 0;
+    double frameMs = 0.0, growMs = 0.0;
+    for (int f = 0; f < frames; f++) {
+        const float time = 6.0f * (float)f / (float)frames;
+        start = timerMilliseconds();
+        beginHexAnimation(animator, time);
+        const double grown = timerMilliseconds();
+        growHexAnimatedBounds(animator, world);
+        growMs += timerMilliseconds() - grown;
+        active = selectAnimatedChunks(animator, all.data(), all.size(), animated.data(), idle.data(), idleCount);
+        animateHexChunks(animator, animated.data(), active, animationBaseTiles, &source, out, jobs);
+        frameMs += timerMilliseconds() - start;
+        lastActive = active;
+        // Culling sees the grown boxes - no animated tile may stick out of its chunk's
+        for (size_t i = 0; i < active; i++) {
+            const HexChunk& c = world.chunks[animated[i]];
+            const HexInstance* tilesOut = out + animator.offsets[i];
+            for (size_t t = 0; t < (size_t)c.columns * (size_t)c.rows; t++) {
+                lifted += tilesOut[t].height > desc.height;
+                outOfBox += tilesOut[t].height > world.bounds.max_y[animated[i]] * (1.0f + 1e-5f);
+            }
+        }
+        if (f % 8 == 0) {
+            for (size_t i = 0; i < idleCount; i++) {
+                const size_t chunk = idle[i];
+                const size_t n = animateHexChunkScalar(animator, chunk, base + ranges[chunk].first, reference);
+                wrongSkips += memcmp(reference, base + ranges[chunk].first, n * sizeof(HexInstance)) != 0;
+            }
+        }
+    }
+    printf("animate: %d frames over 6 s - %.1f%% of chunk visits animated, %.3f ms per frame, %.3f ms per 100k animated tiles, %zu chunks still animated after the ripples\n",
+        frames, 100.0 * (double)animator.stats.chunks_animated / (double)animator.stats.chunks_tested, frameMs / frames,
+        animator.stats.tiles > 0 ? animator.stats.time_ms * 100000.0 / (double)animator.stats.tiles : 0.0, lastActive);
+    printf("animate: skipped chunks %s\n", wrongSkips == 0 ? "would not have changed" : "WOULD HAVE CHANGED");
+    bool boxesBack = animator.grown_count == 0;
+    for (size_t i = 0; i < world.chunk_count; i++) boxesBack = boxesBack && world.bounds.max_y[i] == desc.height;
+    printf("animate: %zu tile draws lifted past the map height, %zu outside their grown chunk box, boxes grown in %.4f ms per frame, %s after the ripples\n",
+        lifted, outOfBox, growMs / frames, boxesBack ? "back to the map height" : "STILL GROWN");
+    ok = ok && wrongSkips == 0 && animator.ripple_count == 0 && lastActive > 0 && lifted > 0 && outOfBox == 0 && boxesBack;
+    hexClearHighlights(animator);
+    beginHexAnimation(animator, 6.0f);
+    active = selectAnimatedChunks(animator, all.data(), all.size(), animated.data(), idle.data(), idleCount);
+    printf("animate: highlights cleared - %zu chunks animated\n", active);
+    ok = ok && active == 0;
+
+    // Every chunk animated into a frame slot too small for all of them, the way the window does it - the tiles
+    // that fit, then a frame's worth of constants. Without the reserve the tiles leave no room for those.
+    // The slot holds half the map's tiles (at least one chunk), so on any map of two or more chunks some never fit
+    const size_t slotTiles = std::max(tiles / 2, hexAnimatedTileCount(animator, all.data(), 1));
+    const size_t slot = slotTiles * sizeof(HexInstance) + UPLOAD_FRAME_CONSTANTS;
+    size_t fitted[2] = {}, constants[2] = {};
+    bool fitRight = true;
+    for (int reserved = 0; reserved < 2; reserved++) {
+        UploadAllocator upload;
+        initUploadAllocator(upload, 1024 * 1024, slot, 1);
+        const size_t reserve = reserved ? UPLOAD_FRAME_CONSTANTS : 0;
+        idleCount = 0;
+        const size_t room = uploadFrameRoom(upload, 0, sizeof(HexInstance), reserve);
+        fitted[reserved] = fitAnimatedChunks(animator, all.data(), all.size(), room / sizeof(HexInstance), idle.data(), idleCount);
+        const size_t fittedTiles = hexAnimatedTileCount(animator, all.data(), fitted[reserved]);
+        // As many chunks as fit, not one fewer
+        fitRight = fitRight && fitted[reserved] > 0 && fittedTiles <= room / sizeof(HexInstance) &&
+                   (fitted[reserved] == all.size() || hexAnimatedTileCount(animator, all.data(), fitted[reserved] + 1) > room / sizeof(HexInstance));
+        if (uploadAllocateFrame(upload, 0, fittedTiles * sizeof(HexInstance), sizeof(HexInstance), reserve) == UPLOAD_INVALID_OFFSET) continue;
+        animateHexChunks(animator, all.data(), fitted[reserved], animationBaseTiles, &source, out, jobs);
+        while (constants[reserved] < UPLOAD_FRAME_CONSTANTS / CBV_ALIGNMENT &&
+               uploadAllocateFrame(upload, 0, 3 * sizeof(Mat4), CBV_ALIGNMENT) != UPLOAD_INVALID_OFFSET) constants[reserved]++;
+        destroyUploadAllocator(upload);
+    }
+    const bool constantsFit = constants[1] == UPLOAD_FRAME_CONSTANTS / CBV_ALIGNMENT && fitRight;
+    printf("animate: %.2f MB frame slot - %zu of %zu chunks fit, then %zu of %zu constant buffers%s (%zu without the reserve)\n",
+        slot / (1024.0 * 1024.0), fitted[1], all.size(), constants[1], UPLOAD_FRAME_CONSTANTS / CBV_ALIGNMENT,
+        constantsFit ? "" : " - OUT OF MEMORY", constants[0]);
+    ok = ok && constantsFit;
+
+    alignedFree(scratch);
+    alignedFree(reference);
+    alignedFree(out);
+    alignedFree(base);
+    destroyJobSystem(jobs);
+    destroyHexAnimator(animator);
+    destroyHexWorld(world);
+    return ok ? 0 : 1;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        printf("usage: %s <command> [args]\n", argv[0]);
+        printf("  mesh [columns rows height]    generate hex plane and validate it\n");
+        printf("  cull [max side]               chunk frustum culling stats for growing maps\n");
+        printf("  instances [columns rows]      pack per-instance tile stream, report sizes and draw count\n");
+        printf("  pacing [cpu_ms gpu_ms frames] frames in flight against a simulated GPU\n");
+        printf("  raster [frames threads out]   software rasterizer fps at DISPLAY size, out is .ppm or .png\n");
+        printf("  alloc [operations]            upload allocator stress, overlap check and stats\n");
+        printf("  vertex [columns rows]         packed vertex formats - bytes per frame, encode time, error\n");
+        printf("  pick [queries]                ray picking - correctness, single query latency, batch throughput\n");
+        printf("  shadercache [path]            shader/pipeline cache with a stub compiler - hits, invalidation, timing\n");
+        printf("  jobs [max threads]            job system scaling from 1 to max threads on mesh, cull and pack work\n");
+        printf("  profile [frames trace]        profiled frame loop - p50/p99 frame time, scope cost, Chrome trace\n");
+        printf("  terrain [columns rows seed]   noise terrain - tiles/s per core, SIMD vs scalar, same map on any thread count\n");
+        printf("  map [gigabytes path frames]   mapped map file round trip, then stream a synthetic map - load latency, RSS\n");
+        printf("  edit [frames edits]           tile edits with dirty range uploads against full rebuilds - edits/s, bytes per edit\n");
+        printf("  optimize [max side]           vertex cache and fetch order for chunk meshes - ACMR/ATVR, build time, index width\n");
+        printf("  math [matrices points]        portable SIMD math - bit exact against scalar, camera matrices, batch throughput\n");
+        printf("  entities [count frames]       SoA entity store - handle churn, dirty world matrix updates per frame against the budget\n");
+        printf("  path [columns rows queries]   A*, portal graph A* and flow fields on a terrain map - queries/s, flow field build time\n");
+        printf("  fov [observers r ticks side]  shadowcast field of view into per-chunk masks - from scratch, incremental ticks, edits\n");
+        printf("  occlusion [frames]            CPU occlusion buffer on a low camera - chunks culled past the frustum, cost per frame\n");
+        printf("  replay [frames capture]       render command capture through the null and software backends - submission cost per frame\n");
+        printf("  startup [threads side]        startup stages as a dependency graph - time to first frame against running them in sequence\n");
+        printf("  copyqueue [frames gbps]       staging ring and batched copies against a simulated copy queue - MB/s, stalls, contents\n");
+        printf("  grid [columns rows queries]   chunk-ordered HexGrid against a row-major vector - sweeps, neighbour queries, flood fill\n");
+        printf("  animate [columns rows frames] ripple and highlight animation into instance memory - ms per 100k tiles, idle chunks skipped\n");
+        return 0;
+    }
+
+    const char* command = argv[1];
+    if (strcmp(command, "mesh") == 0) return runMesh(argc - 2, argv + 2);
+    if (strcmp(command, "cull") == 0) return runCull(argc - 2, argv + 2);
+    if (strcmp(command, "instances") == 0) return runInstances(argc - 2, argv + 2);
+    if (strcmp(command, "pacing") == 0) return runPacing(argc - 2, argv + 2);
+    if (strcmp(command, "raster") == 0) return runRaster(argc - 2, argv + 2);
+    if (strcmp(command, "alloc") == 0) return runAlloc(argc - 2, argv + 2);
+    if (strcmp(command, "vertex") == 0) return runVertex(argc - 2, argv + 2);
+    if (strcmp(command, "pick") == 0) return runPick(argc - 2, argv + 2);
+    if (strcmp(command, "shadercache") == 0) return runShaderCache(argc - 2, argv + 2);
+    if (strcmp(command, "jobs") == 0) return runJobs(argc - 2, argv + 2);
+    if (strcmp(command, "profile") == 0) return runProfile(argc - 2, argv + 2);
+    if (strcmp(command, "terrain") == 0) return runTerrain(argc - 2, argv + 2);
+    if (strcmp(command, "map") == 0) return runMap(argc - 2, argv + 2);
+    if (strcmp(command, "edit") == 0) return runEdit(argc - 2, argv + 2);
+    if (strcmp(command, "optimize") == 0) return runOptimize(argc - 2, argv + 2);
+    if (strcmp(command, "math") == 0) return runMath(argc - 2, argv + 2);
+    if (strcmp(command, "entities") == 0) return runEntities(argc - 2, argv + 2);
+    if (strcmp(command, "path") == 0) return runPath(argc - 2, argv + 2);
+    if (strcmp(command, "fov") == 0) return runFov(argc - 2, argv + 2);
+    if (strcmp(command, "occlusion") == 0) return runOcclusion(argc - 2, argv + 2);
+    if (strcmp(command, "replay") == 0) return runReplay(argc - 2, argv + 2);
+    if (strcmp(command, "startup") == 0) return runStartup(argc - 2, argv + 2);
+    if (strcmp(command, "copyqueue") == 0) return runCopyQueue(argc - 2, argv + 2);
+    if (strcmp(command, "grid") == 0) return runGrid(argc - 2, argv + 2);
+    if (strcmp(command, "animate") == 0) return runAnimate(argc - 2, argv + 2);
+
+    fprintf(stderr, "unknown command: %s\n", command);
+    return 1;
+}
@@ -0,0 +1,324 @@
+#ifndef _H_HEX_ANIMATION
+#define _H_HEX_ANIMATION
+
+// Per-tile animation on top of the static instance stream - ripples raise tiles in an expanding ring, highlighted
+// tiles pulse. Only visible chunks that something is happening in get evaluated, straight from their static
+// tiles into this frame's instance memory (mapped upload memory in the window, written once and never read),
+// and drawn from there instead of the static buffer. Every other chunk costs one bounds test a frame.
+// The kernel works on 4 tiles at a time - same transpose as packHexChunkInstances - and matches the scalar one
+// bit for bit. Ripples lift tiles past HexWorldDesc::height, so growHexAnimatedBounds raises the cull boxes of the
+// chunks they cross before culling - frustum and occlusion tests never see a box shorter than its tiles.
+#include "../core/simd.cpp"
+#include "../core/jobs.cpp"
+#include "../core/timer.cpp"
+#include "hex_world.cpp"
+#include "hex_instances.cpp"
+#include "hex_grid.cpp"
+
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+constexpr int HEX_MAX_RIPPLES = 16;
+constexpr float HEX_HIGHLIGHT_HZ = 1.5f;
+constexpr uint32_t HEX_PALETTE_MASK = ~HEX_GLOW_MASK;
+
+typedef struct HexRipple {
+  float x;              // Center on the XZ plane, same space as HexInstance offsets
+  float z;
+  float start;          // Seconds, same clock as beginHexAnimation
+  float amplitude;      // Peak height change as a fraction of the tile height
+  float speed;          // World units a second the ring moves out
+  float width;          // Half width of the ring
+  float duration;       // Fades out linearly over this long, then the ripple is gone
+} HexRipple;
+
+typedef struct HexAnimationStats {
+  size_t chunks_tested = 0;
+  size_t chunks_animated = 0;
+  size_t tiles = 0;
+  double time_ms = 0.0;
+} HexAnimationStats;
+
+// Static tiles of a chunk in chunk instance order, where the animation starts from every frame
+typedef const HexInstance* (*HexAnimationSource)(void* user, size_t chunk);
+
+typedef struct HexAnimator {
+  const HexWorld* world = nullptr;
+  HexGridShape shape;
+  HexGridBits highlight;                  // One bit per tile, chunk order
+  uint32_t* chunk_highlights = nullptr;   // Highlighted tiles per chunk
+  size_t* offsets = nullptr;              // Where each chunk of the animated list starts in the output
+  uint32_t* grown = nullptr;              // Chunks whose cull box growHexAnimatedBounds raised
+  size_t grown_count = 0;
+  HexRipple ripples[HEX_MAX_RIPPLES];
+  int ripple_count = 0;
+  // This frame, from beginHexAnimation - one entry per live ripple
+  int live = 0;
+  float ripple_x[HEX_MAX_RIPPLES];
+  float ripple_z[HEX_MAX_RIPPLES];
+  float ripple_radius[HEX_MAX_RIPPLES];
+  float ripple_inv_width[HEX_MAX_RIPPLES];
+  float ripple_width[HEX_MAX_RIPPLES];
+  float ripple_gain[HEX_MAX_RIPPLES];     // Amplitude times fade
+  uint32_t glow = 0;                      // Highlight bits for this frame, already shifted
+  HexAnimationStats stats;                // Accumulated until someone resets it
+} HexAnimator;
+
+void destroyHexAnimator(HexAnimator& animator) {
+  destroyHexGridBits(animator.highlight);
+  free(animator.chunk_highlights);
+  free(animator.offsets);
+  free(animator.grown);
+  animator = {};
+}
+
+// The world has to outlive the animator. Chunks up to 64 tiles wide, a chunk row of highlight bits is one word.
+bool createHexAnimator(HexAnimator& animator, const HexWorld& world) {
+  animator = {};
+  if (world.desc.chunk_size > 64 || !initHexGridShape(animator.shape, world)) return false;
+  animator.world = &world;
+  animator.chunk_highlights = (uint32_t*)calloc(world.chunk_count, sizeof(uint32_t));
+  animator.offsets = (size_t*)malloc(world.chunk_count * sizeof(size_t));
+  animator.grown = (uint32_t*)malloc(world.chunk_count * sizeof(uint32_t));
+  if (!animator.chunk_highlights || !animator.offsets || !animator.grown || !createHexGridBits(animator.highlight, animator.shape, 1)) {
+    destroyHexAnimator(animator);
+    return false;
+  }
+  return true;
+}
+
+// A full list drops the oldest ripple
+void hexAddRipple(HexAnimator& animator, const HexRipple& ripple) {
+  if (animator.ripple_count == HEX_MAX_RIPPLES) {
+    memmove(animator.ripples, animator.ripples + 1, (HEX_MAX_RIPPLES - 1) * sizeof(HexRipple));
+    animator.ripple_count--;
+  }
+  animator.ripples[animator.ripple_count++] = ripple;
+}
+
+void hexSetHighlight(HexAnimator& animator, int col, int row, bool on) {
+  if (!hexGridContains(animator.shape, col, row)) return;
+  const size_t index = hexGridIndex(animator.shape, col, row);
+  if ((hexGridBitsGet(animator.highlight, index) != 0) == on) return;
+  hexGridBitsSet(animator.highlight, index, on ? 1 : 0);
+  const size_t chunk = index >> (2 * animator.shape.chunk_shift);
+  animator.chunk_highlights[chunk] += on ? 1 : (uint32_t)-1;
+}
+
+void hexClearHighlights(HexAnimator& animator) {
+  memset(animator.highlight.words, 0, animator.highlight.word_count * sizeof(uint64_t));
+  memset(animator.chunk_highlights, 0, animator.world->chunk_count * sizeof(uint32_t));
+}
+
+// Drops ripples that faded out and works out everything per frame that does not depend on the tile
+void beginHexAnimation(HexAnimator& animator, float time) {
+  int kept = 0;
+  animator.live = 0;
+  for (int i = 0; i < animator.ripple_count; i++) {
+    const HexRipple& r = animator.ripples[i];
+    const float age = time - r.start;
+    if (age >= r.duration) continue;
+    animator.ripples[kept++] = r;
+    if (age < 0.0f) continue;
+    const int l = animator.live++;
+    animator.ripple_x[l] = r.x;
+    animator.ripple_z[l] = r.z;
+    animator.ripple_radius[l] = r.speed * age;
+    animator.ripple_width[l] = r.width;
+    animator.ripple_inv_width[l] = 1.0f / r.width;
+    animator.ripple_gain[l] = r.amplitude * (1.0f - age / r.duration);
+  }
+  animator.ripple_count = kept;
+  const float pulse = 0.5f + 0.5f * std::sin(time * 6.283185307f * HEX_HIGHLIGHT_HZ);
+  animator.glow = (uint32_t)(96.0f + 159.0f * pulse) << HEX_GLOW_SHIFT;
+}
+
+// Live ripple's ring overlaps the chunk's box on the XZ plane
+static inline bool hexRippleCrossesChunk(const HexAnimator& animator, int ripple, size_t chunk) {
+  const AabbSoA& b = animator.world->bounds;
+  const float x = animator.ripple_x[ripple], z = animator.ripple_z[ripple];
+  const float nearX = x < b.min_x[chunk] ? b.min_x[chunk] - x : (x > b.max_x[chunk] ? x - b.max_x[chunk] : 0.0f);
+  const float nearZ = z < b.min_z[chunk] ? b.min_z[chunk] - z : (z > b.max_z[chunk] ? z - b.max_z[chunk] : 0.0f);
+  const float farX = std::fmax(std::fabs(x - b.min_x[chunk]), std::fabs(x - b.max_x[chunk]));
+  const float farZ = std::fmax(std::fabs(z - b.min_z[chunk]), std::fabs(z - b.max_z[chunk]));
+  const float nearest = std::sqrt(nearX * nearX + nearZ * nearZ);
+  const float farthest = std::sqrt(farX * farX + farZ * farZ);
+  return animator.ripple_radius[ripple] - animator.ripple_width[ripple] <= farthest &&
+         animator.ripple_radius[ripple] + animator.ripple_width[ripple] >= nearest;
+}
+
+// Something moves in the chunk this frame - a highlighted tile, or a ripple ring crossing its box
+bool hexChunkAnimated(const HexAnimator& animator, size_t chunk) {
+  if (animator.chunk_highlights[chunk] != 0) return true;
+  for (int i = 0; i < animator.live; i++) {
+    if (hexRippleCrossesChunk(animator, i, chunk)) return true;
+  }
+  return false;
+}
+
+// Between beginHexAnimation and culling - boxes of chunks a ripple crosses reach the tallest a tile in them can
+// get this frame, height * (1 + every crossing ripple's gain), the ones raised last frame go back to height.
+// world is the one the animator was created for. Visits every chunk while a ripple is live.
+void growHexAnimatedBounds(HexAnimator& animator, HexWorld& world) {
+  for (size_t i = 0; i < animator.grown_count; i++) world.bounds.max_y[animator.grown[i]] = world.desc.height;
+  animator.grown_count = 0;
+  if (animator.live == 0) return;
+  for (size_t chunk = 0; chunk < world.chunk_count; chunk++) {
+    float gain = 0.0f;
+    for (int i = 0; i < animator.live; i++) {
+      if (hexRippleCrossesChunk(animator, i, chunk)) gain += animator.ripple_gain[i];
+    }
+    if (gain <= 0.0f) continue;
+    world.bounds.max_y[chunk] = world.desc.height * (1.0f + gain);
+    animator.grown[animator.grown_count++] = (uint32_t)chunk;
+  }
+}
+
+// Splits visible chunks into animated and idle ones, both keep the visible order - idle can be visible itself.
+// Returns the animated count.
+size_t selectAnimatedChunks(HexAnimator& animator, const uint32_t* visible, size_t visibleCount,
+                            uint32_t* animated, uint32_t* idle, size_t& idleCount) {
+  size_t count = 0;
+  idleCount = 0;
+  for (size_t i = 0; i < visibleCount; i++) {
+    if (hexChunkAnimated(animator, visible[i])) animated[count++] = visible[i];
+    else idle[idleCount++] = visible[i];
+  }
+  animator.stats.chunks_tested += visibleCount;
+  animator.stats.chunks_animated += count;
+  return count;
+}
+
+// Height scale for one tile, the same operations in the same order as the SIMD lanes
+static inline float hexRippleScale(const HexAnimator& animator, float x, float z) {
+  float scale = 0.0f;
+  for (int i = 0; i < animator.live; i++) {
+    const float dx = x - animator.ripple_x[i];
+    const float dz = z - animator.ripple_z[i];
+    const float d = std::sqrt(dx * dx + dz * dz);
+    const float p = (d - animator.ripple_radius[i]) * animator.ripple_inv_width[i];
+    float envelope = 1.0f - p * p;
+    envelope = envelope > 0.0f ? envelope : 0.0f;
+    scale = scale + animator.ripple_gain[i] * (envelope * envelope);
+  }
+  return scale;
+}
+
+// Reference kernel, the SIMD one uses it for row tails and is checked against it
+size_t animateHexChunkScalar(const HexAnimator& animator, size_t chunk, const HexInstance* base, HexInstance* out) {
+  const HexChunk& c = animator.world->chunks[chunk];
+  const size_t chunkBit = chunk << (2 * animator.shape.chunk_shift);
+  size_t n = 0;
+  for (int r = 0; r < c.rows; r++) {
+    const size_t rowBit = chunkBit + ((size_t)r << animator.shape.chunk_shift);
+    const uint64_t bits = animator.highlight.words[rowBit >> 6] >> (rowBit & 63);
+    for (int col = 0; col < c.columns; col++, n++) {
+      HexInstance tile = base[n];
+      tile.height = tile.height * (1.0f + hexRippleScale(animator, tile.offset_x, tile.offset_z));
+      tile.color_index = (tile.color_index & HEX_PALETTE_MASK) | (((bits >> col) & 1) ? animator.glow : 0);
+      out[n] = tile;
+    }
+  }
+  return n;
+}
+
+// Animates one chunk's tiles (chunk instance order, columns * rows of them) from base into out.
+// out may be write-combined mapped memory - written front to back, 16 bytes at a time, never read.
+size_t animateHexChunk(const HexAnimator& animator, size_t chunk, const HexInstance* base, HexInstance* out) {
+#if defined(HEX_SIMD_SSE)
+  const HexChunk& c = animator.world->chunks[chunk];
+  const size_t chunkBit = chunk << (2 * animator.shape.chunk_shift);
+  const __m128 one = _mm_set1_ps(1.0f);
+  const __m128 zero = _mm_setzero_ps();
+  const __m128i paletteMask = _mm_set1_epi32((int)HEX_PALETTE_MASK);
+  const __m128i glow = _mm_set1_epi32((int)animator.glow);
+  const __m128i laneBits = _mm_set_epi32(8, 4, 2, 1);
+  const bool highlighted = animator.chunk_highlights[chunk] != 0;
+  size_t n = 0;
+  for (int r = 0; r < c.rows; r++) {
+    const size_t rowBit = chunkBit + ((size_t)r << animator.shape.chunk_shift);
+    const uint64_t bits = highlighted ? animator.highlight.words[rowBit >> 6] >> (rowBit & 63) : 0;
+    int col = 0;
+    for (; col + 4 <= c.columns; col += 4, n += 4) {
+      // AoS -> SoA, one register per field
+      __m128 x = _mm_loadu_ps(&base[n + 0].offset_x);
+      __m128 z = _mm_loadu_ps(&base[n + 1].offset_x);
+      __m128 height = _mm_loadu_ps(&base[n + 2].offset_x);
+      __m128 color = _mm_loadu_ps(&base[n + 3].offset_x);
+      _MM_TRANSPOSE4_PS(x, z, height, color);
+
+      __m128 scale = zero;
+      for (int i = 0; i < animator.live; i++) {
+        const __m128 dx = _mm_sub_ps(x, _mm_set1_ps(animator.ripple_x[i]));
+        const __m128 dz = _mm_sub_ps(z, _mm_set1_ps(animator.ripple_z[i]));
+        const __m128 d = _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dz, dz)));
+        const __m128 p = _mm_mul_ps(_mm_sub_ps(d, _mm_set1_ps(animator.ripple_radius[i])), _mm_set1_ps(animator.ripple_inv_width[i]));
+        const __m128 envelope = _mm_max_ps(_mm_sub_ps(one, _mm_mul_ps(p, p)), zero);
+        scale = _mm_add_ps(scale, _mm_mul_ps(_mm_set1_ps(animator.ripple_gain[i]), _mm_mul_ps(envelope, envelope)));
+      }
+      height = _mm_mul_ps(height, _mm_add_ps(one, scale));
+
+      const __m128i lit = _mm_cmpeq_epi32(_mm_and_si128(_mm_set1_epi32((int)((bits >> col) & 15)), laneBits), laneBits);
+      const __m128i colorBits = _mm_or_si128(_mm_and_si128(_mm_castps_si128(color), paletteMask), _mm_and_si128(lit, glow));
+      color = _mm_castsi128_ps(colorBits);
+
+      _MM_TRANSPOSE4_PS(x, z, height, color);
+      _mm_storeu_ps(&out[n + 0].offset_x, x);
+      _mm_storeu_ps(&out[n + 1].offset_x, z);
+      _mm_storeu_ps(&out[n + 2].offset_x, height);
+      _mm_storeu_ps(&out[n + 3].offset_x, color);
+    }
+    for (; col < c.columns; col++, n++) {
+      HexInstance tile = base[n];
+      tile.height = tile.height * (1.0f + hexRippleScale(animator, tile.offset_x, tile.offset_z));
+      tile.color_index = (tile.color_index & HEX_PALETTE_MASK) | (((bits >> col) & 1) ? animator.glow : 0);
+      out[n] = tile;
+    }
+  }
+  return n;
+#else
+  return animateHexChunkScalar(animator, chunk, base, out);
+#endif
+}
+
+// Tiles the chunks take up packed back to back
+size_t hexAnimatedTileCount(const HexAnimator& animator, const uint32_t* chunks, size_t count) {
+  size_t tiles = 0;
+  for (size_t i = 0; i < count; i++) tiles += (size_t)animator.world->chunks[chunks[i]].columns * (size_t)animator.world->chunks[chunks[i]].rows;
+  return tiles;
+}
+
+// Keeps the animated chunks that fit in maxTiles, the rest go to the end of idle and draw still this frame.
+// Returns the animated count left.
+size_t fitAnimatedChunks(const HexAnimator& animator, const uint32_t* chunks, size_t count, size_t maxTiles,
+                         uint32_t* idle, size_t& idleCount) {
+  size_t fit = 0;
+  for (size_t tiles = 0; fit < count; fit++) {
+    tiles += (size_t)animator.world->chunks[chunks[fit]].columns * (size_t)animator.world->chunks[chunks[fit]].rows;
+    if (tiles > maxTiles) break;
+  }
+  for (size_t i = fit; i < count; i++) idle[idleCount++] = chunks[i];
+  return fit;
+}
+
+// Animates the chunks into out back to back in list order, hexAnimatedTileCount tiles of room. Chunks are
+// spread over the job system, every one is a few KB of contiguous writes. Returns the tiles written.
+size_t animateHexChunks(HexAnimator& animator, const uint32_t* chunks, size_t count, HexAnimationSource source, void* user,
+                        HexInstance* out, JobSystem& jobs) {
+  const uint64_t start = timerNanoseconds();
+  size_t tiles = 0;
+  for (size_t i = 0; i < count; i++) {
+    animator.offsets[i] = tiles;
+    tiles += (size_t)animator.world->chunks[chunks[i]].columns * (size_t)animator.world->chunks[chunks[i]].rows;
+  }
+  jobParallelFor(jobs, count, 4, [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; i++) animateHexChunk(animator, chunks[i], source(user, chunks[i]), out + animator.offsets[i]);
+  });
+  animator.stats.tiles += tiles;
+  animator.stats.time_ms += (double)(timerNanoseconds() - start) / 1000000.0;
+  return tiles;
+}
+
+#endif /* _H_HEX_ANIMATION */
@@ -0,0 +1,58 @@
+#ifndef _H_HEX_COMMANDS
+#define _H_HEX_COMMANDS
+
+// The tile pass as backend-neutral commands - onRender and the headless replay record it through the
+// same function, so a synthetic capture has exactly the shape of a real one.
+#include "../render_pipeline/command_stream.cpp"
+#include "hex_instances.cpp"
+
+#include <cstdint>
+
+// Buffer and pipeline ids in tile streams
+enum HexCommandBuffer : uint32_t {
+  HEX_BUFFER_TILE_VERTICES = 0,  // Shared tile mesh
+  HEX_BUFFER_TILE_INDICES = 1,
+  HEX_BUFFER_INSTANCES = 2,      // One HexInstance per tile, chunk ranges from buildHexInstanceRanges
+  HEX_BUFFER_ANIMATED_INSTANCES = 3  // This frame's animated chunks back to back, rewritten every frame
+};
+
+enum HexCommandPipeline : uint32_t {
+  HEX_PIPELINE_TILES = 0         // win32_instanced_shader
+};
+
+// Sizes of what the buffers hold - views cover all of it, draws pick instances by first_instance
+typedef struct HexTileBuffers {
+  uint32_t vertex_size;
+  uint32_t vertex_stride;        // sizeof(VertexHalf) in the window, the software path also takes SwVertex
+  uint32_t index_size;
+  uint32_t index_count;          // unsigned short indices
+  uint32_t instance_size;
+  uint32_t animated_size;        // This frame's, 0 without animated chunks
+} HexTileBuffers;
+
+// One pass: clear, tile pipeline, constants in slot 0, one instanced draw per run of visible chunks - then
+// animatedCount tiles from the animated buffer in one more draw
+void recordHexTilePass(CommandStream& stream, const float clear[4], uint32_t width, uint32_t height, const HexTileBuffers& buffers,
+                       const void* constants, uint32_t constantsSize, const HexInstanceRange* draws, size_t drawCount,
+                       uint32_t animatedCount = 0) {
+  cmdBeginPass(stream, "tiles", clear, width, height);
+  cmdSetPipeline(stream, HEX_PIPELINE_TILES);
+  cmdSetConstants(stream, 0, constants, constantsSize);
+  const CommandBufferView streams[2] = {
+    { HEX_BUFFER_TILE_VERTICES, 0, buffers.vertex_size, buffers.vertex_stride },
+    { HEX_BUFFER_INSTANCES, 0, buffers.instance_size, (uint32_t)sizeof(HexInstance) }
+  };
+  cmdSetVertexBuffers(stream, 0, streams, 2);
+  cmdSetIndexBuffer(stream, { HEX_BUFFER_TILE_INDICES, 0, buffers.index_size, (uint32_t)sizeof(unsigned short) });
+  for (size_t i = 0; i < drawCount; i++) {
+    cmdDrawIndexed(stream, buffers.index_count, draws[i].count, 0, 0, draws[i].first);
+  }
+  if (animatedCount > 0) {
+    const CommandBufferView animated = { HEX_BUFFER_ANIMATED_INSTANCES, 0, buffers.animated_size, (uint32_t)sizeof(HexInstance) };
+    cmdSetVertexBuffers(stream, 1, &animated, 1);
+    cmdDrawIndexed(stream, buffers.index_count, animatedCount, 0, 0, 0);
+  }
+  cmdEndPass(stream);
+}
+
+#endif /* _H_HEX_COMMANDS */
@@ -0,0 +1,79 @@
+#ifndef _H_HEX_COORDS
+#define _H_HEX_COORDS
+
+#include <cstdint>
+
+// Hexes are pointy-top and lie on the XZ plane, +y is up (same space prepareCamera looks at).
+// Tiles are addressed by axial (q, r) coordinates, rectangular maps use "odd-r" offset (col, row).
+// See https://www.redblobgames.com/grids/hexagons/ - everything here follows that page.
+constexpr float HEX_SQRT3 = 1.7320508075688772f;
+constexpr float HEX_DEFAULT_RADIUS = 0.5f; // Center to corner
+
+typedef struct HexAxial {
+  int q;
+  int r;
+} HexAxial;
+
+inline HexAxial hexOffsetToAxial(int col, int row) {
+  return { col - ((row - (row & 1)) / 2), row };
+}
+
+inline void hexAxialToOffset(HexAxial a, int& col, int& row) {
+  row = a.r;
+  col = a.q + ((a.r - (a.r & 1)) / 2);
+}
+
+inline void hexOffsetToWorld(int col, int row, float radius, float& x, float& z) {
+  x = radius * HEX_SQRT3 * ((float)col + 0.5f * (float)(row & 1));
+  z = radius * 1.5f * (float)row;
+}
+
+inline void hexAxialToWorld(HexAxial a, float radius, float& x, float& z) {
+  x = radius * HEX_SQRT3 * ((float)a.q + 0.5f * (float)a.r);
+  z = radius * 1.5f * (float)a.r;
+}
+
+// Corners go counter-clockwise when looking down from +y, corner 0 sits at -30 degrees
+inline void hexCornerOffset(int corner, float radius, float& x, float& z) {
+  static const float cornerX[6] = { 0.8660254f, 0.8660254f, 0.0f, -0.8660254f, -0.8660254f, 0.0f };
+  static const float cornerZ[6] = { -0.5f, 0.5f, 1.0f, 0.5f, -0.5f, -1.0f };
+  x = cornerX[corner] * radius;
+  z = cornerZ[corner] * radius;
+}
+
+// Neighbour directions in axial space, direction i shares edge between corners i and i+1
+static const HexAxial HEX_DIRECTIONS[6] = {
+  { 1, 0 }, { 0, 1 }, { -1, 1 }, { -1, 0 }, { 0, -1 }, { 1, -1 }
+};
+
+// The same directions in offset space: column step on even and odd rows, the row step is HEX_DIRECTIONS[d].r
+static const int HEX_OFFSET_COLUMN_STEP[2][6] = {
+  { 1, 0, -1, -1, -1, 0 },
+  { 1, 1, 0, -1, 0, 1 }
+};
+
+inline HexAxial hexNeighbour(HexAxial a, int direction) {
+  return { a.q + HEX_DIRECTIONS[direction].q, a.r + HEX_DIRECTIONS[direction].r };
+}
+
+inline int hexDistance(HexAxial a, HexAxial b) {
+  int dq = a.q - b.q;
+  int dr = a.r - b.r;
+  int ds = -dq - dr;
+  dq = dq < 0 ? -dq : dq;
+  dr = dr < 0 ? -dr : dr;
+  ds = ds < 0 ? -ds : ds;
+  return dq > dr ? (dq > ds ? dq : ds) : (dr > ds ? dr : ds);
+}
+
+// Cheap integer hash, used wherever we need a per-tile "random" value that does not depend on rand() state
+inline uint32_t hexHash(uint32_t x) {
+  x ^= x >> 16;
+  x *= 0x7feb352dU;
+  x ^= x >> 15;
+  x *= 0x846ca68bU;
+  x ^= x >> 16;
+  return x;
+}
+
+#endif /* _H_HEX_COORDS */
@@ -0,0 +1,202 @@
+#ifndef _H_HEX_EDIT
+#define _H_HEX_EDIT
+
+// Tile edits without rebuilding the world. An edit lands in a private copy of its chunk's tiles and sets
+// the tile's dirty bit; flushHexTileEdits walks dirty chunks at frame end, under a time budget, and hands
+// out only the byte ranges that changed. Every tile owns its whole prism (top and walls), so an edit
+// never changes what a neighbour chunk draws - only the owning chunk goes dirty.
+#include "../core/simd.cpp"
+#include "../core/memory.cpp"
+#include "../core/timer.cpp"
+#include "hex_coords.cpp"
+#include "hex_world.cpp"
+#include "hex_instances.cpp"
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+constexpr int HEX_EDIT_MERGE_GAP = 4;       // Clean tiles two dirty runs can have between them and still upload as one
+constexpr double HEX_EDIT_BUDGET_MS = 0.5;   // Default flush budget per frame
+
+enum HexTileEditFields : uint32_t {
+  HEX_EDIT_HEIGHT = 1,
+  HEX_EDIT_TYPE = 2,    // Palette index - tile type and color are the same thing in HexInstance
+  HEX_EDIT_RAISE = 4    // height is added to the current one instead of replacing it
+};
+
+typedef struct HexTileEdit {
+  uint32_t fields = 0;  // HexTileEditFields to apply
+  float height = 0.0f;  // World units, clamped to [0, HexWorldDesc::height] so chunk boxes stay valid
+  uint32_t type = 0;
+} HexTileEdit;
+
+// Fills a chunk's tiles the first time one of them is edited, ex. from the map file
+typedef void (*HexChunkSource)(void* user, size_t chunk, HexInstance* out);
+
+typedef struct HexEditStats {
+  uint64_t edits = 0;
+  uint64_t rejected = 0;       // Outside the map
+  uint64_t chunks_flushed = 0;
+  uint64_t ranges = 0;
+  uint64_t bytes = 0;
+  double flush_ms = 0.0;
+} HexEditStats;
+
+typedef struct HexTileEditor {
+  const HexWorld* world = nullptr;
+  const HexInstanceRange* ranges = nullptr;  // Where each chunk lives in the instance stream
+  HexChunkSource source = nullptr;
+  void* source_user = nullptr;
+  int words_per_chunk = 0;
+  HexInstance** chunk_tiles = nullptr;       // nullptr until the chunk is first edited
+  uint64_t* dirty_bits = nullptr;            // words_per_chunk per chunk, one bit per tile
+  uint32_t* dirty_queue = nullptr;           // Ring of dirty chunks in the order they went dirty
+  size_t dirty_head = 0;
+  size_t dirty_count = 0;
+  uint8_t* queued = nullptr;
+  HexEditStats stats;
+} HexTileEditor;
+
+void destroyHexTileEditor(HexTileEditor& editor) {
+  if (editor.chunk_tiles) {
+    for (size_t i = 0; i < editor.world->chunk_count; i++) alignedFree(editor.chunk_tiles[i]);
+  }
+  free(editor.chunk_tiles);
+  free(editor.dirty_bits);
+  free(editor.dirty_queue);
+  free(editor.queued);
+  editor = {};
+}
+
+// ranges from buildHexInstanceRanges, source brings a chunk's current tiles in on its first edit
+bool createHexTileEditor(HexTileEditor& editor, const HexWorld& world, const HexInstanceRange* ranges, HexChunkSource source, void* user) {
+  editor = {};
+  editor.world = &world;
+  editor.ranges = ranges;
+  editor.source = source;
+  editor.source_user = user;
+  editor.words_per_chunk = (world.desc.chunk_size * world.desc.chunk_size + 63) / 64;
+  editor.chunk_tiles = (HexInstance**)calloc(world.chunk_count, sizeof(HexInstance*));
+  editor.dirty_bits = (uint64_t*)calloc(world.chunk_count * (size_t)editor.words_per_chunk, sizeof(uint64_t));
+  editor.dirty_queue = (uint32_t*)malloc(world.chunk_count * sizeof(uint32_t));
+  editor.queued = (uint8_t*)calloc(world.chunk_count, 1);
+  if (!editor.chunk_tiles || !editor.dirty_bits || !editor.dirty_queue || !editor.queued) {
+    destroyHexTileEditor(editor);
+    return false;
+  }
+  return true;
+}
+
+// Edited tiles of a chunk, nullptr if nothing in it was ever edited - whoever uploads a chunk for the first
+// time has to take its tiles from here when there are any
+inline const HexInstance* hexEditedChunkTiles(const HexTileEditor& editor, size_t chunk) {
+  return editor.chunk_tiles[chunk];
+}
+
+inline size_t hexEditPending(const HexTileEditor& editor) {
+  return editor.dirty_count;
+}
+
+bool hexEditTile(HexTileEditor& editor, HexAxial tile, const HexTileEdit& edit) {
+  const HexWorld& world = *editor.world;
+  int col, row;
+  hexAxialToOffset(tile, col, row);
+  if (col < 0 || row < 0 || col >= world.desc.columns || row >= world.desc.rows) {
+    editor.stats.rejected++;
+    return false;
+  }
+  const int cs = world.desc.chunk_size;
+  const size_t chunk = (size_t)(row / cs) * (size_t)world.chunks_x + (size_t)(col / cs);
+  const HexChunk& c = world.chunks[chunk];
+  const int index = (row - c.first_row) * c.columns + (col - c.first_column);
+
+  HexInstance*& tiles = editor.chunk_tiles[chunk];
+  if (tiles == nullptr) {
+    tiles = (HexInstance*)alignedAlloc((size_t)c.columns * (size_t)c.rows * sizeof(HexInstance));
+    if (tiles == nullptr) return false;
+    editor.source(editor.source_user, chunk, tiles);
+  }
+  HexInstance& instance = tiles[index];
+  if (edit.fields & (HEX_EDIT_HEIGHT | HEX_EDIT_RAISE)) {
+    float height = (edit.fields & HEX_EDIT_RAISE) ? instance.height + edit.height : edit.height;
+    height = height < 0.0f ? 0.0f : height;
+    instance.height = height > world.desc.height ? world.desc.height : height;
+  }
+  if (edit.fields & HEX_EDIT_TYPE) instance.color_index = edit.type % HEX_PALETTE_SIZE;
+
+  editor.dirty_bits[chunk * (size_t)editor.words_per_chunk + (size_t)(index / 64)] |= 1ull << (index % 64);
+  if (!editor.queued[chunk]) {
+    editor.queued[chunk] = 1;
+    editor.dirty_queue[(editor.dirty_head + editor.dirty_count) % world.chunk_count] = (uint32_t)chunk;
+    editor.dirty_count++;
+  }
+  editor.stats.edits++;
+  return true;
+}
+
+inline bool hexEditHeight(HexTileEditor& editor, HexAxial tile, float height) {
+  HexTileEdit edit;
+  edit.fields = HEX_EDIT_HEIGHT;
+  edit.height = height;
+  return hexEditTile(editor, tile, edit);
+}
+
+inline bool hexEditType(HexTileEditor& editor, HexAxial tile, uint32_t type) {
+  HexTileEdit edit;
+  edit.fields = HEX_EDIT_TYPE;
+  edit.type = type;
+  return hexEditTile(editor, tile, edit);
+}
+
+// Hands dirty tiles to upload(chunk, byteOffset, data, size), byteOffset into the whole instance stream.
+// Runs of dirty tiles closer than HEX_EDIT_MERGE_GAP go out as one range. Stops taking new chunks once
+// budgetMs is spent - the rest stay queued for the next call. Returns chunks flushed.
+template <typename Upload>
+size_t flushHexTileEdits(HexTileEditor& editor, double budgetMs, Upload upload) {
+  if (editor.dirty_count == 0) return 0;
+  const uint64_t start = timerNanoseconds();
+  const uint64_t budgetNs = (uint64_t)(budgetMs * 1000000.0);
+  const size_t chunkCount = editor.world->chunk_count;
+  size_t flushed = 0;
+
+  while (editor.dirty_count > 0) {
+    const uint32_t chunk = editor.dirty_queue[editor.dirty_head];
+    editor.dirty_head = (editor.dirty_head + 1) % chunkCount;
+    editor.dirty_count--;
+    editor.queued[chunk] = 0;
+
+    const HexInstance* tiles = editor.chunk_tiles[chunk];
+    const size_t first = editor.ranges[chunk].first;
+    uint64_t* bits = editor.dirty_bits + (size_t)chunk * (size_t)editor.words_per_chunk;
+    int runStart = -1, runEnd = -1;
+    for (int w = 0; w < editor.words_per_chunk; w++) {
+      uint64_t word = bits[w];
+      bits[w] = 0;
+      while (word) {
+        const int tile = w * 64 + lowestBit64(word);
+        word &= word - 1;
+        if (runStart >= 0 && tile - runEnd - 1 > HEX_EDIT_MERGE_GAP) {
+          upload(chunk, (first + (size_t)runStart) * sizeof(HexInstance), tiles + runStart, (size_t)(runEnd - runStart + 1) * sizeof(HexInstance));
+          editor.stats.ranges++;
+          editor.stats.bytes += (uint64_t)(runEnd - runStart + 1) * sizeof(HexInstance);
+          runStart = -1;
+        }
+        if (runStart < 0) runStart = tile;
+        runEnd = tile;
+      }
+    }
+    if (runStart >= 0) {
+      upload(chunk, (first + (size_t)runStart) * sizeof(HexInstance), tiles + runStart, (size_t)(runEnd - runStart + 1) * sizeof(HexInstance));
+      editor.stats.ranges++;
+      editor.stats.bytes += (uint64_t)(runEnd - runStart + 1) * sizeof(HexInstance);
+    }
+    flushed++;
+    if (timerNanoseconds() - start >= budgetNs) break;
+  }
+  editor.stats.chunks_flushed += flushed;
+  editor.stats.flush_ms += (double)(timerNanoseconds() - start) / 1000000.0;
+  return flushed;
+}
+
+#endif /* _H_HEX_EDIT */
@@ -0,0 +1,334 @@
+#ifndef _H_HEX_FOV
+#define _H_HEX_FOV
+
+// Field of view over the tile heights for many observers, merged into one bit per tile for fog of war.
+// Every observer is cast ring by ring outwards: tile j on side s of ring k sees past the point j * (k - 1) / k
+// of the same side of ring k - 1, so the shadow cast so far is carried outwards as one horizon slope per ring
+// tile, interpolated between the two tiles the line of sight passes (XDraw, Franklin et al. - on hexes the
+// interpolation is exact along a side). That is O(radius^2) per observer instead of a ray per tile.
+// Results go to a small bit window per observer, the windows are ORed into per-chunk masks. Only observers that
+// moved (or saw terrain change) are cast again, and only the chunks their old and new windows cover are merged.
+// Heights are read from a chunk-order copy (hex_grid.cpp), already scaled - a ring's sides run across rows,
+// and a radius 12 disc mostly falls in one or two chunks.
+#include "../core/jobs.cpp"
+#include "../core/memory.cpp"
+#include "../core/profiler.cpp"
+#include "hex_coords.cpp"
+#include "hex_grid.cpp"
+#include "hex_world.cpp"
+#include "hex_terrain.cpp"
+
+#include <atomic>
+#include <cfloat>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+constexpr int HEX_FOV_MAX_RADIUS = 31;                             // Window rows are 2 * radius + 1 bits, one word
+constexpr int HEX_FOV_WINDOW_WORDS = 2 * HEX_FOV_MAX_RADIUS + 1;
+constexpr size_t HEX_FOV_JOB_OBSERVERS = 64;
+
+typedef struct HexFovObserver {
+  int col;
+  int row;
+  int radius;
+  float eye;          // Above the tile the observer stands on, world units
+  int cast_col;       // Where the window was cast from, radius -1 before the first cast
+  int cast_row;
+  int cast_radius;
+  bool dirty;
+} HexFovObserver;
+
+typedef struct HexFovStats {
+  size_t observers_cast = 0;  // Last update
+  size_t chunks_merged = 0;
+  size_t tiles_cast = 0;
+} HexFovStats;
+
+typedef struct HexFov {
+  int columns = 0;
+  int rows = 0;
+  int chunk_size = 0;
+  int chunks_x = 0;
+  int chunks_y = 0;
+  size_t chunk_count = 0;
+  const float* terrain = nullptr;  // HexTerrain::height, copied into height again by hexFovInvalidate
+  float height_scale = 1.0f;       // HexWorldDesc::height
+  HexGrid<float> height;           // Tile tops in world units, read on every cast
+  // chunk_size words per chunk, bit c of word r is tile (first_column + c, first_row + r)
+  uint64_t* visible = nullptr;
+  uint8_t* chunk_dirty = nullptr;
+  HexFovObserver* observers = nullptr;
+  uint64_t* windows = nullptr;     // HEX_FOV_WINDOW_WORDS per observer, row y bit x is tile (cast_col - r + x, cast_row - r + y)
+  size_t observer_count = 0;
+  size_t observer_capacity = 0;
+  HexFovStats stats;
+  // Scratch for updateHexFov
+  std::vector<uint32_t> cast;
+  std::vector<uint32_t> merge;
+  std::vector<uint32_t> bin_first;
+  std::vector<uint32_t> bin;
+} HexFov;
+
+void destroyHexFov(HexFov& fov) {
+  destroyHexGrid(fov.height);
+  alignedFree(fov.visible);
+  alignedFree(fov.windows);
+  free(fov.chunk_dirty);
+  free(fov.observers);
+  fov = {};
+}
+
+// Room for capacity observers. The terrain has to outlive the fov, call hexFovInvalidate after changing it.
+bool createHexFov(HexFov& fov, const HexWorld& world, const HexTerrain& terrain, size_t capacity) {
+  if (world.desc.chunk_size > 64 || terrain.columns != world.desc.columns || terrain.rows != world.desc.rows) return false;
+  fov = {};
+  fov.columns = world.desc.columns;
+  fov.rows = world.desc.rows;
+  fov.chunk_size = world.desc.chunk_size;
+  fov.chunks_x = world.chunks_x;
+  fov.chunks_y = world.chunks_y;
+  fov.chunk_count = world.chunk_count;
+  fov.terrain = terrain.height;
+  fov.height_scale = world.desc.height;
+  fov.observer_capacity = capacity;
+  fov.visible = (uint64_t*)alignedAlloc(fov.chunk_count * (size_t)fov.chunk_size * sizeof(uint64_t));
+  fov.chunk_dirty = (uint8_t*)calloc(fov.chunk_count, 1);
+  fov.observers = (HexFovObserver*)malloc(capacity * sizeof(HexFovObserver));
+  fov.windows = (uint64_t*)alignedAlloc(capacity * HEX_FOV_WINDOW_WORDS * sizeof(uint64_t));
+  HexGridShape shape;
+  if (!fov.visible || !fov.chunk_dirty || !fov.observers || !fov.windows || !initHexGridShape(shape, world) || !createHexGrid(fov.height, shape)) {
+    destroyHexFov(fov);
+    return false;
+  }
+  memset(fov.visible, 0, fov.chunk_count * (size_t)fov.chunk_size * sizeof(uint64_t));
+  forEachHexGridRow(fov.height, [&](float* tiles, int col, int row, int count) {
+    const float* source = fov.terrain + (size_t)row * (size_t)fov.columns + (size_t)col;
+    for (int i = 0; i < count; i++) tiles[i] = source[i] * fov.height_scale;
+  });
+  return true;
+}
+
+inline bool hexFovVisible(const HexFov& fov, int col, int row) {
+  if (col < 0 || row < 0 || col >= fov.columns || row >= fov.rows) return false;
+  const size_t chunk = (size_t)(row / fov.chunk_size) * (size_t)fov.chunks_x + (size_t)(col / fov.chunk_size);
+  const uint64_t word = fov.visible[chunk * (size_t)fov.chunk_size + (size_t)(row % fov.chunk_size)];
+  return (word >> (col % fov.chunk_size)) & 1;
+}
+
+static void hexFovMarkChunks(HexFov& fov, int col, int row, int radius) {
+  if (radius < 0) return;
+  const int firstX = (col - radius < 0 ? 0 : col - radius) / fov.chunk_size;
+  const int lastX = (col + radius >= fov.columns ? fov.columns - 1 : col + radius) / fov.chunk_size;
+  const int firstY = (row - radius < 0 ? 0 : row - radius) / fov.chunk_size;
+  const int lastY = (row + radius >= fov.rows ? fov.rows - 1 : row + radius) / fov.chunk_size;
+  for (int y = firstY; y <= lastY; y++) {
+    for (int x = firstX; x <= lastX; x++) fov.chunk_dirty[(size_t)y * (size_t)fov.chunks_x + (size_t)x] = 1;
+  }
+}
+
+// Returns the observer index, SIZE_MAX when full. Radius is clamped to HEX_FOV_MAX_RADIUS.
+size_t hexFovAddObserver(HexFov& fov, int col, int row, int radius, float eye) {
+  if (fov.observer_count == fov.observer_capacity) return SIZE_MAX;
+  HexFovObserver& o = fov.observers[fov.observer_count];
+  o.col = col;
+  o.row = row;
+  o.radius = radius < 0 ? 0 : (radius > HEX_FOV_MAX_RADIUS ? HEX_FOV_MAX_RADIUS : radius);
+  o.eye = eye;
+  o.cast_col = col;
+  o.cast_row = row;
+  o.cast_radius = -1;
+  o.dirty = true;
+  return fov.observer_count++;
+}
+
+// Nothing happens until updateHexFov, moving back and forth in between costs nothing
+void hexFovMoveObserver(HexFov& fov, size_t observer, int col, int row) {
+  HexFovObserver& o = fov.observers[observer];
+  if (o.col == col && o.row == row) return;
+  o.col = col;
+  o.row = row;
+  o.dirty = true;
+}
+
+// Swaps the last observer into the hole, like entityDestroy - indices past observer change
+void hexFovRemoveObserver(HexFov& fov, size_t observer) {
+  HexFovObserver& o = fov.observers[observer];
+  hexFovMarkChunks(fov, o.cast_col, o.cast_row, o.cast_radius);
+  const size_t last = --fov.observer_count;
+  if (observer != last) {
+    o = fov.observers[last];
+    memcpy(fov.windows + observer * HEX_FOV_WINDOW_WORDS, fov.windows + last * HEX_FOV_WINDOW_WORDS, HEX_FOV_WINDOW_WORDS * sizeof(uint64_t));
+  }
+}
+
+// Heights in the rectangle changed - they are copied again, and every observer whose window covers part of it
+// is cast again
+void hexFovInvalidate(HexFov& fov, int firstColumn, int firstRow, int columns, int rows) {
+  for (int row = firstRow < 0 ? 0 : firstRow; row < firstRow + rows && row < fov.rows; row++) {
+    for (int col = firstColumn < 0 ? 0 : firstColumn; col < firstColumn + columns && col < fov.columns; col++) {
+      hexGridAt(fov.height, col, row) = fov.terrain[(size_t)row * (size_t)fov.columns + (size_t)col] * fov.height_scale;
+    }
+  }
+  for (size_t i = 0; i < fov.observer_count; i++) {
+    HexFovObserver& o = fov.observers[i];
+    if (o.cast_col + o.cast_radius < firstColumn || o.cast_col - o.cast_radius >= firstColumn + columns ||
+        o.cast_row + o.cast_radius < firstRow || o.cast_row - o.cast_radius >= firstRow + rows) continue;
+    o.dirty = true;
+  }
+}
+
+// One observer into its window. Returns the tiles looked at.
+size_t hexFovCast(const HexFov& fov, const HexFovObserver& o, uint64_t* window) {
+  memset(window, 0, HEX_FOV_WINDOW_WORDS * sizeof(uint64_t));
+  const int r = o.radius;
+  const int baseCol = o.col - r;
+  const int baseRow = o.row - r;
+  if (o.col < 0 || o.row < 0 || o.col >= fov.columns || o.row >= fov.rows) return 0;
+  const float eye = hexGridAt(fov.height, o.col, o.row) + o.eye;
+  window[r] |= 1ull << r;
+
+  // Horizon slope per tile of the previous and the current ring, 6k tiles on ring k
+  float horizons[2][6 * HEX_FOV_MAX_RADIUS];
+  const HexAxial center = hexOffsetToAxial(o.col, o.row);
+  const HexGridShape& shape = fov.height.shape;
+  const float* height = fov.height.tiles;
+  size_t tiles = 1;
+  for (int k = 1; k <= r; k++) {
+    const float* previous = horizons[(k - 1) & 1];
+    float* current = horizons[k & 1];
+    const int previousCount = 6 * (k - 1);
+    const float inverseK = 1.0f / (float)k;
+    for (int side = 0; side < 6; side++) {
+      // Side s of ring k starts at k * direction s + 4 and walks along direction s
+      int col, row;
+      hexAxialToOffset({ center.q + k * HEX_DIRECTIONS[(side + 4) % 6].q, center.r + k * HEX_DIRECTIONS[(side + 4) % 6].r }, col, row);
+      // Where the line of sight crosses ring k - 1: j * (k - 1) / k along the same side, as whole and remainder
+      int first = side * (k - 1);
+      int remainder = 0;
+      float* out = current + side * k;
+      // Inside a chunk the next tile is a fixed step away, crossing into another one the index starts over
+      size_t index = hexGridIndex(shape, col, row);
+      for (int j = 0; j < k; j++) {
+        float horizon = -FLT_MAX;
+        if (k > 1) {
+          const float h0 = previous[first];
+          const float h1 = previous[first + 1 == previousCount ? 0 : first + 1];
+          horizon = remainder == 0 ? h0 : h0 + (h1 - h0) * ((float)remainder * inverseK);
+        }
+        out[j] = horizon;
+        if ((unsigned)col < (unsigned)fov.columns && (unsigned)row < (unsigned)fov.rows) {  // Off the map blocks nothing
+          const float slope = (height[index] - eye) * inverseK;
+          if (slope >= horizon) {
+            window[row - baseRow] |= 1ull << (col - baseCol);
+            out[j] = slope;
+          }
+          tiles++;
+        }
+        remainder += k - 1;
+        if (remainder >= k) {
+          remainder -= k;
+          first++;
+        }
+        const int nextCol = col + HEX_OFFSET_COLUMN_STEP[row & 1][side];
+        const int nextRow = row + HEX_DIRECTIONS[side].r;
+        index = ((nextCol ^ col) | (nextRow ^ row)) >> shape.chunk_shift == 0 && nextCol >= 0 ?
+                index + (size_t)(ptrdiff_t)shape.step[row & 1][side] : hexGridIndex(shape, nextCol, nextRow);
+        col = nextCol;
+        row = nextRow;
+      }
+    }
+  }
+  return tiles;
+}
+
+// Casts what moved, merges what it touched. Observers in parallel, then chunks in parallel.
+void updateHexFov(HexFov& fov, JobSystem& jobs) {
+  PROFILE_SCOPE("updateHexFov");
+  fov.stats = {};
+  fov.cast.clear();
+  for (size_t i = 0; i < fov.observer_count; i++) {
+    HexFovObserver& o = fov.observers[i];
+    if (!o.dirty) continue;
+    hexFovMarkChunks(fov, o.cast_col, o.cast_row, o.cast_radius);
+    hexFovMarkChunks(fov, o.col, o.row, o.radius);
+    o.cast_col = o.col;
+    o.cast_row = o.row;
+    o.cast_radius = o.radius;
+    o.dirty = false;
+    fov.cast.push_back((uint32_t)i);
+  }
+  std::atomic<size_t> tiles{0};
+  jobParallelFor(jobs, fov.cast.size(), HEX_FOV_JOB_OBSERVERS, [&](size_t begin, size_t end) {
+    size_t local = 0;
+    for (size_t i = begin; i < end; i++) {
+      const uint32_t o = fov.cast[i];
+      local += hexFovCast(fov, fov.observers[o], fov.windows + (size_t)o * HEX_FOV_WINDOW_WORDS);
+    }
+    tiles.fetch_add(local, std::memory_order_relaxed);
+  });
+  fov.stats.observers_cast = fov.cast.size();
+  fov.stats.tiles_cast = tiles.load(std::memory_order_relaxed);
+
+  // Every observer into the bins of the dirty chunks its window covers, CSR style
+  fov.merge.clear();
+  for (size_t chunk = 0; chunk < fov.chunk_count; chunk++) {
+    if (fov.chunk_dirty[chunk]) fov.merge.push_back((uint32_t)chunk);
+  }
+  if (fov.merge.empty()) return;
+  std::vector<uint32_t>& first = fov.bin_first;
+  first.assign(fov.chunk_count + 1, 0);
+  for (int pass = 0; pass < 2; pass++) {
+    for (size_t i = 0; i < fov.observer_count; i++) {
+      const HexFovObserver& o = fov.observers[i];
+      const int r = o.cast_radius;
+      const int firstX = (o.cast_col - r < 0 ? 0 : o.cast_col - r) / fov.chunk_size;
+      const int lastX = (o.cast_col + r >= fov.columns ? fov.columns - 1 : o.cast_col + r) / fov.chunk_size;
+      const int firstY = (o.cast_row - r < 0 ? 0 : o.cast_row - r) / fov.chunk_size;
+      const int lastY = (o.cast_row + r >= fov.rows ? fov.rows - 1 : o.cast_row + r) / fov.chunk_size;
+      for (int y = firstY; y <= lastY; y++) {
+        for (int x = firstX; x <= lastX; x++) {
+          const size_t chunk = (size_t)y * (size_t)fov.chunks_x + (size_t)x;
+          if (!fov.chunk_dirty[chunk]) continue;
+          if (pass == 0) first[chunk + 1]++;
+          else fov.bin[first[chunk]++] = (uint32_t)i;
+        }
+      }
+    }
+    if (pass == 0) {
+      for (size_t chunk = 0; chunk < fov.chunk_count; chunk++) first[chunk + 1] += first[chunk];
+      fov.bin.resize(first[fov.chunk_count]);
+    } else {
+      // Fill moved every start to the next bin's, shift back
+      for (size_t chunk = fov.chunk_count; chunk > 0; chunk--) first[chunk] = first[chunk - 1];
+      first[0] = 0;
+    }
+  }
+
+  const uint64_t rowMask = fov.chunk_size == 64 ? ~0ull : (1ull << fov.chunk_size) - 1;
+  jobParallelFor(jobs, fov.merge.size(), 4, [&](size_t begin, size_t end) {
+    for (size_t m = begin; m < end; m++) {
+      const size_t chunk = fov.merge[m];
+      const int firstColumn = (int)(chunk % (size_t)fov.chunks_x) * fov.chunk_size;
+      const int firstRow = (int)(chunk / (size_t)fov.chunks_x) * fov.chunk_size;
+      uint64_t* rows = fov.visible + chunk * (size_t)fov.chunk_size;
+      memset(rows, 0, (size_t)fov.chunk_size * sizeof(uint64_t));
+      for (uint32_t b = first[chunk]; b < first[chunk + 1]; b++) {
+        const HexFovObserver& o = fov.observers[fov.bin[b]];
+        const uint64_t* window = fov.windows + (size_t)fov.bin[b] * HEX_FOV_WINDOW_WORDS;
+        const int r = o.cast_radius;
+        const int shift = o.cast_col - r - firstColumn;  // Window bit 0 lands on chunk bit shift
+        for (int y = 0; y <= 2 * r; y++) {
+          const int local = o.cast_row - r + y - firstRow;
+          if (local < 0 || local >= fov.chunk_size) continue;
+          rows[local] |= (shift >= 0 ? window[y] << shift : window[y] >> -shift) & rowMask;
+        }
+      }
+      fov.chunk_dirty[chunk] = 0;
+    }
+  });
+  fov.stats.chunks_merged = fov.merge.size();
+}
+
+#endif /* _H_HEX_FOV */
@@ -0,0 +1,224 @@
+#ifndef _H_HEX_GRID
+#define _H_HEX_GRID
+
+// Per-tile data in chunk order - the map is cut into the same chunk_size x chunk_size chunks as HexWorld,
+// every chunk is one contiguous block and row-major inside. A tile's neighbours are one chunk row away at
+// most, and a whole chunk of 4 byte tiles is one page, where a row-major map puts the rows above and below
+// a map row away. Measured with `grid` and `fov` headless: sweeps and random neighbour lookups are no faster
+// than row-major (0.7x to 1.1x, noisy), flood fills about even to 1.3x. What it does buy is small walks over
+// a map too big for the cache - FOV casts on a 4096x4096 map run ~1.4x faster, on 1024x1024 the same.
+// Edge chunks are padded to full size, so indexing is shifts and masks only. Padding tiles are zero and never
+// show up in iteration. Tiles are addressed by offset (col, row) or axial coordinates, see hex_coords.cpp.
+#include "../core/memory.cpp"
+#include "hex_coords.cpp"
+#include "hex_world.cpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+constexpr size_t HEX_GRID_NONE = ~(size_t)0;
+
+// Layout shared by HexGrid<T> and HexGridBits - the same index means the same tile in both
+typedef struct HexGridShape {
+  int columns = 0;
+  int rows = 0;
+  int chunk_size = 0;          // Power of two
+  int chunk_shift = 0;         // log2(chunk_size)
+  int chunks_x = 0;
+  int chunks_y = 0;
+  size_t chunk_count = 0;
+  size_t tile_count = 0;       // Padding included, chunk_count * chunk_size^2
+  int32_t step[2][6] = {};     // Index step per direction on even and odd rows, for tiles inside a chunk
+} HexGridShape;
+
+bool initHexGridShape(HexGridShape& shape, int columns, int rows, int chunkSize = HEX_CHUNK_SIZE) {
+  if (columns <= 0 || rows <= 0 || chunkSize < 2 || (chunkSize & (chunkSize - 1)) != 0) return false;
+  shape = {};
+  shape.columns = columns;
+  shape.rows = rows;
+  shape.chunk_size = chunkSize;
+  while ((1 << shape.chunk_shift) < chunkSize) shape.chunk_shift++;
+  shape.chunks_x = (columns + chunkSize - 1) / chunkSize;
+  shape.chunks_y = (rows + chunkSize - 1) / chunkSize;
+  shape.chunk_count = (size_t)shape.chunks_x * (size_t)shape.chunks_y;
+  shape.tile_count = shape.chunk_count << (2 * shape.chunk_shift);
+  for (int parity = 0; parity < 2; parity++) {
+    for (int d = 0; d < 6; d++) shape.step[parity][d] = HEX_DIRECTIONS[d].r * chunkSize + HEX_OFFSET_COLUMN_STEP[parity][d];
+  }
+  return true;
+}
+
+// Chunks line up with the world's, chunk i here is HexWorld::chunks[i]
+inline bool initHexGridShape(HexGridShape& shape, const HexWorld& world) {
+  return initHexGridShape(shape, world.desc.columns, world.desc.rows, world.desc.chunk_size);
+}
+
+inline bool hexGridContains(const HexGridShape& shape, int col, int row) {
+  return col >= 0 && row >= 0 && col < shape.columns && row < shape.rows;
+}
+
+inline size_t hexGridIndex(const HexGridShape& shape, int col, int row) {
+  const int mask = shape.chunk_size - 1;
+  const size_t chunk = (size_t)(row >> shape.chunk_shift) * (size_t)shape.chunks_x + (size_t)(col >> shape.chunk_shift);
+  return (chunk << (2 * shape.chunk_shift)) | ((size_t)(row & mask) << shape.chunk_shift) | (size_t)(col & mask);
+}
+
+inline size_t hexGridIndex(const HexGridShape& shape, HexAxial a) {
+  int col, row;
+  hexAxialToOffset(a, col, row);
+  return hexGridIndex(shape, col, row);
+}
+
+inline void hexGridOffset(const HexGridShape& shape, size_t index, int& col, int& row) {
+  const int mask = shape.chunk_size - 1;
+  const size_t chunk = index >> (2 * shape.chunk_shift);
+  col = (int)(chunk % (size_t)shape.chunks_x) * shape.chunk_size + (int)(index & (size_t)mask);
+  row = (int)(chunk / (size_t)shape.chunks_x) * shape.chunk_size + (int)((index >> shape.chunk_shift) & (size_t)mask);
+}
+
+// Index of the neighbour in direction (HEX_DIRECTIONS order), HEX_GRID_NONE past the map edge
+inline size_t hexGridNeighbour(const HexGridShape& shape, int col, int row, int direction) {
+  const int nextCol = col + HEX_OFFSET_COLUMN_STEP[row & 1][direction];
+  const int nextRow = row + HEX_DIRECTIONS[direction].r;
+  return hexGridContains(shape, nextCol, nextRow) ? hexGridIndex(shape, nextCol, nextRow) : HEX_GRID_NONE;
+}
+
+// All six neighbours of the tile at index, HEX_GRID_NONE past the map edge. Inside a chunk that is six adds off
+// one index - most tiles are, and random lookups are bound by how many of them the CPU keeps in flight, so the
+// fewer instructions a lookup takes the more cache misses overlap.
+inline void hexGridNeighbours(const HexGridShape& shape, size_t index, int col, int row, size_t out[6]) {
+  const unsigned inner = (unsigned)(shape.chunk_size - 2);
+  if ((unsigned)((col & (shape.chunk_size - 1)) - 1) < inner && (unsigned)((row & (shape.chunk_size - 1)) - 1) < inner &&
+      col + 1 < shape.columns && row + 1 < shape.rows) {
+    const int32_t* step = shape.step[row & 1];
+    for (int d = 0; d < 6; d++) out[d] = index + (size_t)(ptrdiff_t)step[d];
+    return;
+  }
+  for (int d = 0; d < 6; d++) out[d] = hexGridNeighbour(shape, col, row, d);
+}
+
+// Same as HexWorld::chunks
+inline HexChunk hexGridChunk(const HexGridShape& shape, size_t chunk) {
+  HexChunk c;
+  c.first_column = (int)(chunk % (size_t)shape.chunks_x) * shape.chunk_size;
+  c.first_row = (int)(chunk / (size_t)shape.chunks_x) * shape.chunk_size;
+  c.columns = shape.columns - c.first_column < shape.chunk_size ? shape.columns - c.first_column : shape.chunk_size;
+  c.rows = shape.rows - c.first_row < shape.chunk_size ? shape.rows - c.first_row : shape.chunk_size;
+  return c;
+}
+
+template <typename T>
+struct HexGrid {
+  static_assert(std::is_trivially_copyable<T>::value, "Tiles are moved around with memcpy");
+  HexGridShape shape;
+  T* tiles = nullptr;          // shape.tile_count, cache line aligned
+};
+
+template <typename T>
+void destroyHexGrid(HexGrid<T>& grid) {
+  alignedFree(grid.tiles);
+  grid = {};
+}
+
+// All tiles zero
+template <typename T>
+bool createHexGrid(HexGrid<T>& grid, const HexGridShape& shape) {
+  grid = {};
+  if (shape.tile_count == 0) return false;
+  grid.shape = shape;
+  grid.tiles = (T*)alignedAlloc(shape.tile_count * sizeof(T));
+  if (!grid.tiles) return false;
+  memset(grid.tiles, 0, shape.tile_count * sizeof(T));
+  return true;
+}
+
+template <typename T>
+inline T& hexGridAt(HexGrid<T>& grid, int col, int row) {
+  return grid.tiles[hexGridIndex(grid.shape, col, row)];
+}
+
+template <typename T>
+inline const T& hexGridAt(const HexGrid<T>& grid, int col, int row) {
+  return grid.tiles[hexGridIndex(grid.shape, col, row)];
+}
+
+template <typename T>
+inline T& hexGridAt(HexGrid<T>& grid, HexAxial a) {
+  return grid.tiles[hexGridIndex(grid.shape, a)];
+}
+
+// chunk_size contiguous tiles, rows of a cache line or more start on one - on edge chunks the part
+// past HexChunk::columns is padding
+template <typename T>
+inline T* hexGridRow(HexGrid<T>& grid, size_t chunk, int localRow) {
+  return grid.tiles + (chunk << (2 * grid.shape.chunk_shift)) + ((size_t)localRow << grid.shape.chunk_shift);
+}
+
+// Every row of every chunk in memory order - fn(T* tiles, int col, int row, int count) gets count contiguous
+// map tiles starting at (col, row), the loop body is a plain array loop the compiler can vectorize
+template <typename T, typename RowFn>
+void forEachHexGridRow(HexGrid<T>& grid, RowFn fn) {
+  for (size_t chunk = 0; chunk < grid.shape.chunk_count; chunk++) {
+    const HexChunk c = hexGridChunk(grid.shape, chunk);
+    for (int r = 0; r < c.rows; r++) fn(hexGridRow(grid, chunk, r), c.first_column, c.first_row + r, c.columns);
+  }
+}
+
+// Row-major map (row * columns + col, like HexTerrain) in and out
+template <typename T>
+void copyHexGridFromRowMajor(HexGrid<T>& grid, const T* source) {
+  forEachHexGridRow(grid, [&](T* tiles, int col, int row, int count) {
+    memcpy(tiles, source + (size_t)row * (size_t)grid.shape.columns + (size_t)col, (size_t)count * sizeof(T));
+  });
+}
+
+template <typename T>
+void copyHexGridToRowMajor(HexGrid<T>& grid, T* out) {
+  forEachHexGridRow(grid, [&](T* tiles, int col, int row, int count) {
+    memcpy(out + (size_t)row * (size_t)grid.shape.columns + (size_t)col, tiles, (size_t)count * sizeof(T));
+  });
+}
+
+// Bit-packed attribute column in the same order - 1, 2, 4 or 8 bits a tile, a value never straddles two words.
+// With 32 tile chunks one 64 bit word holds a chunk row of 2 bit values.
+typedef struct HexGridBits {
+  HexGridShape shape;
+  int bits = 0;
+  int shift = 0;               // log2(bits)
+  size_t word_count = 0;
+  uint64_t* words = nullptr;
+} HexGridBits;
+
+void destroyHexGridBits(HexGridBits& column) {
+  alignedFree(column.words);
+  column = {};
+}
+
+bool createHexGridBits(HexGridBits& column, const HexGridShape& shape, int bits) {
+  column = {};
+  if (shape.tile_count == 0 || (bits != 1 && bits != 2 && bits != 4 && bits != 8)) return false;
+  column.shape = shape;
+  column.bits = bits;
+  while ((1 << column.shift) < bits) column.shift++;
+  column.word_count = ((shape.tile_count << column.shift) + 63) / 64;
+  column.words = (uint64_t*)alignedAlloc(column.word_count * sizeof(uint64_t));
+  if (!column.words) return false;
+  memset(column.words, 0, column.word_count * sizeof(uint64_t));
+  return true;
+}
+
+inline uint32_t hexGridBitsGet(const HexGridBits& column, size_t index) {
+  const size_t bit = index << column.shift;
+  return (uint32_t)(column.words[bit >> 6] >> (bit & 63)) & ((1u << column.bits) - 1);
+}
+
+inline void hexGridBitsSet(HexGridBits& column, size_t index, uint32_t value) {
+  const size_t bit = index << column.shift;
+  const uint64_t mask = (uint64_t)((1u << column.bits) - 1) << (bit & 63);
+  uint64_t& word = column.words[bit >> 6];
+  word = (word & ~mask) | (((uint64_t)value << (bit & 63)) & mask);
+}
+
+#endif /* _H_HEX_GRID */
@@ -0,0 +1,154 @@
+#ifndef _H_HEX_INSTANCES
+#define _H_HEX_INSTANCES
+
+// Per-instance stream for instanced tile rendering - one shared hex mesh, one HexInstance per tile.
+// Platform-neutral, the D3D12 side only maps a buffer and points the packer at it.
+#include "../core/simd.cpp"
+#include "../graphics/vertex_formats.cpp"
+#include "hex_world.cpp"
+
+#include <cstdint>
+
+constexpr int HEX_PALETTE_SIZE = 8;
+// color_index bits 8-15 are a highlight glow, how far the tile color is lifted towards white -
+// the palette lookups only look at the index modulo HEX_PALETTE_SIZE
+constexpr uint32_t HEX_GLOW_SHIFT = 8;
+constexpr uint32_t HEX_GLOW_MASK = 0xffu << HEX_GLOW_SHIFT;
+constexpr float HEX_GLOW_STRENGTH = 0.6f;
+
+inline float hexTileGlow(uint32_t colorIndex) {
+  return (float)((colorIndex & HEX_GLOW_MASK) >> HEX_GLOW_SHIFT) * (HEX_GLOW_STRENGTH / 255.0f);
+}
+
+// Same values as palette[] in win32_instanced_shader - the software rasterizer reads them from here
+static const float HEX_PALETTE[HEX_PALETTE_SIZE][4] = {
+  { 0.20f, 0.55f, 0.25f, 1.0f },
+  { 0.30f, 0.65f, 0.30f, 1.0f },
+  { 0.75f, 0.70f, 0.45f, 1.0f },
+  { 0.55f, 0.45f, 0.30f, 1.0f },
+  { 0.50f, 0.50f, 0.52f, 1.0f },
+  { 0.90f, 0.92f, 0.95f, 1.0f },
+  { 0.20f, 0.40f, 0.75f, 1.0f },
+  { 0.15f, 0.30f, 0.60f, 1.0f }
+};
+
+// 16 bytes per tile, the PER_INSTANCE input elements are generated from VertexLayout<HexInstance> below
+typedef struct HexInstance {
+  float offset_x;        // Tile center on the XZ plane
+  float offset_z;
+  float height;          // Scales the unit-height shared mesh
+  uint32_t color_index;  // Index into the shader palette
+} HexInstance;
+
+static_assert(sizeof(HexInstance) == 16, "HexInstance is uploaded as is");
+
+// Vertex slot 1 of the instanced pipeline, offset_x and offset_z go in as one float2
+template <> struct VertexLayout<HexInstance> {
+  static constexpr VertexAttrib attribs[] = {
+    VERTEX_ATTRIB_AS(HexInstance, offset_x, "OFFSET", VERTEX_ATTRIB_FLOAT2),
+    VERTEX_ATTRIB(HexInstance, height, "HEIGHT"),
+    VERTEX_ATTRIB(HexInstance, color_index, "COLORINDEX")
+  };
+};
+
+static_assert(vertexLayoutIsTight<HexInstance>(), "HexInstance layout has holes");
+
+// Range of instances in the instance buffer - one per chunk, or a merged run of chunks
+typedef struct HexInstanceRange {
+  uint32_t first;
+  uint32_t count;
+} HexInstanceRange;
+
+inline uint32_t hexTileColorIndex(uint32_t seed, int col, int row) {
+  return hexHash((uint32_t)col ^ hexHash((uint32_t)row ^ hexHash(seed))) % HEX_PALETTE_SIZE;
+}
+
+// Reference packer, used as the tail of the SIMD one and to check it
+size_t packHexChunkInstancesScalar(const HexWorld& world, size_t chunk, HexInstance* out) {
+  const HexChunk& c = world.chunks[chunk];
+  size_t n = 0;
+  for (int row = c.first_row; row < c.first_row + c.rows; row++) {
+    for (int col = c.first_column; col < c.first_column + c.columns; col++) {
+      hexOffsetToWorld(col, row, world.desc.radius, out[n].offset_x, out[n].offset_z);
+      out[n].height = world.desc.height;
+      out[n].color_index = hexTileColorIndex(world.desc.seed, col, row);
+      n++;
+    }
+  }
+  return n;
+}
+
+// Packs one chunk, row by row, into out (room for columns * rows instances). out may be mapped
+// upload memory - it is only ever written to, 16 bytes at a time.
+size_t packHexChunkInstances(const HexWorld& world, size_t chunk, HexInstance* out) {
+#if defined(HEX_SIMD_SSE)
+  const HexChunk& c = world.chunks[chunk];
+  const float stepX = world.desc.radius * HEX_SQRT3;
+  const float stepZ = world.desc.radius * 1.5f;
+  const __m128 laneOffset = _mm_set_ps(3.0f, 2.0f, 1.0f, 0.0f);
+  const __m128 height = _mm_set1_ps(world.desc.height);
+  size_t n = 0;
+
+  for (int row = c.first_row; row < c.first_row + c.rows; row++) {
+    const __m128 z = _mm_set1_ps(stepZ * (float)row);
+    const float rowShift = 0.5f * (float)(row & 1);
+    int col = c.first_column;
+    for (; col + 4 <= c.first_column + c.columns; col += 4) {
+      __m128 x = _mm_add_ps(_mm_set1_ps((float)col + rowShift), laneOffset);
+      x = _mm_mul_ps(x, _mm_set1_ps(stepX));
+      __m128 color = _mm_castsi128_ps(_mm_set_epi32(
+          (int)hexTileColorIndex(world.desc.seed, col + 3, row),
+          (int)hexTileColorIndex(world.desc.seed, col + 2, row),
+          (int)hexTileColorIndex(world.desc.seed, col + 1, row),
+          (int)hexTileColorIndex(world.desc.seed, col, row)));
+
+      // SoA -> AoS, each register ends up as one whole HexInstance
+      __m128 r0 = x, r1 = z, r2 = height, r3 = color;
+      _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+      _mm_storeu_ps(&out[n + 0].offset_x, r0);
+      _mm_storeu_ps(&out[n + 1].offset_x, r1);
+      _mm_storeu_ps(&out[n + 2].offset_x, r2);
+      _mm_storeu_ps(&out[n + 3].offset_x, r3);
+      n += 4;
+    }
+    for (; col < c.first_column + c.columns; col++) {
+      hexOffsetToWorld(col, row, world.desc.radius, out[n].offset_x, out[n].offset_z);
+      out[n].height = world.desc.height;
+      out[n].color_index = hexTileColorIndex(world.desc.seed, col, row);
+      n++;
+    }
+  }
+  return n;
+#else
+  return packHexChunkInstancesScalar(world, chunk, out);
+#endif
+}
+
+// Chunk-major layout - chunk i owns ranges[i], returns total instance count
+size_t buildHexInstanceRanges(const HexWorld& world, HexInstanceRange* ranges) {
+  size_t total = 0;
+  for (size_t i = 0; i < world.chunk_count; i++) {
+    ranges[i].first = (uint32_t)total;
+    ranges[i].count = (uint32_t)(world.chunks[i].columns * world.chunks[i].rows);
+    total += ranges[i].count;
+  }
+  return total;
+}
+
+// Turns a sorted visible chunk list into as few instance runs as possible - neighbouring chunks
+// in the same chunk row sit next to each other in the buffer, so they collapse into one draw
+size_t mergeVisibleInstanceRanges(const uint32_t* visible, size_t visibleCount,
+                                  const HexInstanceRange* ranges, HexInstanceRange* out) {
+  size_t n = 0;
+  for (size_t i = 0; i < visibleCount; i++) {
+    const HexInstanceRange& r = ranges[visible[i]];
+    if (n > 0 && out[n - 1].first + out[n - 1].count == r.first) {
+      out[n - 1].count += r.count;
+    } else {
+      out[n++] = r;
+    }
+  }
+  return n;
+}
+
+#endif /* _H_HEX_INSTANCES */
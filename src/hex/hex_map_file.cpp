@@ -0,0 +1,284 @@
+#ifndef _H_HEX_MAP_FILE
+#define _H_HEX_MAP_FILE
+
+// Binary hex map, read straight out of a file mapping - no parse step, opening a map only checks the
+// header and the chunk table. Layout, all little-endian:
+//   HexMapHeader
+//   HexMapChunkEntry[chunk_count]          - same chunk order as HexWorld
+//   per chunk, starting on a page boundary:
+//     HexInstance[tile_count]              - uploadable as is, chunk tiles row by row
+//     VertexHalf[vertex_count]             - with HEX_MAP_MESHES only, positions relative to the chunk origin
+//     uint16_t or uint32_t[index_count]    - index_size per chunk, 16 bits whenever the chunk's vertices fit
+// Meshes are baked cache optimized (mesh_optimize.cpp), flat maps share corners between neighbouring tiles.
+// Page aligned chunks can be brought in and dropped one by one, see hex_map_stream.cpp.
+#include "../core/mapped_file.cpp"
+#include "../graphics/vertex_formats.cpp"
+#include "../graphics/mesh_optimize.cpp"
+#include "hex_mesh.cpp"
+#include "hex_world.cpp"
+#include "hex_instances.cpp"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+constexpr uint32_t HEX_MAP_MAGIC = 0x4d584548;  // "HEXM"
+constexpr uint32_t HEX_MAP_VERSION = 2;         // Bump when anything below changes layout
+constexpr uint64_t HEX_MAP_CHUNK_ALIGNMENT = MAPPED_PAGE_SIZE;
+
+enum HexMapFlags : uint32_t {
+  HEX_MAP_MESHES = 1  // Every chunk carries a pre-built mesh next to its tiles - the window bakes without it and
+                      // draws instanced tiles, only the headless map command writes and reads these meshes so far
+};
+
+typedef struct HexMapHeader {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t header_size;     // sizeof(HexMapHeader) of the writer
+  uint32_t flags;
+  int32_t columns;
+  int32_t rows;
+  int32_t chunk_size;
+  float radius;
+  float height;
+  uint32_t seed;
+  uint32_t chunk_count;
+  uint32_t reserved;
+  uint64_t chunk_table_offset;
+  uint64_t file_size;       // Catches truncated files before anything reads past the end
+} HexMapHeader;
+
+typedef struct HexMapChunkEntry {
+  uint64_t offset;          // Page aligned, tiles start here
+  uint64_t size;            // Tiles and mesh, not counting the padding up to the next chunk
+  uint32_t tile_count;
+  uint32_t vertex_count;
+  uint32_t index_count;
+  uint32_t index_size;      // 2 or 4 bytes, 0 without a mesh
+  float origin_x;           // Mesh positions are relative to this, half floats lose too much far from 0
+  float origin_z;
+} HexMapChunkEntry;
+
+static_assert(sizeof(HexMapHeader) == 64, "HexMapHeader is read from disk as is");
+static_assert(sizeof(HexMapChunkEntry) == 40, "HexMapChunkEntry is read from disk as is");
+
+typedef struct HexMap {
+  MappedFile file;
+  const HexMapHeader* header = nullptr;
+  const HexMapChunkEntry* chunks = nullptr;
+} HexMap;
+
+HexWorldDesc hexMapWorldDesc(const HexMapHeader& header) {
+  HexWorldDesc desc = {};
+  desc.columns = header.columns;
+  desc.rows = header.rows;
+  desc.chunk_size = header.chunk_size;
+  desc.radius = header.radius;
+  desc.height = header.height;
+  desc.seed = header.seed;
+  return desc;
+}
+
+static void hexMapChunkSizes(const HexWorld& world, size_t chunk, uint32_t flags, HexMapChunkEntry& entry) {
+  const HexChunk& c = world.chunks[chunk];
+  entry.tile_count = (uint32_t)(c.columns * c.rows);
+  entry.vertex_count = 0;
+  entry.index_count = 0;
+  entry.index_size = 0;
+  if (flags & HEX_MAP_MESHES) {
+    const bool extruded = world.desc.height > 0.0f;
+    entry.vertex_count = extruded ? entry.tile_count * HEX_PRISM_VERTICES : (uint32_t)hexSharedMeshVertexCount(hexChunkMeshDesc(world, chunk));
+    entry.index_count = entry.tile_count * (extruded ? HEX_PRISM_INDICES : HEX_FLAT_INDICES);
+    entry.index_size = (uint32_t)indexFormatSize(chooseIndexFormat(entry.vertex_count));
+  }
+  entry.size = (uint64_t)entry.tile_count * sizeof(HexInstance) + (uint64_t)entry.vertex_count * sizeof(VertexHalf) +
+               (uint64_t)entry.index_count * entry.index_size;
+  hexOffsetToWorld(c.first_column, c.first_row, world.desc.radius, entry.origin_x, entry.origin_z);
+}
+
+static uint32_t hexPaletteRgba8(uint32_t index) {
+  const float* rgba = HEX_PALETTE[index % HEX_PALETTE_SIZE];
+  uint32_t packed = 0;
+  for (int c = 0; c < 4; c++) packed |= (uint32_t)(rgba[c] * 255.0f + 0.5f) << (8 * c);
+  return packed;
+}
+
+// Chunk mesh that matches the packed tiles - tile heights and palette colors baked into the vertices, then
+// triangles and vertices reordered for the post-transform and fetch caches
+static bool hexMapBakeChunkMesh(const HexWorld& world, size_t chunk, const HexInstance* tiles, const HexMapChunkEntry& entry,
+                                VertexHalf* vertices, void* indices) {
+  HexMesh mesh;
+  const HexMeshDesc desc = hexChunkMeshDesc(world, chunk);
+  if (world.desc.height > 0.0f) {
+    if (!createHexMesh(mesh, desc)) return false;
+    const int vpt = mesh.vertices_per_tile;
+    for (size_t t = 0; t < mesh.tile_count; t++) {
+      const float scale = tiles[t].height / world.desc.height;
+      const uint32_t color = hexPaletteRgba8(tiles[t].color_index);
+      for (size_t v = t * (size_t)vpt; v < (t + 1) * (size_t)vpt; v++) {
+        mesh.pos_y[v] *= scale;
+        mesh.color[v] = color;
+      }
+    }
+  } else {
+    if (!createSharedHexMesh(mesh, desc)) return false;
+    // Tile t's center is vertex t, the only one whose color gets drawn
+    for (size_t t = 0; t < mesh.tile_count; t++) mesh.color[t] = hexPaletteRgba8(tiles[t].color_index);
+  }
+  optimizeHexMesh(mesh);
+  const bool fits = mesh.vertex_count == entry.vertex_count && mesh.index_count == entry.index_count;
+  if (fits) {
+    for (size_t v = 0; v < mesh.vertex_count; v++) {
+      vertices[v].pos.x = floatToHalf(mesh.pos_x[v] - entry.origin_x);
+      vertices[v].pos.y = floatToHalf(mesh.pos_y[v]);
+      vertices[v].pos.z = floatToHalf(mesh.pos_z[v] - entry.origin_z);
+      vertices[v].pos.w = 0x3c00;  // 1.0
+      vertices[v].color.rgba = mesh.color[v];
+    }
+    packIndices(mesh.indices, mesh.index_count, chooseIndexFormat(mesh.vertex_count), indices);
+  }
+  destroyHexMesh(mesh);
+  return fits;
+}
+
+// Writes world as a map file, one chunk at a time - memory use does not grow with the map.
+// packChunk(chunk, HexInstance* out) fills a chunk's tiles, ex. packHexChunkTerrainInstances.
+template <typename PackChunk>
+bool writeHexMap(const char* path, const HexWorld& world, uint32_t flags, PackChunk packChunk) {
+  if (world.chunk_count > 0xffffffffull) return false;
+
+  HexMapHeader header = {};
+  header.magic = HEX_MAP_MAGIC;
+  header.version = HEX_MAP_VERSION;
+  header.header_size = sizeof(HexMapHeader);
+  header.flags = flags;
+  header.columns = world.desc.columns;
+  header.rows = world.desc.rows;
+  header.chunk_size = world.desc.chunk_size;
+  header.radius = world.desc.radius;
+  header.height = world.desc.height;
+  header.seed = world.desc.seed;
+  header.chunk_count = (uint32_t)world.chunk_count;
+  header.chunk_table_offset = sizeof(HexMapHeader);
+
+  // Sizes are known up front, so the file goes out front to back without seeking
+  std::vector<HexMapChunkEntry> table(world.chunk_count);
+  uint64_t offset = alignUp(sizeof(HexMapHeader) + world.chunk_count * sizeof(HexMapChunkEntry), HEX_MAP_CHUNK_ALIGNMENT);
+  size_t largest = 0;
+  for (size_t i = 0; i < world.chunk_count; i++) {
+    table[i] = {};
+    hexMapChunkSizes(world, i, flags, table[i]);
+    table[i].offset = offset;
+    offset = alignUp(offset + table[i].size, HEX_MAP_CHUNK_ALIGNMENT);
+    largest = table[i].size > largest ? (size_t)table[i].size : largest;
+  }
+  header.file_size = offset;
+
+  FILE* file = fopen(path, "wb");
+  if (file == nullptr) return false;
+  bool ok = fwrite(&header, sizeof(header), 1, file) == 1;
+  ok = ok && fwrite(table.data(), sizeof(HexMapChunkEntry), table.size(), file) == table.size();
+  uint64_t written = sizeof(HexMapHeader) + table.size() * sizeof(HexMapChunkEntry);
+
+  // One chunk of scratch, big enough that zeroing it also covers the padding between chunks
+  std::vector<uint8_t> scratch(alignUp(largest, HEX_MAP_CHUNK_ALIGNMENT) + HEX_MAP_CHUNK_ALIGNMENT, 0);
+  for (size_t i = 0; i < world.chunk_count && ok; i++) {
+    const HexMapChunkEntry& entry = table[i];
+    memset(scratch.data(), 0, scratch.size());
+    ok = fwrite(scratch.data(), 1, (size_t)(entry.offset - written), file) == entry.offset - written;
+    HexInstance* tiles = reinterpret_cast<HexInstance*>(scratch.data());
+    packChunk(i, tiles);
+    if (flags & HEX_MAP_MESHES) {
+      VertexHalf* vertices = reinterpret_cast<VertexHalf*>(tiles + entry.tile_count);
+      void* indices = vertices + entry.vertex_count;
+      ok = ok && hexMapBakeChunkMesh(world, i, tiles, entry, vertices, indices);
+    }
+    ok = ok && fwrite(scratch.data(), 1, (size_t)entry.size, file) == entry.size;
+    written = entry.offset + entry.size;
+    if (i + 1 == world.chunk_count) {
+      memset(scratch.data(), 0, scratch.size());
+      ok = ok && fwrite(scratch.data(), 1, (size_t)(header.file_size - written), file) == header.file_size - written;
+    }
+  }
+  ok = ferror(file) == 0 && ok;
+  ok = fclose(file) == 0 && ok;
+  if (!ok) remove(path);
+  return ok;
+}
+
+void closeHexMap(HexMap& map) {
+  closeMappedFile(map.file);
+  map = {};
+}
+
+// Maps the file and checks the header and chunk table against each other - chunk data is not touched,
+// so opening costs the same for any size of map. Returns false for anything this build can not read.
+bool openHexMap(HexMap& map, const char* path) {
+  map = {};
+  if (!openMappedFile(map.file, path)) return false;
+  const uint8_t* data = map.file.data;
+  const uint64_t size = map.file.size;
+  const HexMapHeader* header = reinterpret_cast<const HexMapHeader*>(data);
+  bool ok = size >= sizeof(HexMapHeader) && header->magic == HEX_MAP_MAGIC && header->version == HEX_MAP_VERSION &&
+            header->header_size == sizeof(HexMapHeader) && header->file_size == size &&
+            header->columns > 0 && header->rows > 0 && header->chunk_size > 0 && header->radius > 0.0f &&
+            header->chunk_table_offset >= sizeof(HexMapHeader) &&
+            header->chunk_table_offset + (uint64_t)header->chunk_count * sizeof(HexMapChunkEntry) <= size;
+  if (ok) {
+    const uint64_t chunksX = ((uint64_t)header->columns + header->chunk_size - 1) / header->chunk_size;
+    const uint64_t chunksY = ((uint64_t)header->rows + header->chunk_size - 1) / header->chunk_size;
+    ok = chunksX * chunksY == header->chunk_count;
+  }
+  const HexMapChunkEntry* chunks = ok ? reinterpret_cast<const HexMapChunkEntry*>(data + header->chunk_table_offset) : nullptr;
+  // Tile counts have to match the chunk grid, callers size their buffers from HexWorld
+  const int32_t chunksX = ok ? (header->columns + header->chunk_size - 1) / header->chunk_size : 0;
+  for (uint32_t i = 0; ok && i < header->chunk_count; i++) {
+    const HexMapChunkEntry& entry = chunks[i];
+    const int32_t firstColumn = (int32_t)(i % (uint32_t)chunksX) * header->chunk_size;
+    const int32_t firstRow = (int32_t)(i / (uint32_t)chunksX) * header->chunk_size;
+    const int32_t columns = header->columns - firstColumn < header->chunk_size ? header->columns - firstColumn : header->chunk_size;
+    const int32_t rows = header->rows - firstRow < header->chunk_size ? header->rows - firstRow : header->chunk_size;
+    const uint64_t expected = (uint64_t)entry.tile_count * sizeof(HexInstance) + (uint64_t)entry.vertex_count * sizeof(VertexHalf) +
+                              (uint64_t)entry.index_count * entry.index_size;
+    const bool indexSize = entry.index_count == 0 || entry.index_size == sizeof(uint16_t) ||
+                           (entry.index_size == sizeof(uint32_t) && entry.vertex_count > 0x10000);
+    ok = entry.tile_count == (uint32_t)(columns * rows) && entry.size == expected && indexSize &&
+         entry.offset % HEX_MAP_CHUNK_ALIGNMENT == 0 && entry.offset <= size && entry.size <= size - entry.offset &&
+         ((header->flags & HEX_MAP_MESHES) != 0 || (entry.vertex_count == 0 && entry.index_count == 0));
+  }
+  if (!ok) {
+    closeHexMap(map);
+    return false;
+  }
+  map.header = header;
+  map.chunks = chunks;
+  return true;
+}
+
+inline const HexInstance* hexMapChunkTiles(const HexMap& map, size_t chunk) {
+  return reinterpret_cast<const HexInstance*>(map.file.data + map.chunks[chunk].offset);
+}
+
+inline const VertexHalf* hexMapChunkVertices(const HexMap& map, size_t chunk) {
+  return reinterpret_cast<const VertexHalf*>(hexMapChunkTiles(map, chunk) + map.chunks[chunk].tile_count);
+}
+
+// uint16_t or uint32_t, see hexMapChunkIndexFormat
+inline const void* hexMapChunkIndices(const HexMap& map, size_t chunk) {
+  return hexMapChunkVertices(map, chunk) + map.chunks[chunk].vertex_count;
+}
+
+inline IndexFormat hexMapChunkIndexFormat(const HexMap& map, size_t chunk) {
+  return map.chunks[chunk].index_size == sizeof(uint32_t) ? INDEX_FORMAT_32 : INDEX_FORMAT_16;
+}
+
+// Straight from the mapping into out, ex. mapped upload memory - one memcpy, no staging. Returns tiles copied.
+inline size_t copyHexMapChunkTiles(const HexMap& map, size_t chunk, HexInstance* out) {
+  const HexMapChunkEntry& entry = map.chunks[chunk];
+  memcpy(out, hexMapChunkTiles(map, chunk), entry.tile_count * sizeof(HexInstance));
+  return entry.tile_count;
+}
+
+#endif /* _H_HEX_MAP_FILE */
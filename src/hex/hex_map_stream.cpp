@@ -0,0 +1,257 @@
+#ifndef _H_HEX_MAP_STREAM
+#define _H_HEX_MAP_STREAM
+
+// Keeps the chunks of a mapped HexMap that are near a focus point resident, on a thread of its own.
+// Loading a chunk means faulting its pages in, so the frame thread can memcpy it into upload memory without
+// ever waiting on the disk. Chunks that fall behind are dropped from the process again, which keeps
+// the resident set at what is around the camera, no matter how big the file is.
+// Reading a chunk the streamer has just dropped is still fine - it only pages back in on the reader's time.
+#include "../core/mapped_file.cpp"
+#include "../core/profiler.cpp"
+#include "../core/timer.cpp"
+#include "hex_map_file.cpp"
+#include "hex_world.cpp"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+constexpr int HEX_MAP_STREAM_BATCH = 16;  // Chunks loaded between checks for a newer focus
+
+enum HexChunkResidency : uint8_t {
+  HEX_CHUNK_UNLOADED = 0,
+  HEX_CHUNK_RESIDENT = 1
+};
+
+typedef struct HexMapStreamDesc {
+  float load_radius = 64.0f;   // World units around the focus, measured to the chunk box
+  float evict_radius = 96.0f;  // The gap to load_radius keeps chunks on the edge from coming and going
+} HexMapStreamDesc;
+
+typedef struct HexMapStreamStats {
+  uint64_t loaded = 0;
+  uint64_t evicted = 0;
+  uint64_t loaded_bytes = 0;
+  uint32_t resident = 0;
+  uint64_t resident_bytes = 0;
+  ProfileFrameStats latency;   // From the focus update that first wanted a chunk until it was resident
+} HexMapStreamStats;
+
+typedef struct HexMapStreamer {
+  const HexMap* map = nullptr;
+  const HexWorld* world = nullptr;
+  HexMapStreamDesc desc;
+  std::atomic<uint8_t>* residency = nullptr;  // Per chunk, written by the stream thread only
+  std::thread thread;
+
+  std::mutex mutex;              // Guards everything down to latency
+  std::condition_variable wake;
+  float focus_x = 0.0f;
+  float focus_z = 0.0f;
+  uint64_t focus_ns = 0;
+  uint32_t focus_generation = 0;
+  bool quit = false;
+  RollingStats latency;
+
+  std::atomic<uint32_t> seen_generation{0};  // Newest focus the stream thread has started on
+  std::atomic<uint64_t> loaded{0};
+  std::atomic<uint64_t> evicted{0};
+  std::atomic<uint64_t> loaded_bytes{0};
+  std::atomic<uint32_t> resident_count{0};
+  std::atomic<uint64_t> resident_bytes{0};
+
+  // Stream thread only
+  std::vector<uint32_t> resident;
+  std::vector<std::pair<float, uint32_t>> wanted;
+  uint64_t* wanted_since = nullptr;  // Focus time a chunk started being wanted
+  uint32_t* wanted_pass = nullptr;   // Last pass that wanted it
+} HexMapStreamer;
+
+inline bool hexMapChunkResident(const HexMapStreamer& streamer, size_t chunk) {
+  return streamer.residency[chunk].load(std::memory_order_acquire) == HEX_CHUNK_RESIDENT;
+}
+
+// Squared XZ distance from a point to a chunk box, 0 inside
+static inline float hexChunkDistanceSq(const HexWorld& world, size_t chunk, float x, float z) {
+  const float dx = x < world.bounds.min_x[chunk] ? world.bounds.min_x[chunk] - x : (x > world.bounds.max_x[chunk] ? x - world.bounds.max_x[chunk] : 0.0f);
+  const float dz = z < world.bounds.min_z[chunk] ? world.bounds.min_z[chunk] - z : (z > world.bounds.max_z[chunk] ? z - world.bounds.max_z[chunk] : 0.0f);
+  return dx * dx + dz * dz;
+}
+
+static inline uint64_t hexMapChunkBytes(const HexMap& map, size_t chunk) {
+  return alignUp(map.chunks[chunk].size, HEX_MAP_CHUNK_ALIGNMENT);
+}
+
+// Chunks whose boxes come within radius of (x, z), nearest first
+static void hexMapWantedChunks(HexMapStreamer& streamer, float x, float z) {
+  const HexWorld& world = *streamer.world;
+  const float radius = streamer.desc.load_radius;
+  const float chunkWidth = (float)world.desc.chunk_size * world.desc.radius * HEX_SQRT3;
+  const float chunkDepth = (float)world.desc.chunk_size * world.desc.radius * 1.5f;
+  // One chunk of slack on each side covers the half tiles boxes stick out by, the exact test is below
+  auto clampChunk = [](float v, int count) { return v < 0.0f ? 0 : (v >= (float)count ? count - 1 : (int)v); };
+  const int cx0 = clampChunk((x - radius) / chunkWidth - 1.0f, world.chunks_x);
+  const int cx1 = clampChunk((x + radius) / chunkWidth + 1.0f, world.chunks_x);
+  const int cz0 = clampChunk((z - radius) / chunkDepth - 1.0f, world.chunks_y);
+  const int cz1 = clampChunk((z + radius) / chunkDepth + 1.0f, world.chunks_y);
+
+  streamer.wanted.clear();
+  for (int cz = cz0; cz <= cz1; cz++) {
+    for (int cx = cx0; cx <= cx1; cx++) {
+      const uint32_t chunk = (uint32_t)cz * (uint32_t)world.chunks_x + (uint32_t)cx;
+      const float distanceSq = hexChunkDistanceSq(world, chunk, x, z);
+      if (distanceSq <= radius * radius) streamer.wanted.push_back({ distanceSq, chunk });
+    }
+  }
+  std::sort(streamer.wanted.begin(), streamer.wanted.end());
+}
+
+static void hexMapStreamMain(HexMapStreamer* streamer) {
+  profilerSetThreadName("map stream");
+  const HexMap& map = *streamer->map;
+  const HexWorld& world = *streamer->world;
+  uint32_t pass = 1;  // wanted_pass starts at 0, which must not look like the previous pass
+
+  for (;;) {
+    float x, z;
+    uint64_t focusNs;
+    {
+      std::unique_lock<std::mutex> lock(streamer->mutex);
+      streamer->wake.wait(lock, [&] { return streamer->quit || streamer->focus_generation != streamer->seen_generation.load(std::memory_order_relaxed); });
+      if (streamer->quit) return;
+      x = streamer->focus_x;
+      z = streamer->focus_z;
+      focusNs = streamer->focus_ns;
+      streamer->seen_generation.store(streamer->focus_generation, std::memory_order_relaxed);
+    }
+    PROFILE_SCOPE("stream chunks");
+    pass++;
+
+    // Evict first, so the resident set never holds both the old and the new surroundings
+    const float evictSq = streamer->desc.evict_radius * streamer->desc.evict_radius;
+    for (size_t i = 0; i < streamer->resident.size();) {
+      const uint32_t chunk = streamer->resident[i];
+      if (hexChunkDistanceSq(world, chunk, x, z) <= evictSq) {
+        i++;
+        continue;
+      }
+      streamer->residency[chunk].store(HEX_CHUNK_UNLOADED, std::memory_order_release);
+      mappedFileEvict(map.file, map.chunks[chunk].offset, hexMapChunkBytes(map, chunk));
+      streamer->resident[i] = streamer->resident.back();
+      streamer->resident.pop_back();
+      streamer->evicted.fetch_add(1, std::memory_order_relaxed);
+      streamer->resident_count.fetch_sub(1, std::memory_order_relaxed);
+      streamer->resident_bytes.fetch_sub(hexMapChunkBytes(map, chunk), std::memory_order_relaxed);
+    }
+
+    hexMapWantedChunks(*streamer, x, z);
+    for (const auto& wanted : streamer->wanted) {
+      // Chunks that were not wanted last pass start their clock with this focus
+      if (streamer->wanted_pass[wanted.second] + 1 != pass) streamer->wanted_since[wanted.second] = focusNs;
+      streamer->wanted_pass[wanted.second] = pass;
+    }
+
+    int batch = 0;
+    for (const auto& wanted : streamer->wanted) {
+      const uint32_t chunk = wanted.second;
+      if (streamer->residency[chunk].load(std::memory_order_relaxed) == HEX_CHUNK_RESIDENT) continue;
+      const uint64_t bytes = hexMapChunkBytes(map, chunk);
+      mappedFilePrefetch(map.file, map.chunks[chunk].offset, bytes);
+      streamer->residency[chunk].store(HEX_CHUNK_RESIDENT, std::memory_order_release);
+      streamer->resident.push_back(chunk);
+      streamer->loaded.fetch_add(1, std::memory_order_relaxed);
+      streamer->loaded_bytes.fetch_add(bytes, std::memory_order_relaxed);
+      streamer->resident_count.fetch_add(1, std::memory_order_relaxed);
+      streamer->resident_bytes.fetch_add(bytes, std::memory_order_relaxed);
+      const float latencyMs = (float)((double)(timerNanoseconds() - streamer->wanted_since[chunk]) / 1000000.0);
+      {
+        std::lock_guard<std::mutex> lock(streamer->mutex);
+        rollingStatsAdd(streamer->latency, latencyMs);
+      }
+
+      // A newer focus wins over the rest of this one, the camera has moved on
+      if (++batch % HEX_MAP_STREAM_BATCH == 0) {
+        std::lock_guard<std::mutex> lock(streamer->mutex);
+        if (streamer->quit || streamer->focus_generation != streamer->seen_generation.load(std::memory_order_relaxed)) break;
+      }
+    }
+  }
+}
+
+void stopHexMapStreamer(HexMapStreamer& streamer) {
+  if (streamer.thread.joinable()) {
+    {
+      std::lock_guard<std::mutex> lock(streamer.mutex);
+      streamer.quit = true;
+    }
+    streamer.wake.notify_one();
+    streamer.thread.join();
+  }
+  delete[] streamer.residency;
+  free(streamer.wanted_since);
+  free(streamer.wanted_pass);
+  streamer.residency = nullptr;
+  streamer.wanted_since = nullptr;
+  streamer.wanted_pass = nullptr;
+  streamer.resident.clear();
+  streamer.wanted.clear();
+}
+
+// world has to be created from the map's header. Nothing loads until the first hexMapStreamFocus.
+bool startHexMapStreamer(HexMapStreamer& streamer, const HexMap& map, const HexWorld& world, const HexMapStreamDesc& desc) {
+  if (map.header == nullptr || map.header->chunk_count != world.chunk_count) return false;
+  streamer.map = &map;
+  streamer.world = &world;
+  streamer.desc = desc;
+  streamer.quit = false;
+  streamer.focus_generation = 0;
+  streamer.seen_generation.store(0, std::memory_order_relaxed);
+  streamer.latency = {};
+  streamer.loaded.store(0, std::memory_order_relaxed);
+  streamer.evicted.store(0, std::memory_order_relaxed);
+  streamer.loaded_bytes.store(0, std::memory_order_relaxed);
+  streamer.resident_count.store(0, std::memory_order_relaxed);
+  streamer.resident_bytes.store(0, std::memory_order_relaxed);
+  streamer.residency = new std::atomic<uint8_t>[world.chunk_count];
+  streamer.wanted_since = (uint64_t*)calloc(world.chunk_count, sizeof(uint64_t));
+  streamer.wanted_pass = (uint32_t*)calloc(world.chunk_count, sizeof(uint32_t));
+  if (streamer.wanted_since == nullptr || streamer.wanted_pass == nullptr) {
+    stopHexMapStreamer(streamer);
+    return false;
+  }
+  for (size_t i = 0; i < world.chunk_count; i++) streamer.residency[i].store(HEX_CHUNK_UNLOADED, std::memory_order_relaxed);
+  streamer.thread = std::thread(hexMapStreamMain, &streamer);
+  return true;
+}
+
+// Cheap, call every frame - the stream thread only wakes up when the focus actually moved
+void hexMapStreamFocus(HexMapStreamer& streamer, float x, float z) {
+  {
+    std::lock_guard<std::mutex> lock(streamer.mutex);
+    if (streamer.focus_generation != 0 && streamer.focus_x == x && streamer.focus_z == z) return;
+    streamer.focus_x = x;
+    streamer.focus_z = z;
+    streamer.focus_ns = timerNanoseconds();
+    streamer.focus_generation++;
+  }
+  streamer.wake.notify_one();
+}
+
+HexMapStreamStats hexMapStreamStats(HexMapStreamer& streamer) {
+  HexMapStreamStats stats = {};
+  stats.loaded = streamer.loaded.load(std::memory_order_relaxed);
+  stats.evicted = streamer.evicted.load(std::memory_order_relaxed);
+  stats.loaded_bytes = streamer.loaded_bytes.load(std::memory_order_relaxed);
+  stats.resident = streamer.resident_count.load(std::memory_order_relaxed);
+  stats.resident_bytes = streamer.resident_bytes.load(std::memory_order_relaxed);
+  std::lock_guard<std::mutex> lock(streamer.mutex);
+  stats.latency = rollingStatsSummary(streamer.latency);
+  return stats;
+}
+
+#endif /* _H_HEX_MAP_STREAM */
@@ -0,0 +1,331 @@
+#ifndef _H_HEX_MESH
+#define _H_HEX_MESH
+
+// Platform-neutral hex plane generator - no <windows.h> or DirectXMath in here,
+// so meshes can be built and checked on headless boxes before anything gets uploaded.
+#include "../core/simd.cpp"
+#include "../core/memory.cpp"
+#include "hex_coords.cpp"
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+// Per tile layout - slot 0 is the center, 1..6 top corners, 7..12 bottom corners (extruded only)
+constexpr int HEX_FLAT_VERTICES = 7;
+constexpr int HEX_FLAT_INDICES = 6 * 3;
+constexpr int HEX_PRISM_VERTICES = 13;
+constexpr int HEX_PRISM_INDICES = HEX_FLAT_INDICES + 6 * 2 * 3;
+
+// Kernels store whole SIMD registers per tile and let the next tile overwrite the tail,
+// so every buffer gets this much slack at the end
+constexpr int HEX_MESH_PADDING = 64;
+
+typedef struct HexMeshDesc {
+  int columns = 1;
+  int rows = 1;
+  int first_column = 0;   // Offset of tile (0, 0) in a bigger map - chunks use it, colors stay stable across chunks
+  int first_row = 0;
+  float radius = HEX_DEFAULT_RADIUS;
+  float height = 0.0f;    // 0 gives flat hexes, anything above extrudes them into prisms standing on y = 0
+  uint32_t seed = 0;      // Tile colors are hashed from this, same seed - same mesh
+} HexMeshDesc;
+
+// Structure-of-arrays mesh, vertices of one tile are contiguous (tile t owns [t * vertices_per_tile, ...))
+typedef struct HexMesh {
+  float* pos_x = nullptr;
+  float* pos_y = nullptr;
+  float* pos_z = nullptr;
+  uint32_t* color = nullptr;    // RGBA8, red in the lowest byte - same as DXGI_FORMAT_R8G8B8A8_UNORM
+  uint32_t* indices = nullptr;  // Clockwise triangles, matches CullMode BACK with FrontCounterClockwise FALSE
+  size_t tile_count = 0;
+  size_t vertex_count = 0;
+  size_t index_count = 0;
+  int vertices_per_tile = 0;    // 0 once vertices are shared between tiles or reordered, see mesh_optimize.cpp
+  int indices_per_tile = 0;
+} HexMesh;
+
+// Index pattern of a single tile, local to that tile's first vertex
+static int hexTileIndexPattern(bool extruded, uint32_t* out) {
+  int n = 0;
+  for (int i = 0; i < 6; i++) {
+    int next = (i + 1) % 6;
+    out[n++] = 0;
+    out[n++] = 1 + next;
+    out[n++] = 1 + i;
+  }
+  if (extruded) {
+    for (int i = 0; i < 6; i++) {
+      int next = (i + 1) % 6;
+      uint32_t top0 = 1 + i, top1 = 1 + next;
+      uint32_t bottom0 = 7 + i, bottom1 = 7 + next;
+      out[n++] = top0; out[n++] = top1;    out[n++] = bottom1;
+      out[n++] = top0; out[n++] = bottom1; out[n++] = bottom0;
+    }
+  }
+  return n;
+}
+
+static uint32_t hexTileColor(uint32_t seed, int col, int row) {
+  // Alpha forced to 255, rgb straight from the hash
+  return hexHash((uint32_t)col ^ hexHash((uint32_t)row ^ hexHash(seed))) | 0xff000000u;
+}
+
+// Writes `count` lanes of (base + pattern[i]) starting at dst, rounded up to whole registers
+static inline void hexStoreOffsetFloats(float* dst, const float* pattern, float base, int count) {
+#if defined(HEX_SIMD_AVX2)
+  __m256 b = _mm256_set1_ps(base);
+  for (int i = 0; i < count; i += 8) _mm256_storeu_ps(dst + i, _mm256_add_ps(b, _mm256_loadu_ps(pattern + i)));
+#elif defined(HEX_SIMD_SSE)
+  __m128 b = _mm_set1_ps(base);
+  for (int i = 0; i < count; i += 4) _mm_storeu_ps(dst + i, _mm_add_ps(b, _mm_loadu_ps(pattern + i)));
+#elif defined(HEX_SIMD_NEON)
+  float32x4_t b = vdupq_n_f32(base);
+  for (int i = 0; i < count; i += 4) vst1q_f32(dst + i, vaddq_f32(b, vld1q_f32(pattern + i)));
+#else
+  for (int i = 0; i < count; i++) dst[i] = base + pattern[i];
+#endif
+}
+
+static inline void hexStoreOffsetInts(uint32_t* dst, const uint32_t* pattern, uint32_t base, int count) {
+#if defined(HEX_SIMD_AVX2)
+  __m256i b = _mm256_set1_epi32((int)base);
+  for (int i = 0; i < count; i += 8) {
+    __m256i p = _mm256_loadu_si256((const __m256i*)(pattern + i));
+    _mm256_storeu_si256((__m256i*)(dst + i), _mm256_add_epi32(b, p));
+  }
+#elif defined(HEX_SIMD_SSE)
+  __m128i b = _mm_set1_epi32((int)base);
+  for (int i = 0; i < count; i += 4) {
+    __m128i p = _mm_loadu_si128((const __m128i*)(pattern + i));
+    _mm_storeu_si128((__m128i*)(dst + i), _mm_add_epi32(b, p));
+  }
+#elif defined(HEX_SIMD_NEON)
+  uint32x4_t b = vdupq_n_u32(base);
+  for (int i = 0; i < count; i += 4) vst1q_u32(dst + i, vaddq_u32(b, vld1q_u32(pattern + i)));
+#else
+  for (int i = 0; i < count; i++) dst[i] = base + pattern[i];
+#endif
+}
+
+static inline void hexStoreBroadcast(uint32_t* dst, uint32_t value, int count) {
+#if defined(HEX_SIMD_AVX2)
+  __m256i v = _mm256_set1_epi32((int)value);
+  for (int i = 0; i < count; i += 8) _mm256_storeu_si256((__m256i*)(dst + i), v);
+#elif defined(HEX_SIMD_SSE)
+  __m128i v = _mm_set1_epi32((int)value);
+  for (int i = 0; i < count; i += 4) _mm_storeu_si128((__m128i*)(dst + i), v);
+#elif defined(HEX_SIMD_NEON)
+  uint32x4_t v = vdupq_n_u32(value);
+  for (int i = 0; i < count; i += 4) vst1q_u32(dst + i, v);
+#else
+  for (int i = 0; i < count; i++) dst[i] = value;
+#endif
+}
+
+void destroyHexMesh(HexMesh& mesh) {
+  alignedFree(mesh.pos_x);
+  alignedFree(mesh.pos_y);
+  alignedFree(mesh.pos_z);
+  alignedFree(mesh.color);
+  alignedFree(mesh.indices);
+  mesh = {};
+}
+
+// Fills tiles [firstTile, firstTile + tileCount) of a mesh that was already allocated for desc.
+// Split out so callers (chunks, jobs) can generate sub ranges in parallel - the last tile of a range
+// is stored exactly, so it never spills into a tile another thread owns.
+void generateHexMeshTiles(HexMesh& mesh, const HexMeshDesc& desc, size_t firstTile, size_t tileCount) {
+  const bool extruded = desc.height > 0.0f;
+  const int vpt = mesh.vertices_per_tile;
+  const int ipt = mesh.indices_per_tile;
+
+  // Per slot offsets from tile center, padded with zeros to a whole register
+  alignas(32) float offX[HEX_MESH_PADDING] = {};
+  alignas(32) float offY[HEX_MESH_PADDING] = {};
+  alignas(32) float offZ[HEX_MESH_PADDING] = {};
+  alignas(32) uint32_t pattern[HEX_MESH_PADDING] = {};
+  for (int i = 0; i < 6; i++) {
+    hexCornerOffset(i, desc.radius, offX[1 + i], offZ[1 + i]);
+    offY[1 + i] = extruded ? desc.height : 0.0f;
+    if (extruded) {
+      offX[7 + i] = offX[1 + i];
+      offZ[7 + i] = offZ[1 + i];
+      offY[7 + i] = 0.0f;
+    }
+  }
+  offY[0] = extruded ? desc.height : 0.0f;
+  hexTileIndexPattern(extruded, pattern);
+
+  const int vertexLanes = (vpt + SIMD_WIDTH - 1) / SIMD_WIDTH * SIMD_WIDTH;
+  const int indexLanes = (ipt + SIMD_WIDTH - 1) / SIMD_WIDTH * SIMD_WIDTH;
+  const float stepX = desc.radius * HEX_SQRT3;
+  const float stepZ = desc.radius * 1.5f;
+
+  const size_t lastTile = firstTile + tileCount;
+  for (size_t t = firstTile; t < lastTile; t++) {
+    const int row = desc.first_row + (int)(t / (size_t)desc.columns);
+    const int col = desc.first_column + (int)(t % (size_t)desc.columns);
+    const float cx = stepX * ((float)col + 0.5f * (float)(row & 1));
+    const float cz = stepZ * (float)row;
+    const size_t v = t * (size_t)vpt;
+
+    if (t + 1 == lastTile && lastTile < mesh.tile_count) {
+      const uint32_t color = hexTileColor(desc.seed, col, row);
+      for (int i = 0; i < vpt; i++) {
+        mesh.pos_x[v + i] = cx + offX[i];
+        mesh.pos_y[v + i] = 0.0f + offY[i];
+        mesh.pos_z[v + i] = cz + offZ[i];
+        mesh.color[v + i] = color;
+      }
+      for (int i = 0; i < ipt; i++) mesh.indices[t * (size_t)ipt + i] = (uint32_t)v + pattern[i];
+      continue;
+    }
+
+    hexStoreOffsetFloats(mesh.pos_x + v, offX, cx, vertexLanes);
+    hexStoreOffsetFloats(mesh.pos_y + v, offY, 0.0f, vertexLanes);
+    hexStoreOffsetFloats(mesh.pos_z + v, offZ, cz, vertexLanes);
+    hexStoreBroadcast(mesh.color + v, hexTileColor(desc.seed, col, row), vertexLanes);
+    hexStoreOffsetInts(mesh.indices + t * (size_t)ipt, pattern, (uint32_t)v, indexLanes);
+  }
+}
+
+bool allocateHexMesh(HexMesh& mesh, const HexMeshDesc& desc) {
+  if (desc.columns <= 0 || desc.rows <= 0 || desc.radius <= 0.0f) return false;
+
+  const bool extruded = desc.height > 0.0f;
+  mesh = {};
+  mesh.tile_count = (size_t)desc.columns * (size_t)desc.rows;
+  mesh.vertices_per_tile = extruded ? HEX_PRISM_VERTICES : HEX_FLAT_VERTICES;
+  mesh.indices_per_tile = extruded ? HEX_PRISM_INDICES : HEX_FLAT_INDICES;
+  mesh.vertex_count = mesh.tile_count * mesh.vertices_per_tile;
+  mesh.index_count = mesh.tile_count * mesh.indices_per_tile;
+  if (mesh.vertex_count > 0xffffffffull) return false;
+
+  const size_t vertexBytes = (mesh.vertex_count + HEX_MESH_PADDING) * sizeof(float);
+  mesh.pos_x = (float*)alignedAlloc(vertexBytes);
+  mesh.pos_y = (float*)alignedAlloc(vertexBytes);
+  mesh.pos_z = (float*)alignedAlloc(vertexBytes);
+  mesh.color = (uint32_t*)alignedAlloc(vertexBytes);
+  mesh.indices = (uint32_t*)alignedAlloc((mesh.index_count + HEX_MESH_PADDING) * sizeof(uint32_t));
+  if (!mesh.pos_x || !mesh.pos_y || !mesh.pos_z || !mesh.color || !mesh.indices) {
+    destroyHexMesh(mesh);
+    return false;
+  }
+  return true;
+}
+
+// Builds columns x rows hex plane in one go. Returns false on bad desc or failed allocation.
+bool createHexMesh(HexMesh& mesh, const HexMeshDesc& desc) {
+  if (!allocateHexMesh(mesh, desc)) return false;
+  generateHexMeshTiles(mesh, desc, 0, mesh.tile_count);
+  return true;
+}
+
+// Corner i of a tile on an integer lattice - x in steps of sqrt(3)/2 * radius, z in steps of radius / 2.
+// Neighbouring tiles land on the same lattice points, that is what makes the corners shareable.
+static const int HEX_CORNER_LATTICE_X[6] = { 1, 1, 0, -1, -1, 0 };
+static const int HEX_CORNER_LATTICE_Z[6] = { -1, 1, 2, 1, -1, -2 };
+
+// Vertex of every tile corner (tile_count * 6 entries) for the shared topology. Corners are numbered after the
+// tile centers, in first use order. Returns the vertex count, 0 if scratch could not be allocated.
+static size_t hexSharedCorners(const HexMeshDesc& desc, uint32_t* cornerVertex) {
+  // Lattice cells the chunk can touch, relative to its first tile
+  const int width = 2 * desc.columns + 3;
+  const int height = 3 * desc.rows + 2;
+  uint32_t* lattice = (uint32_t*)malloc((size_t)width * (size_t)height * sizeof(uint32_t));
+  if (lattice == nullptr) return 0;
+  memset(lattice, 0xff, (size_t)width * (size_t)height * sizeof(uint32_t));
+
+  const size_t tileCount = (size_t)desc.columns * (size_t)desc.rows;
+  uint32_t next = (uint32_t)tileCount;
+  for (int r = 0; r < desc.rows; r++) {
+    const int parity = (desc.first_row + r) & 1;
+    for (int c = 0; c < desc.columns; c++) {
+      const size_t t = (size_t)r * (size_t)desc.columns + (size_t)c;
+      for (int i = 0; i < 6; i++) {
+        const int x = 2 * c + parity + HEX_CORNER_LATTICE_X[i] + 1;
+        const int z = 3 * r + HEX_CORNER_LATTICE_Z[i] + 2;
+        uint32_t& vertex = lattice[(size_t)z * (size_t)width + (size_t)x];
+        if (vertex == UINT32_MAX) vertex = next++;
+        cornerVertex[t * 6 + i] = vertex;
+      }
+    }
+  }
+  free(lattice);
+  return next;
+}
+
+// Vertex count of createSharedHexMesh for desc, without building it
+size_t hexSharedMeshVertexCount(const HexMeshDesc& desc) {
+  if (desc.columns <= 0 || desc.rows <= 0) return 0;
+  uint32_t* corners = (uint32_t*)malloc((size_t)desc.columns * (size_t)desc.rows * 6 * sizeof(uint32_t));
+  if (corners == nullptr) return 0;
+  const size_t count = hexSharedCorners(desc, corners);
+  free(corners);
+  return count;
+}
+
+// Flat plane where neighbouring tiles share corners - about 3 vertices per tile instead of 7. Tile t keeps its
+// center at vertex t with the tile color; shared corners can only carry one tile's color, so shaders read color
+// from the provoking vertex (nointerpolation), which is always the center. Prisms keep per tile vertices, walls
+// and tops of neighbours differ in height. Returns false for extruded descs.
+bool createSharedHexMesh(HexMesh& mesh, const HexMeshDesc& desc) {
+  if (desc.height > 0.0f) return false;
+  if (!allocateHexMesh(mesh, desc)) return false;
+  uint32_t* corners = (uint32_t*)malloc(mesh.tile_count * 6 * sizeof(uint32_t));
+  const size_t vertexCount = corners ? hexSharedCorners(desc, corners) : 0;
+  if (vertexCount == 0) {
+    free(corners);
+    destroyHexMesh(mesh);
+    return false;
+  }
+
+  const float stepX = desc.radius * HEX_SQRT3 * 0.5f;
+  const float stepZ = desc.radius * 0.5f;
+  for (int r = 0; r < desc.rows; r++) {
+    const int row = desc.first_row + r;
+    for (int c = 0; c < desc.columns; c++) {
+      const int col = desc.first_column + c;
+      const size_t t = (size_t)r * (size_t)desc.columns + (size_t)c;
+      const int centerX = 2 * col + (row & 1);
+      const int centerZ = 3 * row;
+      const uint32_t color = hexTileColor(desc.seed, col, row);
+      mesh.pos_x[t] = stepX * (float)centerX;
+      mesh.pos_y[t] = 0.0f;
+      mesh.pos_z[t] = stepZ * (float)centerZ;
+      mesh.color[t] = color;
+      for (int i = 0; i < 6; i++) {
+        // Rewritten by every tile that shares the corner, with the same position
+        const uint32_t v = corners[t * 6 + i];
+        mesh.pos_x[v] = stepX * (float)(centerX + HEX_CORNER_LATTICE_X[i]);
+        mesh.pos_y[v] = 0.0f;
+        mesh.pos_z[v] = stepZ * (float)(centerZ + HEX_CORNER_LATTICE_Z[i]);
+        mesh.color[v] = color;
+      }
+      uint32_t* indices = mesh.indices + t * HEX_FLAT_INDICES;
+      for (int i = 0; i < 6; i++) {
+        indices[i * 3 + 0] = (uint32_t)t;
+        indices[i * 3 + 1] = corners[t * 6 + (i + 1) % 6];
+        indices[i * 3 + 2] = corners[t * 6 + i];
+      }
+    }
+  }
+  free(corners);
+  mesh.vertex_count = vertexCount;
+  mesh.vertices_per_tile = 0;
+  return true;
+}
+
+// Sanity check for headless runs - every index in range, no degenerate triangles
+bool validateHexMesh(const HexMesh& mesh) {
+  if (mesh.index_count % 3 != 0) return false;
+  for (size_t i = 0; i < mesh.index_count; i += 3) {
+    uint32_t a = mesh.indices[i], b = mesh.indices[i + 1], c = mesh.indices[i + 2];
+    if (a >= mesh.vertex_count || b >= mesh.vertex_count || c >= mesh.vertex_count) return false;
+    if (a == b || b == c || a == c) return false;
+  }
+  return true;
+}
+
+#endif /* _H_HEX_MESH */
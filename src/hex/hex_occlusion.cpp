@@ -0,0 +1,229 @@
+#ifndef _H_HEX_OCCLUSION
+#define _H_HEX_OCCLUSION
+
+// Occlusion culling for hex chunks on top of the frustum test - the nearest visible chunks are drawn into
+// a low resolution depth buffer as solid blocks of tiles, and every visible chunk whose boxes all end up
+// behind them is dropped before draws are recorded. Only worth it with the camera low over hilly terrain, and
+// even there the boxes hide a small share of what really is hidden - `occlusion` headless measures it.
+//
+// A block is a rectangle of tiles squeezed down to its lowest tile and to the part of the plane its tiles
+// cover for sure, so it never sticks out of the real terrain - an occluder that is too small only culls less.
+// Neighbouring blocks of a row about as tall as each other go out as one box at the lowest one's height,
+// about half the boxes for the same culling.
+#include "../core/profiler.cpp"
+#include "../core/timer.cpp"
+#include "../software/sw_occlusion.cpp"
+#include "hex_instances.cpp"
+#include "hex_world.cpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+constexpr int HEX_OCCLUDER_BLOCKS = 16;     // Occluder blocks per chunk side, 2x2 tiles in a 32 tile chunk
+constexpr int HEX_OCCLUDEE_BLOCKS = 4;      // Test boxes per chunk side, a chunk is hidden when all of them are
+constexpr size_t HEX_OCCLUDER_CHUNKS = 8;   // Nearest visible chunks that get rasterized
+constexpr float HEX_OCCLUDER_MERGE = 0.98f; // Blocks share a box while the lowest is at least this much of the tallest
+
+typedef struct HexOccluders {
+  OcclusionBuffer buffer;
+  float* block_height = nullptr;   // [chunk * occluder blocks^2 + block], top of the box it is part of, 0 - not an occluder
+  uint8_t* run_end = nullptr;      // [chunk * occluder blocks^2 + block], one past the last block of its box in the row
+  float* test_height = nullptr;    // [chunk * occludee blocks^2 + block], tallest tile - edits can go past world.desc.height
+  std::vector<uint64_t> order;     // Depth bits << 32 | index into world.visible
+  size_t culled = 0;               // Chunks dropped by occludeHexWorld, accumulated like buffer.stats
+} HexOccluders;
+
+void destroyHexOccluders(HexOccluders& occ) {
+  destroyOcclusionBuffer(occ.buffer);
+  free(occ.block_height);
+  free(occ.run_end);
+  free(occ.test_height);
+  occ = {};
+}
+
+bool createHexOccluders(HexOccluders& occ, const HexWorld& world, int width, int height) {
+  occ = {};
+  const size_t blocks = world.chunk_count * HEX_OCCLUDER_BLOCKS * HEX_OCCLUDER_BLOCKS;
+  occ.block_height = (float*)calloc(blocks, sizeof(float));
+  occ.run_end = (uint8_t*)malloc(blocks);
+  const size_t tests = world.chunk_count * HEX_OCCLUDEE_BLOCKS * HEX_OCCLUDEE_BLOCKS;
+  occ.test_height = (float*)malloc(tests * sizeof(float));
+  if (!occ.block_height || !occ.run_end || !occ.test_height || !createOcclusionBuffer(occ.buffer, width, height)) {
+    destroyHexOccluders(occ);
+    return false;
+  }
+  for (size_t i = 0; i < tests; i++) occ.test_height[i] = world.desc.height;
+  for (size_t i = 0; i < blocks; i++) occ.run_end[i] = (uint8_t)(i % HEX_OCCLUDER_BLOCKS + 1);
+  occ.order.reserve(world.chunk_count);
+  return true;
+}
+
+// Call whenever a chunk's tiles change - tiles packed like packHexChunkInstances, rows outer.
+// Inside the chunk a block reaches halfway into its neighbours, where even and odd rows and columns interleave,
+// so its height takes the neighbouring row and column of tiles into account too. Blocks end up flush with
+// each other, and a side next to a block at least as tall can be skipped. Then each row is cut into runs
+// of blocks within HEX_OCCLUDER_MERGE of each other, every block of a run lowered to its lowest.
+void updateHexChunkOccluder(HexOccluders& occ, const HexWorld& world, size_t chunk, const HexInstance* tiles) {
+  const HexChunk& c = world.chunks[chunk];
+  float* blocks = occ.block_height + chunk * HEX_OCCLUDER_BLOCKS * HEX_OCCLUDER_BLOCKS;
+  uint8_t* runEnd = occ.run_end + chunk * HEX_OCCLUDER_BLOCKS * HEX_OCCLUDER_BLOCKS;
+  float* tests = occ.test_height + chunk * HEX_OCCLUDEE_BLOCKS * HEX_OCCLUDEE_BLOCKS;
+  for (int i = 0; i < HEX_OCCLUDEE_BLOCKS * HEX_OCCLUDEE_BLOCKS; i++) tests[i] = 0.0f;
+  float tallest = 0.0f;
+  for (int r = 0; r < c.rows; r++) {
+    float* testRow = tests + r * HEX_OCCLUDEE_BLOCKS / c.rows * HEX_OCCLUDEE_BLOCKS;
+    for (int col = 0; col < c.columns; col++) {
+      const float h = tiles[(size_t)r * c.columns + col].height;
+      float& test = testRow[col * HEX_OCCLUDEE_BLOCKS / c.columns];
+      test = h > test ? h : test;
+      tallest = h > tallest ? h : tallest;
+    }
+  }
+
+  for (int by = 0; by < HEX_OCCLUDER_BLOCKS; by++) {
+    const int r0 = by * c.rows / HEX_OCCLUDER_BLOCKS, r1 = (by + 1) * c.rows / HEX_OCCLUDER_BLOCKS;
+    const int rowFirst = by > 0 ? r0 - 1 : r0, rowLast = by + 1 < HEX_OCCLUDER_BLOCKS ? r1 : r1 - 1;
+    for (int bx = 0; bx < HEX_OCCLUDER_BLOCKS; bx++) {
+      const int c0 = bx * c.columns / HEX_OCCLUDER_BLOCKS, c1 = (bx + 1) * c.columns / HEX_OCCLUDER_BLOCKS;
+      const int columnLast = bx + 1 < HEX_OCCLUDER_BLOCKS ? c1 : c1 - 1;
+      float lowest = r0 < r1 && c0 < c1 ? tallest : 0.0f;
+      for (int r = rowFirst; r <= rowLast && r0 < r1; r++) {
+        for (int col = c0; col <= columnLast && c0 < c1; col++) {
+          const float h = tiles[(size_t)r * c.columns + col].height;
+          lowest = h < lowest ? h : lowest;
+        }
+      }
+      // Flat tile mesh when the world has no height, nothing stands up to hide behind
+      blocks[by * HEX_OCCLUDER_BLOCKS + bx] = world.desc.height > 0.0f && lowest > 0.0f ? lowest : 0.0f;
+    }
+
+    float* row = blocks + by * HEX_OCCLUDER_BLOCKS;
+    for (int bx = 0; bx < HEX_OCCLUDER_BLOCKS;) {
+      int end = bx + 1;
+      float lowest = row[bx], tallest = row[bx];
+      while (lowest > 0.0f && end < HEX_OCCLUDER_BLOCKS) {
+        const float h = row[end];
+        const float low = h < lowest ? h : lowest, tall = h > tallest ? h : tallest;
+        if (!(low >= HEX_OCCLUDER_MERGE * tall)) break;
+        lowest = low;
+        tallest = tall;
+        end++;
+      }
+      for (int i = bx; i < end; i++) {
+        row[i] = lowest;
+        runEnd[by * HEX_OCCLUDER_BLOCKS + i] = (uint8_t)end;
+      }
+      bx = end;
+    }
+  }
+}
+
+// Box of blocks [bx, bxEnd) in row by - tiles [c0, c1) x [r0, r1) of chunk c. On the chunk border it shrinks to
+// what the blocks' own hexes cover for sure, even and odd rows only overlap from the first column's centers to
+// the right half of the last one.
+static void hexOccluderBlockBox(const HexWorld& world, const HexChunk& c, int bx, int bxEnd, int by, float height, float boxMin[3], float boxMax[3]) {
+  const float stepX = world.desc.radius * HEX_SQRT3;
+  const float stepZ = world.desc.radius * 1.5f;
+  const int c0 = c.first_column + bx * c.columns / HEX_OCCLUDER_BLOCKS, c1 = c.first_column + bxEnd * c.columns / HEX_OCCLUDER_BLOCKS;
+  const int r0 = c.first_row + by * c.rows / HEX_OCCLUDER_BLOCKS, r1 = c.first_row + (by + 1) * c.rows / HEX_OCCLUDER_BLOCKS;
+  boxMin[0] = stepX * (float)c0;
+  boxMax[0] = bxEnd < HEX_OCCLUDER_BLOCKS ? stepX * (float)c1 : stepX * ((float)(c1 - 1) + 0.5f);
+  boxMin[1] = 0.0f;
+  boxMax[1] = height;
+  boxMin[2] = by > 0 ? stepZ * ((float)r0 - 0.5f) : stepZ * (float)r0 - world.desc.radius * 0.5f;
+  boxMax[2] = by + 1 < HEX_OCCLUDER_BLOCKS ? stepZ * ((float)r1 - 0.5f) : stepZ * (float)(r1 - 1) + world.desc.radius * 0.5f;
+}
+
+// Filters world.visible (from cullHexWorld) down to chunks not hidden behind the nearest ones, order kept.
+// Same matrix cullHexWorld gets. Stats accumulate in occ.buffer.stats and occ.culled.
+size_t occludeHexWorld(HexOccluders& occ, HexWorld& world, const float worldViewProjection[16]) {
+  PROFILE_SCOPE("occlusion");
+  uint64_t start = timerNanoseconds();
+  const float* m = worldViewProjection;
+  OcclusionBuffer& buffer = occ.buffer;
+  clearOcclusionBuffer(buffer);
+
+  // Nearest chunks by clip w of their box centers - positive floats sort like their bits
+  occ.order.clear();
+  for (size_t i = 0; i < world.visible_count; i++) {
+    const uint32_t chunk = world.visible[i];
+    const float x = 0.5f * (world.bounds.min_x[chunk] + world.bounds.max_x[chunk]);
+    const float y = 0.5f * (world.bounds.min_y[chunk] + world.bounds.max_y[chunk]);
+    const float z = 0.5f * (world.bounds.min_z[chunk] + world.bounds.max_z[chunk]);
+    float w = x * m[3] + y * m[7] + z * m[11] + m[15];
+    w = w > 0.0f ? w : 0.0f;
+    uint32_t bits;
+    memcpy(&bits, &w, sizeof(bits));
+    occ.order.push_back((uint64_t)bits << 32 | i);
+  }
+  const size_t occluders = occ.order.size() < HEX_OCCLUDER_CHUNKS ? occ.order.size() : HEX_OCCLUDER_CHUNKS;
+  std::nth_element(occ.order.begin(), occ.order.begin() + occluders, occ.order.end());
+
+  for (size_t o = 0; o < occluders; o++) {
+    const uint32_t chunk = world.visible[(uint32_t)occ.order[o]];
+    const HexChunk& c = world.chunks[chunk];
+    const float* blocks = occ.block_height + (size_t)chunk * HEX_OCCLUDER_BLOCKS * HEX_OCCLUDER_BLOCKS;
+    const uint8_t* runEnd = occ.run_end + (size_t)chunk * HEX_OCCLUDER_BLOCKS * HEX_OCCLUDER_BLOCKS;
+    for (int by = 0; by < HEX_OCCLUDER_BLOCKS; by++) {
+      const float* row = blocks + by * HEX_OCCLUDER_BLOCKS;
+      for (int bx = 0, end; bx < HEX_OCCLUDER_BLOCKS; bx = end) {
+        end = runEnd[by * HEX_OCCLUDER_BLOCKS + bx];
+        const float height = row[bx];
+        if (height <= 0.0f) continue;
+        // A front or back side is buried only when the neighbouring row is at least as tall all along the run
+        bool front = by > 0, back = by + 1 < HEX_OCCLUDER_BLOCKS;
+        for (int i = bx; i < end; i++) {
+          front = front && row[i - HEX_OCCLUDER_BLOCKS] >= height;
+          back = back && row[i + HEX_OCCLUDER_BLOCKS] >= height;
+        }
+        unsigned faces = OCCLUSION_FACE_ALL;
+        if (bx > 0 && row[bx - 1] >= height) faces &= ~OCCLUSION_FACE_NEG_X;
+        if (end < HEX_OCCLUDER_BLOCKS && row[end] >= height) faces &= ~OCCLUSION_FACE_POS_X;
+        if (front) faces &= ~OCCLUSION_FACE_NEG_Z;
+        if (back) faces &= ~OCCLUSION_FACE_POS_Z;
+        float boxMin[3], boxMax[3];
+        hexOccluderBlockBox(world, c, bx, end, by, height, boxMin, boxMax);
+        rasterizeOccluderBox(buffer, m, boxMin, boxMax, faces);
+      }
+    }
+  }
+  uint64_t rasterized = timerNanoseconds();
+  buildOcclusionHiZ(buffer);
+
+  // A box around the whole chunk reaches from its nearest corner to its tallest tile and rarely fits behind
+  // anything, a few smaller boxes each with their own height do a lot better
+  const float stepX = world.desc.radius * HEX_SQRT3;
+  const float stepZ = world.desc.radius * 1.5f;
+  size_t kept = 0;
+  for (size_t i = 0; i < world.visible_count; i++) {
+    const uint32_t chunk = world.visible[i];
+    const HexChunk& c = world.chunks[chunk];
+    const float* tests = occ.test_height + (size_t)chunk * HEX_OCCLUDEE_BLOCKS * HEX_OCCLUDEE_BLOCKS;
+    // Ripples only lift tiles, growHexAnimatedBounds raised the box by as much as they can
+    const float lift = world.bounds.max_y[chunk] > world.desc.height ? world.bounds.max_y[chunk] / world.desc.height : 1.0f;
+    bool visible = false;
+    for (int b = 0; b < HEX_OCCLUDEE_BLOCKS * HEX_OCCLUDEE_BLOCKS && !visible; b++) {
+      const int bx = b % HEX_OCCLUDEE_BLOCKS, by = b / HEX_OCCLUDEE_BLOCKS;
+      const int c0 = c.first_column + bx * c.columns / HEX_OCCLUDEE_BLOCKS, c1 = c.first_column + (bx + 1) * c.columns / HEX_OCCLUDEE_BLOCKS;
+      const int r0 = c.first_row + by * c.rows / HEX_OCCLUDEE_BLOCKS, r1 = c.first_row + (by + 1) * c.rows / HEX_OCCLUDEE_BLOCKS;
+      if (c0 == c1 || r0 == r1) continue;
+      // Everything the tiles could touch - half a hex out on the left, a whole one on the right for odd rows
+      const float boxMin[3] = { stepX * ((float)c0 - 0.5f), 0.0f, stepZ * (float)r0 - world.desc.radius };
+      const float boxMax[3] = { stepX * (float)c1, tests[b] * lift, stepZ * (float)(r1 - 1) + world.desc.radius };
+      visible = occlusionTestBox(buffer, m, boxMin, boxMax);
+    }
+    if (visible) world.visible[kept++] = chunk;
+  }
+  occ.culled += world.visible_count - kept;
+  world.visible_count = kept;
+
+  uint64_t end = timerNanoseconds();
+  buffer.stats.raster_ms += (double)(rasterized - start) / 1000000.0;
+  buffer.stats.test_ms += (double)(end - rasterized) / 1000000.0;
+  return kept;
+}
+
+#endif /* _H_HEX_OCCLUSION */
@@ -0,0 +1,745 @@
+#ifndef _H_HEX_PATH
+#define _H_HEX_PATH
+
+// Pathfinding on the tile grid:
+// - A* for single routes - binary heap of packed (f, node) keys, per-node state stamped with a search generation
+//   so nothing is cleared between queries.
+// - Chunk-level portals (HPA*, Botea et al. 2004) for long routes - A* over a few nodes per chunk border,
+//   then refined tile by tile between consecutive portals.
+// - Flow fields for crowds - one integration field per goal, built chunk by chunk on the job system,
+//   then every unit on the map just follows the direction of its tile.
+// Nodes are tile indices into a grid padded with one impassable tile on every side, so neighbours are
+// node + step with no bounds checks. Stepping onto a tile costs that tile's cost, 0 means impassable.
+#include "../core/memory.cpp"
+#include "../core/jobs.cpp"
+#include "hex_coords.cpp"
+#include "hex_world.cpp"
+#include "hex_terrain.cpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <vector>
+
+constexpr uint32_t HEX_PATH_UNREACHABLE = UINT32_MAX;
+constexpr uint8_t HEX_PATH_NO_DIRECTION = 0xff;
+constexpr uint8_t HEX_PATH_FROM_START = 6;    // Search state - the node a search started from has no previous node
+constexpr uint8_t HEX_PATH_CLOSED = 0x80;
+constexpr size_t HEX_PATH_PORTAL_SPAN = 24;   // Border crossings per portal at most, long runs get several
+
+// Step cost per biome, in HexBiome order - deep water blocks
+static const uint8_t HEX_PATH_BIOME_COST[HEX_BIOME_COUNT] = { 3, 1, 2, 1, 4, 6, 8, 0 };
+
+typedef struct HexPathGrid {
+  int columns = 0;
+  int rows = 0;
+  int stride = 0;              // columns + 2, padding included
+  int chunk_size = HEX_CHUNK_SIZE;
+  int chunks_x = 0;
+  int chunks_y = 0;
+  size_t chunk_count = 0;
+  size_t node_count = 0;       // (columns + 2) * (rows + 2)
+  uint32_t min_cost = 1;       // Cheapest passable tile, scales the A* heuristic
+  int32_t step[2][6] = {};     // Node step per direction, on even and odd rows
+  uint8_t* cost = nullptr;
+} HexPathGrid;
+
+inline uint32_t hexPathNode(const HexPathGrid& grid, int col, int row) {
+  return (uint32_t)((row + 1) * grid.stride + col + 1);
+}
+
+inline void hexPathNodeOffset(const HexPathGrid& grid, uint32_t node, int& col, int& row) {
+  row = (int)(node / (uint32_t)grid.stride) - 1;
+  col = (int)(node % (uint32_t)grid.stride) - 1;
+}
+
+inline int hexPathNodeParity(const HexPathGrid& grid, uint32_t node) {
+  return ((int)(node / (uint32_t)grid.stride) - 1) & 1;
+}
+
+inline size_t hexPathChunkOf(const HexPathGrid& grid, int col, int row) {
+  return (size_t)(row / grid.chunk_size) * (size_t)grid.chunks_x + (size_t)(col / grid.chunk_size);
+}
+
+// Same layout as HexWorld::chunks
+inline HexChunk hexPathChunk(const HexPathGrid& grid, size_t chunk) {
+  HexChunk c;
+  c.first_column = (int)(chunk % (size_t)grid.chunks_x) * grid.chunk_size;
+  c.first_row = (int)(chunk / (size_t)grid.chunks_x) * grid.chunk_size;
+  c.columns = grid.columns - c.first_column < grid.chunk_size ? grid.columns - c.first_column : grid.chunk_size;
+  c.rows = grid.rows - c.first_row < grid.chunk_size ? grid.rows - c.first_row : grid.chunk_size;
+  return c;
+}
+
+void destroyHexPathGrid(HexPathGrid& grid) {
+  alignedFree(grid.cost);
+  grid = {};
+}
+
+// Costs from the terrain biomes, chunks the same as the world's
+bool createHexPathGrid(HexPathGrid& grid, const HexWorld& world, const HexTerrain& terrain) {
+  if (terrain.columns != world.desc.columns || terrain.rows != world.desc.rows) return false;
+  grid = {};
+  grid.columns = world.desc.columns;
+  grid.rows = world.desc.rows;
+  grid.stride = grid.columns + 2;
+  grid.chunk_size = world.desc.chunk_size;
+  grid.chunks_x = world.chunks_x;
+  grid.chunks_y = world.chunks_y;
+  grid.chunk_count = world.chunk_count;
+  grid.node_count = (size_t)grid.stride * (size_t)(grid.rows + 2);
+  grid.cost = (uint8_t*)alignedAlloc(grid.node_count);
+  if (!grid.cost) return false;
+  memset(grid.cost, 0, grid.node_count);
+
+  for (int parity = 0; parity < 2; parity++) {
+    for (int d = 0; d < 6; d++) grid.step[parity][d] = HEX_DIRECTIONS[d].r * grid.stride + HEX_OFFSET_COLUMN_STEP[parity][d];
+  }
+  uint32_t cheapest = UINT32_MAX;
+  for (int row = 0; row < grid.rows; row++) {
+    for (int col = 0; col < grid.columns; col++) {
+      const uint8_t cost = HEX_PATH_BIOME_COST[terrain.biome[(size_t)row * (size_t)grid.columns + (size_t)col]];
+      grid.cost[hexPathNode(grid, col, row)] = cost;
+      if (cost && cost < cheapest) cheapest = cost;
+    }
+  }
+  grid.min_cost = cheapest == UINT32_MAX ? 1 : cheapest;
+  return true;
+}
+
+// Per-thread scratch for searches - one per worker, never shared
+typedef struct HexPathSearch {
+  uint32_t* g = nullptr;
+  uint32_t* stamp = nullptr;     // Node state is only valid where stamp == generation
+  uint8_t* from = nullptr;       // Direction back to the previous node, HEX_PATH_CLOSED once expanded
+  uint32_t generation = 0;
+  std::vector<uint64_t> open;    // Min-heap of (f << 32 | node)
+  size_t expanded = 0;           // Nodes closed, summed over every search
+  // Portal graph searches
+  std::vector<uint32_t> portal_g;
+  std::vector<uint32_t> portal_stamp;
+  std::vector<uint32_t> portal_from;
+  std::vector<uint32_t> start_dist;
+  std::vector<uint32_t> goal_dist;
+  std::vector<uint32_t> waypoints;
+  std::vector<uint32_t> leg;
+} HexPathSearch;
+
+void destroyHexPathSearch(HexPathSearch& search) {
+  alignedFree(search.g);
+  alignedFree(search.stamp);
+  alignedFree(search.from);
+  search = {};
+}
+
+bool createHexPathSearch(HexPathSearch& search, const HexPathGrid& grid) {
+  search = {};
+  search.g = (uint32_t*)alignedAlloc(grid.node_count * sizeof(uint32_t));
+  search.stamp = (uint32_t*)alignedAlloc(grid.node_count * sizeof(uint32_t));
+  search.from = (uint8_t*)alignedAlloc(grid.node_count);
+  if (!search.g || !search.stamp || !search.from) {
+    destroyHexPathSearch(search);
+    return false;
+  }
+  memset(search.stamp, 0, grid.node_count * sizeof(uint32_t));
+  return true;
+}
+
+static inline void hexPathNextGeneration(HexPathSearch& search, const HexPathGrid& grid) {
+  if (++search.generation == 0) {
+    // Wrapped, stamps from four billion searches ago would look current
+    memset(search.stamp, 0, grid.node_count * sizeof(uint32_t));
+    std::fill(search.portal_stamp.begin(), search.portal_stamp.end(), 0u);
+    search.generation = 1;
+  }
+}
+
+static inline uint32_t hexPathHeuristic(const HexPathGrid& grid, int col, int row, HexAxial goal) {
+  return (uint32_t)hexDistance(hexOffsetToAxial(col, row), goal) * grid.min_cost;
+}
+
+static inline void hexPathPush(std::vector<uint64_t>& open, uint32_t f, uint32_t node) {
+  open.push_back((uint64_t)f << 32 | node);
+  std::push_heap(open.begin(), open.end(), std::greater<uint64_t>());
+}
+
+static inline uint64_t hexPathPop(std::vector<uint64_t>& open) {
+  std::pop_heap(open.begin(), open.end(), std::greater<uint64_t>());
+  const uint64_t key = open.back();
+  open.pop_back();
+  return key;
+}
+
+// A* from start to goal. Returns the path cost, HEX_PATH_UNREACHABLE if there is none.
+// path (optional) gets every node from start to goal, both included.
+uint32_t hexFindPath(HexPathSearch& search, const HexPathGrid& grid, uint32_t start, uint32_t goal, std::vector<uint32_t>* path) {
+  if (path) path->clear();
+  if (!grid.cost[start] || !grid.cost[goal]) return HEX_PATH_UNREACHABLE;
+  hexPathNextGeneration(search, grid);
+  const uint32_t generation = search.generation;
+  int goalCol, goalRow, col, row;
+  hexPathNodeOffset(grid, goal, goalCol, goalRow);
+  hexPathNodeOffset(grid, start, col, row);
+  const HexAxial goalAxial = hexOffsetToAxial(goalCol, goalRow);
+
+  search.g[start] = 0;
+  search.stamp[start] = generation;
+  search.from[start] = HEX_PATH_FROM_START;
+  search.open.clear();
+  hexPathPush(search.open, hexPathHeuristic(grid, col, row, goalAxial), start);
+
+  bool found = false;
+  while (!search.open.empty()) {
+    const uint32_t node = (uint32_t)hexPathPop(search.open);
+    if (search.from[node] & HEX_PATH_CLOSED) continue;  // Stale entry, node got a better g after it was pushed
+    search.from[node] |= HEX_PATH_CLOSED;
+    search.expanded++;
+    if (node == goal) {
+      found = true;
+      break;
+    }
+    hexPathNodeOffset(grid, node, col, row);
+    const int parity = row & 1;
+    const uint32_t g = search.g[node];
+    for (int d = 0; d < 6; d++) {
+      const uint32_t next = node + (uint32_t)grid.step[parity][d];
+      const uint32_t cost = grid.cost[next];
+      if (!cost) continue;
+      const uint32_t nextG = g + cost;
+      if (search.stamp[next] == generation) {
+        if ((search.from[next] & HEX_PATH_CLOSED) || nextG >= search.g[next]) continue;
+      } else {
+        search.stamp[next] = generation;
+      }
+      search.g[next] = nextG;
+      search.from[next] = (uint8_t)((d + 3) % 6);
+      const uint32_t h = hexPathHeuristic(grid, col + HEX_OFFSET_COLUMN_STEP[parity][d], row + HEX_DIRECTIONS[d].r, goalAxial);
+      hexPathPush(search.open, nextG + h, next);
+    }
+  }
+  if (!found) return HEX_PATH_UNREACHABLE;
+
+  if (path) {
+    for (uint32_t node = goal;; ) {
+      path->push_back(node);
+      const uint8_t back = search.from[node] & ~HEX_PATH_CLOSED;
+      if (back == HEX_PATH_FROM_START) break;
+      node += (uint32_t)grid.step[hexPathNodeParity(grid, node)][back];
+    }
+    std::reverse(path->begin(), path->end());
+  }
+  return search.g[goal];
+}
+
+// Dijkstra confined to one chunk. dist is chunk-local (row-major inside the chunk) and comes in with the seeds
+// set, open with the seeds pushed as (dist << 32 | local). reverse: dist ends up as the cost to reach a seed
+// instead of the cost from one.
+static void hexChunkDijkstra(const HexPathGrid& grid, const HexChunk& chunk, uint32_t* dist, std::vector<uint64_t>& open, bool reverse) {
+  while (!open.empty()) {
+    const uint64_t key = hexPathPop(open);
+    const uint32_t local = (uint32_t)key;
+    const uint32_t d = (uint32_t)(key >> 32);
+    if (d != dist[local]) continue;
+    const int row = chunk.first_row + (int)local / chunk.columns;
+    const int col = chunk.first_column + (int)local % chunk.columns;
+    const int parity = row & 1;
+    const uint32_t node = hexPathNode(grid, col, row);
+    for (int dir = 0; dir < 6; dir++) {
+      const int nextCol = col + HEX_OFFSET_COLUMN_STEP[parity][dir] - chunk.first_column;
+      const int nextRow = row + HEX_DIRECTIONS[dir].r - chunk.first_row;
+      if (nextCol < 0 || nextCol >= chunk.columns || nextRow < 0 || nextRow >= chunk.rows) continue;
+      const uint32_t next = node + (uint32_t)grid.step[parity][dir];
+      if (!grid.cost[next]) continue;
+      const uint32_t nextDist = d + (reverse ? grid.cost[node] : grid.cost[next]);
+      const uint32_t nextLocal = (uint32_t)(nextRow * chunk.columns + nextCol);
+      if (nextDist < dist[nextLocal]) {
+        dist[nextLocal] = nextDist;
+        hexPathPush(open, nextDist, nextLocal);
+      }
+    }
+  }
+}
+
+static inline uint32_t hexChunkLocal(const HexPathGrid& grid, const HexChunk& chunk, uint32_t node) {
+  int col, row;
+  hexPathNodeOffset(grid, node, col, row);
+  return (uint32_t)((row - chunk.first_row) * chunk.columns + (col - chunk.first_column));
+}
+
+// Single seed, whole chunk
+static void hexChunkDistances(const HexPathGrid& grid, const HexChunk& chunk, uint32_t seed, bool reverse,
+                              std::vector<uint32_t>& dist, std::vector<uint64_t>& open) {
+  dist.assign((size_t)chunk.columns * (size_t)chunk.rows, HEX_PATH_UNREACHABLE);
+  open.clear();
+  const uint32_t local = hexChunkLocal(grid, chunk, seed);
+  dist[local] = 0;
+  hexPathPush(open, 0, local);
+  hexChunkDijkstra(grid, chunk, dist.data(), open, reverse);
+}
+
+// Portal graph over chunk borders. A portal sits in the middle of every run of passable tile pairs across a
+// border, one node on either side. Nodes are grouped by chunk, edges are directed (tile costs are per tile):
+// across the border, and between every pair of nodes of a chunk that can reach each other inside it.
+typedef struct HexPathHierarchy {
+  std::vector<uint32_t> node_tile;     // Grid node of every portal node
+  std::vector<uint32_t> node_chunk;
+  std::vector<uint32_t> chunk_first;   // chunk_count + 1 offsets into the nodes
+  std::vector<uint32_t> edge_first;    // node count + 1 offsets into the edges
+  std::vector<uint32_t> edge_target;
+  std::vector<uint32_t> edge_cost;
+} HexPathHierarchy;
+
+typedef struct HexPathCrossing {
+  uint32_t chunk;   // Chunk on the far side, always after this one
+  uint32_t inside;
+  uint32_t outside;
+} HexPathCrossing;
+
+static bool hexPathAdjacent(const HexPathGrid& grid, uint32_t a, uint32_t b) {
+  if (a == b) return true;
+  const int parity = hexPathNodeParity(grid, a);
+  for (int d = 0; d < 6; d++) {
+    if (a + (uint32_t)grid.step[parity][d] == b) return true;
+  }
+  return false;
+}
+
+// Portals between chunk and the chunks after it, as (inside, outside) tile pairs
+static void hexChunkPortals(const HexPathGrid& grid, size_t chunk, std::vector<uint32_t>& portals) {
+  const HexChunk c = hexPathChunk(grid, chunk);
+  std::vector<HexPathCrossing> crossings;
+  for (int row = c.first_row; row < c.first_row + c.rows; row++) {
+    for (int col = c.first_column; col < c.first_column + c.columns; col++) {
+      // Only the border can cross
+      if (row != c.first_row && row != c.first_row + c.rows - 1 && col != c.first_column && col != c.first_column + c.columns - 1) continue;
+      const uint32_t node = hexPathNode(grid, col, row);
+      if (!grid.cost[node]) continue;
+      const int parity = row & 1;
+      for (int d = 0; d < 6; d++) {
+        const uint32_t next = node + (uint32_t)grid.step[parity][d];
+        if (!grid.cost[next]) continue;
+        const size_t other = hexPathChunkOf(grid, col + HEX_OFFSET_COLUMN_STEP[parity][d], row + HEX_DIRECTIONS[d].r);
+        if (other > chunk) crossings.push_back({ (uint32_t)other, node, next });
+      }
+    }
+  }
+  // Scan order walks each border tile by tile, runs break where either side stops being contiguous. A tile can
+  // cross to up to three outside tiles, so the outside side is checked against the last few crossings.
+  std::stable_sort(crossings.begin(), crossings.end(), [](const HexPathCrossing& a, const HexPathCrossing& b) { return a.chunk < b.chunk; });
+  size_t first = 0;
+  for (size_t i = 1; i <= crossings.size(); i++) {
+    bool runEnds = i == crossings.size() || crossings[i].chunk != crossings[i - 1].chunk ||
+      !hexPathAdjacent(grid, crossings[i].inside, crossings[i - 1].inside);
+    if (!runEnds) {
+      bool touches = false;
+      for (size_t j = i - 1; j + 4 >= i && j >= first && !touches; j--) {
+        touches = hexPathAdjacent(grid, crossings[i].outside, crossings[j].outside);
+        if (j == 0) break;
+      }
+      runEnds = !touches;
+    }
+    if (!runEnds) continue;
+    // Cheapest crossing of every HEX_PATH_PORTAL_SPAN of the run, middle first on ties - a portal in the middle
+    // of a cheap stretch is where most routes want to cross anyway
+    const size_t segments = (i - first + HEX_PATH_PORTAL_SPAN - 1) / HEX_PATH_PORTAL_SPAN;
+    for (size_t segment = 0; segment < segments; segment++) {
+      const size_t begin = first + (i - first) * segment / segments;
+      const size_t end = first + (i - first) * (segment + 1) / segments;
+      const size_t middle = begin + (end - begin) / 2;
+      size_t best = middle;
+      for (size_t offset = 1; offset <= end - begin; offset++) {
+        for (size_t j : { middle - offset, middle + offset }) {
+          if (j < begin || j >= end) continue;
+          const uint32_t cost = grid.cost[crossings[j].inside] + grid.cost[crossings[j].outside];
+          if (cost < (uint32_t)grid.cost[crossings[best].inside] + grid.cost[crossings[best].outside]) best = j;
+        }
+      }
+      portals.push_back(crossings[best].inside);
+      portals.push_back(crossings[best].outside);
+    }
+    first = i;
+  }
+}
+
+static uint32_t hexPathAddNode(std::vector<uint32_t>& chunkNodes, uint32_t tile) {
+  for (size_t i = 0; i < chunkNodes.size(); i++) {
+    if (chunkNodes[i] == tile) return (uint32_t)i;
+  }
+  chunkNodes.push_back(tile);
+  return (uint32_t)chunkNodes.size() - 1;
+}
+
+// Whole grid, chunks in parallel. Rebuild after costs change - it is a couple hundred ms on a 1k x 1k map.
+void buildHexPathHierarchy(HexPathHierarchy& hierarchy, const HexPathGrid& grid, JobSystem& jobs) {
+  PROFILE_SCOPE("buildHexPathHierarchy");
+  hierarchy = {};
+  const size_t chunkCount = grid.chunk_count;
+  std::vector<std::vector<uint32_t>> portals(chunkCount);
+  jobParallelFor(jobs, chunkCount, 4, [&](size_t begin, size_t end) {
+    for (size_t chunk = begin; chunk < end; chunk++) hexChunkPortals(grid, chunk, portals[chunk]);
+  });
+
+  // Nodes, deduplicated per chunk - a corner tile can sit on several borders
+  std::vector<std::vector<uint32_t>> chunkNodes(chunkCount);
+  std::vector<uint32_t> crossing;  // (chunk, index, other chunk, other index) per portal
+  for (size_t chunk = 0; chunk < chunkCount; chunk++) {
+    for (size_t i = 0; i < portals[chunk].size(); i += 2) {
+      int col, row;
+      hexPathNodeOffset(grid, portals[chunk][i + 1], col, row);
+      const size_t other = hexPathChunkOf(grid, col, row);
+      crossing.push_back((uint32_t)chunk);
+      crossing.push_back(hexPathAddNode(chunkNodes[chunk], portals[chunk][i]));
+      crossing.push_back((uint32_t)other);
+      crossing.push_back(hexPathAddNode(chunkNodes[other], portals[chunk][i + 1]));
+    }
+  }
+  hierarchy.chunk_first.resize(chunkCount + 1, 0);
+  for (size_t chunk = 0; chunk < chunkCount; chunk++) {
+    hierarchy.chunk_first[chunk + 1] = hierarchy.chunk_first[chunk] + (uint32_t)chunkNodes[chunk].size();
+    for (uint32_t tile : chunkNodes[chunk]) {
+      hierarchy.node_tile.push_back(tile);
+      hierarchy.node_chunk.push_back((uint32_t)chunk);
+    }
+  }
+  const size_t nodeCount = hierarchy.node_tile.size();
+
+  // Edges as (from, to, cost) - inside every chunk in parallel, then the border crossings
+  std::vector<std::vector<uint32_t>> chunkEdges(chunkCount);
+  jobParallelFor(jobs, chunkCount, 1, [&](size_t begin, size_t end) {
+    std::vector<uint32_t> dist;
+    std::vector<uint64_t> open;
+    for (size_t chunk = begin; chunk < end; chunk++) {
+      const HexChunk c = hexPathChunk(grid, chunk);
+      const uint32_t first = hierarchy.chunk_first[chunk];
+      const uint32_t last = hierarchy.chunk_first[chunk + 1];
+      for (uint32_t a = first; a < last; a++) {
+        hexChunkDistances(grid, c, hierarchy.node_tile[a], false, dist, open);
+        for (uint32_t b = first; b < last; b++) {
+          const uint32_t cost = dist[hexChunkLocal(grid, c, hierarchy.node_tile[b])];
+          if (a == b || cost == HEX_PATH_UNREACHABLE) continue;
+          chunkEdges[chunk].insert(chunkEdges[chunk].end(), { a, b, cost });
+        }
+      }
+    }
+  });
+  std::vector<uint32_t> edges;
+  for (const std::vector<uint32_t>& e : chunkEdges) edges.insert(edges.end(), e.begin(), e.end());
+  for (size_t i = 0; i < crossing.size(); i += 4) {
+    const uint32_t a = hierarchy.chunk_first[crossing[i]] + crossing[i + 1];
+    const uint32_t b = hierarchy.chunk_first[crossing[i + 2]] + crossing[i + 3];
+    edges.insert(edges.end(), { a, b, grid.cost[hierarchy.node_tile[b]], b, a, grid.cost[hierarchy.node_tile[a]] });
+  }
+
+  // CSR by source node
+  hierarchy.edge_first.assign(nodeCount + 1, 0);
+  for (size_t i = 0; i < edges.size(); i += 3) hierarchy.edge_first[edges[i] + 1]++;
+  for (size_t n = 0; n < nodeCount; n++) hierarchy.edge_first[n + 1] += hierarchy.edge_first[n];
+  hierarchy.edge_target.resize(edges.size() / 3);
+  hierarchy.edge_cost.resize(edges.size() / 3);
+  std::vector<uint32_t> fill(hierarchy.edge_first.begin(), hierarchy.edge_first.end() - 1);
+  for (size_t i = 0; i < edges.size(); i += 3) {
+    const uint32_t slot = fill[edges[i]]++;
+    hierarchy.edge_target[slot] = edges[i + 1];
+    hierarchy.edge_cost[slot] = edges[i + 2];
+  }
+}
+
+// Portal graph A* from start to goal. Without a path the result is the portal graph cost, which can be a little
+// above the best one (portals sit in the middle of their border run). With a path, every leg between portals is
+// refined with hexFindPath and the cost of the refined path comes back. Start and goal in one chunk go straight
+// to hexFindPath.
+uint32_t hexFindPathHierarchical(HexPathSearch& search, const HexPathGrid& grid, const HexPathHierarchy& hierarchy,
+                                 uint32_t start, uint32_t goal, std::vector<uint32_t>* path) {
+  if (path) path->clear();
+  if (!grid.cost[start] || !grid.cost[goal]) return HEX_PATH_UNREACHABLE;
+  int startCol, startRow, goalCol, goalRow;
+  hexPathNodeOffset(grid, start, startCol, startRow);
+  hexPathNodeOffset(grid, goal, goalCol, goalRow);
+  const size_t startChunk = hexPathChunkOf(grid, startCol, startRow);
+  const size_t goalChunk = hexPathChunkOf(grid, goalCol, goalRow);
+  if (startChunk == goalChunk) return hexFindPath(search, grid, start, goal, path);
+
+  // Start to its chunk's portals, and the goal chunk's portals to the goal
+  const HexChunk startRect = hexPathChunk(grid, startChunk);
+  const HexChunk goalRect = hexPathChunk(grid, goalChunk);
+  hexChunkDistances(grid, startRect, start, false, search.start_dist, search.open);
+  hexChunkDistances(grid, goalRect, goal, true, search.goal_dist, search.open);
+
+  const size_t nodeCount = hierarchy.node_tile.size();
+  if (search.portal_g.size() < nodeCount) {
+    search.portal_g.resize(nodeCount);
+    search.portal_stamp.assign(nodeCount, 0);
+    search.portal_from.resize(nodeCount);
+  }
+  hexPathNextGeneration(search, grid);
+  const uint32_t generation = search.generation;
+  const HexAxial goalAxial = hexOffsetToAxial(goalCol, goalRow);
+  const uint32_t goalKey = (uint32_t)nodeCount;  // Stands for the goal itself in the open list
+  uint32_t bestCost = HEX_PATH_UNREACHABLE;
+  uint32_t bestLast = UINT32_MAX;
+
+  search.open.clear();
+  for (uint32_t n = hierarchy.chunk_first[startChunk]; n < hierarchy.chunk_first[startChunk + 1]; n++) {
+    const uint32_t g = search.start_dist[hexChunkLocal(grid, startRect, hierarchy.node_tile[n])];
+    if (g == HEX_PATH_UNREACHABLE) continue;
+    int col, row;
+    hexPathNodeOffset(grid, hierarchy.node_tile[n], col, row);
+    search.portal_g[n] = g;
+    search.portal_stamp[n] = generation;
+    search.portal_from[n] = UINT32_MAX;
+    hexPathPush(search.open, g + hexPathHeuristic(grid, col, row, goalAxial), n);
+  }
+  while (!search.open.empty()) {
+    const uint64_t key = hexPathPop(search.open);
+    const uint32_t n = (uint32_t)key;
+    if (n == goalKey) {
+      if ((uint32_t)(key >> 32) == bestCost) break;
+      continue;
+    }
+    const uint32_t g = search.portal_g[n];
+    if (g & 0x80000000u) continue;  // Closed
+    search.portal_g[n] |= 0x80000000u;
+    search.expanded++;
+    if (hierarchy.node_chunk[n] == goalChunk) {
+      const uint32_t toGoal = search.goal_dist[hexChunkLocal(grid, goalRect, hierarchy.node_tile[n])];
+      if (toGoal != HEX_PATH_UNREACHABLE && g + toGoal < bestCost) {
+        bestCost = g + toGoal;
+        bestLast = n;
+        hexPathPush(search.open, bestCost, goalKey);
+      }
+    }
+    for (uint32_t e = hierarchy.edge_first[n]; e < hierarchy.edge_first[n + 1]; e++) {
+      const uint32_t next = hierarchy.edge_target[e];
+      const uint32_t nextG = g + hierarchy.edge_cost[e];
+      if (search.portal_stamp[next] == generation) {
+        if ((search.portal_g[next] & 0x80000000u) || nextG >= search.portal_g[next]) continue;
+      } else {
+        search.portal_stamp[next] = generation;
+      }
+      search.portal_g[next] = nextG;
+      search.portal_from[next] = n;
+      int col, row;
+      hexPathNodeOffset(grid, hierarchy.node_tile[next], col, row);
+      hexPathPush(search.open, nextG + hexPathHeuristic(grid, col, row, goalAxial), next);
+    }
+  }
+  if (bestLast == UINT32_MAX) return HEX_PATH_UNREACHABLE;
+  if (!path) return bestCost;
+
+  // Portal tiles back to front, then one A* leg per pair of waypoints
+  search.waypoints.clear();
+  search.waypoints.push_back(goal);
+  for (uint32_t n = bestLast; n != UINT32_MAX; n = search.portal_from[n]) search.waypoints.push_back(hierarchy.node_tile[n]);
+  search.waypoints.push_back(start);
+  std::reverse(search.waypoints.begin(), search.waypoints.end());
+  uint32_t total = 0;
+  path->push_back(start);
+  for (size_t i = 1; i < search.waypoints.size(); i++) {
+    if (search.waypoints[i] == search.waypoints[i - 1]) continue;
+    const uint32_t cost = hexFindPath(search, grid, search.waypoints[i - 1], search.waypoints[i], &search.leg);
+    if (cost == HEX_PATH_UNREACHABLE) {
+      path->clear();
+      return HEX_PATH_UNREACHABLE;
+    }
+    total += cost;
+    path->insert(path->end(), search.leg.begin() + 1, search.leg.end());
+  }
+  return total;
+}
+
+typedef struct HexPathQuery {
+  uint32_t start;
+  uint32_t goal;
+} HexPathQuery;
+
+// Path costs for a batch of queries, one contiguous slice per search. hierarchy can be null for plain A*.
+void hexFindPaths(HexPathSearch* searches, size_t searchCount, const HexPathGrid& grid, const HexPathHierarchy* hierarchy,
+                  const HexPathQuery* queries, uint32_t* costs, size_t count, JobSystem& jobs) {
+  PROFILE_SCOPE("hexFindPaths");
+  jobParallelFor(jobs, searchCount, 1, [&](size_t begin, size_t end) {
+    for (size_t s = begin; s < end; s++) {
+      const size_t first = count * s / searchCount;
+      const size_t last = count * (s + 1) / searchCount;
+      for (size_t q = first; q < last; q++) {
+        costs[q] = hierarchy
+          ? hexFindPathHierarchical(searches[s], grid, *hierarchy, queries[q].start, queries[q].goal, nullptr)
+          : hexFindPath(searches[s], grid, queries[q].start, queries[q].goal, nullptr);
+      }
+    }
+  });
+}
+
+// Cost to one goal from every tile, and the step to take from it. Units only read it, any number of them can
+// share one field from any thread.
+typedef struct HexFlowField {
+  uint32_t goal = 0;
+  uint32_t* integration = nullptr;  // Cost to the goal per node, HEX_PATH_UNREACHABLE where there is no way
+  uint8_t* direction = nullptr;     // Direction of the next step per node, HEX_PATH_NO_DIRECTION at the goal and off the map
+  int sweeps = 0;                   // Chunk sweeps the last build took
+  size_t chunk_runs = 0;            // Chunk passes the last build took
+} HexFlowField;
+
+void destroyHexFlowField(HexFlowField& field) {
+  alignedFree(field.integration);
+  alignedFree(field.direction);
+  field = {};
+}
+
+bool createHexFlowField(HexFlowField& field, const HexPathGrid& grid) {
+  field = {};
+  field.integration = (uint32_t*)alignedAlloc(grid.node_count * sizeof(uint32_t));
+  field.direction = (uint8_t*)alignedAlloc(grid.node_count);
+  if (!field.integration || !field.direction) {
+    destroyHexFlowField(field);
+    return false;
+  }
+  return true;
+}
+
+// One chunk against the current field: pulls in what its neighbours offer across the border and settles the
+// inside. Reads the tiles around the chunk, writes only its own. Returns true if any tile got cheaper.
+static bool hexFlowFieldChunk(HexFlowField& field, const HexPathGrid& grid, size_t chunk, bool seedAll,
+                              std::vector<uint32_t>& dist, std::vector<uint64_t>& open) {
+  const HexChunk c = hexPathChunk(grid, chunk);
+  dist.resize((size_t)c.columns * (size_t)c.rows);
+  open.clear();
+  for (int row = c.first_row; row < c.first_row + c.rows; row++) {
+    const int parity = row & 1;
+    const bool edgeRow = row == c.first_row || row == c.first_row + c.rows - 1;
+    for (int col = c.first_column; col < c.first_column + c.columns; col++) {
+      const uint32_t node = hexPathNode(grid, col, row);
+      const uint32_t local = (uint32_t)((row - c.first_row) * c.columns + (col - c.first_column));
+      uint32_t best = field.integration[node];
+      dist[local] = best;
+      if (!grid.cost[node]) continue;
+      if (seedAll && best != HEX_PATH_UNREACHABLE) hexPathPush(open, best, local);
+      if (!edgeRow && col != c.first_column && col != c.first_column + c.columns - 1) continue;
+      for (int d = 0; d < 6; d++) {
+        const int nextCol = col + HEX_OFFSET_COLUMN_STEP[parity][d];
+        const int nextRow = row + HEX_DIRECTIONS[d].r;
+        if (nextCol >= c.first_column && nextCol < c.first_column + c.columns && nextRow >= c.first_row && nextRow < c.first_row + c.rows) continue;
+        const uint32_t next = node + (uint32_t)grid.step[parity][d];
+        if (!grid.cost[next] || field.integration[next] == HEX_PATH_UNREACHABLE) continue;
+        const uint32_t through = field.integration[next] + grid.cost[next];
+        if (through < best) best = through;
+      }
+      if (best < dist[local]) {
+        dist[local] = best;
+        hexPathPush(open, best, local);
+      }
+    }
+  }
+  if (open.empty()) return false;
+  hexChunkDijkstra(grid, c, dist.data(), open, true);
+
+  bool changed = false;
+  for (int row = c.first_row; row < c.first_row + c.rows; row++) {
+    for (int col = c.first_column; col < c.first_column + c.columns; col++) {
+      const uint32_t node = hexPathNode(grid, col, row);
+      const uint32_t value = dist[(size_t)(row - c.first_row) * (size_t)c.columns + (size_t)(col - c.first_column)];
+      if (value < field.integration[node]) {
+        field.integration[node] = value;
+        changed = true;
+      }
+    }
+  }
+  return changed;
+}
+
+// Integration field by chunks: every sweep runs the chunks whose neighbours changed, in four phases by chunk
+// parity so no two neighbouring chunks run at once, until nothing changes. Then the directions, rows in parallel.
+void buildHexFlowField(HexFlowField& field, const HexPathGrid& grid, uint32_t goal, JobSystem& jobs) {
+  PROFILE_SCOPE("buildHexFlowField");
+  field.goal = goal;
+  field.sweeps = 0;
+  field.chunk_runs = 0;
+  jobParallelFor(jobs, (size_t)grid.rows + 2, 64, [&](size_t begin, size_t end) {
+    for (size_t row = begin; row < end; row++) {
+      memset(field.integration + row * (size_t)grid.stride, 0xff, (size_t)grid.stride * sizeof(uint32_t));
+    }
+  });
+  if (!grid.cost[goal]) {
+    memset(field.direction, HEX_PATH_NO_DIRECTION, grid.node_count);
+    return;
+  }
+  field.integration[goal] = 0;
+
+  const size_t chunkCount = grid.chunk_count;
+  std::vector<uint8_t> active(chunkCount, 0);
+  std::vector<uint8_t> changed(chunkCount, 0);
+  std::vector<uint32_t> batch;
+  int goalCol, goalRow;
+  hexPathNodeOffset(grid, goal, goalCol, goalRow);
+  active[hexPathChunkOf(grid, goalCol, goalRow)] = 1;
+  std::atomic<size_t> runs{0};
+
+  for (bool any = true; any; field.sweeps++) {
+    const bool seedAll = field.sweeps == 0;  // Only the goal chunk runs in the first sweep, the goal seeds it
+    for (int phase = 0; phase < 4; phase++) {
+      batch.clear();
+      for (size_t chunk = 0; chunk < chunkCount; chunk++) {
+        const int cx = (int)(chunk % (size_t)grid.chunks_x);
+        const int cy = (int)(chunk / (size_t)grid.chunks_x);
+        if (active[chunk] && ((cx & 1) | ((cy & 1) << 1)) == phase) batch.push_back((uint32_t)chunk);
+      }
+      jobParallelFor(jobs, batch.size(), 1, [&](size_t begin, size_t end) {
+        std::vector<uint32_t> dist;
+        std::vector<uint64_t> open;
+        for (size_t i = begin; i < end; i++) changed[batch[i]] = hexFlowFieldChunk(field, grid, batch[i], seedAll, dist, open) ? 1 : 0;
+        runs.fetch_add(end - begin, std::memory_order_relaxed);
+      });
+    }
+    // Next sweep: every chunk next to one that changed
+    any = false;
+    for (size_t chunk = 0; chunk < chunkCount; chunk++) {
+      const int cx = (int)(chunk % (size_t)grid.chunks_x);
+      const int cy = (int)(chunk / (size_t)grid.chunks_x);
+      uint8_t next = 0;
+      for (int y = cy - 1; y <= cy + 1 && !next; y++) {
+        for (int x = cx - 1; x <= cx + 1 && !next; x++) {
+          if (x < 0 || y < 0 || x >= grid.chunks_x || y >= grid.chunks_y || (x == cx && y == cy)) continue;
+          next = changed[(size_t)y * (size_t)grid.chunks_x + (size_t)x];
+        }
+      }
+      active[chunk] = next;
+      any = any || next;
+    }
+    std::fill(changed.begin(), changed.end(), (uint8_t)0);
+  }
+  field.chunk_runs = runs.load(std::memory_order_relaxed);
+
+  // Cheapest step out of every tile - ties go to the lowest direction, so the field is the same on any thread count
+  jobParallelFor(jobs, (size_t)grid.rows + 2, 16, [&](size_t begin, size_t end) {
+    for (size_t paddedRow = begin; paddedRow < end; paddedRow++) {
+      uint8_t* direction = field.direction + paddedRow * (size_t)grid.stride;
+      memset(direction, HEX_PATH_NO_DIRECTION, (size_t)grid.stride);
+      if (paddedRow == 0 || paddedRow == (size_t)grid.rows + 1) continue;
+      const int parity = (int)(paddedRow - 1) & 1;
+      for (int col = 0; col < grid.columns; col++) {
+        const uint32_t node = (uint32_t)(paddedRow * (size_t)grid.stride) + (uint32_t)col + 1;
+        if (node == goal || field.integration[node] == HEX_PATH_UNREACHABLE) continue;
+        uint32_t best = HEX_PATH_UNREACHABLE;
+        for (int d = 0; d < 6; d++) {
+          const uint32_t next = node + (uint32_t)grid.step[parity][d];
+          if (!grid.cost[next] || field.integration[next] == HEX_PATH_UNREACHABLE) continue;
+          const uint32_t through = field.integration[next] + grid.cost[next];
+          if (through < best) {
+            best = through;
+            direction[col + 1] = (uint8_t)d;
+          }
+        }
+      }
+    }
+  });
+}
+
+// Where a unit on node goes next, node itself at the goal or where the goal can not be reached
+inline uint32_t hexFlowFieldStep(const HexFlowField& field, const HexPathGrid& grid, uint32_t node) {
+  const uint8_t d = field.direction[node];
+  return d == HEX_PATH_NO_DIRECTION ? node : node + (uint32_t)grid.step[hexPathNodeParity(grid, node)][d];
+}
+
+#endif /* _H_HEX_PATH */
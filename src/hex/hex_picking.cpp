@@ -0,0 +1,374 @@
+#ifndef _H_HEX_PICKING
+#define _H_HEX_PICKING
+
+// Ray queries against the hex plane - cursor picking, box selection, line of sight.
+// No triangles are tested: a ray hits the plane the tile tops lie on and the hit point is turned
+// into axial coordinates analytically, so one query costs the same on any map size.
+// Platform-neutral, matrices are row-major for row vectors (what XMStoreFloat4x4 gives).
+#include "../core/simd.cpp"
+#include "../core/memory.cpp"
+#include "../core/matrix.cpp"
+#include "hex_coords.cpp"
+#include "hex_world.cpp"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+constexpr int32_t HEX_PICK_MISS = INT32_MIN;
+constexpr float HEX_PICK_MAX_COORD = 16777216.0f;  // Past 2^24 floats stop holding whole axial coordinates
+
+typedef struct HexRay {
+  float origin[3];
+  float direction[3];  // Does not have to be normalized, t is in units of it
+} HexRay;
+
+// Many rays at once, structure-of-arrays so the SIMD path loads one component of 8 rays per register
+typedef struct HexRayBatch {
+  float* origin_x = nullptr;
+  float* origin_y = nullptr;
+  float* origin_z = nullptr;
+  float* direction_x = nullptr;
+  float* direction_y = nullptr;
+  float* direction_z = nullptr;
+  size_t count = 0;
+  size_t capacity = 0;
+} HexRayBatch;
+
+typedef struct HexPick {
+  HexAxial tile;
+  int column;
+  int row;
+  float t;        // Along the ray
+  float x;        // Hit point on the plane
+  float z;
+} HexPick;
+
+// What rays get tested against - y of the tile tops and the map rectangle. Conversion factors are
+// folded in once, the scalar and SIMD paths use the same ones so they agree bit for bit.
+typedef struct HexPickPlane {
+  float y;
+  int columns;
+  int rows;
+  float q_from_x;   // sqrt(3) / 3 / radius
+  float q_from_z;   // 1 / 3 / radius
+  float r_from_z;   // 2 / 3 / radius
+} HexPickPlane;
+
+HexPickPlane hexPickPlane(float y, float radius, int columns, int rows) {
+  HexPickPlane plane = {};
+  plane.y = y;
+  plane.columns = columns;
+  plane.rows = rows;
+  plane.q_from_x = HEX_SQRT3 / 3.0f / radius;
+  plane.q_from_z = 1.0f / 3.0f / radius;
+  plane.r_from_z = 2.0f / 3.0f / radius;
+  return plane;
+}
+
+inline HexPickPlane hexPickPlane(const HexWorld& world) {
+  return hexPickPlane(world.desc.height, world.desc.radius, world.desc.columns, world.desc.rows);
+}
+
+bool allocateHexRayBatch(HexRayBatch& batch, size_t capacity) {
+  const size_t bytes = (capacity + SIMD_WIDTH) * sizeof(float);
+  batch = {};
+  batch.origin_x = (float*)alignedAlloc(bytes);
+  batch.origin_y = (float*)alignedAlloc(bytes);
+  batch.origin_z = (float*)alignedAlloc(bytes);
+  batch.direction_x = (float*)alignedAlloc(bytes);
+  batch.direction_y = (float*)alignedAlloc(bytes);
+  batch.direction_z = (float*)alignedAlloc(bytes);
+  batch.capacity = capacity;
+  return batch.origin_x && batch.origin_y && batch.origin_z && batch.direction_x && batch.direction_y && batch.direction_z;
+}
+
+void destroyHexRayBatch(HexRayBatch& batch) {
+  alignedFree(batch.origin_x);
+  alignedFree(batch.origin_y);
+  alignedFree(batch.origin_z);
+  alignedFree(batch.direction_x);
+  alignedFree(batch.direction_y);
+  alignedFree(batch.direction_z);
+  batch = {};
+}
+
+inline void hexRayBatchSet(HexRayBatch& batch, size_t i, const HexRay& ray) {
+  batch.origin_x[i] = ray.origin[0];
+  batch.origin_y[i] = ray.origin[1];
+  batch.origin_z[i] = ray.origin[2];
+  batch.direction_x[i] = ray.direction[0];
+  batch.direction_y[i] = ray.direction[1];
+  batch.direction_z[i] = ray.direction[2];
+}
+
+// Pixel (px, py) of a width x height viewport to a ray in the space inverseWvp maps into.
+// Pass the inverse of world * view * projection to get rays in mesh space, where the tiles are.
+bool hexRayFromScreen(const float inverseWvp[16], float px, float py, int width, int height, HexRay& ray) {
+  float ndcX = (px + 0.5f) / (float)width * 2.0f - 1.0f;
+  float ndcY = 1.0f - (py + 0.5f) / (float)height * 2.0f;
+  const float nearPoint[3] = { ndcX, ndcY, 0.0f };  // D3D depth goes 0..1
+  const float farPoint[3] = { ndcX, ndcY, 1.0f };
+  float a[3], b[3];
+  if (!matrixTransformPoint(inverseWvp, nearPoint, a) || !matrixTransformPoint(inverseWvp, farPoint, b)) return false;
+  for (int i = 0; i < 3; i++) {
+    ray.origin[i] = a[i];
+    ray.direction[i] = b[i] - a[i];
+  }
+  return true;
+}
+
+// Cube rounding, ties go to even like cvtps_epi32 does
+inline HexAxial hexAxialRound(float fq, float fr) {
+  float fs = -fq - fr;
+  float q = nearbyintf(fq), r = nearbyintf(fr), s = nearbyintf(fs);
+  float dq = fabsf(q - fq), dr = fabsf(r - fr), ds = fabsf(s - fs);
+  if (dq > dr && dq > ds) {
+    q = -r - s;
+  } else if (dr > ds) {
+    r = -q - s;
+  }
+  return { (int)q, (int)r };
+}
+
+inline HexAxial hexWorldToAxial(float x, float z, float radius) {
+  return hexAxialRound((HEX_SQRT3 / 3.0f * x - z / 3.0f) / radius, (2.0f / 3.0f * z) / radius);
+}
+
+// Single query, the batched one below gives the same tiles
+bool hexPickRay(const HexPickPlane& plane, const float origin[3], const float direction[3], HexPick& pick) {
+  float t = (plane.y - origin[1]) / direction[1];
+  if (!(t >= 0.0f && t <= FLT_MAX)) return false;  // Parallel to the plane, behind the origin or NaN
+
+  float x = origin[0] + t * direction[0];
+  float z = origin[2] + t * direction[2];
+  float fq = x * plane.q_from_x - z * plane.q_from_z;
+  float fr = z * plane.r_from_z;
+  if (!(fabsf(fq) < HEX_PICK_MAX_COORD && fabsf(fr) < HEX_PICK_MAX_COORD)) return false;
+
+  HexAxial tile = hexAxialRound(fq, fr);
+  int column = tile.q + (tile.r >> 1);
+  if (column < 0 || column >= plane.columns || tile.r < 0 || tile.r >= plane.rows) return false;
+
+  pick.tile = tile;
+  pick.column = column;
+  pick.row = tile.r;
+  pick.t = t;
+  pick.x = x;
+  pick.z = z;
+  return true;
+}
+
+inline bool hexPickRay(const HexPickPlane& plane, const HexRay& ray, HexPick& pick) {
+  return hexPickRay(plane, ray.origin, ray.direction, pick);
+}
+
+// Reference for the SIMD version - writes axial q, r per ray or HEX_PICK_MISS in both, returns hit count
+size_t hexPickRaysScalar(const HexPickPlane& plane, const HexRayBatch& batch, int32_t* outQ, int32_t* outR) {
+  size_t hits = 0;
+  for (size_t i = 0; i < batch.count; i++) {
+    const float origin[3] = { batch.origin_x[i], batch.origin_y[i], batch.origin_z[i] };
+    const float direction[3] = { batch.direction_x[i], batch.direction_y[i], batch.direction_z[i] };
+    HexPick pick;
+    if (hexPickRay(plane, origin, direction, pick)) {
+      outQ[i] = pick.tile.q;
+      outR[i] = pick.tile.r;
+      hits++;
+    } else {
+      outQ[i] = HEX_PICK_MISS;
+      outR[i] = HEX_PICK_MISS;
+    }
+  }
+  return hits;
+}
+
+size_t hexPickRays(const HexPickPlane& plane, const HexRayBatch& batch, int32_t* outQ, int32_t* outR) {
+  size_t i = 0;
+  size_t hits = 0;
+#if defined(HEX_SIMD_AVX2) || defined(HEX_SIMD_SSE)
+  #if defined(HEX_SIMD_AVX2)
+    #define PICK_WIDTH 8
+    #define PICK_VEC __m256
+    #define PICK_IVEC __m256i
+    #define PICK_SET1 _mm256_set1_ps
+    #define PICK_SET1I _mm256_set1_epi32
+    #define PICK_LOAD _mm256_loadu_ps
+    #define PICK_STOREI(p, v) _mm256_storeu_si256(reinterpret_cast<__m256i*>(p), v)
+    #define PICK_ADD _mm256_add_ps
+    #define PICK_SUB _mm256_sub_ps
+    #define PICK_MUL _mm256_mul_ps
+    #define PICK_DIV _mm256_div_ps
+    #define PICK_AND _mm256_and_ps
+    #define PICK_ANDNOT _mm256_andnot_ps
+    #define PICK_OR _mm256_or_ps
+    #define PICK_XOR _mm256_xor_ps
+    #define PICK_LESS(a, b) _mm256_cmp_ps(a, b, _CMP_LT_OQ)
+    #define PICK_LESS_EQUAL(a, b) _mm256_cmp_ps(a, b, _CMP_LE_OQ)
+    #define PICK_GREATER(a, b) _mm256_cmp_ps(a, b, _CMP_GT_OQ)
+    #define PICK_TO_INT _mm256_cvtps_epi32
+    #define PICK_TO_FLOAT _mm256_cvtepi32_ps
+    #define PICK_ADDI _mm256_add_epi32
+    #define PICK_SRAI _mm256_srai_epi32
+    #define PICK_CAST_I _mm256_castps_si256
+    #define PICK_CAST_F _mm256_castsi256_ps
+    #define PICK_MASK _mm256_movemask_ps
+  #else
+    #define PICK_WIDTH 4
+    #define PICK_VEC __m128
+    #define PICK_IVEC __m128i
+    #define PICK_SET1 _mm_set1_ps
+    #define PICK_SET1I _mm_set1_epi32
+    #define PICK_LOAD _mm_loadu_ps
+    #define PICK_STOREI(p, v) _mm_storeu_si128(reinterpret_cast<__m128i*>(p), v)
+    #define PICK_ADD _mm_add_ps
+    #define PICK_SUB _mm_sub_ps
+    #define PICK_MUL _mm_mul_ps
+    #define PICK_DIV _mm_div_ps
+    #define PICK_AND _mm_and_ps
+    #define PICK_ANDNOT _mm_andnot_ps
+    #define PICK_OR _mm_or_ps
+    #define PICK_XOR _mm_xor_ps
+    #define PICK_LESS(a, b) _mm_cmplt_ps(a, b)
+    #define PICK_LESS_EQUAL(a, b) _mm_cmple_ps(a, b)
+    #define PICK_GREATER(a, b) _mm_cmpgt_ps(a, b)
+    #define PICK_TO_INT _mm_cvtps_epi32
+    #define PICK_TO_FLOAT _mm_cvtepi32_ps
+    #define PICK_ADDI _mm_add_epi32
+    #define PICK_SRAI _mm_srai_epi32
+    #define PICK_CAST_I _mm_castps_si128
+    #define PICK_CAST_F _mm_castsi128_ps
+    #define PICK_MASK _mm_movemask_ps
+  #endif
+  // Select between a and b by mask, SSE2 has no blendv
+  #define PICK_SELECT(mask, a, b) PICK_OR(PICK_AND(mask, a), PICK_ANDNOT(mask, b))
+
+  const PICK_VEC planeY = PICK_SET1(plane.y);
+  const PICK_VEC qFromX = PICK_SET1(plane.q_from_x);
+  const PICK_VEC qFromZ = PICK_SET1(plane.q_from_z);
+  const PICK_VEC rFromZ = PICK_SET1(plane.r_from_z);
+  const PICK_VEC zero = PICK_SET1(0.0f);
+  const PICK_VEC maxT = PICK_SET1(FLT_MAX);
+  const PICK_VEC maxCoord = PICK_SET1(HEX_PICK_MAX_COORD);
+  const PICK_VEC sign = PICK_SET1(-0.0f);
+  const PICK_VEC columns = PICK_SET1((float)plane.columns);
+  const PICK_VEC rows = PICK_SET1((float)plane.rows);
+  const PICK_IVEC miss = PICK_SET1I(HEX_PICK_MISS);
+
+  for (; i + PICK_WIDTH <= batch.count; i += PICK_WIDTH) {
+    PICK_VEC t = PICK_DIV(PICK_SUB(planeY, PICK_LOAD(batch.origin_y + i)), PICK_LOAD(batch.direction_y + i));
+    PICK_VEC hit = PICK_AND(PICK_LESS_EQUAL(zero, t), PICK_LESS_EQUAL(t, maxT));
+
+    PICK_VEC x = PICK_ADD(PICK_LOAD(batch.origin_x + i), PICK_MUL(t, PICK_LOAD(batch.direction_x + i)));
+    PICK_VEC z = PICK_ADD(PICK_LOAD(batch.origin_z + i), PICK_MUL(t, PICK_LOAD(batch.direction_z + i)));
+    PICK_VEC fq = PICK_SUB(PICK_MUL(x, qFromX), PICK_MUL(z, qFromZ));
+    PICK_VEC fr = PICK_MUL(z, rFromZ);
+    hit = PICK_AND(hit, PICK_LESS(PICK_ANDNOT(sign, fq), maxCoord));
+    hit = PICK_AND(hit, PICK_LESS(PICK_ANDNOT(sign, fr), maxCoord));
+    // Lanes that missed get zeroed so the conversions below stay in range
+    fq = PICK_AND(hit, fq);
+    fr = PICK_AND(hit, fr);
+
+    PICK_VEC fs = PICK_SUB(PICK_XOR(fq, sign), fr);
+    PICK_VEC q = PICK_TO_FLOAT(PICK_TO_INT(fq));
+    PICK_VEC r = PICK_TO_FLOAT(PICK_TO_INT(fr));
+    PICK_VEC s = PICK_TO_FLOAT(PICK_TO_INT(fs));
+    PICK_VEC dq = PICK_ANDNOT(sign, PICK_SUB(q, fq));
+    PICK_VEC dr = PICK_ANDNOT(sign, PICK_SUB(r, fr));
+    PICK_VEC ds = PICK_ANDNOT(sign, PICK_SUB(s, fs));
+    PICK_VEC fixQ = PICK_AND(PICK_GREATER(dq, dr), PICK_GREATER(dq, ds));
+    PICK_VEC fixR = PICK_ANDNOT(fixQ, PICK_GREATER(dr, ds));
+    q = PICK_SELECT(fixQ, PICK_SUB(PICK_XOR(r, sign), s), q);
+    r = PICK_SELECT(fixR, PICK_SUB(PICK_XOR(q, sign), s), r);
+
+    PICK_IVEC qi = PICK_TO_INT(q);
+    PICK_IVEC ri = PICK_TO_INT(r);
+    PICK_VEC column = PICK_TO_FLOAT(PICK_ADDI(qi, PICK_SRAI(ri, 1)));
+    hit = PICK_AND(hit, PICK_AND(PICK_LESS_EQUAL(zero, column), PICK_LESS(column, columns)));
+    hit = PICK_AND(hit, PICK_AND(PICK_LESS_EQUAL(zero, r), PICK_LESS(r, rows)));
+
+    PICK_STOREI(outQ + i, PICK_CAST_I(PICK_SELECT(hit, PICK_CAST_F(qi), PICK_CAST_F(miss))));
+    PICK_STOREI(outR + i, PICK_CAST_I(PICK_SELECT(hit, PICK_CAST_F(ri), PICK_CAST_F(miss))));
+    int mask = PICK_MASK(hit);
+    while (mask) {
+      hits++;
+      mask &= mask - 1;
+    }
+  }
+
+  #undef PICK_SELECT
+  #undef PICK_WIDTH
+  #undef PICK_VEC
+  #undef PICK_IVEC
+  #undef PICK_SET1
+  #undef PICK_SET1I
+  #undef PICK_LOAD
+  #undef PICK_STOREI
+  #undef PICK_ADD
+  #undef PICK_SUB
+  #undef PICK_MUL
+  #undef PICK_DIV
+  #undef PICK_AND
+  #undef PICK_ANDNOT
+  #undef PICK_OR
+  #undef PICK_XOR
+  #undef PICK_LESS
+  #undef PICK_LESS_EQUAL
+  #undef PICK_GREATER
+  #undef PICK_TO_INT
+  #undef PICK_TO_FLOAT
+  #undef PICK_ADDI
+  #undef PICK_SRAI
+  #undef PICK_CAST_I
+  #undef PICK_CAST_F
+  #undef PICK_MASK
+#endif
+  for (; i < batch.count; i++) {
+    const float origin[3] = { batch.origin_x[i], batch.origin_y[i], batch.origin_z[i] };
+    const float direction[3] = { batch.direction_x[i], batch.direction_y[i], batch.direction_z[i] };
+    HexPick pick;
+    if (hexPickRay(plane, origin, direction, pick)) {
+      outQ[i] = pick.tile.q;
+      outR[i] = pick.tile.r;
+      hits++;
+    } else {
+      outQ[i] = HEX_PICK_MISS;
+      outR[i] = HEX_PICK_MISS;
+    }
+  }
+  return hits;
+}
+
+// Box selection - one ray every `step` pixels inside [x0, x1) x [y0, y1), rays go into batch (grown up to capacity).
+// Returns how many rays were written.
+size_t hexRaysFromScreenRect(const float inverseWvp[16], int x0, int y0, int x1, int y1, int step,
+                             int width, int height, HexRayBatch& batch) {
+  batch.count = 0;
+  if (x0 > x1) { int t = x0; x0 = x1; x1 = t; }
+  if (y0 > y1) { int t = y0; y0 = y1; y1 = t; }
+  for (int y = y0; y < y1; y += step) {
+    for (int x = x0; x < x1 && batch.count < batch.capacity; x += step) {
+      HexRay ray;
+      if (hexRayFromScreen(inverseWvp, (float)x, (float)y, width, height, ray)) hexRayBatchSet(batch, batch.count++, ray);
+    }
+  }
+  return batch.count;
+}
+
+// Drops misses and duplicates from hexPickRays output, in place. Returns how many tiles are left.
+size_t hexUniquePicks(int32_t* q, int32_t* r, size_t count, std::vector<uint64_t>& scratch) {
+  scratch.clear();
+  for (size_t i = 0; i < count; i++) {
+    if (q[i] != HEX_PICK_MISS) scratch.push_back(((uint64_t)(uint32_t)r[i] << 32) | (uint32_t)q[i]);
+  }
+  std::sort(scratch.begin(), scratch.end());
+  size_t n = std::unique(scratch.begin(), scratch.end()) - scratch.begin();
+  for (size_t i = 0; i < n; i++) {
+    q[i] = (int32_t)(uint32_t)scratch[i];
+    r[i] = (int32_t)(uint32_t)(scratch[i] >> 32);
+  }
+  return n;
+}
+
+#endif /* _H_HEX_PICKING */
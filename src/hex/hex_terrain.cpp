@@ -0,0 +1,481 @@
+#ifndef _H_HEX_TERRAIN
+#define _H_HEX_TERRAIN
+
+// Procedural terrain - seeded 2D simplex noise summed over octaves (fBm), evaluated SIMD_WIDTH tiles at once.
+// Every tile depends only on its own coordinates and the seed, so chunks can be filled in any order on any
+// number of threads and the SIMD path matches the scalar one bit for bit - same seed, same map, everywhere.
+#include "../core/simd.cpp"
+#include "../core/memory.cpp"
+#include "../core/jobs.cpp"
+#include "hex_coords.cpp"
+#include "hex_world.cpp"
+#include "hex_instances.cpp"
+
+#include <cstdint>
+#include <cstring>
+
+constexpr int HEX_NOISE_MAX_OCTAVES = 8;
+constexpr int HEX_TERRAIN_BATCH = 64;  // Tiles per noise call, a chunk row at most
+
+// Biomes double as palette indices - HEX_PALETTE and the shader palette are in this order
+enum HexBiome : uint8_t {
+  HEX_BIOME_FOREST = 0,
+  HEX_BIOME_GRASS = 1,
+  HEX_BIOME_SAND = 2,
+  HEX_BIOME_DIRT = 3,
+  HEX_BIOME_ROCK = 4,
+  HEX_BIOME_SNOW = 5,
+  HEX_BIOME_SHALLOW_WATER = 6,
+  HEX_BIOME_DEEP_WATER = 7,
+  HEX_BIOME_COUNT = 8
+};
+
+static_assert(HEX_BIOME_COUNT == HEX_PALETTE_SIZE, "Biomes index the tile palette");
+
+typedef struct HexNoiseDesc {
+  uint32_t seed = 0;
+  int octaves = 5;
+  float frequency = 1.0f / 24.0f;  // Per world unit - features come out a couple dozen tiles wide
+  float lacunarity = 2.0f;
+  float gain = 0.5f;
+} HexNoiseDesc;
+
+typedef struct HexTerrainDesc {
+  HexNoiseDesc elevation;
+  HexNoiseDesc moisture;
+  float water_level = 0.42f;   // Elevation in [0, 1] below which tiles are water, flattened to this level
+  float min_height = 0.15f;    // Lowest tile height as a fraction of HexWorldDesc::height
+} HexTerrainDesc;
+
+// Row-major over the whole map, tile (col, row) is at row * columns + col
+typedef struct HexTerrain {
+  HexTerrainDesc desc;
+  int columns = 0;
+  int rows = 0;
+  float* height = nullptr;   // [0, 1], scaled by HexWorldDesc::height when packed
+  uint8_t* biome = nullptr;
+  uint32_t* color = nullptr; // RGBA8, palette color shaded by height - for meshes that do not use the palette
+} HexTerrain;
+
+// Elevation and moisture get different seeds out of one, so a map is a single number
+HexTerrainDesc hexTerrainDesc(uint32_t seed) {
+  HexTerrainDesc desc = {};
+  desc.elevation.seed = hexHash(seed ^ 0x68e31da4u);
+  desc.moisture.seed = hexHash(seed ^ 0xb5297a4du);
+  desc.moisture.octaves = 3;
+  desc.moisture.frequency = 1.0f / 48.0f;
+  return desc;
+}
+
+// Skew and unskew factors for 2D simplex, (sqrt(3) - 1) / 2 and (3 - sqrt(3)) / 6
+constexpr float HEX_NOISE_F2 = 0.36602540378f;
+constexpr float HEX_NOISE_G2 = 0.21132486540f;
+constexpr float HEX_NOISE_SCALE = 40.0f;  // Brings the sum of three corners to about [-1, 1]
+
+static inline uint32_t hexNoiseHash(int32_t i, int32_t j, uint32_t seed) {
+  return hexHash(((uint32_t)i * 0x8da6b343u) ^ ((uint32_t)j * 0xd8163841u) ^ seed);
+}
+
+// One of 8 gradients, (±1, ±2) and (±2, ±1), dotted with (x, y)
+static inline float hexNoiseGrad(uint32_t hash, float x, float y) {
+  float u = (hash & 4) == 0 ? x : y;
+  float v = (hash & 4) == 0 ? y : x;
+  u = (hash & 1) ? -u : u;
+  float v2 = v + v;
+  v2 = (hash & 2) ? -v2 : v2;
+  return u + v2;
+}
+
+static inline float hexNoiseCorner(uint32_t hash, float x, float y) {
+  float t = (0.5f - x * x) - y * y;
+  t = t > 0.0f ? t : 0.0f;
+  float t2 = t * t;
+  return (t2 * t2) * hexNoiseGrad(hash, x, y);
+}
+
+static inline int32_t hexNoiseFloor(float v) {
+  int32_t i = (int32_t)v;
+  return (float)i > v ? i - 1 : i;
+}
+
+// Reference simplex, the SIMD kernel below does exactly these operations in exactly this order
+inline float hexSimplex2(float x, float y, uint32_t seed) {
+  const float s = (x + y) * HEX_NOISE_F2;
+  const int32_t i = hexNoiseFloor(x + s);
+  const int32_t j = hexNoiseFloor(y + s);
+  const float t = (float)(i + j) * HEX_NOISE_G2;
+  const float x0 = x - ((float)i - t);
+  const float y0 = y - ((float)j - t);
+  const bool lower = x0 > y0;
+  const float x1 = (x0 - (lower ? 1.0f : 0.0f)) + HEX_NOISE_G2;
+  const float y1 = (y0 - (lower ? 0.0f : 1.0f)) + HEX_NOISE_G2;
+  const float x2 = (x0 - 1.0f) + 2.0f * HEX_NOISE_G2;
+  const float y2 = (y0 - 1.0f) + 2.0f * HEX_NOISE_G2;
+  const float n0 = hexNoiseCorner(hexNoiseHash(i, j, seed), x0, y0);
+  const float n1 = hexNoiseCorner(hexNoiseHash(i + (lower ? 1 : 0), j + (lower ? 0 : 1), seed), x1, y1);
+  const float n2 = hexNoiseCorner(hexNoiseHash(i + 1, j + 1, seed), x2, y2);
+  return ((n0 + n1) + n2) * HEX_NOISE_SCALE;
+}
+
+typedef struct HexNoiseOctaves {
+  int count;
+  uint32_t seed[HEX_NOISE_MAX_OCTAVES];
+  float frequency[HEX_NOISE_MAX_OCTAVES];
+  float amplitude[HEX_NOISE_MAX_OCTAVES];
+  float normalize;   // 1 / sum of amplitudes, keeps the result in about [-1, 1]
+} HexNoiseOctaves;
+
+static HexNoiseOctaves hexNoiseOctaves(const HexNoiseDesc& desc) {
+  HexNoiseOctaves o = {};
+  o.count = desc.octaves < 1 ? 1 : (desc.octaves > HEX_NOISE_MAX_OCTAVES ? HEX_NOISE_MAX_OCTAVES : desc.octaves);
+  float frequency = desc.frequency, amplitude = 1.0f, sum = 0.0f;
+  for (int k = 0; k < o.count; k++) {
+    o.seed[k] = hexHash(desc.seed + (uint32_t)k * 0x9e3779b9u);
+    o.frequency[k] = frequency;
+    o.amplitude[k] = amplitude;
+    sum += amplitude;
+    frequency *= desc.lacunarity;
+    amplitude *= desc.gain;
+  }
+  o.normalize = 1.0f / sum;
+  return o;
+}
+
+void hexNoiseFbmScalar(const HexNoiseDesc& desc, const float* x, const float* z, float* out, size_t count) {
+  const HexNoiseOctaves o = hexNoiseOctaves(desc);
+  for (size_t n = 0; n < count; n++) {
+    float sum = 0.0f;
+    for (int k = 0; k < o.count; k++) {
+      sum = sum + o.amplitude[k] * hexSimplex2(x[n] * o.frequency[k], z[n] * o.frequency[k], o.seed[k]);
+    }
+    out[n] = sum * o.normalize;
+  }
+}
+
+#if defined(HEX_SIMD_SSE) && !defined(HEX_SIMD_AVX2)
+// SSE2 has no 32-bit low multiply (that is SSE4.1) - two 32x32->64 multiplies on even and odd lanes do it
+static inline __m128i hexMulLo32(__m128i a, __m128i b) {
+  __m128i even = _mm_mul_epu32(a, b);
+  __m128i odd = _mm_mul_epu32(_mm_srli_epi64(a, 32), _mm_srli_epi64(b, 32));
+  return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)), _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+}
+#endif
+
+// fBm at (x[n], z[n]) for n in [0, count). Whole registers are read and written, so all three arrays
+// need room for SIMD_WIDTH - 1 more floats past count.
+void hexNoiseFbm(const HexNoiseDesc& desc, const float* x, const float* z, float* out, size_t count) {
+#if defined(HEX_SIMD_AVX2) || defined(HEX_SIMD_SSE)
+  #if defined(HEX_SIMD_AVX2)
+    #define NOISE_WIDTH 8
+    #define NOISE_VEC __m256
+    #define NOISE_IVEC __m256i
+    #define NOISE_SET1 _mm256_set1_ps
+    #define NOISE_ISET1 _mm256_set1_epi32
+    #define NOISE_LOAD _mm256_loadu_ps
+    #define NOISE_STORE _mm256_storeu_ps
+    #define NOISE_ADD _mm256_add_ps
+    #define NOISE_SUB _mm256_sub_ps
+    #define NOISE_MUL _mm256_mul_ps
+    #define NOISE_MAX _mm256_max_ps
+    #define NOISE_AND _mm256_and_ps
+    #define NOISE_ANDNOT _mm256_andnot_ps
+    #define NOISE_XOR _mm256_xor_ps
+    #define NOISE_GT(a, b) _mm256_cmp_ps(a, b, _CMP_GT_OQ)
+    #define NOISE_BLEND(a, b, mask) _mm256_blendv_ps(a, b, mask)
+    #define NOISE_TO_FLOAT _mm256_cvtepi32_ps
+    #define NOISE_TRUNC _mm256_cvttps_epi32
+    #define NOISE_AS_FLOAT _mm256_castsi256_ps
+    #define NOISE_AS_INT _mm256_castps_si256
+    #define NOISE_IADD _mm256_add_epi32
+    #define NOISE_ISUB _mm256_sub_epi32
+    #define NOISE_IMUL _mm256_mullo_epi32
+    #define NOISE_IXOR _mm256_xor_si256
+    #define NOISE_IAND _mm256_and_si256
+    #define NOISE_IEQ _mm256_cmpeq_epi32
+    #define NOISE_ISRL _mm256_srli_epi32
+    #define NOISE_ISLL _mm256_slli_epi32
+    #define NOISE_IZERO _mm256_setzero_si256
+  #else
+    #define NOISE_WIDTH 4
+    #define NOISE_VEC __m128
+    #define NOISE_IVEC __m128i
+    #define NOISE_SET1 _mm_set1_ps
+    #define NOISE_ISET1 _mm_set1_epi32
+    #define NOISE_LOAD _mm_loadu_ps
+    #define NOISE_STORE _mm_storeu_ps
+    #define NOISE_ADD _mm_add_ps
+    #define NOISE_SUB _mm_sub_ps
+    #define NOISE_MUL _mm_mul_ps
+    #define NOISE_MAX _mm_max_ps
+    #define NOISE_AND _mm_and_ps
+    #define NOISE_ANDNOT _mm_andnot_ps
+    #define NOISE_XOR _mm_xor_ps
+    #define NOISE_GT(a, b) _mm_cmpgt_ps(a, b)
+    #define NOISE_BLEND(a, b, mask) _mm_or_ps(_mm_and_ps(mask, b), _mm_andnot_ps(mask, a))
+    #define NOISE_TO_FLOAT _mm_cvtepi32_ps
+    #define NOISE_TRUNC _mm_cvttps_epi32
+    #define NOISE_AS_FLOAT _mm_castsi128_ps
+    #define NOISE_AS_INT _mm_castps_si128
+    #define NOISE_IADD _mm_add_epi32
+    #define NOISE_ISUB _mm_sub_epi32
+    #define NOISE_IMUL hexMulLo32
+    #define NOISE_IXOR _mm_xor_si128
+    #define NOISE_IAND _mm_and_si128
+    #define NOISE_IEQ _mm_cmpeq_epi32
+    #define NOISE_ISRL _mm_srli_epi32
+    #define NOISE_ISLL _mm_slli_epi32
+    #define NOISE_IZERO _mm_setzero_si128
+  #endif
+
+  const HexNoiseOctaves o = hexNoiseOctaves(desc);
+  const NOISE_VEC zero = NOISE_SET1(0.0f);
+  const NOISE_VEC one = NOISE_SET1(1.0f);
+  const NOISE_VEC half = NOISE_SET1(0.5f);
+  const NOISE_VEC f2 = NOISE_SET1(HEX_NOISE_F2);
+  const NOISE_VEC g2 = NOISE_SET1(HEX_NOISE_G2);
+  const NOISE_VEC g2x2 = NOISE_SET1(2.0f * HEX_NOISE_G2);
+  const NOISE_IVEC ione = NOISE_ISET1(1);
+  const NOISE_IVEC ifour = NOISE_ISET1(4);
+  const NOISE_IVEC itwo = NOISE_ISET1(2);
+
+  // Lane-wise hexNoiseHash
+  auto hash = [&](NOISE_IVEC i, NOISE_IVEC j, NOISE_IVEC seed) {
+    NOISE_IVEC h = NOISE_IXOR(NOISE_IXOR(NOISE_IMUL(i, NOISE_ISET1((int)0x8da6b343u)), NOISE_IMUL(j, NOISE_ISET1((int)0xd8163841u))), seed);
+    h = NOISE_IXOR(h, NOISE_ISRL(h, 16));
+    h = NOISE_IMUL(h, NOISE_ISET1(0x7feb352d));
+    h = NOISE_IXOR(h, NOISE_ISRL(h, 15));
+    h = NOISE_IMUL(h, NOISE_ISET1((int)0x846ca68bu));
+    return NOISE_IXOR(h, NOISE_ISRL(h, 16));
+  };
+  // Lane-wise hexNoiseCorner - negation is a sign flip, same as the scalar minus
+  auto corner = [&](NOISE_IVEC h, NOISE_VEC x, NOISE_VEC y) {
+    NOISE_VEC t = NOISE_SUB(NOISE_SUB(half, NOISE_MUL(x, x)), NOISE_MUL(y, y));
+    t = NOISE_MAX(t, zero);
+    NOISE_VEC t2 = NOISE_MUL(t, t);
+    NOISE_VEC swap = NOISE_AS_FLOAT(NOISE_IEQ(NOISE_IAND(h, ifour), NOISE_IZERO()));
+    NOISE_VEC u = NOISE_BLEND(y, x, swap);
+    NOISE_VEC v = NOISE_BLEND(x, y, swap);
+    u = NOISE_XOR(u, NOISE_AS_FLOAT(NOISE_ISLL(NOISE_IAND(h, ione), 31)));
+    NOISE_VEC v2 = NOISE_XOR(NOISE_ADD(v, v), NOISE_AS_FLOAT(NOISE_ISLL(NOISE_IAND(h, itwo), 30)));
+    return NOISE_MUL(NOISE_MUL(t2, t2), NOISE_ADD(u, v2));
+  };
+  auto floorInt = [&](NOISE_VEC v) {
+    NOISE_IVEC i = NOISE_TRUNC(v);
+    // Mask is -1 where truncation went up, adding it steps one down
+    return NOISE_IADD(i, NOISE_AS_INT(NOISE_GT(NOISE_TO_FLOAT(i), v)));
+  };
+
+  for (size_t n = 0; n < count; n += NOISE_WIDTH) {
+    const NOISE_VEC px = NOISE_LOAD(x + n);
+    const NOISE_VEC pz = NOISE_LOAD(z + n);
+    NOISE_VEC sum = zero;
+    for (int k = 0; k < o.count; k++) {
+      const NOISE_VEC sx = NOISE_MUL(px, NOISE_SET1(o.frequency[k]));
+      const NOISE_VEC sy = NOISE_MUL(pz, NOISE_SET1(o.frequency[k]));
+      const NOISE_IVEC seed = NOISE_ISET1((int)o.seed[k]);
+
+      const NOISE_VEC s = NOISE_MUL(NOISE_ADD(sx, sy), f2);
+      const NOISE_IVEC i = floorInt(NOISE_ADD(sx, s));
+      const NOISE_IVEC j = floorInt(NOISE_ADD(sy, s));
+      const NOISE_VEC t = NOISE_MUL(NOISE_TO_FLOAT(NOISE_IADD(i, j)), g2);
+      const NOISE_VEC x0 = NOISE_SUB(sx, NOISE_SUB(NOISE_TO_FLOAT(i), t));
+      const NOISE_VEC y0 = NOISE_SUB(sy, NOISE_SUB(NOISE_TO_FLOAT(j), t));
+      const NOISE_VEC lower = NOISE_GT(x0, y0);
+      const NOISE_VEC x1 = NOISE_ADD(NOISE_SUB(x0, NOISE_AND(lower, one)), g2);
+      const NOISE_VEC y1 = NOISE_ADD(NOISE_SUB(y0, NOISE_ANDNOT(lower, one)), g2);
+      const NOISE_VEC x2 = NOISE_ADD(NOISE_SUB(x0, one), g2x2);
+      const NOISE_VEC y2 = NOISE_ADD(NOISE_SUB(y0, one), g2x2);
+      // lower is -1 as an int, so i - lower steps right and j + 1 + lower steps up for the other half
+      const NOISE_IVEC i1 = NOISE_ISUB(i, NOISE_AS_INT(lower));
+      const NOISE_IVEC j1 = NOISE_IADD(NOISE_IADD(j, ione), NOISE_AS_INT(lower));
+      const NOISE_VEC n0 = corner(hash(i, j, seed), x0, y0);
+      const NOISE_VEC n1 = corner(hash(i1, j1, seed), x1, y1);
+      const NOISE_VEC n2 = corner(hash(NOISE_IADD(i, ione), NOISE_IADD(j, ione), seed), x2, y2);
+      const NOISE_VEC noise = NOISE_MUL(NOISE_ADD(NOISE_ADD(n0, n1), n2), NOISE_SET1(HEX_NOISE_SCALE));
+      sum = NOISE_ADD(sum, NOISE_MUL(NOISE_SET1(o.amplitude[k]), noise));
+    }
+    NOISE_STORE(out + n, NOISE_MUL(sum, NOISE_SET1(o.normalize)));
+  }
+
+  #undef NOISE_WIDTH
+  #undef NOISE_VEC
+  #undef NOISE_IVEC
+  #undef NOISE_SET1
+  #undef NOISE_ISET1
+  #undef NOISE_LOAD
+  #undef NOISE_STORE
+  #undef NOISE_ADD
+  #undef NOISE_SUB
+  #undef NOISE_MUL
+  #undef NOISE_MAX
+  #undef NOISE_AND
+  #undef NOISE_ANDNOT
+  #undef NOISE_XOR
+  #undef NOISE_GT
+  #undef NOISE_BLEND
+  #undef NOISE_TO_FLOAT
+  #undef NOISE_TRUNC
+  #undef NOISE_AS_FLOAT
+  #undef NOISE_AS_INT
+  #undef NOISE_IADD
+  #undef NOISE_ISUB
+  #undef NOISE_IMUL
+  #undef NOISE_IXOR
+  #undef NOISE_IAND
+  #undef NOISE_IEQ
+  #undef NOISE_ISRL
+  #undef NOISE_ISLL
+  #undef NOISE_IZERO
+#else
+  hexNoiseFbmScalar(desc, x, z, out, count);
+#endif
+}
+
+void destroyHexTerrain(HexTerrain& terrain) {
+  alignedFree(terrain.height);
+  alignedFree(terrain.biome);
+  alignedFree(terrain.color);
+  terrain = {};
+}
+
+bool allocateHexTerrain(HexTerrain& terrain, const HexWorld& world, const HexTerrainDesc& desc) {
+  terrain = {};
+  terrain.desc = desc;
+  terrain.columns = world.desc.columns;
+  terrain.rows = world.desc.rows;
+  const size_t tiles = (size_t)terrain.columns * (size_t)terrain.rows;
+  terrain.height = (float*)alignedAlloc(tiles * sizeof(float));
+  terrain.biome = (uint8_t*)alignedAlloc(tiles);
+  terrain.color = (uint32_t*)alignedAlloc(tiles * sizeof(uint32_t));
+  if (!terrain.height || !terrain.biome || !terrain.color) {
+    destroyHexTerrain(terrain);
+    return false;
+  }
+  return true;
+}
+
+static inline uint8_t hexClassifyBiome(const HexTerrainDesc& desc, float elevation, float moisture) {
+  if (elevation < desc.water_level - 0.07f) return HEX_BIOME_DEEP_WATER;
+  if (elevation < desc.water_level) return HEX_BIOME_SHALLOW_WATER;
+  if (elevation < desc.water_level + 0.04f) return HEX_BIOME_SAND;
+  if (elevation > 0.80f) return HEX_BIOME_SNOW;
+  if (elevation > 0.68f) return HEX_BIOME_ROCK;
+  if (moisture < 0.40f) return HEX_BIOME_DIRT;
+  return moisture < 0.60f ? HEX_BIOME_GRASS : HEX_BIOME_FOREST;
+}
+
+static inline uint32_t hexShadeColor(const float rgba[4], float shade) {
+  uint32_t packed = 0xff000000u;
+  for (int c = 0; c < 3; c++) {
+    float v = rgba[c] * shade * 255.0f + 0.5f;
+    packed |= (uint32_t)(v > 255.0f ? 255.0f : v) << (8 * c);
+  }
+  return packed;
+}
+
+// Fills one chunk's tiles. Touches nothing outside the chunk, so chunks can run on any thread in any order.
+void generateHexTerrainChunk(HexTerrain& terrain, const HexWorld& world, size_t chunk) {
+  const HexChunk& c = world.chunks[chunk];
+  // Room for a whole register past the batch, hexNoiseFbm reads and writes it
+  alignas(32) float xs[HEX_TERRAIN_BATCH + 8];
+  alignas(32) float zs[HEX_TERRAIN_BATCH + 8];
+  alignas(32) float elevation[HEX_TERRAIN_BATCH + 8];
+  alignas(32) float moisture[HEX_TERRAIN_BATCH + 8];
+  const HexTerrainDesc& desc = terrain.desc;
+
+  for (int row = c.first_row; row < c.first_row + c.rows; row++) {
+    for (int first = c.first_column; first < c.first_column + c.columns; first += HEX_TERRAIN_BATCH) {
+      const int last = first + HEX_TERRAIN_BATCH < c.first_column + c.columns ? first + HEX_TERRAIN_BATCH : c.first_column + c.columns;
+      const int count = last - first;
+      for (int n = 0; n < count + 8; n++) {
+        // Padding lanes just repeat the last tile, their results are thrown away
+        hexOffsetToWorld(n < count ? first + n : last - 1, row, world.desc.radius, xs[n], zs[n]);
+      }
+      hexNoiseFbm(desc.elevation, xs, zs, elevation, (size_t)count);
+      hexNoiseFbm(desc.moisture, xs, zs, moisture, (size_t)count);
+
+      const size_t base = (size_t)row * (size_t)terrain.columns + (size_t)first;
+      for (int n = 0; n < count; n++) {
+        const float e = elevation[n] * 0.5f + 0.5f;
+        const float m = moisture[n] * 0.5f + 0.5f;
+        const uint8_t biome = hexClassifyBiome(desc, e, m);
+        // Water is flat at water level, land rises from it
+        const float level = e > desc.water_level ? (e < 1.0f ? e : 1.0f) : desc.water_level;
+        const float height = desc.min_height + (1.0f - desc.min_height) * level;
+        terrain.height[base + n] = height;
+        terrain.biome[base + n] = biome;
+        terrain.color[base + n] = hexShadeColor(HEX_PALETTE[biome], 0.75f + 0.25f * height);
+      }
+    }
+  }
+}
+
+// Whole map, one job per chunk
+void generateHexTerrain(HexTerrain& terrain, const HexWorld& world, JobSystem& jobs) {
+  jobParallelFor(jobs, world.chunk_count, 1, [&](size_t begin, size_t end) {
+    for (size_t chunk = begin; chunk < end; chunk++) generateHexTerrainChunk(terrain, world, chunk);
+  });
+}
+
+// Terrain version of packHexChunkInstancesScalar - height and palette index come from the terrain
+size_t packHexChunkTerrainInstancesScalar(const HexWorld& world, const HexTerrain& terrain, size_t chunk, HexInstance* out) {
+  const HexChunk& c = world.chunks[chunk];
+  size_t n = 0;
+  for (int row = c.first_row; row < c.first_row + c.rows; row++) {
+    for (int col = c.first_column; col < c.first_column + c.columns; col++) {
+      const size_t tile = (size_t)row * (size_t)terrain.columns + (size_t)col;
+      hexOffsetToWorld(col, row, world.desc.radius, out[n].offset_x, out[n].offset_z);
+      out[n].height = world.desc.height * terrain.height[tile];
+      out[n].color_index = terrain.biome[tile];
+      n++;
+    }
+  }
+  return n;
+}
+
+size_t packHexChunkTerrainInstances(const HexWorld& world, const HexTerrain& terrain, size_t chunk, HexInstance* out) {
+#if defined(HEX_SIMD_SSE)
+  const HexChunk& c = world.chunks[chunk];
+  const float stepX = world.desc.radius * HEX_SQRT3;
+  const float stepZ = world.desc.radius * 1.5f;
+  const __m128 laneOffset = _mm_set_ps(3.0f, 2.0f, 1.0f, 0.0f);
+  const __m128 scale = _mm_set1_ps(world.desc.height);
+  const __m128i zero = _mm_setzero_si128();
+  size_t n = 0;
+
+  for (int row = c.first_row; row < c.first_row + c.rows; row++) {
+    const __m128 z = _mm_set1_ps(stepZ * (float)row);
+    const float rowShift = 0.5f * (float)(row & 1);
+    const size_t rowBase = (size_t)row * (size_t)terrain.columns;
+    int col = c.first_column;
+    for (; col + 4 <= c.first_column + c.columns; col += 4) {
+      __m128 x = _mm_add_ps(_mm_set1_ps((float)col + rowShift), laneOffset);
+      x = _mm_mul_ps(x, _mm_set1_ps(stepX));
+      __m128 height = _mm_mul_ps(scale, _mm_loadu_ps(terrain.height + rowBase + col));
+      int32_t biomes;
+      memcpy(&biomes, terrain.biome + rowBase + col, sizeof(biomes));
+      __m128i color = _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(biomes), zero), zero);
+
+      __m128 r0 = x, r1 = z, r2 = height, r3 = _mm_castsi128_ps(color);
+      _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+      _mm_storeu_ps(&out[n + 0].offset_x, r0);
+      _mm_storeu_ps(&out[n + 1].offset_x, r1);
+      _mm_storeu_ps(&out[n + 2].offset_x, r2);
+      _mm_storeu_ps(&out[n + 3].offset_x, r3);
+      n += 4;
+    }
+    for (; col < c.first_column + c.columns; col++) {
+      const size_t tile = rowBase + (size_t)col;
+      hexOffsetToWorld(col, row, world.desc.radius, out[n].offset_x, out[n].offset_z);
+      out[n].height = world.desc.height * terrain.height[tile];
+      out[n].color_index = terrain.biome[tile];
+      n++;
+    }
+  }
+  return n;
+#else
+  return packHexChunkTerrainInstancesScalar(world, terrain, chunk, out);
+#endif
+}
+
+#endif /* _H_HEX_TERRAIN */
@@ -0,0 +1,160 @@
+#ifndef _H_HEX_WORLD
+#define _H_HEX_WORLD
+
+// Hex world split into fixed size chunks - each chunk gets its own mesh and bounding box,
+// so the renderer only has to deal with what the camera actually sees.
+#include "../core/frustum.cpp"
+#include "../core/jobs.cpp"
+#include "../core/profiler.cpp"
+#include "hex_mesh.cpp"
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+constexpr int HEX_CHUNK_SIZE = 32; // Tiles per chunk side - 32x32 prisms still fit 16-bit indices
+constexpr size_t HEX_CULL_JOB_CHUNKS = 4096;  // Smallest slice worth a job, a slice culls in a couple of microseconds
+constexpr size_t HEX_CULL_MAX_JOBS = 64;
+
+typedef struct HexWorldDesc {
+  int columns = 256;
+  int rows = 256;
+  int chunk_size = HEX_CHUNK_SIZE;
+  float radius = HEX_DEFAULT_RADIUS;
+  float height = 0.0f;      // Tallest tile in the world, chunk boxes are built from it
+  uint32_t seed = 0;
+} HexWorldDesc;
+
+typedef struct HexChunk {
+  int first_column;
+  int first_row;
+  int columns;
+  int rows;
+} HexChunk;
+
+typedef struct HexWorld {
+  HexWorldDesc desc;
+  int chunks_x = 0;
+  int chunks_y = 0;
+  size_t chunk_count = 0;
+  HexChunk* chunks = nullptr;
+  AabbSoA bounds;               // One box per chunk, same order as chunks
+  uint32_t* visible = nullptr;  // Output of the last cullHexWorld call
+  size_t visible_count = 0;
+  CullStats stats;              // Accumulated until someone resets it
+} HexWorld;
+
+void destroyHexWorld(HexWorld& world) {
+  free(world.chunks);
+  free(world.visible);
+  destroyAabbSoA(world.bounds);
+  world = {};
+}
+
+bool createHexWorld(HexWorld& world, const HexWorldDesc& desc) {
+  if (desc.columns <= 0 || desc.rows <= 0 || desc.chunk_size <= 0) return false;
+
+  world = {};
+  world.desc = desc;
+  world.chunks_x = (desc.columns + desc.chunk_size - 1) / desc.chunk_size;
+  world.chunks_y = (desc.rows + desc.chunk_size - 1) / desc.chunk_size;
+  world.chunk_count = (size_t)world.chunks_x * (size_t)world.chunks_y;
+  world.chunks = (HexChunk*) malloc(world.chunk_count * sizeof(HexChunk));
+  world.visible = (uint32_t*) malloc(world.chunk_count * sizeof(uint32_t));
+  if (!world.chunks || !world.visible || !allocateAabbSoA(world.bounds, world.chunk_count)) {
+    destroyHexWorld(world);
+    return false;
+  }
+
+  // Half width of a pointy-top hex is sqrt(3)/2 * radius, odd rows are shifted by that much to the right
+  const float halfWidth = desc.radius * HEX_SQRT3 * 0.5f;
+  const float stepX = desc.radius * HEX_SQRT3;
+  const float stepZ = desc.radius * 1.5f;
+
+  for (int cy = 0; cy < world.chunks_y; cy++) {
+    for (int cx = 0; cx < world.chunks_x; cx++) {
+      size_t i = (size_t)cy * world.chunks_x + cx;
+      HexChunk& chunk = world.chunks[i];
+      chunk.first_column = cx * desc.chunk_size;
+      chunk.first_row = cy * desc.chunk_size;
+      chunk.columns = desc.columns - chunk.first_column < desc.chunk_size ? desc.columns - chunk.first_column : desc.chunk_size;
+      chunk.rows = desc.rows - chunk.first_row < desc.chunk_size ? desc.rows - chunk.first_row : desc.chunk_size;
+
+      int lastColumn = chunk.first_column + chunk.columns - 1;
+      int lastRow = chunk.first_row + chunk.rows - 1;
+      bool hasOddRow = chunk.rows > 1 || (chunk.first_row & 1);
+      world.bounds.min_x[i] = stepX * (float)chunk.first_column - halfWidth;
+      world.bounds.max_x[i] = stepX * ((float)lastColumn + (hasOddRow ? 0.5f : 0.0f)) + halfWidth;
+      world.bounds.min_y[i] = 0.0f;
+      world.bounds.max_y[i] = desc.height;
+      world.bounds.min_z[i] = stepZ * (float)chunk.first_row - desc.radius;
+      world.bounds.max_z[i] = stepZ * (float)lastRow + desc.radius;
+    }
+  }
+
+  return true;
+}
+
+HexMeshDesc hexChunkMeshDesc(const HexWorld& world, size_t chunk) {
+  HexMeshDesc desc = {};
+  desc.columns = world.chunks[chunk].columns;
+  desc.rows = world.chunks[chunk].rows;
+  desc.first_column = world.chunks[chunk].first_column;
+  desc.first_row = world.chunks[chunk].first_row;
+  desc.radius = world.desc.radius;
+  desc.height = world.desc.height;
+  desc.seed = world.desc.seed;
+  return desc;
+}
+
+// Culls chunks against world * view * projection (row-major, row vectors - straight out of XMStoreFloat4x4).
+// Result lands in world.visible / world.visible_count, stats accumulate in world.stats.
+size_t cullHexWorld(HexWorld& world, const float worldViewProjection[16]) {
+  Frustum frustum;
+  frustumFromMatrix(frustum, worldViewProjection);
+  world.visible_count = cullAabbs(frustum, world.bounds, world.visible, &world.stats);
+  return world.visible_count;
+}
+
+// Same as above with the chunk list sliced across jobs. Slices cull into their own part of world.visible
+// and get compacted in order afterwards, so the result is identical to the serial call.
+size_t cullHexWorld(HexWorld& world, const float worldViewProjection[16], JobSystem& jobs) {
+  if (jobs.worker_count <= 1 || world.chunk_count < 2 * HEX_CULL_JOB_CHUNKS) return cullHexWorld(world, worldViewProjection);
+
+  uint64_t start = timerNanoseconds();
+  Frustum frustum;
+  frustumFromMatrix(frustum, worldViewProjection);
+
+  // Slices start on a multiple of 8 boxes, so the SoA views keep the alignment the SIMD loads want
+  size_t slice = (world.chunk_count + HEX_CULL_MAX_JOBS - 1) / HEX_CULL_MAX_JOBS;
+  slice = slice < HEX_CULL_JOB_CHUNKS ? HEX_CULL_JOB_CHUNKS : (slice + 7) & ~(size_t)7;
+  const size_t sliceCount = (world.chunk_count + slice - 1) / slice;
+  size_t counts[HEX_CULL_MAX_JOBS];
+
+  jobParallelFor(jobs, sliceCount, 1, [&](size_t begin, size_t end) {
+    PROFILE_SCOPE("cull slices");
+    for (size_t s = begin; s < end; s++) {
+      const size_t first = s * slice;
+      AabbSoA view = world.bounds;
+      view.min_x += first; view.min_y += first; view.min_z += first;
+      view.max_x += first; view.max_y += first; view.max_z += first;
+      view.count = world.chunk_count - first < slice ? world.chunk_count - first : slice;
+      uint32_t* out = world.visible + first;
+      counts[s] = cullAabbs(frustum, view, out);
+      for (size_t i = 0; i < counts[s]; i++) out[i] += (uint32_t)first;
+    }
+  });
+
+  size_t count = counts[0];
+  for (size_t s = 1; s < sliceCount; s++) {
+    memmove(world.visible + count, world.visible + s * slice, counts[s] * sizeof(uint32_t));
+    count += counts[s];
+  }
+  world.visible_count = count;
+  world.stats.tested += world.chunk_count;
+  world.stats.visible += count;
+  world.stats.time_ms += (double)(timerNanoseconds() - start) / 1000000.0;
+  return count;
+}
+
+#endif /* _H_HEX_WORLD */
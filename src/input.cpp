@@ -6,6 +6,12 @@
 typedef struct Input {
   POINT last_mouse_pos;
   bool left_mouse_button_down = false;
+  POINT mouse_pos = {};                  // Client area, updated on every move - picking reads it
+  bool right_mouse_button_down = false;  // Dragging a selection box
+  POINT selection_start = {};
+  bool selection_done = false;           // Box released, onUpdate resolves it once
+  int edit_raise = 0;                    // Page Up/Down presses since the last update
+  int edit_type = -1;                    // 1..8 pressed since the last update, as a palette index
 } Input;
 
 #endif /* _H_INPUT */
@@ -1,8 +1,6 @@
 
-// Configuration variables - might go even before we include stuff if this stuff ends up in different files
-constexpr int DISPLAY_FACTOR = 100;
-constexpr int DISPLAY_WIDTH = 16 * DISPLAY_FACTOR;
-constexpr int DISPLAY_HEIGHT = 9 * DISPLAY_FACTOR;
+// Configuration variables - go before everything else, some stuff needs them when included
+#include "config.cpp"
 
 // Top-level defines
 #include "graphics/defines.cpp"
@@ -10,55 +8,116 @@ constexpr int DISPLAY_HEIGHT = 9 * DISPLAY_FACTOR;
 #include "win32_renderer.cpp"
 #include "win_utils.cpp"
 #include "camera.cpp"
+#include "core/startup.cpp"
 #include "input.cpp"
-#include "entities/cube.cpp"
+#include "entities/hexcube.cpp"
+#include "hex/hex_world.cpp"
+#include "hex/hex_instances.cpp"
+#include "hex/hex_picking.cpp"
+#include "hex/hex_terrain.cpp"
+#include "hex/hex_map_file.cpp"
+#include "hex/hex_map_stream.cpp"
+#include "hex/hex_edit.cpp"
+#include "hex/hex_occlusion.cpp"
+#include "hex/hex_animation.cpp"
+#include "hex/hex_commands.cpp"
 #include "shaders/win32_default_shaders.cpp"
 #include "render_pipeline/on_init.cpp"
 #include "render_pipeline/on_init_compile_shaders.cpp"
+#include "render_pipeline/win32_frame_backend.cpp"
+#include "render_pipeline/win32_upload_heap.cpp"
+#include "render_pipeline/win32_copy_backend.cpp"
+#include "render_pipeline/win32_gpu_profiler.cpp"
+#include "render_pipeline/win32_command_backend.cpp"
 
 #include <Windows.h>
+#include <windowsx.h>
 #include <wrl.h>
 #include <cstdlib>
 #include <ctime>
+#include <cstdio>
+#include <algorithm>
 
 // Global variables
 HWND g_hwnd = NULL;
 
-// Pack this together? This is used for objects that are being renderer
-// Entities on the screen.
-Microsoft::WRL::ComPtr<ID3D12Resource> vertexBuffer;
-Microsoft::WRL::ComPtr<ID3D12Resource> indexBuffer;
-Microsoft::WRL::ComPtr<ID3D12Resource> constantBuffer;
+// Per-frame constants are sub-allocated from uploadHeaps. Tile mesh and instances live in default heap
+// buffers owned by copyBackend, everything written into them goes through copyUploader and the copy queue.
+win32_UploadHeaps uploadHeaps = {};
+win32_CopyBackend copyBackend;
+CopyUploader copyUploader;
 
-D3D12_VERTEX_BUFFER_VIEW vertexBufferView;
-D3D12_INDEX_BUFFER_VIEW indexBufferView;
-UINT8* constantBufferView;  // There is something called D3D12_CONSTANT_BUFFER_VIEW_DESC in d3d12.h
+// onRender records the frame into frameCommands, commandBackend turns it into the command list.
+// F7 starts and stops appending every frame to COMMAND_CAPTURE_PATH for the headless replay.
+HexTileBuffers tileBuffers = {};
+CommandStream frameCommands;
+CommandCapture commandCapture;
+win32_CommandBackend commandBackend;
+win32_FrameBackend frameBackend;
 
 
 typedef struct {
-    DirectX::XMMATRIX world;
-    DirectX::XMMATRIX view;
-    DirectX::XMMATRIX projection;
+    Mat4 world;
+    Mat4 view;
+    Mat4 projection;
 } MVPMatrix;
 
 // TODO(ragnar): Rename it to something better
 MVPMatrix constantBufferData;  // MVP matrices go here - stuff that lands in shader
 MVPMatrix cameraData;
 
+static_assert(CBV_ALIGNMENT == D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT, "CBV addresses have to be 256 byte aligned");
+
+// Slot 0 - shared tile mesh, slot 1 - one HexInstance per tile
+constexpr auto hexTileInputLayout = makeInputLayout<InputStream<VertexHalf, 0>, InputStream<HexInstance, 1, true>>();
+
 // Forward declarations - maybe remove them?
-void prepareCube();
+bool openHexWorld(const HexWorldDesc& desc);
+void prepareHexWorld();
+void uploadStreamedChunks();
+void applyTileEdits();
+void animateVisibleChunks();
+void toggleCommandCapture();
 void prepareCamera();
 void onUpdate();
 void onRender();
 void onDestroy();
-void WaitForPreviousFrame();
 
 // Engine entities - ex. Camera is engine entity - controlled by engine, but bothered by game state and shouldn't know anything out it.
 static Camera camera = {};
 static Input input = {};
 
 // Game entities
-static Vertex* cubeVertices = {};
+static HexWorld hexWorld = {};
+static HexMap hexMap = {};         // hexWorld is created from its header, tiles stream out of it
+static HexMapStreamer mapStreamer;
+static uint8_t* chunkUploaded = nullptr;  // Chunk tiles already queued for the instance buffer
+static HexTileEditor tileEditor;          // Edited chunks win over the map file
+static HexOccluders occluders;            // Built from chunk tiles as they upload, F8 turns the pass on and off
+static bool occlusionCulling = false;     // Off until it pays - on the generated hills it drops a few % of chunks for ~0.5 ms
+static HexInstanceRange* chunkInstances = {};  // Where each chunk lives inside the instance buffer
+static HexInstanceRange* instanceDraws = {};   // Visible chunks merged into runs, rebuilt every frame
+static size_t instanceDrawCount = 0;
+static HexAnimator tileAnimator;               // Edits send out ripples, the box selection glows
+static uint32_t* animatedChunks = nullptr;     // Visible chunks drawn from this frame's animated tiles instead
+static uint32_t animatedTileCount = 0;
+static uint64_t animationStart = 0;
+static int tileIndexCount = 0;
+static UINT64 frameCounter = 0;
+static ShaderCache shaderCache = {};
+static JobSystem frameJobs;  // Window thread is worker 0, the rest help with culling and world setup
+static win32_GpuProfiler gpuProfiler = {};
+
+// Picking - tile under the cursor every frame, box selection as one batch of rays
+constexpr int SELECTION_RAY_STEP = 4;  // One ray per 4x4 pixels is plenty, tiles are way bigger than that
+static bool hoverHit = false;
+static HexPick hoverPick = {};
+static HexRayBatch selectionRays = {};
+static int32_t* selectionQ = nullptr;
+static int32_t* selectionR = nullptr;
+static std::vector<uint64_t> selectionScratch;
+static size_t selectionCount = 0;     // Unique tiles in the last box
+static bool captureToggled = false;   // F7, handled at the start of the next onUpdate
 
 LRESULT CALLBACK WindowProc(HWND hwnd, UINT uMsg, WPARAM wParam, LPARAM lParam) {
     switch (uMsg) {
@@ -74,8 +133,26 @@ LRESULT CALLBACK WindowProc(HWND hwnd, UINT uMsg, WPARAM wParam, LPARAM lParam)
             input.left_mouse_button_down = false;
             return 0;
         }
+        case WM_RBUTTONDOWN:
+        {
+            input.right_mouse_button_down = true;
+            input.selection_start = { GET_X_LPARAM(lParam), GET_Y_LPARAM(lParam) };
+            SetCapture(hwnd);
+            return 0;
+        }
+        case WM_RBUTTONUP:
+        {
+            if (input.right_mouse_button_down) {
+                input.right_mouse_button_down = false;
+                input.mouse_pos = { GET_X_LPARAM(lParam), GET_Y_LPARAM(lParam) };
+                input.selection_done = true;
+                ReleaseCapture();
+            }
+            return 0;
+        }
         case WM_MOUSEMOVE:
         {
+            input.mouse_pos = { GET_X_LPARAM(lParam), GET_Y_LPARAM(lParam) };
             if (input.left_mouse_button_down) {
               // TODO(moliw): Fix rotations, those suck
               // I might not understand for now how to do it properly...
@@ -97,6 +174,19 @@ LRESULT CALLBACK WindowProc(HWND hwnd, UINT uMsg, WPARAM wParam, LPARAM lParam)
             if (wParam == VK_ESCAPE) {
                 PostQuitMessage(0);
             }
+            if (wParam == VK_F7) captureToggled = true;
+            if (wParam == VK_F8) occlusionCulling = !occlusionCulling;
+            if (wParam == VK_F9) {
+                // Whatever the rings still hold, last few seconds of frames
+                long events = profilerWriteChromeTrace(PROFILE_TRACE_PATH);
+                char message[128];
+                snprintf(message, sizeof(message), "profiler: %ld events written to %s\n", events, PROFILE_TRACE_PATH);
+                OutputDebugStringA(message);
+            }
+            // Tile edits go to the box selection, or the tile under the cursor without one
+            if (wParam == VK_PRIOR) input.edit_raise++;
+            if (wParam == VK_NEXT) input.edit_raise--;
+            if (wParam >= '1' && wParam <= '8') input.edit_type = (int)(wParam - '1');
             return 0;
         case WM_DESTROY:
             PostQuitMessage(0);
@@ -105,16 +195,33 @@ LRESULT CALLBACK WindowProc(HWND hwnd, UINT uMsg, WPARAM wParam, LPARAM lParam)
     return DefWindowProc(hwnd, uMsg, wParam, lParam);
 }
 
-int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE, LPSTR, int nCmdShow) {
-    srand(static_cast<unsigned int>(time(0)));
-    
-    cubeVertices = createDefaultCube();
+// What the startup stages need from WinMain
+typedef struct StartupContext {
+    HINSTANCE instance;
+    int show_command;
+    HexWorldDesc world_desc;
+} StartupContext;
+
+static StartupGraph startupGraph;
+
+// One trip through the frame loop - waits only if the GPU still uses this frame slot's allocator and constants
+static void runFrame() {
+    beginFrame(framePacer);
+    gpuProfilerBeginFrame(gpuProfiler, framePacer.frame_slot);
+    uploadResetFrame(uploadHeaps.allocator, framePacer.frame_slot);
+    onUpdate();
+    onRender();
+    profilerEndFrame();
+}
 
+// Startup stages - which of them overlap is decided by the graph in WinMain
+static bool startupWindow(void* user, StartupTask& task) {
+    const StartupContext& context = *reinterpret_cast<StartupContext*>(user);
     const char CLASS_NAME[] = "hexagonal-plane";
 
     WNDCLASS wc = {};
     wc.lpfnWndProc = WindowProc;
-    wc.hInstance = hInstance;
+    wc.hInstance = context.instance;
     wc.lpszClassName = CLASS_NAME;
     wc.hCursor = LoadCursor(nullptr, IDC_ARROW);
     RegisterClassA(&wc);
@@ -123,26 +230,132 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE, LPSTR, int nCmdShow) {
         0, CLASS_NAME, "DirectX 12 Learning Code...", WS_OVERLAPPEDWINDOW,
         CW_USEDEFAULT, CW_USEDEFAULT,
         DISPLAY_WIDTH, DISPLAY_HEIGHT,
-        nullptr, nullptr, hInstance, nullptr
+        nullptr, nullptr, context.instance, nullptr
     );
-
     if (g_hwnd == NULL) {
-        return 0;
+        snprintf(task.error, sizeof(task.error), "CreateWindowEx failed with %lu", GetLastError());
+        return false;
     }
+    return true;
+}
 
-    // TODO(ragnar): Remove exception
-    // TODO(ragnar): Split this calls - we don't know what fails
-    try {
-        onInit(renderer, g_hwnd); // Some stuff get's passed, because for other renderers we need to have window handler in main module
-        onInitCompileShaders(renderer, shaders, win32_shader);
-        prepareCamera();
-        prepareCube();
-    } catch (const std::runtime_error& e) {
-        MessageBoxA(g_hwnd, e.what(), "Error", MB_OK | MB_ICONERROR);
-        return -1;
+static bool startupDevice(void*, StartupTask&) {
+    onInitDevice(renderer);
+    return true;
+}
+
+// A missing or stale cache is not an error, everything just gets compiled
+static bool startupShaderCache(void*, StartupTask&) {
+    loadShaderCache(shaderCache, SHADER_CACHE_PATH);
+    return true;
+}
+
+static bool startupShaders(void*, StartupTask&) {
+    onInitCompileShaders(shaders, shaderCache, win32_instanced_shader);
+    return true;
+}
+
+static bool startupMap(void* user, StartupTask& task) {
+    const StartupContext& context = *reinterpret_cast<StartupContext*>(user);
+    if (!openHexWorld(context.world_desc)) {
+        snprintf(task.error, sizeof(task.error), "cannot open or bake %s", HEX_MAP_PATH);
+        return false;
     }
+    return true;
+}
+
+static bool startupCamera(void*, StartupTask&) {
+    prepareCamera();
+    return true;
+}
 
-    ShowWindow(g_hwnd, nCmdShow);
+static bool startupSwapChain(void*, StartupTask&) {
+    onInitSwapChain(renderer, g_hwnd);
+    return true;
+}
+
+static bool startupPipeline(void*, StartupTask&) {
+    onInitPipeline(renderer, shaders, shaderCache, { hexTileInputLayout.data(), (UINT)hexTileInputLayout.size() });
+    saveShaderCache(shaderCache);
+    return true;
+}
+
+static bool startupUploadHeaps(void*, StartupTask&) {
+    initUploadHeaps(uploadHeaps, renderer);
+    initCopyBackend(copyBackend, renderer);
+    initCopyUploader(copyUploader, &copyBackend, copyBackend.staging_mapped, COPY_STAGING_SIZE);
+    initGpuProfiler(gpuProfiler, renderer);
+    return true;
+}
+
+static bool startupHexWorld(void*, StartupTask&) {
+    prepareHexWorld();
+    return true;
+}
+
+// The window shows up with a frame already in it
+static bool startupFirstFrame(void* user, StartupTask&) {
+    const StartupContext& context = *reinterpret_cast<StartupContext*>(user);
+    commandBackend.command_list = renderer.command_list.Get();
+    commandBackend.upload_heaps = &uploadHeaps;
+    commandBackend.copies = &copyUploader;
+    commandBackend.gpu_profiler = &gpuProfiler;
+    commandBackend.root_signature = renderer.root_signature.Get();
+    commandBackend.pipelines[HEX_PIPELINE_TILES] = renderer.pipeline_state.Get();
+    frameBackend.renderer = &renderer;
+    frameBackend.fence_event = g_fenceEvent;
+    initFramePacer(framePacer, &frameBackend);
+    runFrame();
+    ShowWindow(g_hwnd, context.show_command);
+    return true;
+}
+
+int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE, LPSTR, int nCmdShow) {
+    srand(static_cast<unsigned int>(time(0)));
+    
+    StartupContext context = {};
+    context.instance = hInstance;
+    context.show_command = nCmdShow;
+    context.world_desc.seed = (uint32_t)rand();
+    context.world_desc.height = 0.5f;  // Tallest terrain tile, the rest scale down from it
+    if (!createJobSystem(frameJobs, hardwareThreads())) {
+        return -1;
+    }
+    profilerSetThreadName("window thread");
+
+    // Every stage names what it needs, everything else overlaps - shaders compile and the map loads
+    // while the device and the window are created. Window, swap chain and first frame stay on this thread.
+    StartupGraph& startup = startupGraph;
+    const int window = addStartupTask(startup, "window", startupWindow, &context, {}, true);
+    const int device = addStartupTask(startup, "device", startupDevice, nullptr);
+    const int cacheLoad = addStartupTask(startup, "shader cache", startupShaderCache, nullptr);
+    const int shaderCompile = addStartupTask(startup, "shaders", startupShaders, nullptr, { cacheLoad });
+    const int map = addStartupTask(startup, "map", startupMap, &context);
+    const int camera = addStartupTask(startup, "camera", startupCamera, nullptr);
+    const int swapChain = addStartupTask(startup, "swap chain", startupSwapChain, nullptr, { window, device }, true);
+    const int pipeline = addStartupTask(startup, "pipeline", startupPipeline, nullptr, { device, shaderCompile });
+    const int uploads = addStartupTask(startup, "upload heaps", startupUploadHeaps, nullptr, { device });
+    const int world = addStartupTask(startup, "hex world", startupHexWorld, nullptr, { map, uploads });
+    addStartupTask(startup, "first frame", startupFirstFrame, &context, { swapChain, pipeline, world, camera }, true);
+    const bool started = runStartupGraph(startup, frameJobs);
+
+    // Time to first frame and every stage's share of it go to the debugger output
+    char report[2048];
+    formatStartupReport(startup, report, sizeof(report));
+    OutputDebugStringA(report);
+    snprintf(report, sizeof(report), "shaders: cache load %.2f, compile %.2f, pso %.2f, save %.2f ms, hits %zu, misses %zu, rejected %zu\n",
+        shaderCache.stats.load_ms, shaderCache.stats.compile_ms, shaderCache.stats.pipeline_ms, shaderCache.stats.save_ms,
+        shaderCache.stats.hits, shaderCache.stats.misses, shaderCache.stats.rejected);
+    OutputDebugStringA(report);
+    if (!started) {
+        const StartupTask* failed = firstStartupFailure(startup);
+        char message[256];
+        snprintf(message, sizeof(message), "%s: %s", failed != nullptr ? failed->name : "startup", failed != nullptr ? failed->error : "failed");
+        MessageBoxA(g_hwnd, message, "Error", MB_OK | MB_ICONERROR);
+        stopHexMapStreamer(mapStreamer);
+        destroyJobSystem(frameJobs);
+        return -1;
+    }
 
     MSG msg = {};
     while (msg.message != WM_QUIT) {
@@ -150,8 +363,7 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE, LPSTR, int nCmdShow) {
             TranslateMessage(&msg);
             DispatchMessage(&msg);
         } else {
-            onUpdate();
-            onRender();
+            runFrame();
         }
     }
 
@@ -163,186 +375,411 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE, LPSTR, int nCmdShow) {
 void prepareCamera () {
     // Renderer initialized, below stuff is engine related
     
-    cameraData.world = DirectX::XMMatrixIdentity();
+    cameraData.world = mat4Identity();
 
     // Maybe we can write something about DirectX3D space coordinates?
     // It's right hand - pointed straight to our face. Thumb is y, second finger is x, first finger is z.
     // -z to our face.
     // +y up.
     // Rest is history
-    DirectX::XMVECTOR eye = DirectX::XMVectorSet(2.0f, 2.0f, -2.0f, 0.0f);
-    DirectX::XMVECTOR at  = DirectX::XMVectorSet(0.0f, 0.0f, 0.0f, 0.0f);
-    DirectX::XMVECTOR up  = DirectX::XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f);
-    cameraData.view = DirectX::XMMatrixLookAtLH(eye, at, up);
+    Float3 eye = { 2.0f, 2.0f, -2.0f };
+    Float3 at  = { 0.0f, 0.0f, 0.0f };
+    Float3 up  = { 0.0f, 1.0f, 0.0f };
+    cameraData.view = mat4LookAtLH(eye, at, up);
 
     // Perspective projection provided straight from microsoft vaults.
-    cameraData.projection = DirectX::XMMatrixPerspectiveFovLH(DirectX::XM_PIDIV4,
+    cameraData.projection = mat4PerspectiveFovLH(MATH_PIDIV4,
         (float)DISPLAY_WIDTH / (float)DISPLAY_HEIGHT,
         0.1f,
         100.0f);
 }
 
-// Test function to properly render our test cube
-void prepareCube() {
+// Opens the baked map, bakes it from noise terrain first when there is none this build can read
+bool openHexWorld(const HexWorldDesc& desc) {
+    if (!openHexMap(hexMap, HEX_MAP_PATH)) {
+        HexTerrain terrain = {};
+        bool baked = createHexWorld(hexWorld, desc) && allocateHexTerrain(terrain, hexWorld, hexTerrainDesc(desc.seed));
+        if (baked) {
+            generateHexTerrain(terrain, hexWorld, frameJobs);
+            baked = writeHexMap(HEX_MAP_PATH, hexWorld, 0, [&](size_t chunk, HexInstance* out) {
+                packHexChunkTerrainInstances(hexWorld, terrain, chunk, out);
+            });
+        }
+        destroyHexTerrain(terrain);
+        destroyHexWorld(hexWorld);
+        if (!baked || !openHexMap(hexMap, HEX_MAP_PATH)) return false;
+    }
+    return createHexWorld(hexWorld, hexMapWorldDesc(*hexMap.header));
+}
+
+static void mapChunkSource(void*, size_t chunk, HexInstance* out) {
+    copyHexMapChunkTiles(hexMap, chunk, out);
+}
+
+// Uploads the shared tile mesh and sets up one instance buffer, chunk tiles get copied into it as they stream in
+void prepareHexWorld() {
     // Do we end creating directx stuff above?
     // No, we are still inside onInit function
     // TODO(moliwa): Split creation of renderer and stuff for rendered entities
 
-    const UINT vertexBufferSize = sizeof(Vertex) * DEFAULT_CUBE_VERTICES;
-
-    D3D12_HEAP_PROPERTIES heapProps = {};
-    D3D12_RESOURCE_DESC resourceDesc = {};
-    D3D12_RANGE readRange = {0, 0};
-
-    heapProps.Type = D3D12_HEAP_TYPE_UPLOAD;
-
-    resourceDesc.Dimension = D3D12_RESOURCE_DIMENSION_BUFFER;
-    resourceDesc.Width = vertexBufferSize;
-    resourceDesc.Height = 1;
-    resourceDesc.DepthOrArraySize = 1;
-    resourceDesc.MipLevels = 1;
-    resourceDesc.SampleDesc.Count = 1;
-    resourceDesc.Layout = D3D12_TEXTURE_LAYOUT_ROW_MAJOR;
-
-    ThrowIfFailed(renderer.device->CreateCommittedResource(
-        &heapProps,
-        D3D12_HEAP_FLAG_NONE,
-        &resourceDesc,
-        D3D12_RESOURCE_STATE_GENERIC_READ,
-        nullptr,
-        IID_PPV_ARGS(&vertexBuffer)));
-
-    UINT8* pVertexDataBegin;
-    ThrowIfFailed(vertexBuffer->Map(0, &readRange, reinterpret_cast<void**>(&pVertexDataBegin)));
-
-    memcpy(pVertexDataBegin, cubeVertices, vertexBufferSize);
-
-    vertexBuffer->Unmap(0, nullptr);
-
-    vertexBufferView.BufferLocation = vertexBuffer->GetGPUVirtualAddress();
-    vertexBufferView.StrideInBytes = sizeof(Vertex);
-    vertexBufferView.SizeInBytes = vertexBufferSize;
-
-    const UINT indexBufferSize = sizeof(cubeIndices);
-    resourceDesc.Width = indexBufferSize;  // ResourceDesc is being reused here!
-
-    ThrowIfFailed(renderer.device->CreateCommittedResource(
-        &heapProps,
-        D3D12_HEAP_FLAG_NONE,
-        &resourceDesc,
-        D3D12_RESOURCE_STATE_GENERIC_READ,
-        nullptr,
-        IID_PPV_ARGS(&indexBuffer)));
-
-    UINT8* pIndexDataBegin;
-    ThrowIfFailed(indexBuffer->Map(0, &readRange, reinterpret_cast<void**>(&pIndexDataBegin)));
-    memcpy(pIndexDataBegin, cubeIndices, sizeof(cubeIndices));
-    indexBuffer->Unmap(0, nullptr);
-
-    indexBufferView.BufferLocation = indexBuffer->GetGPUVirtualAddress();
-    indexBufferView.Format = DXGI_FORMAT_R16_UINT;
-    indexBufferView.SizeInBytes = indexBufferSize;
-
-  // We prepare something like GPU heap here and try to push data on it?
-  // Key call I think are: CreateComittedResource, Map and memcpy
-  // TODO(moliwa): Is there something else besides memcpy to move data?
-    heapProps = {};
-    resourceDesc = {};
-    readRange = {0, 0};
-    
-    heapProps.Type = D3D12_HEAP_TYPE_UPLOAD;
-
-    resourceDesc.Dimension = D3D12_RESOURCE_DIMENSION_BUFFER;
-    // resourceDesc.Width = 1024 * 64; // Why this sizes here??? - code generated
-    // According to https://learn.microsoft.com/en-us/windows/win32/api/d3d12/ns-d3d12-d2d12_resource_desc
-    // Alignment might be one of 0, 4KB, 64KB or 4MB so I guess this here makes it like that.
-    // Here we do not set this field
-    resourceDesc.Width = 1024 * 4; // Why this sizes here???
-    resourceDesc.Height = 1;
-    resourceDesc.DepthOrArraySize = 1;
-    resourceDesc.MipLevels = 1;
-    resourceDesc.SampleDesc.Count = 1;
-    resourceDesc.Layout = D3D12_TEXTURE_LAYOUT_ROW_MAJOR;
-
-    ThrowIfFailed(renderer.device->CreateCommittedResource(
-        &heapProps,
-        D3D12_HEAP_FLAG_NONE,
-        &resourceDesc,
-        D3D12_RESOURCE_STATE_GENERIC_READ,
-        nullptr,
-        IID_PPV_ARGS(&constantBuffer)));
-
-    ThrowIfFailed(constantBuffer->Map(0, &readRange, reinterpret_cast<void**>(&constantBufferView)));
-    memcpy(constantBufferView, &constantBufferData, sizeof(constantBufferData));
+    int tileVertexCount = 0;
+    VertexHalf* tileVertices = createInstancedHexTile(hexWorld.desc.height > 0.0f, tileVertexCount, tileIndexCount);
+    chunkInstances = (HexInstanceRange*)malloc(hexWorld.chunk_count * sizeof(HexInstanceRange));
+    instanceDraws = (HexInstanceRange*)malloc(hexWorld.chunk_count * sizeof(HexInstanceRange));
+    const size_t selectionCapacity = (size_t)(DISPLAY_WIDTH / SELECTION_RAY_STEP + 1) * (DISPLAY_HEIGHT / SELECTION_RAY_STEP + 1);
+    bool selectionReady = allocateHexRayBatch(selectionRays, selectionCapacity);
+    selectionQ = (int32_t*)malloc(selectionCapacity * sizeof(int32_t));
+    selectionR = (int32_t*)malloc(selectionCapacity * sizeof(int32_t));
+    chunkUploaded = (uint8_t*)calloc(hexWorld.chunk_count, 1);
+    animatedChunks = (uint32_t*)malloc(hexWorld.chunk_count * sizeof(uint32_t));
+    HexMapStreamDesc streamDesc = {};
+    streamDesc.load_radius = 110.0f;   // Past the far plane, whatever the frustum can reach is loaded
+    streamDesc.evict_radius = 140.0f;
+    if (tileVertices == nullptr || chunkInstances == nullptr || instanceDraws == nullptr || !selectionReady || selectionQ == nullptr || selectionR == nullptr ||
+        chunkUploaded == nullptr || animatedChunks == nullptr || !createHexAnimator(tileAnimator, hexWorld) || !startHexMapStreamer(mapStreamer, hexMap, hexWorld, streamDesc) ||
+        !createHexTileEditor(tileEditor, hexWorld, chunkInstances, mapChunkSource, nullptr) ||
+        !createHexOccluders(occluders, hexWorld, OCCLUSION_WIDTH, OCCLUSION_HEIGHT)) {
+        throw std::runtime_error("Failed to allocate hex world");
+    }
+    const size_t instanceCount = buildHexInstanceRanges(hexWorld, chunkInstances);
+
+    // Every stream is a default heap buffer, the GPU reads them from its own memory instead of over the bus.
+    // Buffer ids are shared with the command stream, so the backend resolves the same ids to these.
+    const UINT vertexBufferSize = sizeof(VertexHalf) * tileVertexCount;
+    const UINT indexBufferSize = sizeof(unsigned short) * tileIndexCount;
+    // Per-instance stream - room for every chunk, filled by uploadStreamedChunks straight from the map file
+    const UINT instanceBufferSize = (UINT)(sizeof(HexInstance) * instanceCount);
+    const uint32_t ids[] = { HEX_BUFFER_TILE_VERTICES, HEX_BUFFER_TILE_INDICES, HEX_BUFFER_INSTANCES };
+    const UINT sizes[] = { vertexBufferSize, indexBufferSize, instanceBufferSize };
+    for (int i = 0; i < 3; i++) {
+        commandBackend.buffer_gpu[ids[i]] = createCopyDestination(copyBackend, ids[i], sizes[i]);
+    }
+    copyUpload(copyUploader, HEX_BUFFER_TILE_VERTICES, 0, tileVertices, vertexBufferSize);
+    copyUpload(copyUploader, HEX_BUFFER_TILE_INDICES, 0, hexTileIndices, indexBufferSize);
+    free(tileVertices);
+    copyFlush(copyUploader);
+
+    // Views are recorded every frame from these
+    tileBuffers.vertex_size = vertexBufferSize;
+    tileBuffers.vertex_stride = sizeof(VertexHalf);
+    tileBuffers.index_size = indexBufferSize;
+    tileBuffers.index_count = (uint32_t)tileIndexCount;
+    tileBuffers.instance_size = instanceBufferSize;
+    animationStart = timerNanoseconds();
+}
+
+// Queues visible chunks the streamer has made resident for the instance buffer and drops the rest from
+// hexWorld.visible, so nothing draws from a range that was never written. A chunk's range is written once,
+// before its first draw, so the GPU is never reading what gets written here - the frame that draws it waits
+// on the copy fence, the copy queue does not wait on anything.
+void uploadStreamedChunks() {
+    PROFILE_SCOPE("upload chunks");
+    size_t kept = 0;
+    for (size_t i = 0; i < hexWorld.visible_count; i++) {
+        const uint32_t chunk = hexWorld.visible[i];
+        if (!chunkUploaded[chunk] && hexMapChunkResident(mapStreamer, chunk)) {
+            const HexInstance* edited = hexEditedChunkTiles(tileEditor, chunk);
+            const size_t offset = chunkInstances[chunk].first * sizeof(HexInstance);
+            const size_t size = chunkInstances[chunk].count * sizeof(HexInstance);
+            if (edited != nullptr) {
+                copyUpload(copyUploader, HEX_BUFFER_INSTANCES, offset, edited, size);
+            } else {
+                // Decoded from the map straight into the staging ring
+                uint8_t* staging = copyAllocate(copyUploader, HEX_BUFFER_INSTANCES, offset, size);
+                if (staging == nullptr) continue;
+                copyHexMapChunkTiles(hexMap, chunk, reinterpret_cast<HexInstance*>(staging));
+            }
+            // From the source, not the write-combined copy that was just made
+            const HexInstance* tiles = edited != nullptr ? edited : hexMapChunkTiles(hexMap, chunk);
+            updateHexChunkOccluder(occluders, hexWorld, chunk, tiles);
+            cmdWriteBuffer(frameCommands, HEX_BUFFER_INSTANCES, chunkInstances[chunk].first * sizeof(HexInstance), tiles,
+                           chunkInstances[chunk].count * sizeof(HexInstance));
+            chunkUploaded[chunk] = 1;
+        }
+        if (chunkUploaded[chunk]) hexWorld.visible[kept++] = chunk;
+    }
+    hexWorld.visible_count = kept;
+}
+
+// Turns this frame's edit keys into tile edits, then uploads what changed within the frame's budget.
+// Frames still in flight read the same instance buffer, so a batch with edits waits for them on the copy
+// queue - and this frame waits for the batch. Only frames with edits lose the overlap.
+void applyTileEdits() {
+    PROFILE_SCOPE("tile edits");
+    if (input.edit_raise != 0 || input.edit_type >= 0) {
+        HexTileEdit edit;
+        edit.fields = (input.edit_raise != 0 ? (uint32_t)HEX_EDIT_RAISE : 0u) | (input.edit_type >= 0 ? (uint32_t)HEX_EDIT_TYPE : 0u);
+        edit.height = (float)input.edit_raise * 0.1f * hexWorld.desc.height;
+        edit.type = (uint32_t)input.edit_type;
+        if (selectionCount > 0) {
+            for (size_t i = 0; i < selectionCount; i++) hexEditTile(tileEditor, { selectionQ[i], selectionR[i] }, edit);
+        } else if (hoverHit) {
+            hexEditTile(tileEditor, hoverPick.tile, edit);
+        }
+        if (hoverHit) {
+            HexRipple ripple;
+            ripple.x = hoverPick.x;
+            ripple.z = hoverPick.z;
+            ripple.start = (float)((timerNanoseconds() - animationStart) / 1e9);
+            ripple.amplitude = 0.6f;
+            ripple.speed = 12.0f * hexWorld.desc.radius;
+            ripple.width = 2.0f * hexWorld.desc.radius;
+            ripple.duration = 3.0f;
+            hexAddRipple(tileAnimator, ripple);
+        }
+        input.edit_raise = 0;
+        input.edit_type = -1;
+    }
+
+    // Chunks that were never uploaded pick their edited tiles up in uploadStreamedChunks instead
+    flushHexTileEdits(tileEditor, HEX_EDIT_BUDGET_MS, [](size_t chunk, size_t offset, const void* data, size_t size) {
+        if (chunkUploaded[chunk]) {
+            copyUpload(copyUploader, HEX_BUFFER_INSTANCES, offset, data, size, true);
+            cmdWriteBuffer(frameCommands, HEX_BUFFER_INSTANCES, offset, data, size);
+            updateHexChunkOccluder(occluders, hexWorld, chunk, hexEditedChunkTiles(tileEditor, chunk));
+        }
+    });
+}
+
+static const HexInstance* animationSource(void*, size_t chunk) {
+    const HexInstance* edited = hexEditedChunkTiles(tileEditor, chunk);
+    return edited != nullptr ? edited : hexMapChunkTiles(hexMap, chunk);
+}
+
+// Visible chunks with a ripple or a highlight in them get animated from their static tiles straight into this
+// frame's slot of the upload heap - write-combined memory the GPU reads as is, so there is no copy on either
+// side and nothing to wait for. They come out of hexWorld.visible, the rest keep drawing from the instance buffer.
+void animateVisibleChunks() {
+    PROFILE_SCOPE("animate");
+    animatedTileCount = 0;
+    size_t idleCount = 0;
+    const size_t selected = selectAnimatedChunks(tileAnimator, hexWorld.visible, hexWorld.visible_count, animatedChunks, hexWorld.visible, idleCount);
+    // Constants get allocated later this frame, out of what the tiles leave - chunks past that stay still
+    const size_t room = uploadFrameRoom(uploadHeaps.allocator, framePacer.frame_slot, sizeof(HexInstance), UPLOAD_FRAME_CONSTANTS);
+    const size_t count = fitAnimatedChunks(tileAnimator, animatedChunks, selected, room / sizeof(HexInstance), hexWorld.visible, idleCount);
+    hexWorld.visible_count = idleCount;
+    if (count == 0) return;
+    const size_t tiles = hexAnimatedTileCount(tileAnimator, animatedChunks, count);
+    win32_UploadRange range;
+    if (!tryAllocateFrameRange(uploadHeaps, framePacer.frame_slot, tiles * sizeof(HexInstance), sizeof(HexInstance), range, UPLOAD_FRAME_CONSTANTS)) {
+        // Should not happen after uploadFrameRoom - still drawn, just not animated
+        for (size_t i = 0; i < count; i++) hexWorld.visible[hexWorld.visible_count++] = animatedChunks[i];
+        return;
+    }
+    HexInstance* out = reinterpret_cast<HexInstance*>(range.cpu);
+    animatedTileCount = (uint32_t)animateHexChunks(tileAnimator, animatedChunks, count, animationSource, nullptr, out, frameJobs);
+    commandBackend.buffer_gpu[HEX_BUFFER_ANIMATED_INSTANCES] = range.gpu;
+    commandBackend.buffer_cpu[HEX_BUFFER_ANIMATED_INSTANCES] = range.cpu;
+    commandBackend.buffer_cpu_size[HEX_BUFFER_ANIMATED_INSTANCES] = range.allocation.size;
+    tileBuffers.animated_size = (uint32_t)(tiles * sizeof(HexInstance));
+    // A capture gets the same tiles - from a second pass over the sources, the mapped copy is never read back
+    if (frameCommands.record_writes) {
+        static std::vector<HexInstance> captured;
+        captured.resize(tiles);
+        for (size_t i = 0; i < count; i++) {
+            animateHexChunk(tileAnimator, animatedChunks[i], animationSource(nullptr, animatedChunks[i]), captured.data() + tileAnimator.offsets[i]);
+        }
+        cmdWriteBuffer(frameCommands, HEX_BUFFER_ANIMATED_INSTANCES, 0, captured.data(), tiles * sizeof(HexInstance));
+    }
+}
+
+// Starts or stops appending frames to COMMAND_CAPTURE_PATH. A capture starts with what the buffers already
+// hold, after that every upload and edit is recorded as it happens, so a replay never needs the map file.
+void toggleCommandCapture() {
+    char message[256];
+    if (commandCapture.file != nullptr) {
+        const uint32_t frames = commandCapture.frames;
+        const double megabytes = commandCapture.bytes / (1024.0 * 1024.0);
+        const bool written = endCommandCapture(commandCapture);
+        frameCommands.record_writes = false;
+        snprintf(message, sizeof(message), "capture: %u frames, %.1f MB %s %s\n", frames, megabytes, written ? "written to" : "FAILED to write", COMMAND_CAPTURE_PATH);
+        OutputDebugStringA(message);
+        return;
+    }
+    if (!beginCommandCapture(commandCapture, COMMAND_CAPTURE_PATH)) {
+        snprintf(message, sizeof(message), "capture: cannot open %s\n", COMMAND_CAPTURE_PATH);
+        OutputDebugStringA(message);
+        return;
+    }
+    frameCommands.record_writes = true;
+    // The tile mesh only lives on the GPU now, building it again is a few hundred bytes
+    int tileVertexCount = 0;
+    int tileIndices = 0;
+    VertexHalf* tileVertices = createInstancedHexTile(hexWorld.desc.height > 0.0f, tileVertexCount, tileIndices);
+    if (tileVertices != nullptr) cmdWriteBuffer(frameCommands, HEX_BUFFER_TILE_VERTICES, 0, tileVertices, tileBuffers.vertex_size);
+    free(tileVertices);
+    cmdWriteBuffer(frameCommands, HEX_BUFFER_TILE_INDICES, 0, hexTileIndices, tileBuffers.index_size);
+    for (size_t chunk = 0; chunk < hexWorld.chunk_count; chunk++) {
+        if (!chunkUploaded[chunk]) continue;
+        const HexInstance* edited = hexEditedChunkTiles(tileEditor, chunk);
+        cmdWriteBuffer(frameCommands, HEX_BUFFER_INSTANCES, chunkInstances[chunk].first * sizeof(HexInstance),
+                       edited != nullptr ? edited : hexMapChunkTiles(hexMap, chunk), chunkInstances[chunk].count * sizeof(HexInstance));
+    }
 }
 
 void onUpdate() {
-    DirectX::XMMATRIX rotationMatrix = DirectX::XMMatrixRotationX(camera.rotation_x) * DirectX::XMMatrixRotationY(camera.rotation_y);
+    PROFILE_SCOPE("onUpdate");
+    if (captureToggled) {
+        captureToggled = false;
+        toggleCommandCapture();
+    }
+    Mat4 rotationMatrix = mat4RotationX(camera.rotation_x) * mat4RotationY(camera.rotation_y);
     cameraData.world = rotationMatrix;
 
     // Transpose the matrices to be column-major for the shader.
-    constantBufferData.world = DirectX::XMMatrixTranspose(cameraData.world);
-    constantBufferData.view = DirectX::XMMatrixTranspose(cameraData.view);
-    constantBufferData.projection = DirectX::XMMatrixTranspose(cameraData.projection);
-    
-    memcpy(constantBufferView, &constantBufferData, sizeof(constantBufferData));
+    constantBufferData.world = mat4Transpose(cameraData.world);
+    constantBufferData.view = mat4Transpose(cameraData.view);
+    constantBufferData.projection = mat4Transpose(cameraData.projection);
+
+    // Frustum planes come out of the same matrices the shader gets, so chunks are culled in mesh space
+    const Mat4 worldViewProjection = cameraData.world * cameraData.view * cameraData.projection;
+    // Ripples lift tiles past their chunk boxes, the boxes they cross grow first
+    beginHexAnimation(tileAnimator, (float)((timerNanoseconds() - animationStart) / 1e9));
+    growHexAnimatedBounds(tileAnimator, hexWorld);
+    {
+        PROFILE_SCOPE("cull");
+        cullHexWorld(hexWorld, worldViewProjection.m, frameJobs);
+    }
+    uploadStreamedChunks();
+    // Occluders are built from uploaded tiles, and draws get recorded from whatever survives
+    if (occlusionCulling) occludeHexWorld(occluders, hexWorld, worldViewProjection.m);
+    animateVisibleChunks();
+    instanceDrawCount = mergeVisibleInstanceRanges(hexWorld.visible, hexWorld.visible_count, chunkInstances, instanceDraws);
+
+    // Picking works in the same mesh space - rays come from inverting the whole chain
+    Mat4 inverseWorldViewProjection = mat4Identity();
+    mat4Inverse(inverseWorldViewProjection, worldViewProjection);
+    const HexPickPlane pickPlane = hexPickPlane(hexWorld);
+    {
+        PROFILE_SCOPE("picking");
+        HexRay cursorRay;
+        hoverHit = hexRayFromScreen(inverseWorldViewProjection.m, (float)input.mouse_pos.x, (float)input.mouse_pos.y,
+                                    DISPLAY_WIDTH, DISPLAY_HEIGHT, cursorRay) &&
+                   hexPickRay(pickPlane, cursorRay, hoverPick);
+    }
+    // Streaming follows the ground point in the middle of the screen
+    HexRay centerRay;
+    if (hexRayFromScreen(inverseWorldViewProjection.m, DISPLAY_WIDTH * 0.5f, DISPLAY_HEIGHT * 0.5f, DISPLAY_WIDTH, DISPLAY_HEIGHT, centerRay) &&
+        centerRay.direction[1] < 0.0f) {
+        const float t = -centerRay.origin[1] / centerRay.direction[1];
+        hexMapStreamFocus(mapStreamer, centerRay.origin[0] + centerRay.direction[0] * t, centerRay.origin[2] + centerRay.direction[2] * t);
+    }
+    if (input.selection_done) {
+        input.selection_done = false;
+        {
+            PROFILE_SCOPE("picking");
+            hexRaysFromScreenRect(inverseWorldViewProjection.m, input.selection_start.x, input.selection_start.y,
+                                  input.mouse_pos.x + 1, input.mouse_pos.y + 1, SELECTION_RAY_STEP, DISPLAY_WIDTH, DISPLAY_HEIGHT, selectionRays);
+            hexPickRays(pickPlane, selectionRays, selectionQ, selectionR);
+            selectionCount = hexUniquePicks(selectionQ, selectionR, selectionRays.count, selectionScratch);
+        }
+        hexClearHighlights(tileAnimator);
+        for (size_t i = 0; i < selectionCount; i++) {
+            int col, row;
+            hexAxialToOffset({ selectionQ[i], selectionR[i] }, col, row);
+            hexSetHighlight(tileAnimator, col, row, true);
+        }
+    }
+
+    applyTileEdits();
+
+    // Culling stats in the title bar, averaged over the last second or so
+    if (++frameCounter % 60 == 0) {
+        UploadStats upload = uploadStats(uploadHeaps.allocator);
+        char hover[64] = "-";
+        if (hoverHit) snprintf(hover, sizeof(hover), "%d,%d", hoverPick.column, hoverPick.row);
+        ProfileFrameStats cpuFrames = rollingStatsSummary(profiler.cpu_frames);
+        ProfileFrameStats gpuFrames = rollingStatsSummary(profiler.gpu_frames);
+        HexMapStreamStats stream = hexMapStreamStats(mapStreamer);
+        static uint64_t copyBytes = 0;
+        static uint64_t copyStart = timerNanoseconds();
+        const uint64_t now = timerNanoseconds();
+        const double copyMBs = (double)(copyUploader.stats.bytes - copyBytes) / (1024.0 * 1024.0) / ((double)(now - copyStart) / 1e9);
+        copyBytes = copyUploader.stats.bytes;
+        copyStart = now;
+        char title[768];
+        snprintf(title, sizeof(title), "DirectX 12 Learning Code... | frame p50 %.2f p99 %.2f ms | gpu p50 %.2f p99 %.2f ms | chunks tested %zu visible %zu | cull %.4f ms | occluded %zu in %.3f ms | draws %zu | gpu wait %.3f ms | upload %.1f/%.1f MB | copy %.1f MB/s stalls %llu | map %u chunks load p99 %.2f ms rss %.0f MB | animated %zu chunks %.3f ms | tile %s | selected %zu",
+            cpuFrames.p50_ms, cpuFrames.p99_ms, gpuFrames.p50_ms, gpuFrames.p99_ms,
+            hexWorld.stats.tested / 60, hexWorld.stats.visible / 60, hexWorld.stats.time_ms / 60.0,
+            occluders.culled / 60, (occluders.buffer.stats.raster_ms + occluders.buffer.stats.test_ms) / 60.0, instanceDrawCount,
+            framePacer.wait_ms / 60.0, upload.used / (1024.0 * 1024.0), upload.capacity / (1024.0 * 1024.0),
+            copyMBs, (unsigned long long)copyUploader.stats.stalls,
+            stream.resident, stream.latency.p99_ms, processResidentBytes() / (1024.0 * 1024.0),
+            tileAnimator.stats.chunks_animated / 60, tileAnimator.stats.time_ms / 60.0, hover, selectionCount);
+        SetWindowTextA(g_hwnd, title);
+        hexWorld.stats = {};
+        occluders.buffer.stats = {};
+        occluders.culled = 0;
+        framePacer.wait_ms = 0.0;
+        tileAnimator.stats = {};
+    }
 }
 
 void onRender() {
-    // Begin stuff - always has to be done independent of what is being rendered?
-    D3D12_VIEWPORT viewport = { 0.0f, 0.0f, DISPLAY_WIDTH, DISPLAY_HEIGHT, D3D12_MIN_DEPTH, D3D12_MAX_DEPTH };
-    D3D12_RECT scissorRect = { 0, 0, DISPLAY_WIDTH, DISPLAY_HEIGHT };
-    D3D12_RESOURCE_BARRIER barrier = {};
-    D3D12_CPU_DESCRIPTOR_HANDLE rtvHandle = renderer.rtv_heap->GetCPUDescriptorHandleForHeapStart();
+    PROFILE_SCOPE("onRender");
     ID3D12CommandList* ppCommandLists[] = { renderer.command_list.Get() };
+    {
+        // While capturing, this frame's uploads and edits are already in the stream ahead of the pass
+        PROFILE_SCOPE("record");
+        recordHexTilePass(frameCommands, clearColor, DISPLAY_WIDTH, DISPLAY_HEIGHT, tileBuffers,
+                          &constantBufferData, sizeof(constantBufferData), instanceDraws, instanceDrawCount, animatedTileCount);
+    }
 
-    ThrowIfFailed(renderer.command_allocator->Reset());
-    ThrowIfFailed(renderer.command_list->Reset(renderer.command_allocator.Get(), renderer.pipeline_state.Get()));
-    renderer.command_list->SetGraphicsRootSignature(renderer.root_signature.Get());
-    renderer.command_list->SetGraphicsRootConstantBufferView(0, constantBuffer->GetGPUVirtualAddress());
-    renderer.command_list->RSSetViewports(1, &viewport);
-    renderer.command_list->RSSetScissorRects(1, &scissorRect);
-    barrier.Type = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION;
-    barrier.Transition.pResource = renderer.render_targets[FRAME_INDEX].Get();
-    barrier.Transition.StateBefore = D3D12_RESOURCE_STATE_PRESENT;
-    barrier.Transition.StateAfter = D3D12_RESOURCE_STATE_RENDER_TARGET;
-    renderer.command_list->ResourceBarrier(1, &barrier);
+    // beginFrame already made sure the GPU is done with this slot
+    ID3D12CommandAllocator* commandAllocator = renderer.command_allocators[framePacer.frame_slot].Get();
+    ThrowIfFailed(commandAllocator->Reset());
+    ThrowIfFailed(renderer.command_list->Reset(commandAllocator, renderer.pipeline_state.Get()));
+    const UINT gpuFrame = gpuProfileBegin(gpuProfiler, renderer.command_list.Get(), "frame");
+    D3D12_CPU_DESCRIPTOR_HANDLE rtvHandle = renderer.rtv_heap->GetCPUDescriptorHandleForHeapStart();
     rtvHandle.ptr += FRAME_INDEX * RTV_DESCRIPTOR_SIZE;
-    renderer.command_list->OMSetRenderTargets(1, &rtvHandle, FALSE, nullptr);
-    
-    // Render stuff goes here - vertexBufferView and indexBufferView
-    renderer.command_list->ClearRenderTargetView(rtvHandle, clearColor, 0, nullptr);
-    renderer.command_list->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
-    renderer.command_list->IASetVertexBuffers(0, 1, &vertexBufferView);
-    renderer.command_list->IASetIndexBuffer(&indexBufferView);
-    renderer.command_list->DrawIndexedInstanced(36, 1, 0, 0, 0);
-
-    // End stuff - always has to be done independent of what is being rendered?
-    barrier.Transition.StateBefore = D3D12_RESOURCE_STATE_RENDER_TARGET;
-    barrier.Transition.StateAfter = D3D12_RESOURCE_STATE_PRESENT;
-    renderer.command_list->ResourceBarrier(1, &barrier);
+    commandBackend.frame_slot = framePacer.frame_slot;
+    commandBackend.render_target = renderer.render_targets[FRAME_INDEX].Get();
+    commandBackend.rtv = rtvHandle;
+    {
+        PROFILE_SCOPE("submit");
+        executeCommands(frameCommands.bytes.data(), frameCommands.bytes.size(), commandBackend);
+    }
+    // Whatever this frame uploaded goes out now, and the frame waits for it on the GPU
+    waitForCopies(copyBackend, renderer.command_queue.Get(), copyFlush(copyUploader));
+    if (commandCapture.file != nullptr && !captureCommandFrame(commandCapture, frameCommands)) {
+        toggleCommandCapture();  // Disk full or gone, keep what made it
+    }
+    resetCommandStream(frameCommands);
+
+    gpuProfileEnd(gpuProfiler, renderer.command_list.Get(), gpuFrame);
+    gpuProfilerResolve(gpuProfiler, renderer.command_list.Get());
     ThrowIfFailed(renderer.command_list->Close());
     renderer.command_queue->ExecuteCommandLists(_countof(ppCommandLists), ppCommandLists);
-    ThrowIfFailed(renderer.swap_chain->Present(1, 0));
-    WaitForPreviousFrame();
+    {
+        PROFILE_SCOPE("Present");
+        ThrowIfFailed(renderer.swap_chain->Present(1, 0));
+    }
+
+    // No waiting here anymore - the next beginFrame blocks only if it runs FRAMES_IN_FLIGHT ahead
+    endFrame(framePacer);
+    FRAME_INDEX = renderer.swap_chain->GetCurrentBackBufferIndex();
 }
 
 void onDestroy() {
-    WaitForPreviousFrame();
+    flushFrames(framePacer);
+    if (commandCapture.file != nullptr) toggleCommandCapture();
     CloseHandle(g_fenceEvent);
-}
-
-// TODO(moliwa): This should go to onRender pipline and stay there forever and ever
-// This function is only called in onRender
-void WaitForPreviousFrame() {
-    const UINT64 fence = g_fenceValue;
-    ThrowIfFailed(renderer.command_queue->Signal(renderer.fence.Get(), fence));
-    g_fenceValue++;
-
-    if (renderer.fence->GetCompletedValue() < fence) {
-        ThrowIfFailed(renderer.fence->SetEventOnCompletion(fence, g_fenceEvent));
-        WaitForSingleObject(g_fenceEvent, INFINITE);
-    }
-
-    FRAME_INDEX = renderer.swap_chain->GetCurrentBackBufferIndex();
+    stopHexMapStreamer(mapStreamer);
+    destroyHexTileEditor(tileEditor);
+    destroyHexOccluders(occluders);
+    destroyHexAnimator(tileAnimator);
+    free(animatedChunks);
+    free(chunkUploaded);
+    free(chunkInstances);
+    free(instanceDraws);
+    free(selectionQ);
+    free(selectionR);
+    destroyHexRayBatch(selectionRays);
+    copyWaitIdle(copyUploader);
+    destroyCopyBackend(copyBackend);
+    destroyUploadHeaps(uploadHeaps);
+    destroyGpuProfiler(gpuProfiler);
+    destroyHexWorld(hexWorld);
+    closeHexMap(hexMap);
+    destroyJobSystem(frameJobs);
 }
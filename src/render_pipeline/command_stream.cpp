@@ -0,0 +1,425 @@
+#ifndef _H_RENDER_PIPELINE_COMMAND_STREAM
+#define _H_RENDER_PIPELINE_COMMAND_STREAM
+
+// Backend-neutral render commands. onRender records what it wants from the GPU into a flat byte stream -
+// state sets, buffer views, constants, draws - and a CommandBackend turns the stream into API calls:
+// D3D12 in the window, nothing or the software rasterizer headless. Streams are plain bytes, so frames can
+// be appended to a capture file during a real session and replayed offline against the same code.
+//
+// Every command is a CommandHeader followed by its payload, padded to 8 bytes. Buffers and pipelines are
+// small ids picked by whoever records - each backend maps them to whatever it owns.
+#include "../core/mapped_file.cpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+constexpr uint32_t COMMAND_CAPTURE_MAGIC = 0x53435848;  // "HXCS"
+constexpr uint32_t COMMAND_CAPTURE_VERSION = 1;         // Bump when the file layout or any payload changes
+constexpr uint32_t COMMAND_MAX_BUFFERS = 8;
+constexpr uint32_t COMMAND_MAX_PIPELINES = 8;
+constexpr uint32_t COMMAND_MAX_VERTEX_STREAMS = 2;
+constexpr uint32_t COMMAND_MAX_CONSTANTS = 4096;              // Bytes per SET_CONSTANTS, one CBV worth
+constexpr uint32_t COMMAND_MAX_WRITE = 16 * 1024 * 1024;      // Bigger writes are split into several commands
+
+enum CommandType : uint16_t {
+  COMMAND_BEGIN_PASS = 1,       // CommandBeginPass - back buffer bound and cleared, viewport covers it
+  COMMAND_END_PASS,             // No payload - back buffer goes back to present
+  COMMAND_SET_PIPELINE,         // CommandSetPipeline
+  COMMAND_SET_CONSTANTS,        // CommandSetConstants + size bytes
+  COMMAND_SET_VERTEX_BUFFERS,   // CommandSetVertexBuffers
+  COMMAND_SET_INDEX_BUFFER,     // CommandBufferView, stride is the index size
+  COMMAND_DRAW_INDEXED,         // CommandDrawIndexed
+  COMMAND_WRITE_BUFFER,         // CommandWriteBuffer + size bytes - CPU writes into a mapped buffer
+  COMMAND_TYPE_COUNT
+};
+
+typedef struct CommandHeader {
+  uint16_t type;
+  uint16_t reserved;
+  uint32_t size;  // Payload bytes, padding not included
+} CommandHeader;
+
+typedef struct CommandBeginPass {
+  float clear[4];
+  uint32_t width;
+  uint32_t height;
+  char name[24];  // For GPU timestamps, whatever fits
+} CommandBeginPass;
+
+typedef struct CommandSetPipeline {
+  uint32_t pipeline;
+  uint32_t reserved;
+} CommandSetPipeline;
+
+typedef struct CommandSetConstants {
+  uint32_t slot;  // Root parameter
+  uint32_t size;
+} CommandSetConstants;
+
+typedef struct CommandBufferView {
+  uint32_t buffer;
+  uint32_t offset;
+  uint32_t size;
+  uint32_t stride;
+} CommandBufferView;
+
+typedef struct CommandSetVertexBuffers {
+  uint32_t first_slot;
+  uint32_t count;
+  CommandBufferView views[COMMAND_MAX_VERTEX_STREAMS];
+} CommandSetVertexBuffers;
+
+typedef struct CommandDrawIndexed {
+  uint32_t index_count;
+  uint32_t instance_count;
+  uint32_t first_index;
+  int32_t base_vertex;
+  uint32_t first_instance;
+  uint32_t reserved;
+} CommandDrawIndexed;
+
+typedef struct CommandWriteBuffer {
+  uint32_t buffer;
+  uint32_t size;
+  uint64_t offset;
+} CommandWriteBuffer;
+
+typedef struct CommandStream {
+  std::vector<uint8_t> bytes;
+  uint32_t commands = 0;
+  bool record_writes = false;  // WRITE_BUFFER is only worth the bytes while a capture is running
+} CommandStream;
+
+void resetCommandStream(CommandStream& stream) {
+  stream.bytes.clear();
+  stream.commands = 0;
+}
+
+// Header + room for the payload, padding zeroed so streams of the same frame compare equal
+static uint8_t* appendCommandBytes(CommandStream& stream, CommandType type, size_t size) {
+  const size_t at = stream.bytes.size();
+  const size_t padded = (sizeof(CommandHeader) + size + 7) & ~(size_t)7;
+  stream.bytes.resize(at + padded);
+  CommandHeader header = { (uint16_t)type, 0, (uint32_t)size };
+  memcpy(stream.bytes.data() + at, &header, sizeof(header));
+  stream.commands++;
+  return stream.bytes.data() + at + sizeof(header);
+}
+
+template <typename T>
+static void appendCommand(CommandStream& stream, CommandType type, const T& payload) {
+  memcpy(appendCommandBytes(stream, type, sizeof(T)), &payload, sizeof(T));
+}
+
+void cmdBeginPass(CommandStream& stream, const char* name, const float clear[4], uint32_t width, uint32_t height) {
+  CommandBeginPass pass = {};
+  memcpy(pass.clear, clear, sizeof(pass.clear));
+  pass.width = width;
+  pass.height = height;
+  snprintf(pass.name, sizeof(pass.name), "%s", name);
+  appendCommand(stream, COMMAND_BEGIN_PASS, pass);
+}
+
+void cmdEndPass(CommandStream& stream) {
+  appendCommandBytes(stream, COMMAND_END_PASS, 0);
+}
+
+void cmdSetPipeline(CommandStream& stream, uint32_t pipeline) {
+  appendCommand(stream, COMMAND_SET_PIPELINE, CommandSetPipeline{ pipeline, 0 });
+}
+
+// Constants travel inside the stream - the backend decides where they live on the GPU
+void cmdSetConstants(CommandStream& stream, uint32_t slot, const void* data, uint32_t size) {
+  uint8_t* out = appendCommandBytes(stream, COMMAND_SET_CONSTANTS, sizeof(CommandSetConstants) + size);
+  CommandSetConstants constants = { slot, size };
+  memcpy(out, &constants, sizeof(constants));
+  memcpy(out + sizeof(constants), data, size);
+}
+
+void cmdSetVertexBuffers(CommandStream& stream, uint32_t firstSlot, const CommandBufferView* views, uint32_t count) {
+  CommandSetVertexBuffers buffers = {};
+  buffers.first_slot = firstSlot;
+  buffers.count = count < COMMAND_MAX_VERTEX_STREAMS ? count : COMMAND_MAX_VERTEX_STREAMS;
+  memcpy(buffers.views, views, buffers.count * sizeof(CommandBufferView));
+  appendCommand(stream, COMMAND_SET_VERTEX_BUFFERS, buffers);
+}
+
+void cmdSetIndexBuffer(CommandStream& stream, const CommandBufferView& view) {
+  appendCommand(stream, COMMAND_SET_INDEX_BUFFER, view);
+}
+
+void cmdDrawIndexed(CommandStream& stream, uint32_t indexCount, uint32_t instanceCount, uint32_t firstIndex, int32_t baseVertex, uint32_t firstInstance) {
+  appendCommand(stream, COMMAND_DRAW_INDEXED, CommandDrawIndexed{ indexCount, instanceCount, firstIndex, baseVertex, firstInstance, 0 });
+}
+
+// Does nothing unless stream.record_writes - live frames write through mapped pointers themselves,
+// this only tells a replay what those buffers held
+void cmdWriteBuffer(CommandStream& stream, uint32_t buffer, uint64_t offset, const void* data, size_t size) {
+  if (!stream.record_writes) return;
+  const uint8_t* bytes = reinterpret_cast<const uint8_t*>(data);
+  while (size > 0) {
+    const uint32_t piece = size < COMMAND_MAX_WRITE ? (uint32_t)size : COMMAND_MAX_WRITE;
+    uint8_t* out = appendCommandBytes(stream, COMMAND_WRITE_BUFFER, sizeof(CommandWriteBuffer) + piece);
+    CommandWriteBuffer write = { buffer, piece, offset };
+    memcpy(out, &write, sizeof(write));
+    memcpy(out + sizeof(write), bytes, piece);
+    bytes += piece;
+    offset += piece;
+    size -= piece;
+  }
+}
+
+// What a stream turns into - one call per command, arguments already checked against the limits above
+struct CommandBackend {
+  virtual ~CommandBackend() {}
+  virtual void beginPass(const CommandBeginPass& pass) = 0;
+  virtual void endPass() = 0;
+  virtual void setPipeline(uint32_t pipeline) = 0;
+  virtual void setConstants(uint32_t slot, const void* data, uint32_t size) = 0;
+  virtual void setVertexBuffers(const CommandSetVertexBuffers& buffers) = 0;
+  virtual void setIndexBuffer(const CommandBufferView& view) = 0;
+  virtual void drawIndexed(const CommandDrawIndexed& draw) = 0;
+  virtual void writeBuffer(uint32_t buffer, uint64_t offset, const void* data, uint32_t size) = 0;
+};
+
+static inline bool commandViewValid(const CommandBufferView& view) {
+  return view.buffer < COMMAND_MAX_BUFFERS && view.stride > 0;
+}
+
+// Feeds bytes to the backend. Streams may come from disk, so everything is bounds checked and a
+// malformed command stops the replay - returns false, commands before it have been executed.
+bool executeCommands(const uint8_t* bytes, size_t size, CommandBackend& backend, size_t* executed = nullptr) {
+  size_t at = 0;
+  size_t count = 0;
+  bool ok = true;
+  while (at < size) {
+    CommandHeader header;
+    if (size - at < sizeof(header)) {
+      ok = false;
+      break;
+    }
+    memcpy(&header, bytes + at, sizeof(header));
+    const size_t padded = (sizeof(CommandHeader) + (size_t)header.size + 7) & ~(size_t)7;
+    if (padded > size - at) {
+      ok = false;
+      break;
+    }
+    // Streams and captures keep commands 8 byte aligned, payloads can be read in place
+    const uint8_t* payload = bytes + at + sizeof(header);
+    switch (header.type) {
+      case COMMAND_BEGIN_PASS:
+        ok = header.size == sizeof(CommandBeginPass);
+        if (ok) {
+          CommandBeginPass pass = *reinterpret_cast<const CommandBeginPass*>(payload);
+          pass.name[sizeof(pass.name) - 1] = 0;
+          backend.beginPass(pass);
+        }
+        break;
+      case COMMAND_END_PASS:
+        ok = header.size == 0;
+        if (ok) backend.endPass();
+        break;
+      case COMMAND_SET_PIPELINE: {
+        const CommandSetPipeline* pipeline = reinterpret_cast<const CommandSetPipeline*>(payload);
+        ok = header.size == sizeof(CommandSetPipeline) && pipeline->pipeline < COMMAND_MAX_PIPELINES;
+        if (ok) backend.setPipeline(pipeline->pipeline);
+        break;
+      }
+      case COMMAND_SET_CONSTANTS: {
+        const CommandSetConstants* constants = reinterpret_cast<const CommandSetConstants*>(payload);
+        ok = header.size >= sizeof(CommandSetConstants) && constants->size <= COMMAND_MAX_CONSTANTS &&
+             header.size == sizeof(CommandSetConstants) + constants->size;
+        if (ok) backend.setConstants(constants->slot, payload + sizeof(CommandSetConstants), constants->size);
+        break;
+      }
+      case COMMAND_SET_VERTEX_BUFFERS: {
+        const CommandSetVertexBuffers* buffers = reinterpret_cast<const CommandSetVertexBuffers*>(payload);
+        ok = header.size == sizeof(CommandSetVertexBuffers) && buffers->count <= COMMAND_MAX_VERTEX_STREAMS &&
+             buffers->first_slot + buffers->count <= COMMAND_MAX_VERTEX_STREAMS;
+        for (uint32_t i = 0; ok && i < buffers->count; i++) ok = commandViewValid(buffers->views[i]);
+        if (ok) backend.setVertexBuffers(*buffers);
+        break;
+      }
+      case COMMAND_SET_INDEX_BUFFER: {
+        const CommandBufferView* view = reinterpret_cast<const CommandBufferView*>(payload);
+        ok = header.size == sizeof(CommandBufferView) && commandViewValid(*view) && (view->stride == 2 || view->stride == 4);
+        if (ok) backend.setIndexBuffer(*view);
+        break;
+      }
+      case COMMAND_DRAW_INDEXED:
+        ok = header.size == sizeof(CommandDrawIndexed);
+        if (ok) backend.drawIndexed(*reinterpret_cast<const CommandDrawIndexed*>(payload));
+        break;
+      case COMMAND_WRITE_BUFFER: {
+        const CommandWriteBuffer* write = reinterpret_cast<const CommandWriteBuffer*>(payload);
+        ok = header.size >= sizeof(CommandWriteBuffer) && write->buffer < COMMAND_MAX_BUFFERS &&
+             header.size == sizeof(CommandWriteBuffer) + (size_t)write->size;
+        if (ok) backend.writeBuffer(write->buffer, write->offset, payload + sizeof(CommandWriteBuffer), write->size);
+        break;
+      }
+      default:
+        ok = false;
+        break;
+    }
+    if (!ok) break;
+    at += padded;
+    count++;
+  }
+  if (executed != nullptr) *executed = count;
+  return ok;
+}
+
+// Capture file - a header, then one block per frame: CommandCaptureFrame and the frame's stream as is.
+// The frame count is written on close, a capture cut short by a crash still replays up to its last whole frame.
+typedef struct CommandCaptureHeader {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t frames;
+  uint32_t reserved;
+} CommandCaptureHeader;
+
+typedef struct CommandCaptureFrame {
+  uint32_t size;      // Stream bytes, always a multiple of 8
+  uint32_t commands;
+} CommandCaptureFrame;
+
+typedef struct CommandCapture {
+  FILE* file = nullptr;
+  uint32_t frames = 0;
+  uint64_t bytes = 0;
+} CommandCapture;
+
+bool beginCommandCapture(CommandCapture& capture, const char* path) {
+  capture = {};
+  capture.file = fopen(path, "wb");
+  if (capture.file == nullptr) return false;
+  CommandCaptureHeader header = { COMMAND_CAPTURE_MAGIC, COMMAND_CAPTURE_VERSION, 0, 0 };
+  if (fwrite(&header, sizeof(header), 1, capture.file) != 1) {
+    fclose(capture.file);
+    capture.file = nullptr;
+    return false;
+  }
+  capture.bytes = sizeof(header);
+  return true;
+}
+
+bool captureCommandFrame(CommandCapture& capture, const CommandStream& stream) {
+  if (capture.file == nullptr) return false;
+  CommandCaptureFrame frame = { (uint32_t)stream.bytes.size(), stream.commands };
+  bool ok = fwrite(&frame, sizeof(frame), 1, capture.file) == 1;
+  if (ok && !stream.bytes.empty()) ok = fwrite(stream.bytes.data(), stream.bytes.size(), 1, capture.file) == 1;
+  if (ok) {
+    capture.frames++;
+    capture.bytes += sizeof(frame) + stream.bytes.size();
+  }
+  return ok;
+}
+
+bool endCommandCapture(CommandCapture& capture) {
+  if (capture.file == nullptr) return false;
+  bool ok = fseek(capture.file, (long)offsetof(CommandCaptureHeader, frames), SEEK_SET) == 0 &&
+            fwrite(&capture.frames, sizeof(capture.frames), 1, capture.file) == 1;
+  ok = fclose(capture.file) == 0 && ok;
+  capture.file = nullptr;
+  return ok;
+}
+
+// A capture mapped read-only, frames are replayed straight out of the mapping
+typedef struct CommandReplay {
+  MappedFile file;
+  std::vector<uint64_t> frames;  // Offset of each frame's stream
+  std::vector<uint32_t> sizes;
+} CommandReplay;
+
+void closeCommandReplay(CommandReplay& replay) {
+  closeMappedFile(replay.file);
+  replay.frames.clear();
+  replay.sizes.clear();
+}
+
+bool openCommandReplay(CommandReplay& replay, const char* path) {
+  replay.frames.clear();
+  replay.sizes.clear();
+  if (!openMappedFile(replay.file, path)) return false;
+  CommandCaptureHeader header = {};
+  if (replay.file.size < sizeof(header)) {
+    closeCommandReplay(replay);
+    return false;
+  }
+  memcpy(&header, replay.file.data, sizeof(header));
+  if (header.magic != COMMAND_CAPTURE_MAGIC || header.version != COMMAND_CAPTURE_VERSION) {
+    closeCommandReplay(replay);
+    return false;
+  }
+  uint64_t at = sizeof(header);
+  while (replay.file.size - at >= sizeof(CommandCaptureFrame)) {
+    CommandCaptureFrame frame;
+    memcpy(&frame, replay.file.data + at, sizeof(frame));
+    at += sizeof(frame);
+    if (frame.size % 8 != 0 || frame.size > replay.file.size - at) break;
+    replay.frames.push_back(at);
+    replay.sizes.push_back(frame.size);
+    at += frame.size;
+  }
+  return true;
+}
+
+inline const uint8_t* commandReplayFrame(const CommandReplay& replay, size_t frame, size_t& size) {
+  size = replay.sizes[frame];
+  return replay.file.data + replay.frames[frame];
+}
+
+typedef struct CommandStats {
+  size_t passes = 0;
+  size_t draws = 0;
+  size_t instances = 0;
+  size_t indices = 0;
+  size_t state_changes = 0;
+  size_t constant_bytes = 0;
+  size_t write_bytes = 0;
+} CommandStats;
+
+// Reads every command and keeps count, nothing else - replaying through it measures our side of submission,
+// decoding and dispatch, with no driver underneath
+struct NullCommandBackend : CommandBackend {
+  CommandStats stats;
+  uint64_t checksum = 0;  // Folds the arguments in, so none of the reading can be optimized away
+
+  void beginPass(const CommandBeginPass& pass) override {
+    stats.passes++;
+    checksum += pass.width * 31 + pass.height;
+  }
+  void endPass() override {}
+  void setPipeline(uint32_t pipeline) override {
+    stats.state_changes++;
+    checksum += pipeline;
+  }
+  void setConstants(uint32_t slot, const void* data, uint32_t size) override {
+    stats.state_changes++;
+    stats.constant_bytes += size;
+    checksum += slot + (size > 0 ? *reinterpret_cast<const uint8_t*>(data) : 0);
+  }
+  void setVertexBuffers(const CommandSetVertexBuffers& buffers) override {
+    stats.state_changes++;
+    for (uint32_t i = 0; i < buffers.count; i++) checksum += buffers.views[i].buffer + buffers.views[i].offset;
+  }
+  void setIndexBuffer(const CommandBufferView& view) override {
+    stats.state_changes++;
+    checksum += view.buffer + view.offset;
+  }
+  void drawIndexed(const CommandDrawIndexed& draw) override {
+    stats.draws++;
+    stats.instances += draw.instance_count;
+    stats.indices += (size_t)draw.index_count * draw.instance_count;
+    checksum += draw.first_instance;
+  }
+  void writeBuffer(uint32_t buffer, uint64_t offset, const void*, uint32_t size) override {
+    stats.write_bytes += size;
+    checksum += buffer + offset;
+  }
+};
+
+#endif /* _H_RENDER_PIPELINE_COMMAND_STREAM */
@@ -0,0 +1,280 @@
+#ifndef _H_RENDER_PIPELINE_COPY_UPLOADER
+#define _H_RENDER_PIPELINE_COPY_UPLOADER
+
+// Uploads into GPU-local buffers - data is written into a staging ring, copies are batched and go out on
+// a copy queue that signals its own fence. A ring range is reused only once the batch that read it has
+// completed, so streaming never waits on the direct queue and the direct queue only waits on the copy fence.
+// Platform-neutral - the queue sits behind CopyBackend, so the ring and batching can be run headless.
+#include "../core/memory.cpp"
+#include "../core/timer.cpp"
+#include "../core/profiler.cpp"
+
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+constexpr size_t COPY_RING_ALIGNMENT = 16;
+constexpr uint32_t COPY_MAX_BUFFERS = 8;       // Destination ids, same numbering as command stream buffers
+constexpr uint32_t COPY_MAX_REGIONS = 512;     // Per batch, a full batch goes out on its own
+constexpr uint32_t COPY_MAX_BATCHES = 32;      // Submitted and not retired yet
+
+typedef struct CopyRegion {
+  uint32_t buffer;
+  uint32_t reserved;
+  uint64_t dst_offset;
+  uint64_t src_offset;    // Into the staging ring
+  uint64_t size;
+} CopyRegion;
+
+// What the uploader needs from a copy queue - staging memory it can read and a monotonic fence
+struct CopyBackend {
+  virtual ~CopyBackend() {}
+  // Copies every region out of staging in order, then signals fence. afterGraphics - some destination may
+  // still be read by frames in flight, the copies have to wait for those frames first.
+  virtual void submit(const CopyRegion* regions, uint32_t count, uint64_t fence, bool afterGraphics) = 0;
+  virtual uint64_t completedValue() = 0;
+  virtual void waitFor(uint64_t value) = 0;  // Blocks the CPU until completedValue() >= value
+};
+
+typedef struct CopyStats {
+  uint64_t uploads = 0;
+  uint64_t bytes = 0;
+  uint64_t batches = 0;
+  uint64_t regions = 0;       // After merging neighbours
+  uint64_t splits = 0;        // Batches cut short because a write overlapped one already in them
+  uint64_t stalls = 0;        // Times the ring or the batch queue was full and the CPU had to wait
+  double stall_ms = 0.0;
+  size_t peak_used = 0;       // Most ring bytes in use at once
+} CopyStats;
+
+typedef struct CopyUploader {
+  CopyBackend* backend = nullptr;
+  uint8_t* staging = nullptr;
+  size_t capacity = 0;
+  uint64_t write_pos = 0;     // Monotonic, ring offset is pos % capacity
+  uint64_t read_pos = 0;      // Everything before it has been copied out
+  // Open batch
+  CopyRegion regions[COPY_MAX_REGIONS];
+  uint32_t region_count = 0;
+  bool after_graphics = false;
+  // Submitted batches, oldest first
+  uint64_t batch_fence[COPY_MAX_BATCHES] = {};
+  uint64_t batch_end[COPY_MAX_BATCHES] = {};
+  uint64_t batch_head = 0;
+  uint64_t batch_tail = 0;
+  uint64_t next_fence = 1;
+  uint64_t submitted = 0;     // Fence of the last submitted batch
+  CopyStats stats;
+} CopyUploader;
+
+// capacity has to be a multiple of COPY_RING_ALIGNMENT, staging stays owned by the caller
+bool initCopyUploader(CopyUploader& uploader, CopyBackend* backend, uint8_t* staging, size_t capacity) {
+  if (backend == nullptr || staging == nullptr || capacity == 0 || capacity % COPY_RING_ALIGNMENT != 0) return false;
+  uploader.backend = backend;
+  uploader.staging = staging;
+  uploader.capacity = capacity;
+  uploader.write_pos = 0;
+  uploader.read_pos = 0;
+  uploader.region_count = 0;
+  uploader.after_graphics = false;
+  uploader.batch_head = 0;
+  uploader.batch_tail = 0;
+  uploader.next_fence = 1;
+  uploader.submitted = 0;
+  uploader.stats = {};
+  return true;
+}
+
+// Biggest single piece the ring hands out - bigger uploads are split, copyAllocate refuses them
+inline size_t copyMaxPiece(const CopyUploader& uploader) {
+  return uploader.capacity / 4;
+}
+
+// Frees the ring ranges of every batch the queue has finished
+void copyRetire(CopyUploader& uploader) {
+  if (uploader.batch_head == uploader.batch_tail) return;
+  const uint64_t completed = uploader.backend->completedValue();
+  while (uploader.batch_head < uploader.batch_tail && uploader.batch_fence[uploader.batch_head % COPY_MAX_BATCHES] <= completed) {
+    uploader.read_pos = uploader.batch_end[uploader.batch_head % COPY_MAX_BATCHES];
+    uploader.batch_head++;
+  }
+}
+
+static void copyWaitOldest(CopyUploader& uploader) {
+  PROFILE_SCOPE("copy stall");
+  const uint64_t start = timerNanoseconds();
+  uploader.backend->waitFor(uploader.batch_fence[uploader.batch_head % COPY_MAX_BATCHES]);
+  uploader.stats.stall_ms += (double)(timerNanoseconds() - start) / 1000000.0;
+  uploader.stats.stalls++;
+  copyRetire(uploader);
+}
+
+// Submits the open batch. Returns the fence that marks all uploads so far as done, 0 if nothing was ever submitted.
+uint64_t copyFlush(CopyUploader& uploader) {
+  if (uploader.region_count == 0) return uploader.submitted;
+  if (uploader.batch_tail - uploader.batch_head == COPY_MAX_BATCHES) copyWaitOldest(uploader);
+  const uint64_t fence = uploader.next_fence++;
+  uploader.backend->submit(uploader.regions, uploader.region_count, fence, uploader.after_graphics);
+  uploader.batch_fence[uploader.batch_tail % COPY_MAX_BATCHES] = fence;
+  uploader.batch_end[uploader.batch_tail % COPY_MAX_BATCHES] = uploader.write_pos;
+  uploader.batch_tail++;
+  uploader.stats.batches++;
+  uploader.stats.regions += uploader.region_count;
+  uploader.region_count = 0;
+  uploader.after_graphics = false;
+  uploader.submitted = fence;
+  return fence;
+}
+
+// Ring offset for size bytes, waits for the queue when the ring is full. size is at most copyMaxPiece.
+static uint64_t copyReserve(CopyUploader& uploader, size_t size) {
+  copyRetire(uploader);
+  for (;;) {
+    uint64_t pos = alignUp(uploader.write_pos, COPY_RING_ALIGNMENT);
+    uint64_t offset = pos % uploader.capacity;
+    if (offset + size > uploader.capacity) {
+      pos += uploader.capacity - offset;  // Never split a piece over the end, skip to the start
+      offset = 0;
+    }
+    if (pos + size - uploader.read_pos <= uploader.capacity) {
+      uploader.write_pos = pos + size;
+      const size_t used = (size_t)(uploader.write_pos - uploader.read_pos);
+      uploader.stats.peak_used = used > uploader.stats.peak_used ? used : uploader.stats.peak_used;
+      return offset;
+    }
+    // The open batch may hold what is in the way, it has to go out before anything can retire
+    if (uploader.region_count > 0) copyFlush(uploader);
+    copyWaitOldest(uploader);
+  }
+}
+
+// Copies within one list may run at the same time, so two writes to the same bytes go into separate batches.
+// Goes before the ring range is reserved - a batch ends where the ring was when it went out.
+static void copyPrepareRegion(CopyUploader& uploader, uint32_t buffer, uint64_t dstOffset, uint64_t size) {
+  for (uint32_t i = 0; i < uploader.region_count; i++) {
+    const CopyRegion& region = uploader.regions[i];
+    if (region.buffer == buffer && dstOffset < region.dst_offset + region.size && region.dst_offset < dstOffset + size) {
+      copyFlush(uploader);
+      uploader.stats.splits++;
+      return;
+    }
+  }
+  if (uploader.region_count == COPY_MAX_REGIONS) copyFlush(uploader);
+}
+
+static void copyAddRegion(CopyUploader& uploader, uint32_t buffer, uint64_t dstOffset, uint64_t srcOffset, uint64_t size, bool inUse) {
+  uploader.after_graphics = uploader.after_graphics || inUse;
+  if (uploader.region_count > 0) {
+    CopyRegion& last = uploader.regions[uploader.region_count - 1];
+    if (last.buffer == buffer && last.dst_offset + last.size == dstOffset && last.src_offset + last.size == srcOffset) {
+      last.size += size;
+      return;
+    }
+  }
+  uploader.regions[uploader.region_count++] = { buffer, 0, dstOffset, srcOffset, size };
+}
+
+// Staging memory for size bytes that land at dstOffset of buffer, the caller fills it before the next flush.
+// inUse - frames in flight may read the destination. nullptr when size is over copyMaxPiece.
+uint8_t* copyAllocate(CopyUploader& uploader, uint32_t buffer, uint64_t dstOffset, size_t size, bool inUse = false) {
+  if (buffer >= COPY_MAX_BUFFERS || size > copyMaxPiece(uploader)) return nullptr;
+  copyPrepareRegion(uploader, buffer, dstOffset, size);
+  const uint64_t offset = copyReserve(uploader, size);
+  copyAddRegion(uploader, buffer, dstOffset, offset, size, inUse);
+  uploader.stats.uploads++;
+  uploader.stats.bytes += size;
+  return uploader.staging + offset;
+}
+
+// Copies data into staging, splitting it when it is too big for one piece. Returns the fence that marks it
+// done once flushed (batches go out in fence order), 0 on failure.
+uint64_t copyUpload(CopyUploader& uploader, uint32_t buffer, uint64_t dstOffset, const void* data, size_t size, bool inUse = false) {
+  const uint8_t* bytes = reinterpret_cast<const uint8_t*>(data);
+  const size_t piece = copyMaxPiece(uploader);
+  for (size_t done = 0; done < size;) {
+    const size_t n = size - done < piece ? size - done : piece;
+    uint8_t* staging = copyAllocate(uploader, buffer, dstOffset + done, n, inUse);
+    if (staging == nullptr) return 0;
+    memcpy(staging, bytes + done, n);
+    done += n;
+  }
+  return uploader.next_fence;
+}
+
+// Submits what is open and blocks until the queue has copied everything - before destroying buffers
+void copyWaitIdle(CopyUploader& uploader) {
+  const uint64_t fence = copyFlush(uploader);
+  if (fence != 0 && uploader.backend->completedValue() < fence) uploader.backend->waitFor(fence);
+  copyRetire(uploader);
+}
+
+// Pretends to be a copy engine with a fixed bandwidth and per-batch latency. Batches run back to back
+// and their regions are copied into buffers only when they complete, so a ring range reused too early
+// shows up as wrong bytes in the destination.
+struct NullCopyBackend : CopyBackend {
+  typedef std::chrono::steady_clock Clock;
+
+  const uint8_t* staging = nullptr;
+  double bytes_per_ms = 0.0;
+  double latency_ms = 0.0;
+  std::vector<uint8_t> buffers[COPY_MAX_BUFFERS];
+  Clock::time_point queue_free = Clock::now();
+  std::vector<CopyRegion> pending_regions[COPY_MAX_BATCHES];
+  uint64_t pending_value[COPY_MAX_BATCHES] = {};
+  Clock::time_point pending_done[COPY_MAX_BATCHES];
+  uint64_t pending_head = 0;
+  uint64_t pending_tail = 0;
+  uint64_t completed = 0;
+  uint64_t after_graphics = 0;   // Batches that would have waited on the direct queue
+
+  NullCopyBackend(const uint8_t* stagingMemory, double gigabytesPerSecond, double latencyMs)
+    : staging(stagingMemory), bytes_per_ms(gigabytesPerSecond * 1000000.0), latency_ms(latencyMs) {}
+
+  void submit(const CopyRegion* regions, uint32_t count, uint64_t fence, bool afterGraphics) override {
+    uint64_t bytes = 0;
+    for (uint32_t i = 0; i < count; i++) bytes += regions[i].size;
+    Clock::time_point now = Clock::now();
+    Clock::time_point start = queue_free > now ? queue_free : now;
+    queue_free = start + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double, std::milli>(latency_ms + (double)bytes / bytes_per_ms));
+    if (pending_tail - pending_head == COPY_MAX_BATCHES) execute();
+    pending_regions[pending_tail % COPY_MAX_BATCHES].assign(regions, regions + count);
+    pending_value[pending_tail % COPY_MAX_BATCHES] = fence;
+    pending_done[pending_tail % COPY_MAX_BATCHES] = queue_free;
+    pending_tail++;
+    after_graphics += afterGraphics ? 1 : 0;
+  }
+
+  uint64_t completedValue() override {
+    retire(Clock::now());
+    return completed;
+  }
+
+  void waitFor(uint64_t value) override {
+    for (uint64_t i = pending_head; i < pending_tail; i++) {
+      if (pending_value[i % COPY_MAX_BATCHES] >= value) {
+        std::this_thread::sleep_until(pending_done[i % COPY_MAX_BATCHES]);
+        break;
+      }
+    }
+    retire(Clock::now());
+  }
+
+  // Oldest batch lands now
+  void execute() {
+    for (const CopyRegion& region : pending_regions[pending_head % COPY_MAX_BATCHES]) {
+      std::vector<uint8_t>& buffer = buffers[region.buffer];
+      if (buffer.size() < region.dst_offset + region.size) buffer.resize((size_t)(region.dst_offset + region.size));
+      memcpy(buffer.data() + region.dst_offset, staging + region.src_offset, (size_t)region.size);
+    }
+    completed = pending_value[pending_head % COPY_MAX_BATCHES];
+    pending_head++;
+  }
+
+  void retire(Clock::time_point now) {
+    while (pending_head < pending_tail && pending_done[pending_head % COPY_MAX_BATCHES] <= now) execute();
+  }
+};
+
+#endif /* _H_RENDER_PIPELINE_COPY_UPLOADER */
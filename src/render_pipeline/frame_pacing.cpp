@@ -0,0 +1,121 @@
+#ifndef _H_RENDER_PIPELINE_FRAME_PACING
+#define _H_RENDER_PIPELINE_FRAME_PACING
+
+// N frames in flight - CPU records frame N+1 while GPU still works on frame N.
+// Every per-frame resource (command allocator, constant buffer slice) is indexed by frame_slot
+// and only reused once the fence value of that slot has been reached.
+// Platform-neutral - the GPU side sits behind FrameBackend, so pacing can be run headless.
+#include "../core/timer.cpp"
+#include "../core/profiler.cpp"
+
+#include <cstdint>
+#include <chrono>
+#include <thread>
+
+constexpr uint32_t MAX_FRAMES_IN_FLIGHT = 4;
+constexpr uint32_t FRAMES_IN_FLIGHT = 2;
+
+// What the pacer needs from a GPU queue - a monotonic fence
+struct FrameBackend {
+  virtual ~FrameBackend() {}
+  virtual void signal(uint64_t value) = 0;   // Queue signals value once all submitted work is done
+  virtual uint64_t completedValue() = 0;
+  virtual void waitFor(uint64_t value) = 0;  // Blocks the CPU until completedValue() >= value
+};
+
+typedef struct FramePacer {
+  FrameBackend* backend = nullptr;
+  uint32_t frames_in_flight = FRAMES_IN_FLIGHT;
+  uint32_t frame_slot = 0;                          // Per-frame resources to record into this frame
+  uint64_t slot_fence[MAX_FRAMES_IN_FLIGHT] = {};   // Fence value that frees each slot, 0 - free already
+  uint64_t next_fence_value = 1;
+  uint64_t frames = 0;
+  double wait_ms = 0.0;                             // CPU time spent blocked on the GPU
+  uint64_t stalls = 0;                              // Frames that had to wait at all
+} FramePacer;
+
+void initFramePacer(FramePacer& pacer, FrameBackend* backend, uint32_t framesInFlight = FRAMES_IN_FLIGHT) {
+  pacer = {};
+  pacer.backend = backend;
+  pacer.frames_in_flight = framesInFlight < 1 ? 1 : (framesInFlight > MAX_FRAMES_IN_FLIGHT ? MAX_FRAMES_IN_FLIGHT : framesInFlight);
+}
+
+// Call before touching any per-frame resource - waits only if the GPU still uses this slot
+void beginFrame(FramePacer& pacer) {
+  const uint64_t fence = pacer.slot_fence[pacer.frame_slot];
+  if (fence != 0 && pacer.backend->completedValue() < fence) {
+    PROFILE_SCOPE("fence wait");
+    uint64_t start = timerNanoseconds();
+    pacer.backend->waitFor(fence);
+    pacer.wait_ms += (double)(timerNanoseconds() - start) / 1000000.0;
+    pacer.stalls++;
+  }
+}
+
+// Call after the frame's work has been submitted (and presented)
+void endFrame(FramePacer& pacer) {
+  const uint64_t fence = pacer.next_fence_value++;
+  pacer.backend->signal(fence);
+  pacer.slot_fence[pacer.frame_slot] = fence;
+  pacer.frame_slot = (pacer.frame_slot + 1) % pacer.frames_in_flight;
+  pacer.frames++;
+}
+
+// Waits for everything in flight - before destroying resources or resizing
+void flushFrames(FramePacer& pacer) {
+  const uint64_t last = pacer.next_fence_value - 1;
+  if (last > 0 && pacer.backend->completedValue() < last) {
+    pacer.backend->waitFor(last);
+  }
+}
+
+// Pretends to be a GPU that needs gpu_frame_ms for each signalled frame. Frames run back to back
+// on the simulated queue, so the pacer sees the same overlap (or lack of it) a real queue would give.
+struct NullFrameBackend : FrameBackend {
+  typedef std::chrono::steady_clock Clock;
+
+  double gpu_frame_ms = 0.0;
+  Clock::time_point queue_free = Clock::now();   // When the simulated GPU finishes all queued work
+  uint64_t pending_value[64] = {};               // Ring of signalled values and their completion times
+  Clock::time_point pending_done[64];
+  uint64_t pending_head = 0;
+  uint64_t pending_tail = 0;
+  uint64_t completed = 0;
+
+  explicit NullFrameBackend(double gpuFrameMs) : gpu_frame_ms(gpuFrameMs) {}
+
+  void signal(uint64_t value) override {
+    Clock::time_point now = Clock::now();
+    Clock::time_point start = queue_free > now ? queue_free : now;
+    queue_free = start + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double, std::milli>(gpu_frame_ms));
+    // Ring is far bigger than MAX_FRAMES_IN_FLIGHT, oldest entry gets retired if someone floods it
+    if (pending_tail - pending_head == 64) retire(pending_done[pending_head % 64]);
+    pending_value[pending_tail % 64] = value;
+    pending_done[pending_tail % 64] = queue_free;
+    pending_tail++;
+  }
+
+  uint64_t completedValue() override {
+    retire(Clock::now());
+    return completed;
+  }
+
+  void waitFor(uint64_t value) override {
+    for (uint64_t i = pending_head; i < pending_tail; i++) {
+      if (pending_value[i % 64] >= value) {
+        std::this_thread::sleep_until(pending_done[i % 64]);
+        break;
+      }
+    }
+    retire(Clock::now());
+  }
+
+  void retire(Clock::time_point now) {
+    while (pending_head < pending_tail && pending_done[pending_head % 64] <= now) {
+      completed = pending_value[pending_head % 64];
+      pending_head++;
+    }
+  }
+};
+
+#endif /* _H_RENDER_PIPELINE_FRAME_PACING */
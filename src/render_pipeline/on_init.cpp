@@ -4,7 +4,8 @@
 // constexpr int SOME_VALUE = 2137 * DISPLAY_FACTOR; // Some stuff might need to be defined even before we include it
 // Before I lost track of resources - renderer is defined in win32_renderer as static global structure
 // In this case this is actually not function at all but a procedure that manipulates global state to prepare the renderer
-static inline void onInit(win32_Renderer& renderer, HWND& g_hwnd) {
+// Split in two for the startup graph - the device does not need the window, so it is created while the window is
+static inline void onInitDevice(win32_Renderer& renderer) {
   // Define debug layer here - initialization
   // There is another "debug" stuff being initialized that might be important in the future and it's in compiling shaders
 #if defined(DEBUG_DIRECTX)
@@ -21,9 +22,6 @@ static inline void onInit(win32_Renderer& renderer, HWND& g_hwnd) {
       // Prepare required resources to move on
       Microsoft::WRL::ComPtr<IDXGIFactory4> factory;
       D3D12_COMMAND_QUEUE_DESC queueDesc = {};
-      Microsoft::WRL::ComPtr<IDXGISwapChain1> swapChain;
-      DXGI_SWAP_CHAIN_DESC1 swapChainDesc = {};
-      D3D12_DESCRIPTOR_HEAP_DESC rtvHeapDesc = {};
       D3D12_ROOT_PARAMETER rootParameters[1];
       D3D12_ROOT_SIGNATURE_DESC rootSignatureDesc = {};
       Microsoft::WRL::ComPtr<ID3DBlob> signature = {}; // Zero initialization instead of only declaring
@@ -39,7 +37,34 @@ static inline void onInit(win32_Renderer& renderer, HWND& g_hwnd) {
       queueDesc.Type = D3D12_COMMAND_LIST_TYPE_DIRECT;
       ThrowIfFailed(renderer.device->CreateCommandQueue(&queueDesc, IID_PPV_ARGS(&renderer.command_queue)));
 
-      // 3. Creating swapchain
+      // 3. Creating command allocators - one per frame in flight, GPU might still read the previous one
+      for (UINT n = 0; n < FRAMES_IN_FLIGHT; n++) {
+          ThrowIfFailed(renderer.device->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_DIRECT, IID_PPV_ARGS(&renderer.command_allocators[n])));
+      }
+
+      // 4. Creating root signature
+      rootParameters[0].ParameterType = D3D12_ROOT_PARAMETER_TYPE_CBV;
+      rootParameters[0].Descriptor.ShaderRegister = 0;
+      rootParameters[0].Descriptor.RegisterSpace = 0;
+      rootParameters[0].ShaderVisibility = D3D12_SHADER_VISIBILITY_ALL;
+      rootSignatureDesc.NumParameters = _countof(rootParameters);
+      rootSignatureDesc.pParameters = rootParameters;
+      rootSignatureDesc.Flags = D3D12_ROOT_SIGNATURE_FLAG_ALLOW_INPUT_ASSEMBLER_INPUT_LAYOUT;
+      ThrowIfFailed(D3D12SerializeRootSignature(&rootSignatureDesc, D3D_ROOT_SIGNATURE_VERSION_1, &signature, &error));
+      ThrowIfFailed(renderer.device->CreateRootSignature(0, signature->GetBufferPointer(), signature->GetBufferSize(), IID_PPV_ARGS(&renderer.root_signature)));
+}
+
+// Swap chain and its render targets - on the window thread, DXGI talks to the window while it sets up
+static inline void onInitSwapChain(win32_Renderer& renderer, HWND& g_hwnd) {
+      Microsoft::WRL::ComPtr<IDXGIFactory4> factory;
+      Microsoft::WRL::ComPtr<IDXGISwapChain1> swapChain;
+      DXGI_SWAP_CHAIN_DESC1 swapChainDesc = {};
+      D3D12_DESCRIPTOR_HEAP_DESC rtvHeapDesc = {};
+
+      // 1. Own factory - the one device creation used is gone, both enumerate the same adapters
+      ThrowIfFailed(CreateDXGIFactory1(IID_PPV_ARGS(&factory)));
+
+      // 2. Creating swapchain
       swapChainDesc.BufferCount = BUFFER_COUNT;
       swapChainDesc.Width = DISPLAY_WIDTH;
       swapChainDesc.Height = DISPLAY_HEIGHT;
@@ -59,34 +84,20 @@ static inline void onInit(win32_Renderer& renderer, HWND& g_hwnd) {
       ThrowIfFailed(swapChain.As(&renderer.swap_chain));
       FRAME_INDEX = renderer.swap_chain->GetCurrentBackBufferIndex();
 
-      // 4. Creating descriptor heap 
+      // 3. Creating descriptor heap 
       rtvHeapDesc.NumDescriptors = BUFFER_COUNT;
       rtvHeapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_RTV;
       rtvHeapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_NONE;
       ThrowIfFailed(renderer.device->CreateDescriptorHeap(&rtvHeapDesc, IID_PPV_ARGS(&renderer.rtv_heap)));
       RTV_DESCRIPTOR_SIZE = renderer.device->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_RTV);
       
-      // 5. Creating render targets with iterating over because of BUFFER COUNTS
+      // 4. Creating render targets with iterating over because of BUFFER COUNTS
       D3D12_CPU_DESCRIPTOR_HANDLE rtvHandle = renderer.rtv_heap->GetCPUDescriptorHandleForHeapStart();
       for (UINT n = 0; n < BUFFER_COUNT; n++) {
           ThrowIfFailed(renderer.swap_chain->GetBuffer(n, IID_PPV_ARGS(&renderer.render_targets[n])));
           renderer.device->CreateRenderTargetView(renderer.render_targets[n].Get(), nullptr, rtvHandle);
           rtvHandle.ptr += RTV_DESCRIPTOR_SIZE;
       }
-
-      // 6. Creating command allocator
-      ThrowIfFailed(renderer.device->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_DIRECT, IID_PPV_ARGS(&renderer.command_allocator)));
-
-      // 7. Creating root signature
-      rootParameters[0].ParameterType = D3D12_ROOT_PARAMETER_TYPE_CBV;
-      rootParameters[0].Descriptor.ShaderRegister = 0;
-      rootParameters[0].Descriptor.RegisterSpace = 0;
-      rootParameters[0].ShaderVisibility = D3D12_SHADER_VISIBILITY_ALL;
-      rootSignatureDesc.NumParameters = _countof(rootParameters);
-      rootSignatureDesc.pParameters = rootParameters;
-      rootSignatureDesc.Flags = D3D12_ROOT_SIGNATURE_FLAG_ALLOW_INPUT_ASSEMBLER_INPUT_LAYOUT;
-      ThrowIfFailed(D3D12SerializeRootSignature(&rootSignatureDesc, D3D_ROOT_SIGNATURE_VERSION_1, &signature, &error));
-      ThrowIfFailed(renderer.device->CreateRootSignature(0, signature->GetBufferPointer(), signature->GetBufferSize(), IID_PPV_ARGS(&renderer.root_signature)));
 }
 
 #endif /* _H_RENDER_PIPELINE_ON_INIT */
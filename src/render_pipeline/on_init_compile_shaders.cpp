@@ -5,7 +5,101 @@
 #include <dxgi1_6.h>
 #include <d3dcompiler.h>
 
-void onInitCompileShaders(win32_Renderer& renderer, win32_Shaders& shaders, const char* shader_source) {
+#include "win32_input_layout.cpp"
+#include "shader_cache.cpp"
+
+// Bytecode comes from the cache, D3DCompile runs only on a miss
+static void compileShaderCached(ShaderCache& cache, const char* source, const char* entryPoint, const char* target, UINT flags, Microsoft::WRL::ComPtr<ID3DBlob>& blob) {
+  uint64_t key = shaderBytecodeKey(source, entryPoint, target, flags, D3D_COMPILER_VERSION);
+  const std::vector<uint8_t>* bytecode = shaderCacheGetOrCompile(cache, key, SHADER_CACHE_BYTECODE, [&](std::vector<uint8_t>& out) {
+    Microsoft::WRL::ComPtr<ID3DBlob> compiled;
+    Microsoft::WRL::ComPtr<ID3DBlob> errors;
+    if (FAILED(D3DCompile(source, strlen(source), nullptr, nullptr, nullptr, entryPoint, target, flags, 0, &compiled, &errors))) {
+      if (errors) OutputDebugStringA(reinterpret_cast<const char*>(errors->GetBufferPointer()));
+      return false;
+    }
+    const uint8_t* data = reinterpret_cast<const uint8_t*>(compiled->GetBufferPointer());
+    out.assign(data, data + compiled->GetBufferSize());
+    return true;
+  });
+  if (bytecode == nullptr) {
+    throw std::runtime_error("Shader compilation failed");
+  }
+  ThrowIfFailed(D3DCreateBlob(bytecode->size(), &blob));
+  memcpy(blob->GetBufferPointer(), bytecode->data(), bytecode->size());
+}
+
+// Cached PSO blobs only work on the same GPU and driver - both go into the key
+static uint64_t pipelineDeviceTag(ID3D12Device* device) {
+  Microsoft::WRL::ComPtr<IDXGIFactory4> factory;
+  Microsoft::WRL::ComPtr<IDXGIAdapter1> adapter;
+  DXGI_ADAPTER_DESC1 desc = {};
+  LARGE_INTEGER driverVersion = {};
+  if (SUCCEEDED(CreateDXGIFactory1(IID_PPV_ARGS(&factory))) &&
+      SUCCEEDED(factory->EnumAdapterByLuid(device->GetAdapterLuid(), IID_PPV_ARGS(&adapter)))) {
+    adapter->GetDesc1(&desc);
+    adapter->CheckInterfaceSupport(__uuidof(IDXGIDevice), &driverVersion);
+  }
+  uint64_t hash = cacheHashValue(CACHE_HASH_SEED, desc.VendorId);
+  hash = cacheHashValue(hash, desc.DeviceId);
+  hash = cacheHashValue(hash, desc.SubSysId);
+  hash = cacheHashValue(hash, desc.Revision);
+  return cacheHashValue(hash, driverVersion.QuadPart);
+}
+
+// Field by field - some of these structs have padding that is not guaranteed to be zeroed.
+// Root signature is not in here, if it changes the driver refuses the blob and we rebuild.
+static uint64_t pipelineStateKey(const D3D12_GRAPHICS_PIPELINE_STATE_DESC& desc, uint64_t deviceTag) {
+  uint64_t hash = cacheHashValue(CACHE_HASH_SEED, SHADER_CACHE_VERSION);
+  hash = cacheHashValue(hash, (uint32_t)SHADER_CACHE_PIPELINE);
+  hash = cacheHashValue(hash, deviceTag);
+  hash = cacheHashBytes(hash, desc.VS.pShaderBytecode, desc.VS.BytecodeLength);
+  hash = cacheHashBytes(hash, desc.PS.pShaderBytecode, desc.PS.BytecodeLength);
+  for (UINT i = 0; i < desc.InputLayout.NumElements; i++) {
+    const D3D12_INPUT_ELEMENT_DESC& e = desc.InputLayout.pInputElementDescs[i];
+    hash = cacheHashString(hash, e.SemanticName);
+    hash = cacheHashValue(hash, e.SemanticIndex);
+    hash = cacheHashValue(hash, e.Format);
+    hash = cacheHashValue(hash, e.InputSlot);
+    hash = cacheHashValue(hash, e.AlignedByteOffset);
+    hash = cacheHashValue(hash, e.InputSlotClass);
+    hash = cacheHashValue(hash, e.InstanceDataStepRate);
+  }
+  hash = cacheHashValue(hash, desc.RasterizerState);  // All 4 byte members, no padding
+  hash = cacheHashValue(hash, desc.BlendState.AlphaToCoverageEnable);
+  hash = cacheHashValue(hash, desc.BlendState.IndependentBlendEnable);
+  for (UINT i = 0; i < D3D12_SIMULTANEOUS_RENDER_TARGET_COUNT; i++) {
+    const D3D12_RENDER_TARGET_BLEND_DESC& b = desc.BlendState.RenderTarget[i];
+    hash = cacheHashValue(hash, b.BlendEnable);
+    hash = cacheHashValue(hash, b.LogicOpEnable);
+    hash = cacheHashValue(hash, b.SrcBlend);
+    hash = cacheHashValue(hash, b.DestBlend);
+    hash = cacheHashValue(hash, b.BlendOp);
+    hash = cacheHashValue(hash, b.SrcBlendAlpha);
+    hash = cacheHashValue(hash, b.DestBlendAlpha);
+    hash = cacheHashValue(hash, b.BlendOpAlpha);
+    hash = cacheHashValue(hash, b.LogicOp);
+    hash = cacheHashValue(hash, b.RenderTargetWriteMask);
+  }
+  hash = cacheHashValue(hash, desc.DepthStencilState.DepthEnable);
+  hash = cacheHashValue(hash, desc.DepthStencilState.DepthWriteMask);
+  hash = cacheHashValue(hash, desc.DepthStencilState.DepthFunc);
+  hash = cacheHashValue(hash, desc.DepthStencilState.StencilEnable);
+  hash = cacheHashValue(hash, desc.DepthStencilState.StencilReadMask);
+  hash = cacheHashValue(hash, desc.DepthStencilState.StencilWriteMask);
+  hash = cacheHashValue(hash, desc.DepthStencilState.FrontFace);
+  hash = cacheHashValue(hash, desc.DepthStencilState.BackFace);
+  hash = cacheHashValue(hash, desc.SampleMask);
+  hash = cacheHashValue(hash, desc.PrimitiveTopologyType);
+  hash = cacheHashValue(hash, desc.NumRenderTargets);
+  hash = cacheHashValue(hash, desc.RTVFormats);
+  hash = cacheHashValue(hash, desc.DSVFormat);
+  hash = cacheHashValue(hash, desc.SampleDesc);
+  return hash;
+}
+
+// Bytecode only, through the cache - needs neither the device nor the window, so startup runs it next to both
+void onInitCompileShaders(win32_Shaders& shaders, ShaderCache& cache, const char* shader_source) {
   // Shaders debug layer - if enabled there is no optimization
 #if defined(DEBUG_DIRECTX)
     #pragma message("DEBUG_DIRECTX defined - setting up shaders compile flags to DEBUG/SKIP_OPTIMIZATION.")
@@ -13,14 +107,14 @@ void onInitCompileShaders(win32_Renderer& renderer, win32_Shaders& shaders, cons
 #else
     UINT compileFlags = 0;
 #endif
-    // Resource declaration part
-    D3D12_INPUT_ELEMENT_DESC inputElementDescs[] = {
-      // Stuff here depends on what shader we are compiling I think
-      // TODO(moliwa): We should do something about it in more general way, but let's leave it for now
-        { "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
-        { "COLOR", 0, DXGI_FORMAT_R32G32B32A32_FLOAT, 0, 12, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 } // Why is 12 here? is it 3x4bytes or something like that?
-    };
+    // DEBUG_DIRECTX changes compileFlags, so debug and release bytecode get separate entries
+    compileShaderCached(cache, shader_source, "VSMain", "vs_5_0", compileFlags, shaders.vertexShader);
+    compileShaderCached(cache, shader_source, "PSMain", "ps_5_0", compileFlags, shaders.pixelShader);
+}
 
+// inputLayout comes from makeInputLayout - it has to match VS_INPUT of the compiled shaders.
+// Needs the device, root signature and bytecode. The PSO blob goes through cache, saving it is up to the caller.
+void onInitPipeline(win32_Renderer& renderer, win32_Shaders& shaders, ShaderCache& cache, D3D12_INPUT_LAYOUT_DESC inputLayout) {
     D3D12_GRAPHICS_PIPELINE_STATE_DESC psoDesc = {};
     D3D12_RASTERIZER_DESC rasterizerDesc = {};
     D3D12_BLEND_DESC blendDesc = {};
@@ -35,10 +129,7 @@ void onInitCompileShaders(win32_Renderer& renderer, win32_Shaders& shaders, cons
     };
 
     // Procedures part
-    ThrowIfFailed(D3DCompile(shader_source, strlen(shader_source), nullptr, nullptr, nullptr, "VSMain", "vs_5_0", compileFlags, 0, &shaders.vertexShader, nullptr));
-    ThrowIfFailed(D3DCompile(shader_source, strlen(shader_source), nullptr, nullptr, nullptr, "PSMain", "ps_5_0", compileFlags, 0, &shaders.pixelShader, nullptr));
-
-    psoDesc.InputLayout = { inputElementDescs, _countof(inputElementDescs) };
+    psoDesc.InputLayout = inputLayout;
     psoDesc.pRootSignature = renderer.root_signature.Get();
     psoDesc.VS = { reinterpret_cast<UINT8*>(shaders.vertexShader->GetBufferPointer()), shaders.vertexShader->GetBufferSize() };
     psoDesc.PS = { reinterpret_cast<UINT8*>(shaders.pixelShader->GetBufferPointer()), shaders.pixelShader->GetBufferSize() };
@@ -68,15 +159,34 @@ void onInitCompileShaders(win32_Renderer& renderer, win32_Shaders& shaders, cons
     psoDesc.NumRenderTargets = 1;
     psoDesc.RTVFormats[0] = DXGI_FORMAT_R8G8B8A8_UNORM;
     psoDesc.SampleDesc.Count = 1;
-    ThrowIfFailed(renderer.device->CreateGraphicsPipelineState(&psoDesc, IID_PPV_ARGS(&renderer.pipeline_state)));
-    ThrowIfFailed(renderer.device->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_DIRECT, renderer.command_allocator.Get(), renderer.pipeline_state.Get(), IID_PPV_ARGS(&renderer.command_list)));
-    ThrowIfFailed(renderer.command_list->Close());
 
-    ThrowIfFailed(renderer.device->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_DIRECT, renderer.command_allocator.Get(), renderer.pipeline_state.Get(), IID_PPV_ARGS(&renderer.command_list)));
+    // Cached blob first - a driver update or a different GPU makes creation fail, then we build from scratch
+    double pipelineStart = timerMilliseconds();
+    uint64_t pipelineKey = pipelineStateKey(psoDesc, pipelineDeviceTag(renderer.device.Get()));
+    const std::vector<uint8_t>* cachedPipeline = shaderCacheFind(cache, pipelineKey, SHADER_CACHE_PIPELINE);
+    HRESULT pipelineResult = E_FAIL;
+    if (cachedPipeline != nullptr) {
+        psoDesc.CachedPSO = { cachedPipeline->data(), cachedPipeline->size() };
+        pipelineResult = renderer.device->CreateGraphicsPipelineState(&psoDesc, IID_PPV_ARGS(&renderer.pipeline_state));
+        psoDesc.CachedPSO = {};
+        if (FAILED(pipelineResult)) {
+            shaderCacheReject(cache, pipelineKey);
+        }
+    }
+    if (FAILED(pipelineResult)) {
+        ThrowIfFailed(renderer.device->CreateGraphicsPipelineState(&psoDesc, IID_PPV_ARGS(&renderer.pipeline_state)));
+        Microsoft::WRL::ComPtr<ID3DBlob> pipelineBlob;
+        if (SUCCEEDED(renderer.pipeline_state->GetCachedBlob(&pipelineBlob))) {
+            shaderCacheStore(cache, pipelineKey, SHADER_CACHE_PIPELINE, pipelineBlob->GetBufferPointer(), pipelineBlob->GetBufferSize());
+        }
+    }
+    cache.stats.pipeline_ms += timerMilliseconds() - pipelineStart;
+
+    ThrowIfFailed(renderer.device->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_DIRECT, renderer.command_allocators[0].Get(), renderer.pipeline_state.Get(), IID_PPV_ARGS(&renderer.command_list)));
     ThrowIfFailed(renderer.command_list->Close());
 
+    // Fence values are handed out by framePacer, starting from 1
     ThrowIfFailed(renderer.device->CreateFence(0, D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(&renderer.fence)));
-    g_fenceValue = 1;
 
     g_fenceEvent = CreateEvent(nullptr, FALSE, FALSE, nullptr);
     if (g_fenceEvent == nullptr) {
@@ -0,0 +1,260 @@
+#ifndef _H_RENDER_PIPELINE_SHADER_CACHE
+#define _H_RENDER_PIPELINE_SHADER_CACHE
+
+// On-disk cache for compiled shader bytecode and pipeline state blobs.
+// Entries are keyed by a hash of everything that changes the output (source, entry point, target, flags,
+// compiler and driver identity), so a stale entry is never found instead of being invalidated by hand.
+// Platform-neutral - the compiler sits behind a callback, so the whole thing runs headless with a stub.
+#include "../core/timer.cpp"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <unordered_map>
+#include <vector>
+
+constexpr uint32_t SHADER_CACHE_MAGIC = 0x43535848;  // "HXSC"
+constexpr uint32_t SHADER_CACHE_VERSION = 1;         // Bump when the file layout or key recipe changes
+constexpr uint32_t SHADER_CACHE_MAX_AGE = 8;         // Runs an entry survives without being used
+constexpr uint64_t SHADER_CACHE_MAX_ENTRY = 64ull * 1024 * 1024;
+
+enum ShaderCacheKind : uint32_t {
+  SHADER_CACHE_BYTECODE = 1,
+  SHADER_CACHE_PIPELINE = 2
+};
+
+// FNV-1a 64, fine for keys - this is not guarding against anyone, only against stale data
+constexpr uint64_t CACHE_HASH_SEED = 0xcbf29ce484222325ull;
+
+inline uint64_t cacheHashBytes(uint64_t hash, const void* data, size_t size) {
+  const uint8_t* bytes = reinterpret_cast<const uint8_t*>(data);
+  for (size_t i = 0; i < size; i++) {
+    hash ^= bytes[i];
+    hash *= 0x100000001b3ull;
+  }
+  return hash;
+}
+
+// Terminator included, so ("ab", "c") and ("a", "bc") hash differently
+inline uint64_t cacheHashString(uint64_t hash, const char* text) {
+  return cacheHashBytes(hash, text, strlen(text) + 1);
+}
+
+template <typename T>
+inline uint64_t cacheHashValue(uint64_t hash, const T& value) {
+  return cacheHashBytes(hash, &value, sizeof(value));
+}
+
+// compilerTag is whatever identifies the compiler build, ex. D3D_COMPILER_VERSION
+uint64_t shaderBytecodeKey(const char* source, const char* entryPoint, const char* target, uint32_t flags, uint64_t compilerTag) {
+  uint64_t hash = cacheHashValue(CACHE_HASH_SEED, SHADER_CACHE_VERSION);
+  hash = cacheHashValue(hash, (uint32_t)SHADER_CACHE_BYTECODE);
+  hash = cacheHashString(hash, source);
+  hash = cacheHashString(hash, entryPoint);
+  hash = cacheHashString(hash, target);
+  hash = cacheHashValue(hash, flags);
+  return cacheHashValue(hash, compilerTag);
+}
+
+typedef struct ShaderCacheEntry {
+  uint32_t kind = 0;
+  uint32_t age = 0;       // Runs since last use
+  bool used = false;      // Looked up or stored during this run
+  std::vector<uint8_t> data;
+} ShaderCacheEntry;
+
+typedef struct ShaderCacheStats {
+  size_t hits = 0;
+  size_t misses = 0;
+  size_t rejected = 0;    // Entries dropped - corrupt on load or refused by the driver
+  size_t evicted = 0;     // Entries too old to be written back
+  double load_ms = 0.0;
+  double save_ms = 0.0;
+  double compile_ms = 0.0;   // Only spent on misses
+  double pipeline_ms = 0.0;  // Creating pipeline states, with or without a cached blob
+} ShaderCacheStats;
+
+typedef struct ShaderCache {
+  const char* path = nullptr;
+  std::unordered_map<uint64_t, ShaderCacheEntry> entries;
+  bool dirty = false;
+  ShaderCacheStats stats;
+} ShaderCache;
+
+typedef struct ShaderCacheFileHeader {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t count;
+  uint32_t reserved;
+} ShaderCacheFileHeader;
+
+typedef struct ShaderCacheFileEntry {
+  uint64_t key;
+  uint32_t kind;
+  uint32_t age;
+  uint64_t size;
+  uint64_t checksum;  // Of the data only, catches torn writes and bit rot
+} ShaderCacheFileEntry;
+
+// Missing, foreign or corrupt files just leave the cache empty - everything gets compiled again.
+// Returns true if the file was read.
+bool loadShaderCache(ShaderCache& cache, const char* path) {
+  double start = timerMilliseconds();
+  cache.path = path;
+  cache.entries.clear();
+  cache.dirty = false;
+
+  FILE* file = fopen(path, "rb");
+  if (file == nullptr) {
+    cache.stats.load_ms += timerMilliseconds() - start;
+    return false;
+  }
+
+  bool ok = false;
+  ShaderCacheFileHeader header = {};
+  if (fread(&header, sizeof(header), 1, file) == 1 && header.magic == SHADER_CACHE_MAGIC) {
+    if (header.version != SHADER_CACHE_VERSION) {
+      cache.stats.rejected += header.count;
+      cache.dirty = true;  // Rewrite it in the current format
+    } else {
+      ok = true;
+      for (uint32_t i = 0; i < header.count; i++) {
+        ShaderCacheFileEntry e = {};
+        if (fread(&e, sizeof(e), 1, file) != 1 || e.size > SHADER_CACHE_MAX_ENTRY) {
+          ok = false;
+          break;
+        }
+        ShaderCacheEntry entry = {};
+        entry.kind = e.kind;
+        entry.age = e.age;
+        entry.data.resize((size_t)e.size);
+        if (e.size > 0 && fread(entry.data.data(), (size_t)e.size, 1, file) != 1) {
+          ok = false;
+          break;
+        }
+        if (cacheHashBytes(CACHE_HASH_SEED, entry.data.data(), entry.data.size()) != e.checksum) {
+          cache.stats.rejected++;
+          cache.dirty = true;
+          continue;
+        }
+        cache.entries[e.key] = std::move(entry);
+      }
+      if (!ok) {
+        // Truncated - keep nothing, a half read cache is not worth trusting
+        cache.stats.rejected += cache.entries.size();
+        cache.entries.clear();
+        cache.dirty = true;
+      }
+    }
+  }
+
+  fclose(file);
+  cache.stats.load_ms += timerMilliseconds() - start;
+  return ok;
+}
+
+// Writes to path.tmp first and renames, so a crash mid-save leaves the old file intact.
+// Entries unused for SHADER_CACHE_MAX_AGE runs are dropped here.
+bool saveShaderCache(ShaderCache& cache) {
+  if (cache.path == nullptr) return false;
+  double start = timerMilliseconds();
+
+  for (auto it = cache.entries.begin(); it != cache.entries.end(); ) {
+    ShaderCacheEntry& entry = it->second;
+    uint32_t age = entry.used ? 0 : entry.age + 1;
+    cache.dirty = cache.dirty || age != entry.age;
+    entry.age = age;
+    if (entry.age > SHADER_CACHE_MAX_AGE) {
+      cache.stats.evicted++;
+      cache.dirty = true;
+      it = cache.entries.erase(it);
+    } else {
+      ++it;
+    }
+  }
+
+  // Everything used and nothing new - the file on disk is already right
+  if (!cache.dirty) {
+    cache.stats.save_ms += timerMilliseconds() - start;
+    return true;
+  }
+
+  char tmpPath[512];
+  snprintf(tmpPath, sizeof(tmpPath), "%s.tmp", cache.path);
+  FILE* file = fopen(tmpPath, "wb");
+  if (file == nullptr) {
+    cache.stats.save_ms += timerMilliseconds() - start;
+    return false;
+  }
+
+  ShaderCacheFileHeader header = { SHADER_CACHE_MAGIC, SHADER_CACHE_VERSION, (uint32_t)cache.entries.size(), 0 };
+  fwrite(&header, sizeof(header), 1, file);
+  for (const auto& it : cache.entries) {
+    const ShaderCacheEntry& entry = it.second;
+    ShaderCacheFileEntry e = {};
+    e.key = it.first;
+    e.kind = entry.kind;
+    e.age = entry.age;
+    e.size = entry.data.size();
+    e.checksum = cacheHashBytes(CACHE_HASH_SEED, entry.data.data(), entry.data.size());
+    fwrite(&e, sizeof(e), 1, file);
+    if (!entry.data.empty()) fwrite(entry.data.data(), entry.data.size(), 1, file);
+  }
+
+  bool ok = ferror(file) == 0;
+  ok = fclose(file) == 0 && ok;
+  if (ok) {
+    remove(cache.path);  // rename does not replace on Windows
+    ok = rename(tmpPath, cache.path) == 0;
+  }
+  if (ok) cache.dirty = false;
+  cache.stats.save_ms += timerMilliseconds() - start;
+  return ok;
+}
+
+const std::vector<uint8_t>* shaderCacheFind(ShaderCache& cache, uint64_t key, ShaderCacheKind kind) {
+  auto it = cache.entries.find(key);
+  if (it == cache.entries.end() || it->second.kind != kind) {
+    cache.stats.misses++;
+    return nullptr;
+  }
+  cache.stats.hits++;
+  it->second.used = true;
+  return &it->second.data;
+}
+
+void shaderCacheStore(ShaderCache& cache, uint64_t key, ShaderCacheKind kind, const void* data, size_t size) {
+  ShaderCacheEntry& entry = cache.entries[key];
+  entry.kind = kind;
+  entry.age = 0;
+  entry.used = true;
+  entry.data.assign(reinterpret_cast<const uint8_t*>(data), reinterpret_cast<const uint8_t*>(data) + size);
+  cache.dirty = true;
+}
+
+// For blobs the consumer refused, ex. a PSO blob after a driver update
+void shaderCacheReject(ShaderCache& cache, uint64_t key) {
+  if (cache.entries.erase(key) > 0) {
+    cache.stats.rejected++;
+    cache.dirty = true;
+  }
+}
+
+// Cached bytes for key, or whatever compile(std::vector<uint8_t>& out) -> bool produces, stored on success.
+// Returns nullptr if compiling failed. The pointer is valid until the cache is changed again.
+template <typename CompileFn>
+const std::vector<uint8_t>* shaderCacheGetOrCompile(ShaderCache& cache, uint64_t key, ShaderCacheKind kind, CompileFn compile) {
+  const std::vector<uint8_t>* cached = shaderCacheFind(cache, key, kind);
+  if (cached != nullptr) return cached;
+
+  std::vector<uint8_t> compiled;
+  double start = timerMilliseconds();
+  bool ok = compile(compiled);
+  cache.stats.compile_ms += timerMilliseconds() - start;
+  if (!ok) return nullptr;
+
+  shaderCacheStore(cache, key, kind, compiled.data(), compiled.size());
+  return &cache.entries[key].data;
+}
+
+#endif /* _H_RENDER_PIPELINE_SHADER_CACHE */
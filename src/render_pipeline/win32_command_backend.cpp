@@ -0,0 +1,118 @@
+#ifndef _H_RENDER_PIPELINE_WIN32_COMMAND_BACKEND
+#define _H_RENDER_PIPELINE_WIN32_COMMAND_BACKEND
+
+#include "command_stream.cpp"
+#include "win32_upload_heap.cpp"
+#include "copy_uploader.cpp"
+#include "win32_gpu_profiler.cpp"
+#include "../win32_renderer.cpp"
+
+#include <cstring>
+
+constexpr UINT WIN32_COMMAND_MAX_PASS_NAMES = 16;
+
+// CommandBackend on top of the direct command list - what onRender used to call inline. Buffer and pipeline
+// ids are looked up in the tables below, main fills them once the resources exist.
+struct win32_CommandBackend : CommandBackend {
+  ID3D12GraphicsCommandList* command_list = nullptr;
+  win32_UploadHeaps* upload_heaps = nullptr;
+  win32_GpuProfiler* gpu_profiler = nullptr;
+  ID3D12RootSignature* root_signature = nullptr;
+  ID3D12PipelineState* pipelines[COMMAND_MAX_PIPELINES] = {};
+  D3D12_GPU_VIRTUAL_ADDRESS buffer_gpu[COMMAND_MAX_BUFFERS] = {};
+  CopyUploader* copies = nullptr;  // Buffers are GPU-local, writes go through the copy queue
+  UINT8* buffer_cpu[COMMAND_MAX_BUFFERS] = {};  // Except per-frame ones in mapped upload memory, written in place
+  size_t buffer_cpu_size[COMMAND_MAX_BUFFERS] = {};
+  bool replaying = false;          // Live frames already uploaded their writes, only a replay applies WRITE_BUFFER
+
+  // Per frame - set before executeCommands
+  uint32_t frame_slot = 0;
+  ID3D12Resource* render_target = nullptr;
+  D3D12_CPU_DESCRIPTOR_HANDLE rtv = {};
+
+  // The GPU profiler keeps name pointers until the timestamps come back, so pass names live here
+  char pass_names[WIN32_COMMAND_MAX_PASS_NAMES][sizeof(CommandBeginPass::name)] = {};
+  UINT pass_name_count = 0;
+  UINT pass_scope = UINT_MAX;
+
+  const char* passName(const char* name) {
+    for (UINT i = 0; i < pass_name_count; i++) {
+      if (strcmp(pass_names[i], name) == 0) return pass_names[i];
+    }
+    if (pass_name_count == WIN32_COMMAND_MAX_PASS_NAMES) return "pass";
+    memcpy(pass_names[pass_name_count], name, sizeof(pass_names[0]));
+    return pass_names[pass_name_count++];
+  }
+
+  void transition(D3D12_RESOURCE_STATES before, D3D12_RESOURCE_STATES after) {
+    D3D12_RESOURCE_BARRIER barrier = {};
+    barrier.Type = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION;
+    barrier.Transition.pResource = render_target;
+    barrier.Transition.StateBefore = before;
+    barrier.Transition.StateAfter = after;
+    command_list->ResourceBarrier(1, &barrier);
+  }
+
+  void beginPass(const CommandBeginPass& pass) override {
+    D3D12_VIEWPORT viewport = { 0.0f, 0.0f, (float)pass.width, (float)pass.height, D3D12_MIN_DEPTH, D3D12_MAX_DEPTH };
+    D3D12_RECT scissorRect = { 0, 0, (LONG)pass.width, (LONG)pass.height };
+    transition(D3D12_RESOURCE_STATE_PRESENT, D3D12_RESOURCE_STATE_RENDER_TARGET);
+    command_list->OMSetRenderTargets(1, &rtv, FALSE, nullptr);
+    command_list->ClearRenderTargetView(rtv, pass.clear, 0, nullptr);
+    command_list->RSSetViewports(1, &viewport);
+    command_list->RSSetScissorRects(1, &scissorRect);
+    pass_scope = gpu_profiler != nullptr ? gpuProfileBegin(*gpu_profiler, command_list, passName(pass.name)) : UINT_MAX;
+  }
+
+  void endPass() override {
+    if (gpu_profiler != nullptr) gpuProfileEnd(*gpu_profiler, command_list, pass_scope);
+    pass_scope = UINT_MAX;
+    transition(D3D12_RESOURCE_STATE_RENDER_TARGET, D3D12_RESOURCE_STATE_PRESENT);
+  }
+
+  void setPipeline(uint32_t pipeline) override {
+    command_list->SetPipelineState(pipelines[pipeline]);
+    command_list->SetGraphicsRootSignature(root_signature);
+    command_list->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+  }
+
+  // Fresh constants from this slot's linear segment - the GPU may still be reading the other ones
+  void setConstants(uint32_t slot, const void* data, uint32_t size) override {
+    win32_UploadRange range = allocateFrameRange(*upload_heaps, frame_slot, size, CBV_ALIGNMENT);
+    memcpy(range.cpu, data, size);
+    command_list->SetGraphicsRootConstantBufferView(slot, range.gpu);
+  }
+
+  void setVertexBuffers(const CommandSetVertexBuffers& buffers) override {
+    D3D12_VERTEX_BUFFER_VIEW views[COMMAND_MAX_VERTEX_STREAMS];
+    for (uint32_t i = 0; i < buffers.count; i++) {
+      views[i].BufferLocation = buffer_gpu[buffers.views[i].buffer] + buffers.views[i].offset;
+      views[i].SizeInBytes = buffers.views[i].size;
+      views[i].StrideInBytes = buffers.views[i].stride;
+    }
+    command_list->IASetVertexBuffers(buffers.first_slot, buffers.count, views);
+  }
+
+  void setIndexBuffer(const CommandBufferView& view) override {
+    D3D12_INDEX_BUFFER_VIEW index = {};
+    index.BufferLocation = buffer_gpu[view.buffer] + view.offset;
+    index.SizeInBytes = view.size;
+    index.Format = view.stride == 4 ? DXGI_FORMAT_R32_UINT : DXGI_FORMAT_R16_UINT;
+    command_list->IASetIndexBuffer(&index);
+  }
+
+  void drawIndexed(const CommandDrawIndexed& draw) override {
+    command_list->DrawIndexedInstanced(draw.index_count, draw.instance_count, draw.first_index, draw.base_vertex, draw.first_instance);
+  }
+
+  void writeBuffer(uint32_t buffer, uint64_t offset, const void* data, uint32_t size) override {
+    if (!replaying) return;
+    if (buffer_cpu[buffer] != nullptr) {
+      if (offset + size <= buffer_cpu_size[buffer]) memcpy(buffer_cpu[buffer] + offset, data, size);
+    } else if (copies != nullptr) {
+      copyUpload(*copies, buffer, offset, data, size, true);
+    }
+  }
+};
+
+#endif /* _H_RENDER_PIPELINE_WIN32_COMMAND_BACKEND */
@@ -0,0 +1,121 @@
+#ifndef _H_RENDER_PIPELINE_WIN32_COPY_BACKEND
+#define _H_RENDER_PIPELINE_WIN32_COPY_BACKEND
+
+#include "copy_uploader.cpp"
+#include "win32_upload_heap.cpp"
+#include "../win32_renderer.cpp"
+#include "../win_utils.cpp"
+
+// Staging ring for CopyUploader - one persistently mapped upload buffer, the copy queue reads it
+constexpr size_t COPY_STAGING_SIZE = 16 * 1024 * 1024;
+constexpr UINT COPY_ALLOCATORS = 4;  // Batches recording or in flight before submit has to wait for one
+
+// CopyBackend on a D3D12_COMMAND_LIST_TYPE_COPY queue with its own fence. Destinations are default heap
+// buffers created here, in the common state - buffers get promoted to whatever the direct queue reads
+// them as and decay back once those frames are done, so neither queue needs barriers for them.
+struct win32_CopyBackend : CopyBackend {
+  win32_Renderer* renderer = nullptr;
+  Microsoft::WRL::ComPtr<ID3D12CommandQueue> queue;
+  Microsoft::WRL::ComPtr<ID3D12CommandAllocator> allocators[COPY_ALLOCATORS];
+  uint64_t allocator_fence[COPY_ALLOCATORS] = {};
+  UINT allocator_next = 0;
+  Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList> command_list;
+  Microsoft::WRL::ComPtr<ID3D12Fence> fence;
+  HANDLE fence_event = nullptr;
+  Microsoft::WRL::ComPtr<ID3D12Resource> staging;
+  UINT8* staging_mapped = nullptr;
+  Microsoft::WRL::ComPtr<ID3D12Resource> buffers[COPY_MAX_BUFFERS];
+  uint64_t direct_waited = 0;  // Last copy fence the direct queue was told to wait for
+
+  void submit(const CopyRegion* regions, uint32_t count, uint64_t value, bool afterGraphics) override {
+    const UINT index = allocator_next;
+    allocator_next = (allocator_next + 1) % COPY_ALLOCATORS;
+    if (allocator_fence[index] != 0 && completedValue() < allocator_fence[index]) waitFor(allocator_fence[index]);
+    ThrowIfFailed(allocators[index]->Reset());
+    ThrowIfFailed(command_list->Reset(allocators[index].Get(), nullptr));
+    for (uint32_t i = 0; i < count; i++) {
+      command_list->CopyBufferRegion(buffers[regions[i].buffer].Get(), regions[i].dst_offset, staging.Get(), regions[i].src_offset, regions[i].size);
+    }
+    ThrowIfFailed(command_list->Close());
+
+    // Overwrites of ranges frames in flight still draw from - wait for the last frame handed to the direct queue
+    const uint64_t lastFrame = framePacer.next_fence_value - 1;
+    if (afterGraphics && lastFrame > 0) ThrowIfFailed(queue->Wait(renderer->fence.Get(), lastFrame));
+    ID3D12CommandList* lists[] = { command_list.Get() };
+    queue->ExecuteCommandLists(1, lists);
+    ThrowIfFailed(queue->Signal(fence.Get(), value));
+    allocator_fence[index] = value;
+  }
+
+  uint64_t completedValue() override {
+    return fence->GetCompletedValue();
+  }
+
+  void waitFor(uint64_t value) override {
+    ThrowIfFailed(fence->SetEventOnCompletion(value, fence_event));
+    WaitForSingleObject(fence_event, INFINITE);
+  }
+};
+
+void initCopyBackend(win32_CopyBackend& copy, win32_Renderer& renderer) {
+  copy.renderer = &renderer;
+  D3D12_COMMAND_QUEUE_DESC queueDesc = {};
+  queueDesc.Type = D3D12_COMMAND_LIST_TYPE_COPY;
+  queueDesc.Flags = D3D12_COMMAND_QUEUE_FLAG_NONE;
+  ThrowIfFailed(renderer.device->CreateCommandQueue(&queueDesc, IID_PPV_ARGS(&copy.queue)));
+  for (UINT i = 0; i < COPY_ALLOCATORS; i++) {
+    ThrowIfFailed(renderer.device->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_COPY, IID_PPV_ARGS(&copy.allocators[i])));
+  }
+  ThrowIfFailed(renderer.device->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_COPY, copy.allocators[0].Get(), nullptr, IID_PPV_ARGS(&copy.command_list)));
+  ThrowIfFailed(copy.command_list->Close());
+  ThrowIfFailed(renderer.device->CreateFence(0, D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(&copy.fence)));
+  copy.fence_event = CreateEvent(nullptr, FALSE, FALSE, nullptr);
+  if (copy.fence_event == nullptr) {
+    ThrowIfFailed(HRESULT_FROM_WIN32(GetLastError()));
+  }
+  createMappedUploadBuffer(renderer, COPY_STAGING_SIZE, copy.staging, &copy.staging_mapped);
+}
+
+// GPU-local buffer behind a copy destination id
+D3D12_GPU_VIRTUAL_ADDRESS createCopyDestination(win32_CopyBackend& copy, uint32_t buffer, size_t size) {
+  D3D12_HEAP_PROPERTIES heapProps = {};
+  heapProps.Type = D3D12_HEAP_TYPE_DEFAULT;
+
+  D3D12_RESOURCE_DESC resourceDesc = {};
+  resourceDesc.Dimension = D3D12_RESOURCE_DIMENSION_BUFFER;
+  resourceDesc.Width = size;
+  resourceDesc.Height = 1;
+  resourceDesc.DepthOrArraySize = 1;
+  resourceDesc.MipLevels = 1;
+  resourceDesc.SampleDesc.Count = 1;
+  resourceDesc.Layout = D3D12_TEXTURE_LAYOUT_ROW_MAJOR;
+
+  ThrowIfFailed(copy.renderer->device->CreateCommittedResource(
+      &heapProps,
+      D3D12_HEAP_FLAG_NONE,
+      &resourceDesc,
+      D3D12_RESOURCE_STATE_COMMON,
+      nullptr,
+      IID_PPV_ARGS(&copy.buffers[buffer])));
+  return copy.buffers[buffer]->GetGPUVirtualAddress();
+}
+
+// Direct queue holds off until everything uploaded so far has landed - the GPU waits, not the CPU
+void waitForCopies(win32_CopyBackend& copy, ID3D12CommandQueue* direct, uint64_t value) {
+  if (value <= copy.direct_waited) return;
+  ThrowIfFailed(direct->Wait(copy.fence.Get(), value));
+  copy.direct_waited = value;
+}
+
+void destroyCopyBackend(win32_CopyBackend& copy) {
+  for (UINT i = 0; i < COPY_MAX_BUFFERS; i++) copy.buffers[i].Reset();
+  copy.staging.Reset();
+  copy.command_list.Reset();
+  for (UINT i = 0; i < COPY_ALLOCATORS; i++) copy.allocators[i].Reset();
+  copy.fence.Reset();
+  copy.queue.Reset();
+  if (copy.fence_event != nullptr) CloseHandle(copy.fence_event);
+  copy.fence_event = nullptr;
+}
+
+#endif /* _H_RENDER_PIPELINE_WIN32_COPY_BACKEND */
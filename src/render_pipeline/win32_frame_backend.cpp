@@ -0,0 +1,27 @@
+#ifndef _H_RENDER_PIPELINE_WIN32_FRAME_BACKEND
+#define _H_RENDER_PIPELINE_WIN32_FRAME_BACKEND
+
+#include "frame_pacing.cpp"
+#include "../win32_renderer.cpp"
+#include "../win_utils.cpp"
+
+// FrameBackend on top of the direct queue fence - what WaitForPreviousFrame used to do inline
+struct win32_FrameBackend : FrameBackend {
+  win32_Renderer* renderer = nullptr;
+  HANDLE fence_event = nullptr;
+
+  void signal(uint64_t value) override {
+    ThrowIfFailed(renderer->command_queue->Signal(renderer->fence.Get(), value));
+  }
+
+  uint64_t completedValue() override {
+    return renderer->fence->GetCompletedValue();
+  }
+
+  void waitFor(uint64_t value) override {
+    ThrowIfFailed(renderer->fence->SetEventOnCompletion(value, fence_event));
+    WaitForSingleObject(fence_event, INFINITE);
+  }
+};
+
+#endif /* _H_RENDER_PIPELINE_WIN32_FRAME_BACKEND */
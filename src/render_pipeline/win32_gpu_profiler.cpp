@@ -0,0 +1,130 @@
+#ifndef _H_RENDER_PIPELINE_WIN32_GPU_PROFILER
+#define _H_RENDER_PIPELINE_WIN32_GPU_PROFILER
+
+// GPU timestamps on the direct queue. Every frame slot has its own range of queries and readback memory,
+// resolved at the end of the slot's command list and read once beginFrame has waited for that slot again -
+// so reading never stalls. Results go to the profiler as a "GPU" track on the CPU timeline.
+#include "../core/profiler.cpp"
+#include "../win32_renderer.cpp"
+#include "../win_utils.cpp"
+
+constexpr UINT GPU_PROFILE_MAX_SCOPES = 32;  // Per frame, each takes two queries
+
+typedef struct {
+  const char* name;
+  UINT depth;
+} win32_GpuScope;
+
+typedef struct {
+  Microsoft::WRL::ComPtr<ID3D12QueryHeap> query_heap;
+  Microsoft::WRL::ComPtr<ID3D12Resource> readback;
+  UINT64* mapped;
+  UINT64 frequency;           // Ticks per second of the queue's timestamp counter
+  UINT64 gpu_calibration;     // GPU tick and QPC value taken at the same moment
+  UINT64 cpu_calibration;
+  UINT64 cpu_frequency;
+  ProfileTrack* track;
+  win32_GpuScope scopes[FRAMES_IN_FLIGHT][GPU_PROFILE_MAX_SCOPES];
+  UINT scope_count[FRAMES_IN_FLIGHT];
+  UINT depth;
+  UINT slot;
+} win32_GpuProfiler;
+
+void initGpuProfiler(win32_GpuProfiler& gpu, win32_Renderer& renderer) {
+  gpu = {};
+  const UINT queryCount = FRAMES_IN_FLIGHT * GPU_PROFILE_MAX_SCOPES * 2;
+
+  D3D12_QUERY_HEAP_DESC queryHeapDesc = {};
+  queryHeapDesc.Type = D3D12_QUERY_HEAP_TYPE_TIMESTAMP;
+  queryHeapDesc.Count = queryCount;
+  ThrowIfFailed(renderer.device->CreateQueryHeap(&queryHeapDesc, IID_PPV_ARGS(&gpu.query_heap)));
+
+  D3D12_HEAP_PROPERTIES heapProps = {};
+  heapProps.Type = D3D12_HEAP_TYPE_READBACK;
+  D3D12_RESOURCE_DESC resourceDesc = {};
+  resourceDesc.Dimension = D3D12_RESOURCE_DIMENSION_BUFFER;
+  resourceDesc.Width = queryCount * sizeof(UINT64);
+  resourceDesc.Height = 1;
+  resourceDesc.DepthOrArraySize = 1;
+  resourceDesc.MipLevels = 1;
+  resourceDesc.SampleDesc.Count = 1;
+  resourceDesc.Layout = D3D12_TEXTURE_LAYOUT_ROW_MAJOR;
+  ThrowIfFailed(renderer.device->CreateCommittedResource(
+      &heapProps,
+      D3D12_HEAP_FLAG_NONE,
+      &resourceDesc,
+      D3D12_RESOURCE_STATE_COPY_DEST,
+      nullptr,
+      IID_PPV_ARGS(&gpu.readback)));
+  // Readback heaps stay mapped, the fence wait in beginFrame is what makes reading them safe
+  ThrowIfFailed(gpu.readback->Map(0, nullptr, reinterpret_cast<void**>(&gpu.mapped)));
+
+  ThrowIfFailed(renderer.command_queue->GetTimestampFrequency(&gpu.frequency));
+  ThrowIfFailed(renderer.command_queue->GetClockCalibration(&gpu.gpu_calibration, &gpu.cpu_calibration));
+  LARGE_INTEGER qpcFrequency;
+  QueryPerformanceFrequency(&qpcFrequency);
+  gpu.cpu_frequency = (UINT64)qpcFrequency.QuadPart;
+  gpu.track = profilerCreateTrack("GPU");
+}
+
+void destroyGpuProfiler(win32_GpuProfiler& gpu) {
+  if (gpu.readback) gpu.readback->Unmap(0, nullptr);
+  gpu.readback.Reset();
+  gpu.query_heap.Reset();
+  gpu.mapped = nullptr;
+}
+
+// GPU tick to the nanoseconds timerNanoseconds() uses - steady_clock is QPC based on Windows
+static uint64_t gpuTicksToCpuNanoseconds(const win32_GpuProfiler& gpu, UINT64 ticks) {
+  double seconds = ((double)ticks - (double)gpu.gpu_calibration) / (double)gpu.frequency;
+  double cpuSeconds = (double)gpu.cpu_calibration / (double)gpu.cpu_frequency + seconds;
+  return (uint64_t)(cpuSeconds * 1e9);
+}
+
+// Call after beginFrame - publishes what this slot measured FRAMES_IN_FLIGHT frames ago and starts over
+void gpuProfilerBeginFrame(win32_GpuProfiler& gpu, UINT slot) {
+  gpu.slot = slot;
+  gpu.depth = 0;
+  const UINT count = gpu.scope_count[slot];
+  if (count > 0) {
+    const UINT64* ticks = gpu.mapped + slot * GPU_PROFILE_MAX_SCOPES * 2;
+    for (UINT i = 0; i < count; i++) {
+      const UINT64 begin = ticks[i * 2];
+      const UINT64 end = ticks[i * 2 + 1];
+      if (end < begin) continue;
+      // Scope 0 wraps the whole list, that is the frame's GPU time
+      if (i == 0) rollingStatsAdd(profiler.gpu_frames, (float)((double)(end - begin) * 1000.0 / (double)gpu.frequency));
+      if (gpu.track != nullptr) {
+        profilerRecord(gpu.track, gpu.scopes[slot][i].name, gpuTicksToCpuNanoseconds(gpu, begin), gpuTicksToCpuNanoseconds(gpu, end), gpu.scopes[slot][i].depth);
+      }
+    }
+  }
+  gpu.scope_count[slot] = 0;
+}
+
+// Returns the scope index for gpuProfileEnd, UINT_MAX once the frame is out of scopes
+UINT gpuProfileBegin(win32_GpuProfiler& gpu, ID3D12GraphicsCommandList* commandList, const char* name) {
+  UINT& count = gpu.scope_count[gpu.slot];
+  if (count >= GPU_PROFILE_MAX_SCOPES) return UINT_MAX;
+  const UINT scope = count++;
+  gpu.scopes[gpu.slot][scope] = { name, gpu.depth++ };
+  commandList->EndQuery(gpu.query_heap.Get(), D3D12_QUERY_TYPE_TIMESTAMP, (gpu.slot * GPU_PROFILE_MAX_SCOPES + scope) * 2);
+  return scope;
+}
+
+void gpuProfileEnd(win32_GpuProfiler& gpu, ID3D12GraphicsCommandList* commandList, UINT scope) {
+  if (scope == UINT_MAX) return;
+  gpu.depth--;
+  commandList->EndQuery(gpu.query_heap.Get(), D3D12_QUERY_TYPE_TIMESTAMP, (gpu.slot * GPU_PROFILE_MAX_SCOPES + scope) * 2 + 1);
+}
+
+// Last thing before Close - copies this slot's timestamps into its part of the readback buffer
+void gpuProfilerResolve(win32_GpuProfiler& gpu, ID3D12GraphicsCommandList* commandList) {
+  const UINT count = gpu.scope_count[gpu.slot];
+  if (count == 0) return;
+  const UINT first = gpu.slot * GPU_PROFILE_MAX_SCOPES * 2;
+  commandList->ResolveQueryData(gpu.query_heap.Get(), D3D12_QUERY_TYPE_TIMESTAMP, first, count * 2,
+                                gpu.readback.Get(), first * sizeof(UINT64));
+}
+
+#endif /* _H_RENDER_PIPELINE_WIN32_GPU_PROFILER */
@@ -0,0 +1,60 @@
+#ifndef _H_RENDER_PIPELINE_WIN32_INPUT_LAYOUT
+#define _H_RENDER_PIPELINE_WIN32_INPUT_LAYOUT
+
+// D3D12 input layouts generated from VertexLayout<T> at compile time.
+// Usage: constexpr auto layout = makeInputLayout<InputStream<VertexHalf, 0>, InputStream<HexInstance, 1, true>>();
+#include "../graphics/vertex_formats.cpp"
+#include "../graphics/mesh_optimize.cpp"
+
+#include <d3d12.h>
+#include <array>
+
+constexpr DXGI_FORMAT dxgiFormat(VertexAttribFormat format) {
+  switch (format) {
+    case VERTEX_ATTRIB_FLOAT1: return DXGI_FORMAT_R32_FLOAT;
+    case VERTEX_ATTRIB_FLOAT2: return DXGI_FORMAT_R32G32_FLOAT;
+    case VERTEX_ATTRIB_FLOAT3: return DXGI_FORMAT_R32G32B32_FLOAT;
+    case VERTEX_ATTRIB_FLOAT4: return DXGI_FORMAT_R32G32B32A32_FLOAT;
+    case VERTEX_ATTRIB_UINT1: return DXGI_FORMAT_R32_UINT;
+    case VERTEX_ATTRIB_HALF4: return DXGI_FORMAT_R16G16B16A16_FLOAT;
+    case VERTEX_ATTRIB_UNORM8X4: return DXGI_FORMAT_R8G8B8A8_UNORM;
+    case VERTEX_ATTRIB_UNORM10X3_2: return DXGI_FORMAT_R10G10B10A2_UNORM;
+  }
+  return DXGI_FORMAT_UNKNOWN;
+}
+
+// Index buffer view format for a mesh, ex. dxgiFormat(hexMapChunkIndexFormat(map, chunk))
+constexpr DXGI_FORMAT dxgiFormat(IndexFormat format) {
+  return format == INDEX_FORMAT_32 ? DXGI_FORMAT_R32_UINT : DXGI_FORMAT_R16_UINT;
+}
+
+// One vertex buffer slot - per-instance streams step once every instance
+template <typename V, UINT Slot, bool PerInstance = false>
+struct InputStream {
+  typedef V Type;
+  static constexpr UINT slot = Slot;
+  static constexpr bool per_instance = PerInstance;
+};
+
+template <typename S, size_t N>
+constexpr void appendInputStream(std::array<D3D12_INPUT_ELEMENT_DESC, N>& out, size_t& n) {
+  typedef typename S::Type V;
+  static_assert(vertexLayoutIsTight<V>(), "Vertex layout has to cover the whole struct");
+  for (size_t i = 0; i < vertexAttribCount<V>(); i++) {
+    const VertexAttrib& a = VertexLayout<V>::attribs[i];
+    out[n++] = D3D12_INPUT_ELEMENT_DESC{
+        a.semantic, 0, dxgiFormat(a.format), S::slot, a.offset,
+        S::per_instance ? D3D12_INPUT_CLASSIFICATION_PER_INSTANCE_DATA : D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA,
+        S::per_instance ? 1u : 0u };
+  }
+}
+
+template <typename... Streams>
+constexpr std::array<D3D12_INPUT_ELEMENT_DESC, (vertexAttribCount<typename Streams::Type>() + ...)> makeInputLayout() {
+  std::array<D3D12_INPUT_ELEMENT_DESC, (vertexAttribCount<typename Streams::Type>() + ...)> out = {};
+  size_t n = 0;
+  (appendInputStream<Streams>(out, n), ...);
+  return out;
+}
+
+#endif /* _H_RENDER_PIPELINE_WIN32_INPUT_LAYOUT */
@@ -0,0 +1,113 @@
+#ifndef _H_RENDER_PIPELINE_WIN32_UPLOAD_HEAP
+#define _H_RENDER_PIPELINE_WIN32_UPLOAD_HEAP
+
+#include "../core/upload_allocator.cpp"
+#include "../win32_renderer.cpp"
+#include "../win_utils.cpp"
+
+// Backing memory for UploadAllocator - a few big committed upload buffers, mapped once and never unmapped.
+// Upload heaps are write-combined on the CPU side: write into them, never read back.
+constexpr size_t UPLOAD_HEAP_SIZE = 64 * 1024 * 1024;
+constexpr size_t UPLOAD_FRAME_SEGMENT = 8 * 1024 * 1024;  // Constants and animated tiles, about half a million of them
+
+typedef struct {
+  UINT8* cpu;
+  D3D12_GPU_VIRTUAL_ADDRESS gpu;
+  UploadAllocation allocation;
+} win32_UploadRange;
+
+typedef struct {
+  win32_Renderer* renderer;
+  UploadAllocator allocator;
+  Microsoft::WRL::ComPtr<ID3D12Resource> heaps[MAX_UPLOAD_HEAPS];
+  UINT8* mapped[MAX_UPLOAD_HEAPS];
+  Microsoft::WRL::ComPtr<ID3D12Resource> frame_heap;
+  UINT8* frame_mapped;
+} win32_UploadHeaps;
+
+static void createMappedUploadBuffer(win32_Renderer& renderer, size_t size, Microsoft::WRL::ComPtr<ID3D12Resource>& resource, UINT8** mapped) {
+  D3D12_HEAP_PROPERTIES heapProps = {};
+  D3D12_RESOURCE_DESC resourceDesc = {};
+  D3D12_RANGE readRange = {0, 0}; // We do not intend to read from this resource on the CPU
+
+  heapProps.Type = D3D12_HEAP_TYPE_UPLOAD;
+
+  resourceDesc.Dimension = D3D12_RESOURCE_DIMENSION_BUFFER;
+  resourceDesc.Width = size;
+  resourceDesc.Height = 1;
+  resourceDesc.DepthOrArraySize = 1;
+  resourceDesc.MipLevels = 1;
+  resourceDesc.SampleDesc.Count = 1;
+  resourceDesc.Layout = D3D12_TEXTURE_LAYOUT_ROW_MAJOR;
+
+  ThrowIfFailed(renderer.device->CreateCommittedResource(
+      &heapProps,
+      D3D12_HEAP_FLAG_NONE,
+      &resourceDesc,
+      D3D12_RESOURCE_STATE_GENERIC_READ,
+      nullptr,
+      IID_PPV_ARGS(&resource)));
+  ThrowIfFailed(resource->Map(0, &readRange, reinterpret_cast<void**>(mapped)));
+}
+
+static bool onNewUploadHeap(void* user, uint32_t heap, size_t size) {
+  win32_UploadHeaps& heaps = *reinterpret_cast<win32_UploadHeaps*>(user);
+  createMappedUploadBuffer(*heaps.renderer, size, heaps.heaps[heap], &heaps.mapped[heap]);
+  return true;
+}
+
+void initUploadHeaps(win32_UploadHeaps& heaps, win32_Renderer& renderer) {
+  heaps.renderer = &renderer;
+  initUploadAllocator(heaps.allocator, UPLOAD_HEAP_SIZE, UPLOAD_FRAME_SEGMENT, FRAMES_IN_FLIGHT);
+  heaps.allocator.on_new_heap = onNewUploadHeap;
+  heaps.allocator.user = &heaps;
+  createMappedUploadBuffer(renderer, heaps.allocator.frame_segment * FRAMES_IN_FLIGHT, heaps.frame_heap, &heaps.frame_mapped);
+}
+
+void destroyUploadHeaps(win32_UploadHeaps& heaps) {
+  for (uint32_t i = 0; i < MAX_UPLOAD_HEAPS; i++) {
+    heaps.heaps[i].Reset();
+  }
+  heaps.frame_heap.Reset();
+  destroyUploadAllocator(heaps.allocator);
+}
+
+// Long lived range - vertex/index/instance data, freed with freeUploadRange
+win32_UploadRange allocateUploadRange(win32_UploadHeaps& heaps, size_t size, size_t alignment) {
+  win32_UploadRange range = {};
+  range.allocation = uploadAllocate(heaps.allocator, size, alignment);
+  if (range.allocation.offset == UPLOAD_INVALID_OFFSET) {
+    throw std::runtime_error("Upload heaps out of memory");
+  }
+  range.cpu = heaps.mapped[range.allocation.heap] + range.allocation.offset;
+  range.gpu = heaps.heaps[range.allocation.heap]->GetGPUVirtualAddress() + range.allocation.offset;
+  return range;
+}
+
+void freeUploadRange(win32_UploadHeaps& heaps, const win32_UploadRange& range) {
+  uploadFree(heaps.allocator, range.allocation);
+}
+
+// Valid until the slot comes around again, no free needed. False when the slot's segment is full, or would
+// have less than reserve left - bulk data passes UPLOAD_FRAME_CONSTANTS so setConstants never runs dry.
+bool tryAllocateFrameRange(win32_UploadHeaps& heaps, uint32_t slot, size_t size, size_t alignment, win32_UploadRange& range,
+                           size_t reserve = 0) {
+  range = {};
+  size_t offset = uploadAllocateFrame(heaps.allocator, slot, size, alignment, reserve);
+  if (offset == UPLOAD_INVALID_OFFSET) return false;
+  range.cpu = heaps.frame_mapped + offset;
+  range.gpu = heaps.frame_heap->GetGPUVirtualAddress() + offset;
+  range.allocation.offset = offset;
+  range.allocation.size = size;
+  return true;
+}
+
+win32_UploadRange allocateFrameRange(win32_UploadHeaps& heaps, uint32_t slot, size_t size, size_t alignment) {
+  win32_UploadRange range;
+  if (!tryAllocateFrameRange(heaps, slot, size, alignment, range)) {
+    throw std::runtime_error("Frame upload segment out of memory");
+  }
+  return range;
+}
+
+#endif /* _H_RENDER_PIPELINE_WIN32_UPLOAD_HEAP */
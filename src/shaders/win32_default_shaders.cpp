@@ -40,5 +40,65 @@ const char* win32_shader = R"(
     }
 )";
 
+// Instanced hex tiles - slot 0 is the shared unit-height hex mesh, slot 1 is HexInstance per tile
+// Palette has to match HEX_PALETTE in hex/hex_instances.cpp
+const char* win32_instanced_shader = R"(
+    cbuffer ConstantBuffer : register(b0)
+    {
+        matrix world;
+        matrix view;
+        matrix projection;
+    };
+
+    static const float4 palette[8] =
+    {
+        float4(0.20f, 0.55f, 0.25f, 1.0f),
+        float4(0.30f, 0.65f, 0.30f, 1.0f),
+        float4(0.75f, 0.70f, 0.45f, 1.0f),
+        float4(0.55f, 0.45f, 0.30f, 1.0f),
+        float4(0.50f, 0.50f, 0.52f, 1.0f),
+        float4(0.90f, 0.92f, 0.95f, 1.0f),
+        float4(0.20f, 0.40f, 0.75f, 1.0f),
+        float4(0.15f, 0.30f, 0.60f, 1.0f)
+    };
+
+    struct VS_INPUT
+    {
+        float4 pos : POSITION;
+        float4 color : COLOR;
+        float2 offset : OFFSET;
+        float height : HEIGHT;
+        uint colorIndex : COLORINDEX;
+    };
+
+    struct PS_INPUT
+    {
+        float4 pos : SV_POSITION;
+        float4 color : COLOR;
+    };
+
+    PS_INPUT VSMain(VS_INPUT input)
+    {
+        PS_INPUT output;
+        // Shared mesh is one tile at the origin, y goes from 0 to 1
+        float4 pos = float4(input.pos.x + input.offset.x, input.pos.y * input.height, input.pos.z + input.offset.y, 1.0f);
+        pos = mul(pos, world);
+        pos = mul(pos, view);
+        pos = mul(pos, projection);
+        output.pos = pos;
+        // Mesh color only shades top vs sides, the tile color comes from the palette
+        output.color = input.color * palette[input.colorIndex % 8];
+        // Highlight glow in bits 8-15 lifts it towards white, HEX_GLOW_STRENGTH at full
+        float glow = (float)((input.colorIndex >> 8) & 0xff) * (0.6f / 255.0f);
+        output.color.rgb = lerp(output.color.rgb, float3(1.0f, 1.0f, 1.0f), glow);
+        return output;
+    }
+
+    float4 PSMain(PS_INPUT input) : SV_Target
+    {
+        return input.color;
+    }
+)";
+
 #endif /* _H_WIN32_DEFAULT_SHADERS */
 
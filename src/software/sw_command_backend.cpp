@@ -0,0 +1,126 @@
+#ifndef _H_SOFTWARE_SW_COMMAND_BACKEND
+#define _H_SOFTWARE_SW_COMMAND_BACKEND
+
+// Command streams through the software rasterizer - buffers are CPU copies filled by WRITE_BUFFER, so a
+// capture from a real session draws the same frames headless.
+#include "../render_pipeline/command_stream.cpp"
+#include "../graphics/vertex_formats.cpp"
+#include "sw_rasterizer.cpp"
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+struct SwCommandBackend : CommandBackend {
+  SwRasterizer* rasterizer = nullptr;
+  std::vector<uint8_t> buffers[COMMAND_MAX_BUFFERS];
+  uint64_t generation[COMMAND_MAX_BUFFERS] = {};  // Bumped on every write, decoded vertices go stale with it
+  SwMVP mvp = {};
+  CommandSetVertexBuffers vertex_buffers = {};
+  CommandBufferView index_buffer = {};
+  std::vector<SwVertex> decoded;
+  uint32_t decoded_buffer = UINT32_MAX;
+  uint32_t decoded_offset = 0;
+  uint64_t decoded_generation = 0;
+  size_t skipped = 0;  // Draws reading past what their views cover
+
+  // Views on bytes nobody wrote read zeros, like a fresh upload heap
+  const uint8_t* viewData(const CommandBufferView& view) {
+    std::vector<uint8_t>& buffer = buffers[view.buffer];
+    if (buffer.size() < (size_t)view.offset + view.size) buffer.resize((size_t)view.offset + view.size);
+    return buffer.data() + view.offset;
+  }
+
+  // Vertex stream 0 comes as VertexHalf from the window, SwVertex from headless scenes - told apart by stride
+  const SwVertex* vertices(const CommandBufferView& view) {
+    const uint8_t* data = viewData(view);
+    if (view.stride == sizeof(SwVertex) && view.offset % alignof(SwVertex) == 0) return reinterpret_cast<const SwVertex*>(data);
+    if (view.stride != sizeof(VertexHalf)) return nullptr;
+    if (decoded_buffer != view.buffer || decoded_offset != view.offset || decoded_generation != generation[view.buffer] ||
+        decoded.size() != view.size / view.stride) {
+      decoded.resize(view.size / view.stride);
+      for (size_t i = 0; i < decoded.size(); i++) {
+        VertexHalf v;
+        memcpy(&v, data + i * sizeof(VertexHalf), sizeof(v));
+        decoded[i].pos[0] = halfToFloat(v.pos.x);
+        decoded[i].pos[1] = halfToFloat(v.pos.y);
+        decoded[i].pos[2] = halfToFloat(v.pos.z);
+        for (int c = 0; c < 4; c++) decoded[i].color[c] = (float)((v.color.rgba >> (8 * c)) & 0xff) / 255.0f;
+      }
+      decoded_buffer = view.buffer;
+      decoded_offset = view.offset;
+      decoded_generation = generation[view.buffer];
+    }
+    return decoded.data();
+  }
+
+  void beginPass(const CommandBeginPass& pass) override {
+    swClear(*rasterizer, pass.clear);  // At the rasterizer's own size, whatever the capture ran at
+  }
+  void endPass() override {}
+  void setPipeline(uint32_t) override {}  // Only the instanced tile pipeline exists
+  void setConstants(uint32_t slot, const void* data, uint32_t size) override {
+    if (slot == 0) memcpy(&mvp, data, size < sizeof(mvp) ? size : sizeof(mvp));
+  }
+  void setVertexBuffers(const CommandSetVertexBuffers& buffers) override {
+    for (uint32_t i = 0; i < buffers.count; i++) vertex_buffers.views[buffers.first_slot + i] = buffers.views[i];
+    vertex_buffers.count = buffers.first_slot + buffers.count > vertex_buffers.count ? buffers.first_slot + buffers.count : vertex_buffers.count;
+  }
+  void setIndexBuffer(const CommandBufferView& view) override {
+    index_buffer = view;
+  }
+  void drawIndexed(const CommandDrawIndexed& draw) override {
+    const CommandBufferView& vertexView = vertex_buffers.views[0];
+    const CommandBufferView& instanceView = vertex_buffers.views[1];
+    if (vertex_buffers.count != 2 || instanceView.stride != sizeof(HexInstance) || index_buffer.stride == 0) {
+      skipped++;
+      return;
+    }
+    // Sized before any pointer is taken, views may share a buffer
+    viewData(index_buffer);
+    viewData(instanceView);
+    const SwVertex* mesh = vertices(vertexView);
+    const size_t vertexCount = vertexView.size / vertexView.stride;
+    if (mesh == nullptr || (size_t)draw.first_index + draw.index_count > index_buffer.size / index_buffer.stride ||
+        (size_t)draw.first_instance + draw.instance_count > instanceView.size / instanceView.stride ||
+        draw.base_vertex < 0 || (size_t)draw.base_vertex >= vertexCount) {
+      skipped++;
+      return;
+    }
+    // Captures come from disk - an index past the mesh would read past the buffer, not just draw garbage
+    const uint8_t* indices = viewData(index_buffer) + (size_t)draw.first_index * index_buffer.stride;
+    uint32_t maxIndex = 0;
+    for (uint32_t i = 0; i < draw.index_count; i++) {
+      uint32_t index;
+      if (index_buffer.stride == 4) {
+        memcpy(&index, indices + i * 4, 4);
+      } else {
+        uint16_t index16;
+        memcpy(&index16, indices + i * 2, 2);
+        index = index16;
+      }
+      maxIndex = index > maxIndex ? index : maxIndex;
+    }
+    if (draw.index_count > 0 && (size_t)draw.base_vertex + maxIndex >= vertexCount) {
+      skipped++;
+      return;
+    }
+    SwDraw sw = {};
+    sw.vertices = mesh + draw.base_vertex;
+    sw.indices = indices;
+    sw.indices_32bit = index_buffer.stride == 4;
+    sw.index_count = draw.index_count;
+    sw.instances = reinterpret_cast<const HexInstance*>(viewData(instanceView)) + draw.first_instance;
+    sw.instance_count = draw.instance_count;
+    swDraw(*rasterizer, sw, mvp);
+  }
+  void writeBuffer(uint32_t buffer, uint64_t offset, const void* data, uint32_t size) override {
+    if (offset > UINT32_MAX) return;  // Past anything a view can address
+    std::vector<uint8_t>& bytes = buffers[buffer];
+    if (bytes.size() < offset + size) bytes.resize((size_t)(offset + size));
+    memcpy(bytes.data() + offset, data, size);
+    generation[buffer]++;
+  }
+};
+
+#endif /* _H_SOFTWARE_SW_COMMAND_BACKEND */
@@ -0,0 +1,118 @@
+#ifndef _H_SOFTWARE_SW_IMAGE
+#define _H_SOFTWARE_SW_IMAGE
+
+// Frame dumps for the software rasterizer - RGBA8 pixels, red in the lowest byte.
+// PNG is written uncompressed (stored deflate blocks), good enough for diffing and no zlib needed.
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+bool swWritePPM(const char* path, const uint32_t* pixels, int width, int height, int stride) {
+  FILE* file = fopen(path, "wb");
+  if (file == nullptr) return false;
+
+  fprintf(file, "P6\n%d %d\n255\n", width, height);
+  std::vector<uint8_t> row((size_t)width * 3);
+  for (int y = 0; y < height; y++) {
+    for (int x = 0; x < width; x++) {
+      uint32_t c = pixels[(size_t)y * stride + x];
+      row[x * 3 + 0] = (uint8_t)(c & 0xff);
+      row[x * 3 + 1] = (uint8_t)((c >> 8) & 0xff);
+      row[x * 3 + 2] = (uint8_t)((c >> 16) & 0xff);
+    }
+    fwrite(row.data(), 1, row.size(), file);
+  }
+
+  bool ok = ferror(file) == 0;
+  fclose(file);
+  return ok;
+}
+
+static uint32_t swCrc32(const uint8_t* data, size_t size, uint32_t crc = 0) {
+  static uint32_t table[256];
+  static bool tableReady = false;
+  if (!tableReady) {
+    for (uint32_t n = 0; n < 256; n++) {
+      uint32_t c = n;
+      for (int k = 0; k < 8; k++) c = (c & 1) ? 0xedb88320u ^ (c >> 1) : c >> 1;
+      table[n] = c;
+    }
+    tableReady = true;
+  }
+  crc = ~crc;
+  for (size_t i = 0; i < size; i++) crc = table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+  return ~crc;
+}
+
+static void swPushBigEndian(std::vector<uint8_t>& out, uint32_t value) {
+  out.push_back((uint8_t)(value >> 24));
+  out.push_back((uint8_t)(value >> 16));
+  out.push_back((uint8_t)(value >> 8));
+  out.push_back((uint8_t)value);
+}
+
+static void swPngChunk(FILE* file, const char* type, const std::vector<uint8_t>& data) {
+  std::vector<uint8_t> chunk;
+  swPushBigEndian(chunk, (uint32_t)data.size());
+  chunk.insert(chunk.end(), type, type + 4);
+  chunk.insert(chunk.end(), data.begin(), data.end());
+  swPushBigEndian(chunk, swCrc32(chunk.data() + 4, chunk.size() - 4));
+  fwrite(chunk.data(), 1, chunk.size(), file);
+}
+
+bool swWritePNG(const char* path, const uint32_t* pixels, int width, int height, int stride) {
+  FILE* file = fopen(path, "wb");
+  if (file == nullptr) return false;
+
+  static const uint8_t signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+  fwrite(signature, 1, sizeof(signature), file);
+
+  std::vector<uint8_t> header;
+  swPushBigEndian(header, (uint32_t)width);
+  swPushBigEndian(header, (uint32_t)height);
+  header.push_back(8);  // Bit depth
+  header.push_back(6);  // RGBA
+  header.push_back(0);  // Deflate
+  header.push_back(0);  // Adaptive filtering
+  header.push_back(0);  // No interlace
+  swPngChunk(file, "IHDR", header);
+
+  // Raw scanlines, filter type 0 in front of each row
+  std::vector<uint8_t> raw;
+  raw.reserve((size_t)height * ((size_t)width * 4 + 1));
+  for (int y = 0; y < height; y++) {
+    raw.push_back(0);
+    const uint8_t* row = reinterpret_cast<const uint8_t*>(pixels + (size_t)y * stride);
+    raw.insert(raw.end(), row, row + (size_t)width * 4);
+  }
+
+  // zlib stream made of stored blocks, 65535 bytes max each
+  std::vector<uint8_t> zlib;
+  zlib.push_back(0x78);
+  zlib.push_back(0x01);
+  uint32_t adlerA = 1, adlerB = 0;
+  for (size_t offset = 0; offset < raw.size() || raw.empty(); ) {
+    size_t size = raw.size() - offset < 65535 ? raw.size() - offset : 65535;
+    zlib.push_back(offset + size == raw.size() ? 1 : 0);
+    zlib.push_back((uint8_t)(size & 0xff));
+    zlib.push_back((uint8_t)(size >> 8));
+    zlib.push_back((uint8_t)(~size & 0xff));
+    zlib.push_back((uint8_t)((~size >> 8) & 0xff));
+    for (size_t i = 0; i < size; i++) {
+      adlerA = (adlerA + raw[offset + i]) % 65521;
+      adlerB = (adlerB + adlerA) % 65521;
+    }
+    zlib.insert(zlib.end(), raw.begin() + offset, raw.begin() + offset + size);
+    offset += size;
+    if (raw.empty()) break;
+  }
+  swPushBigEndian(zlib, (adlerB << 16) | adlerA);
+  swPngChunk(file, "IDAT", zlib);
+  swPngChunk(file, "IEND", std::vector<uint8_t>());
+
+  bool ok = ferror(file) == 0;
+  fclose(file);
+  return ok;
+}
+
+#endif /* _H_SOFTWARE_SW_IMAGE */
@@ -0,0 +1,318 @@
+#ifndef _H_SOFTWARE_SW_OCCLUSION
+#define _H_SOFTWARE_SW_OCCLUSION
+
+// Low resolution depth-only rasterizer for occlusion culling - a handful of big occluder boxes go in,
+// a max-depth pyramid (HiZ) comes out, and bounding boxes are tested against it before anything is drawn.
+//
+// Same conventions as sw_rasterizer.cpp: row-major world * view * projection for row vectors, depth 0 near
+// and 1 far, pixel centers at +0.5. Everything here errs on the side of "visible" - boxes crossing the near
+// plane always pass the test, and pixels no occluder covers stay at the far plane.
+#include "../core/simd.cpp"
+#include "../core/memory.cpp"
+#include "../core/timer.cpp"
+
+#include <cstdint>
+#include <cstring>
+
+constexpr int OCCLUSION_MAX_LEVELS = 16;
+constexpr int OCCLUSION_TEST_TEXELS = 256;  // Test footprint per side, the level is picked so a box covers at most this many
+
+typedef struct OcclusionStats {
+  size_t occluders = 0;
+  size_t triangles = 0;
+  size_t tested = 0;
+  size_t occluded = 0;
+  double raster_ms = 0.0;
+  double test_ms = 0.0;       // HiZ build included
+} OcclusionStats;
+
+typedef struct OcclusionBuffer {
+  int width = 0;
+  int height = 0;
+  int stride = 0;                                 // Row pitch of level 0 in floats, width rounded up to 4
+  int levels = 0;
+  float* depth = nullptr;                         // Level 0, owns the whole pyramid
+  float* level[OCCLUSION_MAX_LEVELS] = {};        // Level i is the max of 2x2 texels of level i - 1
+  int level_width[OCCLUSION_MAX_LEVELS] = {};
+  int level_height[OCCLUSION_MAX_LEVELS] = {};
+  OcclusionStats stats;
+} OcclusionBuffer;
+
+void destroyOcclusionBuffer(OcclusionBuffer& buffer) {
+  alignedFree(buffer.depth);
+  buffer = {};
+}
+
+bool createOcclusionBuffer(OcclusionBuffer& buffer, int width, int height) {
+  if (width <= 0 || height <= 0) return false;
+
+  buffer = {};
+  buffer.width = width;
+  buffer.height = height;
+  buffer.stride = (width + 3) & ~3;
+  size_t total = (size_t)buffer.stride * height;
+  int w = width, h = height;
+  buffer.level_width[0] = w;
+  buffer.level_height[0] = h;
+  buffer.levels = 1;
+  while ((w > 1 || h > 1) && buffer.levels < OCCLUSION_MAX_LEVELS) {
+    w = (w + 1) / 2;
+    h = (h + 1) / 2;
+    buffer.level_width[buffer.levels] = w;
+    buffer.level_height[buffer.levels] = h;
+    total += (size_t)w * h;
+    buffer.levels++;
+  }
+
+  buffer.depth = (float*)alignedAlloc(total * sizeof(float));
+  if (!buffer.depth) {
+    destroyOcclusionBuffer(buffer);
+    return false;
+  }
+  buffer.level[0] = buffer.depth;
+  float* next = buffer.depth + (size_t)buffer.stride * height;
+  for (int i = 1; i < buffer.levels; i++) {
+    buffer.level[i] = next;
+    next += (size_t)buffer.level_width[i] * buffer.level_height[i];
+  }
+  return true;
+}
+
+void clearOcclusionBuffer(OcclusionBuffer& buffer) {
+  const size_t pixels = (size_t)buffer.stride * buffer.height;
+  for (size_t i = 0; i < pixels; i++) buffer.depth[i] = 1.0f;
+}
+
+typedef struct OcclusionVertex {
+  float x, y, z;  // Screen pixels and depth
+} OcclusionVertex;
+
+// Depth-only, nearest wins. Strictly inside pixels only, so shared edges may leave a pixel at the far
+// plane - that only ever makes the buffer more conservative.
+static void occlusionRasterizeTriangle(OcclusionBuffer& buffer, const OcclusionVertex& v0, const OcclusionVertex& v1, const OcclusionVertex& v2) {
+  // Clockwise with y down is front facing, same as the D3D12 pipeline - boxes only need their front faces
+  const float area = (v1.x - v0.x) * (v2.y - v0.y) - (v1.y - v0.y) * (v2.x - v0.x);
+  if (!(area > 0.0f)) return;
+
+  float minX = v0.x < v1.x ? v0.x : v1.x; minX = v2.x < minX ? v2.x : minX;
+  float maxX = v0.x > v1.x ? v0.x : v1.x; maxX = v2.x > maxX ? v2.x : maxX;
+  float minY = v0.y < v1.y ? v0.y : v1.y; minY = v2.y < minY ? v2.y : minY;
+  float maxY = v0.y > v1.y ? v0.y : v1.y; maxY = v2.y > maxY ? v2.y : maxY;
+  if (maxX < 0.0f || maxY < 0.0f || minX >= (float)buffer.width || minY >= (float)buffer.height) return;
+  const int x0 = (minX < 0.0f ? 0 : (int)minX) & ~3;
+  const int y0 = minY < 0.0f ? 0 : (int)minY;
+  const int x1 = maxX >= (float)buffer.width ? buffer.width - 1 : (int)maxX;
+  const int y1 = maxY >= (float)buffer.height ? buffer.height - 1 : (int)maxY;
+
+  // Edge i is zero on the edge opposite vertex i, positive inside
+  const OcclusionVertex* v[3] = { &v0, &v1, &v2 };
+  float ea[3], eb[3], ec[3];
+  for (int i = 0; i < 3; i++) {
+    const OcclusionVertex& a = *v[(i + 1) % 3];
+    const OcclusionVertex& b = *v[(i + 2) % 3];
+    const float dx = b.x - a.x, dy = b.y - a.y;
+    ea[i] = -dy;
+    eb[i] = dx;
+    ec[i] = dy * a.x - dx * a.y;
+  }
+  // Depth is affine in screen space - z = base + dzdx * x + dzdy * y
+  const float invArea = 1.0f / area;
+  const float dzdx = (ea[1] * (v1.z - v0.z) + ea[2] * (v2.z - v0.z)) * invArea;
+  const float dzdy = (eb[1] * (v1.z - v0.z) + eb[2] * (v2.z - v0.z)) * invArea;
+  const float zBase = v0.z + (ec[1] * (v1.z - v0.z) + ec[2] * (v2.z - v0.z)) * invArea;
+
+#if defined(HEX_SIMD_SSE)
+  const __m128 zero = _mm_setzero_ps();
+  const __m128 laneX = _mm_set_ps(3.5f, 2.5f, 1.5f, 0.5f);
+  const __m128i laneIndex = _mm_set_epi32(3, 2, 1, 0);
+  const __m128 a0 = _mm_set1_ps(ea[0]), a1 = _mm_set1_ps(ea[1]), a2 = _mm_set1_ps(ea[2]);
+  const __m128 zdx = _mm_set1_ps(dzdx);
+  for (int y = y0; y <= y1; y++) {
+    const float py = (float)y + 0.5f;
+    const __m128 c0 = _mm_set1_ps(eb[0] * py + ec[0]);
+    const __m128 c1 = _mm_set1_ps(eb[1] * py + ec[1]);
+    const __m128 c2 = _mm_set1_ps(eb[2] * py + ec[2]);
+    const __m128 zRow = _mm_set1_ps(zBase + dzdy * py);
+    float* row = buffer.depth + (size_t)y * buffer.stride;
+    for (int x = x0; x <= x1; x += 4) {
+      const __m128 px = _mm_add_ps(_mm_set1_ps((float)x), laneX);
+      __m128 inside = _mm_castsi128_ps(_mm_cmplt_epi32(_mm_add_epi32(_mm_set1_epi32(x), laneIndex), _mm_set1_epi32(x1 + 1)));
+      inside = _mm_and_ps(inside, _mm_cmpgt_ps(_mm_add_ps(_mm_mul_ps(a0, px), c0), zero));
+      inside = _mm_and_ps(inside, _mm_cmpgt_ps(_mm_add_ps(_mm_mul_ps(a1, px), c1), zero));
+      inside = _mm_and_ps(inside, _mm_cmpgt_ps(_mm_add_ps(_mm_mul_ps(a2, px), c2), zero));
+      if (_mm_movemask_ps(inside) == 0) continue;
+      const __m128 z = _mm_add_ps(zRow, _mm_mul_ps(zdx, px));
+      const __m128 depth = _mm_loadu_ps(row + x);
+      _mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, _mm_min_ps(z, depth)), _mm_andnot_ps(inside, depth)));
+    }
+  }
+#else
+  for (int y = y0; y <= y1; y++) {
+    const float py = (float)y + 0.5f;
+    float* row = buffer.depth + (size_t)y * buffer.stride;
+    for (int x = x0; x <= x1; x++) {
+      const float px = (float)x + 0.5f;
+      if (!(ea[0] * px + eb[0] * py + ec[0] > 0.0f) || !(ea[1] * px + eb[1] * py + ec[1] > 0.0f) ||
+          !(ea[2] * px + eb[2] * py + ec[2] > 0.0f)) continue;
+      const float z = zBase + dzdx * px + dzdy * py;
+      if (z < row[x]) row[x] = z;
+    }
+  }
+#endif
+}
+
+// Box corner i has x from bit 0, y from bit 1, z from bit 2. False when any corner is behind the eye or
+// in front of the near plane - the projected box would be wrong there.
+static bool occlusionProjectBox(const OcclusionBuffer& buffer, const float m[16], const float boxMin[3], const float boxMax[3], OcclusionVertex out[8]) {
+  for (int i = 0; i < 8; i++) {
+    const float x = (i & 1) ? boxMax[0] : boxMin[0];
+    const float y = (i & 2) ? boxMax[1] : boxMin[1];
+    const float z = (i & 4) ? boxMax[2] : boxMin[2];
+    const float cw = x * m[3] + y * m[7] + z * m[11] + m[15];
+    const float cz = x * m[2] + y * m[6] + z * m[10] + m[14];
+    if (cw <= 1e-6f || cz < 0.0f) return false;
+    const float invW = 1.0f / cw;
+    out[i].x = ((x * m[0] + y * m[4] + z * m[8] + m[12]) * invW * 0.5f + 0.5f) * (float)buffer.width;
+    out[i].y = (0.5f - (x * m[1] + y * m[5] + z * m[9] + m[13]) * invW * 0.5f) * (float)buffer.height;
+    out[i].z = cz * invW;
+  }
+  return true;
+}
+
+typedef struct OcclusionClipVertex {
+  float x, y, z, w;
+} OcclusionClipVertex;
+
+static inline OcclusionVertex occlusionViewport(const OcclusionBuffer& buffer, const OcclusionClipVertex& v) {
+  const float invW = 1.0f / v.w;
+  return { (v.x * invW * 0.5f + 0.5f) * (float)buffer.width, (0.5f - v.y * invW * 0.5f) * (float)buffer.height, v.z * invW };
+}
+
+// Faces of an occluder box, the bottom one is never drawn
+enum {
+  OCCLUSION_FACE_NEG_X = 1 << 0,
+  OCCLUSION_FACE_POS_X = 1 << 1,
+  OCCLUSION_FACE_TOP = 1 << 2,
+  OCCLUSION_FACE_NEG_Z = 1 << 3,
+  OCCLUSION_FACE_POS_Z = 1 << 4,
+  OCCLUSION_FACE_ALL = 0x1f,
+};
+
+// Solid box as an occluder, bottom face left out - occluders stand on the ground, nothing looks at them from below.
+// Faces crossing the near plane are clipped against it, the closest occluders are the ones that hide the most.
+// faceMask drops sides that are known to be buried in a neighbouring occluder.
+void rasterizeOccluderBox(OcclusionBuffer& buffer, const float worldViewProjection[16], const float boxMin[3], const float boxMax[3],
+                          unsigned faceMask = OCCLUSION_FACE_ALL) {
+  // Wound clockwise seen from outside the box, so back faces drop out in setup. Same order as the face bits.
+  static const uint8_t faces[5][4] = {
+    { 0, 4, 6, 2 },  // -x
+    { 1, 3, 7, 5 },  // +x
+    { 2, 6, 7, 3 },  // +y
+    { 0, 2, 3, 1 },  // -z
+    { 4, 5, 7, 6 },  // +z
+  };
+  const float* m = worldViewProjection;
+  OcclusionClipVertex clip[8];
+  int inFront = 0;
+  for (int i = 0; i < 8; i++) {
+    const float x = (i & 1) ? boxMax[0] : boxMin[0];
+    const float y = (i & 2) ? boxMax[1] : boxMin[1];
+    const float z = (i & 4) ? boxMax[2] : boxMin[2];
+    clip[i] = { x * m[0] + y * m[4] + z * m[8] + m[12], x * m[1] + y * m[5] + z * m[9] + m[13],
+                x * m[2] + y * m[6] + z * m[10] + m[14], x * m[3] + y * m[7] + z * m[11] + m[15] };
+    inFront += clip[i].z >= 0.0f && clip[i].w > 1e-6f ? 1 : 0;
+  }
+  if (inFront == 0) return;
+
+  OcclusionVertex corners[8];
+  if (inFront == 8) {
+    for (int i = 0; i < 8; i++) corners[i] = occlusionViewport(buffer, clip[i]);
+  }
+  for (int f = 0; f < 5; f++) {
+    if ((faceMask & (1u << f)) == 0) continue;
+    const uint8_t* q = faces[f];
+    if (inFront == 8) {
+      occlusionRasterizeTriangle(buffer, corners[q[0]], corners[q[1]], corners[q[2]]);
+      occlusionRasterizeTriangle(buffer, corners[q[0]], corners[q[2]], corners[q[3]]);
+      buffer.stats.triangles += 2;
+      continue;
+    }
+    // Sutherland-Hodgman against z >= 0, a quad comes out with at most 5 corners. With a perspective
+    // projection z >= 0 puts the point past the near plane, so w is positive for everything kept.
+    OcclusionVertex polygon[5];
+    int count = 0;
+    for (int i = 0; i < 4; i++) {
+      const OcclusionClipVertex& a = clip[q[i]];
+      const OcclusionClipVertex& b = clip[q[(i + 1) & 3]];
+      if (a.z >= 0.0f) polygon[count++] = occlusionViewport(buffer, a);
+      if ((a.z >= 0.0f) != (b.z >= 0.0f)) {
+        const float t = a.z / (a.z - b.z);
+        const OcclusionClipVertex c = { a.x + (b.x - a.x) * t, a.y + (b.y - a.y) * t, 0.0f, a.w + (b.w - a.w) * t };
+        if (c.w > 1e-6f) polygon[count++] = occlusionViewport(buffer, c);
+      }
+    }
+    for (int i = 2; i < count; i++) {
+      occlusionRasterizeTriangle(buffer, polygon[0], polygon[i - 1], polygon[i]);
+      buffer.stats.triangles++;
+    }
+  }
+  buffer.stats.occluders++;
+}
+
+// Max pyramid over the rasterized depth, call once after the last occluder and before the first test
+void buildOcclusionHiZ(OcclusionBuffer& buffer) {
+  for (int l = 1; l < buffer.levels; l++) {
+    const float* src = buffer.level[l - 1];
+    const int srcW = buffer.level_width[l - 1], srcH = buffer.level_height[l - 1];
+    const int srcStride = l == 1 ? buffer.stride : srcW;
+    float* dst = buffer.level[l];
+    const int w = buffer.level_width[l], h = buffer.level_height[l];
+    for (int y = 0; y < h; y++) {
+      const float* r0 = src + (size_t)(2 * y) * srcStride;
+      const float* r1 = src + (size_t)(2 * y + 1 < srcH ? 2 * y + 1 : 2 * y) * srcStride;
+      for (int x = 0; x < w; x++) {
+        const int x0 = 2 * x, x1 = 2 * x + 1 < srcW ? 2 * x + 1 : 2 * x;
+        float m = r0[x0] > r0[x1] ? r0[x0] : r0[x1];
+        m = r1[x0] > m ? r1[x0] : m;
+        m = r1[x1] > m ? r1[x1] : m;
+        dst[(size_t)y * w + x] = m;
+      }
+    }
+  }
+}
+
+// True unless the whole box is behind what has been rasterized - its nearest depth against the farthest
+// occluder depth in every HiZ texel its screen rectangle touches.
+bool occlusionTestBox(OcclusionBuffer& buffer, const float worldViewProjection[16], const float boxMin[3], const float boxMax[3]) {
+  buffer.stats.tested++;
+  OcclusionVertex corners[8];
+  if (!occlusionProjectBox(buffer, worldViewProjection, boxMin, boxMax, corners)) return true;
+
+  float minX = corners[0].x, maxX = corners[0].x, minY = corners[0].y, maxY = corners[0].y, minZ = corners[0].z;
+  for (int i = 1; i < 8; i++) {
+    minX = corners[i].x < minX ? corners[i].x : minX; maxX = corners[i].x > maxX ? corners[i].x : maxX;
+    minY = corners[i].y < minY ? corners[i].y : minY; maxY = corners[i].y > maxY ? corners[i].y : maxY;
+    minZ = corners[i].z < minZ ? corners[i].z : minZ;
+  }
+  // Fully off screen means the frustum test let it through on a corner case, nothing here can say more
+  if (maxX < 0.0f || maxY < 0.0f || minX >= (float)buffer.width || minY >= (float)buffer.height) return true;
+  int x0 = minX < 0.0f ? 0 : (int)minX;
+  int y0 = minY < 0.0f ? 0 : (int)minY;
+  int x1 = maxX >= (float)buffer.width ? buffer.width - 1 : (int)maxX;
+  int y1 = maxY >= (float)buffer.height ? buffer.height - 1 : (int)maxY;
+
+  int l = 0;
+  while (l + 1 < buffer.levels && ((x1 >> l) - (x0 >> l) >= OCCLUSION_TEST_TEXELS || (y1 >> l) - (y0 >> l) >= OCCLUSION_TEST_TEXELS)) l++;
+  x0 >>= l; x1 >>= l; y0 >>= l; y1 >>= l;
+  const float* level = buffer.level[l];
+  const int stride = l == 0 ? buffer.stride : buffer.level_width[l];
+  for (int y = y0; y <= y1; y++) {
+    for (int x = x0; x <= x1; x++) {
+      if (level[(size_t)y * stride + x] >= minZ) return true;
+    }
+  }
+  buffer.stats.occluded++;
+  return false;
+}
+
+#endif /* _H_SOFTWARE_SW_OCCLUSION */
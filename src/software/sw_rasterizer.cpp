@@ -0,0 +1,378 @@
+#ifndef _H_SOFTWARE_SW_RASTERIZER
+#define _H_SOFTWARE_SW_RASTERIZER
+
+// CPU rasterizer backend for headless rendering - takes the same vertex/index/instance/MVP data
+// the D3D12 path uploads and follows the same rules (clockwise front faces, back face culling,
+// no depth test unless asked for), so frames can be screenshot-diffed on boxes without a GPU.
+//
+// Every draw goes through three stages:
+//   1. transform + setup + binning - triangles split evenly across threads, each thread bins its
+//      own triangles into screen tiles, so submission order stays intact per tile
+//   2. rasterization - tiles handed out to threads, 4 pixels at a time with SIMD edge functions
+//   3. nothing to merge - tiles never overlap, so the same frame comes out for any thread count
+#include "../core/simd.cpp"
+#include "../core/memory.cpp"
+#include "../core/timer.cpp"
+#include "../core/simd_math.cpp"
+#include "../core/parallel.cpp"
+#include "../hex/hex_instances.cpp"
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+constexpr int SW_TILE_SIZE = 64; // Multiple of 4, rows inside a tile are walked 4 pixels at a time
+
+// Same layout as Vertex in win32_primitives.cpp (Float3 + Float4)
+typedef struct SwVertex {
+  float pos[3];
+  float color[4];
+} SwVertex;
+
+static_assert(sizeof(SwVertex) == 28, "SwVertex has to match Vertex");
+
+// Same bytes as MVPMatrix after onUpdate transposes it for the shader - column-major matrices
+typedef struct SwMVP {
+  float world[16];
+  float view[16];
+  float projection[16];
+} SwMVP;
+
+typedef struct SwDraw {
+  const SwVertex* vertices = nullptr;
+  const void* indices = nullptr;
+  bool indices_32bit = false;        // false - unsigned short like cubeIndices and DXGI_FORMAT_R16_UINT
+  size_t index_count = 0;
+  const HexInstance* instances = nullptr;  // Optional, same stream and math as win32_instanced_shader
+  size_t instance_count = 0;
+} SwDraw;
+
+typedef struct SwStats {
+  size_t triangles_in = 0;
+  size_t triangles_binned = 0;
+  double setup_ms = 0.0;
+  double raster_ms = 0.0;
+} SwStats;
+
+// Screen space triangle ready for rasterization, edge function i is zero on the edge opposite vertex i
+typedef struct SwTriangle {
+  float edge_a[3], edge_b[3], edge_c[3];  // w_i(x, y) = a * x + b * y + c
+  bool top_left[3];
+  float inv_area;
+  float z[3];
+  float inv_w[3];
+  float color_w[3][4];                    // Color already divided by w, for perspective-correct interpolation
+  int min_x, min_y, max_x, max_y;
+} SwTriangle;
+
+typedef struct SwRasterizer {
+  int width = 0;
+  int height = 0;
+  int stride = 0;                 // Row pitch in pixels, width rounded up to 4
+  uint32_t* color = nullptr;      // RGBA8, red in the lowest byte like DXGI_FORMAT_R8G8B8A8_UNORM
+  float* depth = nullptr;
+  bool depth_test = false;        // PSO has DepthEnable FALSE, so off by default
+  int threads = 1;
+  int tiles_x = 0;
+  int tiles_y = 0;
+  std::vector<std::vector<SwTriangle>> triangles;       // [thread]
+  std::vector<std::vector<uint32_t>> bins;              // [thread * tile count + tile]
+  SwStats stats;
+} SwRasterizer;
+
+void destroySwRasterizer(SwRasterizer& rasterizer) {
+  alignedFree(rasterizer.color);
+  alignedFree(rasterizer.depth);
+  rasterizer = {};
+}
+
+bool createSwRasterizer(SwRasterizer& rasterizer, int width, int height, int threads) {
+  if (width <= 0 || height <= 0) return false;
+
+  rasterizer = {};
+  rasterizer.width = width;
+  rasterizer.height = height;
+  rasterizer.stride = (width + 3) & ~3;
+  rasterizer.threads = threads < 1 ? 1 : threads;
+  rasterizer.tiles_x = (width + SW_TILE_SIZE - 1) / SW_TILE_SIZE;
+  rasterizer.tiles_y = (height + SW_TILE_SIZE - 1) / SW_TILE_SIZE;
+  // Last tile of a row may run past width to the next multiple of 4, stride covers that
+  size_t pixels = (size_t)rasterizer.stride * height;
+  rasterizer.color = (uint32_t*)alignedAlloc(pixels * sizeof(uint32_t));
+  rasterizer.depth = (float*)alignedAlloc(pixels * sizeof(float));
+  if (!rasterizer.color || !rasterizer.depth) {
+    destroySwRasterizer(rasterizer);
+    return false;
+  }
+  rasterizer.triangles.resize(rasterizer.threads);
+  rasterizer.bins.resize((size_t)rasterizer.threads * rasterizer.tiles_x * rasterizer.tiles_y);
+  return true;
+}
+
+static uint32_t swPackColor(const float c[4]) {
+  uint32_t out = 0;
+  for (int i = 0; i < 4; i++) {
+    float v = c[i] < 0.0f ? 0.0f : (c[i] > 1.0f ? 1.0f : c[i]);
+    out |= (uint32_t)(v * 255.0f + 0.5f) << (8 * i);
+  }
+  return out;
+}
+
+void swClear(SwRasterizer& rasterizer, const float clear[4]) {
+  const uint32_t packed = swPackColor(clear);
+  const size_t pixels = (size_t)rasterizer.stride * rasterizer.height;
+  for (size_t i = 0; i < pixels; i++) {
+    rasterizer.color[i] = packed;
+    rasterizer.depth[i] = 1.0f;
+  }
+}
+
+// world * view * projection as one row-major matrix for row vectors, from the transposed shader copies
+static void swCombineMVP(const SwMVP& mvp, float out[16]) {
+  Mat4 world, view, projection;
+  memcpy(world.m, mvp.world, sizeof(world.m));
+  memcpy(view.m, mvp.view, sizeof(view.m));
+  memcpy(projection.m, mvp.projection, sizeof(projection.m));
+  const Mat4 combined = mat4Transpose(world) * mat4Transpose(view) * mat4Transpose(projection);
+  memcpy(out, combined.m, sizeof(combined.m));
+}
+
+typedef struct SwClipVertex {
+  float x, y, z, w;
+  float color[4];
+} SwClipVertex;
+
+static inline SwClipVertex swTransformVertex(const SwDraw& draw, const float m[16], uint32_t index, size_t instance) {
+  const SwVertex& in = draw.vertices[index];
+  float x = in.pos[0], y = in.pos[1], z = in.pos[2];
+  SwClipVertex out;
+  memcpy(out.color, in.color, sizeof(out.color));
+  if (draw.instances != nullptr) {
+    // Same as VSMain in win32_instanced_shader
+    const HexInstance& inst = draw.instances[instance];
+    x += inst.offset_x;
+    y *= inst.height;
+    z += inst.offset_z;
+    const float* tint = HEX_PALETTE[inst.color_index % HEX_PALETTE_SIZE];
+    for (int i = 0; i < 4; i++) out.color[i] *= tint[i];
+    const float glow = hexTileGlow(inst.color_index);
+    for (int i = 0; i < 3; i++) out.color[i] += (1.0f - out.color[i]) * glow;
+  }
+  out.x = x * m[0] + y * m[4] + z * m[8] + m[12];
+  out.y = x * m[1] + y * m[5] + z * m[9] + m[13];
+  out.z = x * m[2] + y * m[6] + z * m[10] + m[14];
+  out.w = x * m[3] + y * m[7] + z * m[11] + m[15];
+  return out;
+}
+
+// Returns false for triangles that produce no pixels. Triangles crossing the near plane are dropped
+// instead of clipped - the hex plane camera never gets close enough for that to show.
+static bool swSetupTriangle(const SwClipVertex v[3], int width, int height, SwTriangle& tri) {
+  float sx[3], sy[3];
+  for (int i = 0; i < 3; i++) {
+    if (v[i].w <= 1e-6f || v[i].z < 0.0f) return false;
+    float invW = 1.0f / v[i].w;
+    // Viewport transform, y goes down on screen
+    sx[i] = (v[i].x * invW * 0.5f + 0.5f) * (float)width;
+    sy[i] = (0.5f - v[i].y * invW * 0.5f) * (float)height;
+    tri.z[i] = v[i].z * invW;
+    tri.inv_w[i] = invW;
+    for (int c = 0; c < 4; c++) tri.color_w[i][c] = v[i].color[c] * invW;
+  }
+
+  // Clockwise on screen is front facing (FrontCounterClockwise FALSE), with y down that is positive area
+  float area = (sx[1] - sx[0]) * (sy[2] - sy[0]) - (sy[1] - sy[0]) * (sx[2] - sx[0]);
+  if (!(area > 0.0f)) return false;
+
+  float minX = sx[0], maxX = sx[0], minY = sy[0], maxY = sy[0];
+  for (int i = 1; i < 3; i++) {
+    minX = sx[i] < minX ? sx[i] : minX; maxX = sx[i] > maxX ? sx[i] : maxX;
+    minY = sy[i] < minY ? sy[i] : minY; maxY = sy[i] > maxY ? sy[i] : maxY;
+  }
+  if (maxX < 0.0f || maxY < 0.0f || minX >= (float)width || minY >= (float)height) return false;
+  tri.min_x = minX < 0.0f ? 0 : (int)minX;
+  tri.min_y = minY < 0.0f ? 0 : (int)minY;
+  tri.max_x = maxX >= (float)width ? width - 1 : (int)maxX;
+  tri.max_y = maxY >= (float)height ? height - 1 : (int)maxY;
+
+  // Edge i goes from vertex i+1 to vertex i+2, positive inside
+  for (int i = 0; i < 3; i++) {
+    int a = (i + 1) % 3, b = (i + 2) % 3;
+    float dx = sx[b] - sx[a], dy = sy[b] - sy[a];
+    tri.edge_a[i] = -dy;
+    tri.edge_b[i] = dx;
+    tri.edge_c[i] = dy * sx[a] - dx * sy[a];
+    // Top-left fill rule - top edge runs right, left edge runs up (clockwise, y down)
+    tri.top_left[i] = (dy == 0.0f && dx > 0.0f) || dy < 0.0f;
+  }
+  tri.inv_area = 1.0f / area;
+  return true;
+}
+
+static void swRasterizeTriangle(SwRasterizer& rs, const SwTriangle& tri, int tileX0, int tileY0, int tileX1, int tileY1) {
+  const int x0 = (tri.min_x > tileX0 ? tri.min_x : tileX0) & ~3;
+  const int x1 = tri.max_x < tileX1 ? tri.max_x : tileX1;
+  const int y0 = tri.min_y > tileY0 ? tri.min_y : tileY0;
+  const int y1 = tri.max_y < tileY1 ? tri.max_y : tileY1;
+
+#if defined(HEX_SIMD_SSE)
+  const __m128 zero = _mm_setzero_ps();
+  const __m128 one = _mm_set1_ps(1.0f);
+  const __m128 laneX = _mm_set_ps(3.5f, 2.5f, 1.5f, 0.5f);
+  const __m128i laneIndex = _mm_set_epi32(3, 2, 1, 0);
+  __m128 a[3], topLeft[3];
+  for (int e = 0; e < 3; e++) {
+    a[e] = _mm_set1_ps(tri.edge_a[e]);
+    topLeft[e] = _mm_castsi128_ps(_mm_set1_epi32(tri.top_left[e] ? -1 : 0));
+  }
+  const __m128 invArea = _mm_set1_ps(tri.inv_area);
+  const __m128 z0 = _mm_set1_ps(tri.z[0]), dz1 = _mm_set1_ps(tri.z[1] - tri.z[0]), dz2 = _mm_set1_ps(tri.z[2] - tri.z[0]);
+  const __m128 iw0 = _mm_set1_ps(tri.inv_w[0]), diw1 = _mm_set1_ps(tri.inv_w[1] - tri.inv_w[0]), diw2 = _mm_set1_ps(tri.inv_w[2] - tri.inv_w[0]);
+  __m128 c0[4], dc1[4], dc2[4];
+  for (int c = 0; c < 4; c++) {
+    c0[c] = _mm_set1_ps(tri.color_w[0][c]);
+    dc1[c] = _mm_set1_ps(tri.color_w[1][c] - tri.color_w[0][c]);
+    dc2[c] = _mm_set1_ps(tri.color_w[2][c] - tri.color_w[0][c]);
+  }
+  const __m128 scale = _mm_set1_ps(255.0f);
+  const __m128 half = _mm_set1_ps(0.5f);
+
+  for (int y = y0; y <= y1; y++) {
+    const float py = (float)y + 0.5f;
+    uint32_t* colorRow = rs.color + (size_t)y * rs.stride;
+    float* depthRow = rs.depth + (size_t)y * rs.stride;
+    for (int x = x0; x <= x1; x += 4) {
+      const __m128 px = _mm_add_ps(_mm_set1_ps((float)x), laneX);
+      __m128 w[3];
+      __m128 inside = _mm_castsi128_ps(_mm_cmplt_epi32(_mm_add_epi32(_mm_set1_epi32(x), laneIndex), _mm_set1_epi32(x1 + 1)));
+      for (int e = 0; e < 3; e++) {
+        w[e] = _mm_add_ps(_mm_mul_ps(a[e], px), _mm_set1_ps(tri.edge_b[e] * py + tri.edge_c[e]));
+        __m128 edgeInside = _mm_or_ps(_mm_cmpgt_ps(w[e], zero), _mm_and_ps(_mm_cmpeq_ps(w[e], zero), topLeft[e]));
+        inside = _mm_and_ps(inside, edgeInside);
+      }
+      if (_mm_movemask_ps(inside) == 0) continue;
+
+      const __m128 b1 = _mm_mul_ps(w[1], invArea);
+      const __m128 b2 = _mm_mul_ps(w[2], invArea);
+      if (rs.depth_test) {
+        __m128 z = _mm_add_ps(z0, _mm_add_ps(_mm_mul_ps(b1, dz1), _mm_mul_ps(b2, dz2)));
+        __m128 depth = _mm_loadu_ps(depthRow + x);
+        inside = _mm_and_ps(inside, _mm_cmplt_ps(z, depth));
+        if (_mm_movemask_ps(inside) == 0) continue;
+        _mm_storeu_ps(depthRow + x, _mm_or_ps(_mm_and_ps(inside, z), _mm_andnot_ps(inside, depth)));
+      }
+
+      const __m128 invW = _mm_add_ps(iw0, _mm_add_ps(_mm_mul_ps(b1, diw1), _mm_mul_ps(b2, diw2)));
+      const __m128 wRecip = _mm_div_ps(one, invW);
+      __m128i packed = _mm_setzero_si128();
+      for (int c = 0; c < 4; c++) {
+        __m128 v = _mm_mul_ps(_mm_add_ps(c0[c], _mm_add_ps(_mm_mul_ps(b1, dc1[c]), _mm_mul_ps(b2, dc2[c]))), wRecip);
+        v = _mm_min_ps(_mm_max_ps(v, zero), one);
+        __m128i channel = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(v, scale), half));
+        packed = _mm_or_si128(packed, _mm_slli_epi32(channel, 8 * c));
+      }
+      __m128i mask = _mm_castps_si128(inside);
+      __m128i old = _mm_loadu_si128((const __m128i*)(colorRow + x));
+      _mm_storeu_si128((__m128i*)(colorRow + x), _mm_or_si128(_mm_and_si128(mask, packed), _mm_andnot_si128(mask, old)));
+    }
+  }
+#else
+  for (int y = y0; y <= y1; y++) {
+    const float py = (float)y + 0.5f;
+    for (int x = x0; x <= x1; x++) {
+      const float px = (float)x + 0.5f;
+      float w[3];
+      bool inside = true;
+      for (int e = 0; e < 3; e++) {
+        w[e] = tri.edge_a[e] * px + (tri.edge_b[e] * py + tri.edge_c[e]);
+        inside = inside && (w[e] > 0.0f || (w[e] == 0.0f && tri.top_left[e]));
+      }
+      if (!inside) continue;
+
+      const float b1 = w[1] * tri.inv_area;
+      const float b2 = w[2] * tri.inv_area;
+      const size_t pixel = (size_t)y * rs.stride + x;
+      if (rs.depth_test) {
+        float z = tri.z[0] + (b1 * (tri.z[1] - tri.z[0]) + b2 * (tri.z[2] - tri.z[0]));
+        if (!(z < rs.depth[pixel])) continue;
+        rs.depth[pixel] = z;
+      }
+      const float invW = tri.inv_w[0] + (b1 * (tri.inv_w[1] - tri.inv_w[0]) + b2 * (tri.inv_w[2] - tri.inv_w[0]));
+      const float wRecip = 1.0f / invW;
+      float color[4];
+      for (int c = 0; c < 4; c++) {
+        color[c] = (tri.color_w[0][c] + (b1 * (tri.color_w[1][c] - tri.color_w[0][c]) + b2 * (tri.color_w[2][c] - tri.color_w[0][c]))) * wRecip;
+      }
+      rs.color[pixel] = swPackColor(color);
+    }
+  }
+#endif
+}
+
+// Transforms, bins and rasterizes one draw. Draws land in the frame in submission order.
+void swDraw(SwRasterizer& rs, const SwDraw& draw, const SwMVP& mvp) {
+  uint64_t start = timerNanoseconds();
+  float m[16];
+  swCombineMVP(mvp, m);
+
+  const size_t trianglesPerInstance = draw.index_count / 3;
+  const size_t instances = draw.instances != nullptr ? draw.instance_count : 1;
+  const size_t total = trianglesPerInstance * instances;
+  const size_t tileCount = (size_t)rs.tiles_x * rs.tiles_y;
+  const int threads = rs.threads;
+
+  // Stage 1 - thread t owns triangles [total * t / threads, total * (t + 1) / threads)
+  parallelFor((size_t)threads, threads, [&](size_t t) {
+    std::vector<SwTriangle>& tris = rs.triangles[t];
+    std::vector<uint32_t>* bins = &rs.bins[t * tileCount];
+    tris.clear();
+    for (size_t i = 0; i < tileCount; i++) bins[i].clear();
+
+    const size_t first = total * t / threads;
+    const size_t last = total * (t + 1) / threads;
+    for (size_t prim = first; prim < last; prim++) {
+      const size_t instance = prim / trianglesPerInstance;
+      const size_t base = (prim % trianglesPerInstance) * 3;
+      SwClipVertex v[3];
+      for (int k = 0; k < 3; k++) {
+        uint32_t index = draw.indices_32bit ? ((const uint32_t*)draw.indices)[base + k]
+                                            : ((const unsigned short*)draw.indices)[base + k];
+        v[k] = swTransformVertex(draw, m, index, instance);
+      }
+
+      SwTriangle tri;
+      if (!swSetupTriangle(v, rs.width, rs.height, tri)) continue;
+      const uint32_t id = (uint32_t)tris.size();
+      tris.push_back(tri);
+      for (int ty = tri.min_y / SW_TILE_SIZE; ty <= tri.max_y / SW_TILE_SIZE; ty++) {
+        for (int tx = tri.min_x / SW_TILE_SIZE; tx <= tri.max_x / SW_TILE_SIZE; tx++) {
+          bins[(size_t)ty * rs.tiles_x + tx].push_back(id);
+        }
+      }
+    }
+  });
+
+  uint64_t setupDone = timerNanoseconds();
+
+  // Stage 2 - one tile per task, walks thread bins in order so triangle order is kept
+  parallelFor(tileCount, threads, [&](size_t tile) {
+    const int tileX0 = (int)(tile % rs.tiles_x) * SW_TILE_SIZE;
+    const int tileY0 = (int)(tile / rs.tiles_x) * SW_TILE_SIZE;
+    const int tileX1 = (tileX0 + SW_TILE_SIZE < rs.width ? tileX0 + SW_TILE_SIZE : rs.width) - 1;
+    const int tileY1 = (tileY0 + SW_TILE_SIZE < rs.height ? tileY0 + SW_TILE_SIZE : rs.height) - 1;
+    for (int t = 0; t < threads; t++) {
+      const std::vector<uint32_t>& bin = rs.bins[(size_t)t * tileCount + tile];
+      for (uint32_t id : bin) swRasterizeTriangle(rs, rs.triangles[t][id], tileX0, tileY0, tileX1, tileY1);
+    }
+  });
+
+  uint64_t rasterDone = timerNanoseconds();
+  size_t binned = 0;
+  for (int t = 0; t < threads; t++) binned += rs.triangles[t].size();
+  rs.stats.triangles_in += total;
+  rs.stats.triangles_binned += binned;
+  rs.stats.setup_ms += (double)(setupDone - start) / 1000000.0;
+  rs.stats.raster_ms += (double)(rasterDone - setupDone) / 1000000.0;
+}
+
+#endif /* _H_SOFTWARE_SW_RASTERIZER */
@@ -1,12 +1,20 @@
 #ifndef _H_WIN32_PRIMITIVES
 #define _H_WIN32_PRIMITIVES
 
-#include <DirectXMath.h>
+#include "graphics/vertex_formats.cpp"
 
 struct Vertex {
-  DirectX::XMFLOAT3 pos;
-  DirectX::XMFLOAT4 color;
+  Float3 pos;
+  Float4 color;
 };
 
-#endif /* _H_WIN32_PRIMITIVES */
+template <> struct VertexLayout<Vertex> {
+  static constexpr VertexAttrib attribs[] = {
+    VERTEX_ATTRIB(Vertex, pos, "POSITION"),
+    VERTEX_ATTRIB(Vertex, color, "COLOR")
+  };
+};
 
+static_assert(sizeof(Vertex) == sizeof(VertexFloat) && vertexLayoutIsTight<Vertex>(), "Vertex layout");
+
+#endif /* _H_WIN32_PRIMITIVES */
@@ -6,7 +6,10 @@
 #include <d3d12.h>
 #include <dxgi1_6.h>
 
-constexpr UINT BUFFER_COUNT = 2;
+#include "render_pipeline/frame_pacing.cpp"
+
+// One more back buffer than frames in flight, so Present does not block the CPU that runs ahead
+constexpr UINT BUFFER_COUNT = FRAMES_IN_FLIGHT + 1;
 
 
 typedef struct {
@@ -15,7 +18,7 @@ typedef struct {
   Microsoft::WRL::ComPtr<IDXGISwapChain3> swap_chain;
   Microsoft::WRL::ComPtr<ID3D12DescriptorHeap> rtv_heap;
   Microsoft::WRL::ComPtr<ID3D12Resource> render_targets[BUFFER_COUNT];
-  Microsoft::WRL::ComPtr<ID3D12CommandAllocator> command_allocator;
+  Microsoft::WRL::ComPtr<ID3D12CommandAllocator> command_allocators[FRAMES_IN_FLIGHT]; // One per frame slot, reset only after its fence
   Microsoft::WRL::ComPtr<ID3D12RootSignature> root_signature;
   Microsoft::WRL::ComPtr<ID3D12PipelineState> pipeline_state;
   Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList> command_list;
@@ -36,7 +39,7 @@ win32_Shaders shaders   = {0};
 UINT RTV_DESCRIPTOR_SIZE;
 UINT FRAME_INDEX;
 HANDLE g_fenceEvent;
-UINT64 g_fenceValue;
+FramePacer framePacer = {};
 
 #endif /* _H_RENDERER */
 